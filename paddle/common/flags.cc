@@ -483,6 +483,77 @@ PHI_DEFINE_EXPORTED_string(
     "on the same GPU card but may lead to more memory fragmentation "
     "(i.e., maximum batch size of models may be smaller).");
 
+/**
+ * Allocator related FLAG
+ * Name: FLAGS_use_numa_cpu_allocator
+ * Since Version: 3.0
+ * Value Range: bool, default=false
+ * Example:
+ * Note: Whether to serve the CPU memory from an arena per NUMA node. A
+ *       thread takes its memory from the arena of the node it runs on, or
+ *       is bound to, so that the tensors it writes are local to it. It works
+ *       with every allocator_strategy.
+ */
+PHI_DEFINE_EXPORTED_bool(use_numa_cpu_allocator,
+                         false,
+                         "Whether to use an arena per NUMA node for the CPU "
+                         "memory.");
+
+/**
+ * Allocator related FLAG
+ * Name: FLAGS_numa_cpu_allocator_chunk_size_in_mb
+ * Since Version: 3.0
+ * Value Range: uint64, default=64
+ * Example:
+ * Note: The size of the chunks the NUMA CPU allocator takes from a node.
+ */
+PHI_DEFINE_EXPORTED_uint64(numa_cpu_allocator_chunk_size_in_mb,
+                           64,
+                           "The chunk size of the NUMA CPU allocator in MB.");
+
+/**
+ * Allocator related FLAG
+ * Name: FLAGS_use_thread_caching_cpu_allocator
+ * Since Version: 3.0
+ * Value Range: bool, default=false
+ * Example:
+ * Note: Whether to keep the freed small CPU blocks in per-thread freelists
+ *       by size class, in front of the CPU allocator, so that the threads
+ *       of multi-threaded inference do not contend on its locks.
+ */
+PHI_DEFINE_EXPORTED_bool(use_thread_caching_cpu_allocator,
+                         false,
+                         "Whether to cache the small CPU blocks per thread.");
+
+/**
+ * Allocator related FLAG
+ * Name: FLAGS_thread_caching_cpu_allocator_max_size_in_kb
+ * Since Version: 3.0
+ * Value Range: uint64, default=256
+ * Example:
+ * Note: The largest CPU block cached by the thread caching allocator, the
+ *       larger ones go to the CPU allocator directly.
+ */
+PHI_DEFINE_EXPORTED_uint64(thread_caching_cpu_allocator_max_size_in_kb,
+                           256,
+                           "The largest block of the thread caching CPU "
+                           "allocator in KB.");
+
+/**
+ * Allocator related FLAG
+ * Name: FLAGS_thread_caching_cpu_allocator_central_max_size_in_mb
+ * Since Version: 3.0
+ * Value Range: uint64, default=64
+ * Example:
+ * Note: The most bytes kept in the central freelists of the thread caching
+ *       CPU allocator, the blocks the threads give back beyond that are
+ *       freed to the CPU allocator.
+ */
+PHI_DEFINE_EXPORTED_uint64(thread_caching_cpu_allocator_central_max_size_in_mb,
+                           64,
+                           "The most bytes of the central freelists of the "
+                           "thread caching CPU allocator in MB.");
+
 /**
  * Memory related FLAG
  * Name: FLAGS_fraction_of_cpu_memory_to_use
@@ -875,6 +946,36 @@ PHI_DEFINE_EXPORTED_bool(graph_load_in_parallel,
                          "It controls whether load graph node and edge with "
                          "multi threads parallelly.");
 
+/**
+ * Distributed related FLAG
+ * Name: FLAGS_graph_csr_storage
+ * Since Version: 3.0.0
+ * Value Range: bool, default=false
+ * Example:
+ * Note: Control whether the shards of GraphTable are converted into immutable
+ *       compressed sparse row storage after loading edges and nodes, which
+ *       saves the per node objects and samplers.
+ */
+PHI_DEFINE_EXPORTED_bool(graph_csr_storage,
+                         false,
+                         "It controls whether the graph shards are stored in "
+                         "compressed sparse row format after loading.");
+
+/**
+ * Distributed related FLAG
+ * Name: FLAGS_graph_neighbor_sample_cache_value_bytes
+ * Since Version: 3.0.0
+ * Value Range: int32, default=512
+ * Example:
+ * Note: The bytes reserved for each result in the neighbor sample cache of
+ *       GraphTable. Larger results, e.g. of bigger sample sizes, are not
+ *       cached.
+ */
+PHI_DEFINE_EXPORTED_int32(graph_neighbor_sample_cache_value_bytes,
+                          512,
+                          "The bytes reserved for each cached neighbor "
+                          "sample result.");
+
 /**
  * Distributed related FLAG
  * Name: FLAGS_enable_neighbor_list_use_uva
@@ -1217,6 +1318,13 @@ PD_DEFINE_bool(enable_slotrecord_reset_shrink,  // NOLINT
 PD_DEFINE_bool(enable_ins_parser_file,  // NOLINT
                false,
                "enable parser ins file, default false");
+PD_DEFINE_bool(dataset_pipeline_load,  // NOLINT
+               false,
+               "InMemoryDataset loads and local shuffles with chunked tasks "
+               "on a shared work-stealing pool, default false");
+PD_DEFINE_int32(dataset_pipeline_chunk_lines,
+                1024,
+                "lines parsed by one task when dataset_pipeline_load is on");
 PHI_DEFINE_EXPORTED_bool(
     gpugraph_enable_hbm_table_collision_stat,
     false,
@@ -14,6 +14,12 @@
 
 #pragma once
 #include <glog/logging.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
 #include "paddle/fluid/platform/enforce.h"
 
 namespace paddle {
@@ -107,5 +113,144 @@ class ChunkAllocator {
   }
 };
 
+// Arena for fixed-stride float blocks, grouped into one size class per
+// dimension. Blocks of the same dimension are carved contiguously out of
+// cache-line aligned chunks, so values of one accessor are packed densely
+// instead of being scattered over the heap with a malloc header each.
+//
+// All chunks of a size class have the same power of two size and are aligned
+// to it, and a chunk starts with a pointer to its arena. So the arena of a
+// block is found from the block address and the chunk shift returned by
+// acquire(), without keeping a pointer next to every block.
+// Not thread-safe: every sparse table shard owns its own arena.
+class FeatureValueArena {
+ public:
+  static constexpr size_t kAlignment = 64;
+  static constexpr size_t kChunkBytes = 64 * 1024;
+
+  FeatureValueArena() = default;
+  FeatureValueArena(const FeatureValueArena&) = delete;
+  FeatureValueArena& operator=(const FeatureValueArena&) = delete;
+  ~FeatureValueArena() { clear(); }
+
+  // Returns an uninitialized block able to hold `dim` floats, and the log2
+  // size of its chunk in `chunk_shift` if not null.
+  float* acquire(size_t dim, uint32_t* chunk_shift = nullptr) {
+    SizeClass& sc = size_class(dim);
+    Node* node = sc.free_nodes;
+    if (node != nullptr) {
+      sc.free_nodes = node->next;
+    } else {
+      if (sc.bump_left < sc.stride) {
+        create_new_chunk(&sc);
+      }
+      node = reinterpret_cast<Node*>(sc.bump);
+      sc.bump += sc.stride;
+      sc.bump_left -= sc.stride;
+    }
+    ++sc.used;
+    _used_bytes += sc.stride;
+    if (chunk_shift != nullptr) {
+      *chunk_shift = sc.chunk_shift;
+    }
+    return reinterpret_cast<float*>(node);
+  }
+
+  // Gives back a block previously returned by acquire(dim).
+  void release(float* ptr, size_t dim) {
+    SizeClass& sc = *_classes[dim];
+    Node* node = reinterpret_cast<Node*>(ptr);
+    node->next = sc.free_nodes;
+    sc.free_nodes = node;
+    --sc.used;
+    _used_bytes -= sc.stride;
+  }
+
+  // The arena holding a block acquired with the given chunk shift.
+  static FeatureValueArena* owner(const void* ptr, uint32_t chunk_shift) {
+    uintptr_t chunk = reinterpret_cast<uintptr_t>(ptr) &
+                      ~((static_cast<uintptr_t>(1) << chunk_shift) - 1);
+    return *reinterpret_cast<FeatureValueArena**>(chunk);
+  }
+
+  void clear() {
+    for (auto& sc : _classes) {
+      if (sc == nullptr) continue;
+      for (char* chunk : sc->chunks) {
+        free(chunk);
+      }
+    }
+    _classes.clear();
+    _used_bytes = 0;
+    _reserved_bytes = 0;
+  }
+
+  // Bytes held by live blocks.
+  size_t used_bytes() const { return _used_bytes; }
+  // Bytes obtained from the system, including free and not yet carved space.
+  size_t reserved_bytes() const { return _reserved_bytes; }
+  // Ratio of reserved bytes that are not in use, a hint for compaction.
+  double fragmentation() const {
+    if (_reserved_bytes == 0) return 0.0;
+    return 1.0 - static_cast<double>(_used_bytes) / _reserved_bytes;
+  }
+
+ private:
+  struct Node {
+    Node* next;
+  };
+  struct SizeClass {
+    size_t stride = 0;           // bytes per block
+    uint32_t chunk_shift = 0;    // log2 of the chunk size
+    Node* free_nodes = nullptr;  // a list of released blocks
+    char* bump = nullptr;        // carving point of last chunk
+    size_t bump_left = 0;
+    size_t used = 0;  // how many blocks are acquired
+    std::vector<char*> chunks;
+  };
+
+  std::vector<std::unique_ptr<SizeClass>> _classes;  // indexed by dim
+  size_t _used_bytes = 0;
+  size_t _reserved_bytes = 0;
+
+  SizeClass& size_class(size_t dim) {
+    if (dim >= _classes.size()) {
+      _classes.resize(dim + 1);
+    }
+    if (_classes[dim] == nullptr) {
+      _classes[dim].reset(new SizeClass());
+      // keep every block 8-byte aligned and big enough for a free list node
+      size_t stride = std::max(dim * sizeof(float), sizeof(Node));
+      _classes[dim]->stride = (stride + sizeof(Node) - 1) & ~(sizeof(Node) - 1);
+      // a chunk holds its arena pointer and at least one block
+      uint32_t shift = 0;
+      while ((static_cast<size_t>(1) << shift) <
+             std::max(kChunkBytes, kAlignment + _classes[dim]->stride)) {
+        ++shift;
+      }
+      _classes[dim]->chunk_shift = shift;
+    }
+    return *_classes[dim];
+  }
+
+  void create_new_chunk(SizeClass* sc) {
+    size_t alloc_size = static_cast<size_t>(1) << sc->chunk_shift;
+    char* chunk = nullptr;
+    int error = posix_memalign(
+        reinterpret_cast<void**>(&chunk), alloc_size, alloc_size);
+    PADDLE_ENFORCE_EQ(error,
+                      0,
+                      common::errors::ResourceExhausted(
+                          "Fail to alloc memory of %ld size, error code is %d.",
+                          alloc_size,
+                          error));
+    *reinterpret_cast<FeatureValueArena**>(chunk) = this;
+    sc->chunks.push_back(chunk);
+    sc->bump = chunk + kAlignment;
+    sc->bump_left = alloc_size - kAlignment;
+    _reserved_bytes += alloc_size;
+  }
+};
+
 }  // namespace distributed
 }  // namespace paddle
@@ -0,0 +1,87 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace paddle {
+namespace distributed {
+
+// Count-min sketch of key frequencies with 8-bit saturating counters. All
+// counters are halved once `sample_size` increments were recorded, so the
+// estimate follows recent popularity (the aging step of TinyLFU).
+class FrequencySketch {
+ public:
+  static constexpr int kDepth = 4;
+
+  explicit FrequencySketch(size_t expected_keys) {
+    size_t width = 1024;
+    while (width < expected_keys) {
+      width <<= 1;
+    }
+    _mask = width - 1;
+    _table.assign(width * kDepth, 0);
+    _sample_size = width * 10;
+  }
+
+  void Increment(uint64_t key) {
+    for (int i = 0; i < kDepth; ++i) {
+      uint8_t& counter = _table[Index(key, i)];
+      if (counter < UINT8_MAX) {
+        ++counter;
+      }
+    }
+    if (++_additions >= _sample_size) {
+      for (auto& counter : _table) {
+        counter >>= 1;
+      }
+      _additions /= 2;
+    }
+  }
+
+  uint32_t Estimate(uint64_t key) const {
+    uint32_t freq = UINT8_MAX;
+    for (int i = 0; i < kDepth; ++i) {
+      freq = std::min<uint32_t>(freq, _table[Index(key, i)]);
+    }
+    return freq;
+  }
+
+  void Clear() {
+    std::fill(_table.begin(), _table.end(), 0);
+    _additions = 0;
+  }
+
+ private:
+  size_t Index(uint64_t key, int row) const {
+    static const uint64_t seeds[kDepth] = {0x9E3779B97F4A7C15ULL,
+                                           0xC2B2AE3D27D4EB4FULL,
+                                           0x165667B19E3779F9ULL,
+                                           0xD6E8FEB86659FD93ULL};
+    uint64_t h = (key + row) * seeds[row];
+    h ^= h >> 32;
+    return row * (_mask + 1) + (h & _mask);
+  }
+
+  std::vector<uint8_t> _table;
+  size_t _mask;
+  size_t _sample_size;
+  size_t _additions = 0;
+};
+
+}  // namespace distributed
+}  // namespace paddle
@@ -42,6 +42,8 @@ COMMON_DECLARE_int32(gpugraph_storage_mode);
 COMMON_DECLARE_uint64(gpugraph_slot_feasign_max_num);
 COMMON_DECLARE_bool(graph_metapath_split_opt);
 COMMON_DECLARE_double(graph_neighbor_size_percent);
+COMMON_DECLARE_bool(graph_csr_storage);
+COMMON_DECLARE_int32(graph_neighbor_sample_cache_value_bytes);
 
 PHI_DEFINE_EXPORTED_bool(graph_edges_split_only_by_src_id,
                          false,
@@ -820,16 +822,16 @@ int32_t GraphTable::dump_edges_to_ssd(int idx) {
     tasks.push_back(_shards_task_pool[i % task_pool_size_]->enqueue(
         [&, i, this]() -> int64_t {
           int64_t cost = 0;
-          std::vector<Node *> &v = shards[i]->get_bucket();
-          for (size_t j = 0; j < v.size(); j++) {
+          auto *shard = shards[i];
+          for (size_t j = 0; j < shard->get_size(); j++) {
             std::vector<uint64_t> s;
-            for (size_t k = 0; k < v[j]->get_neighbor_size(); k++) {
-              s.push_back(v[j]->get_neighbor_id(k));
+            for (size_t k = 0; k < shard->get_neighbor_size(j); k++) {
+              s.push_back(shard->get_neighbor_id(j, k));
             }
-            cost += v[j]->get_neighbor_size() * sizeof(uint64_t);
+            cost += shard->get_neighbor_size(j) * sizeof(uint64_t);
             add_node_to_ssd(0,
                             idx,
-                            v[j]->get_id(),
+                            shard->get_node_id(j),
                             (char *)(s.data()),  // NOLINT
                             s.size() * sizeof(uint64_t));
           }
@@ -848,12 +850,11 @@ int32_t GraphTable::make_complementary_graph(int idx, int64_t byte_size) {
   for (size_t i = 0; i < shards.size(); ++i) {
     tasks.push_back(
         _shards_task_pool[i % task_pool_size_]->enqueue([&, i, this]() -> int {
-          std::vector<Node *> &v = shards[i]->get_bucket();
+          auto *shard = shards[i];
           size_t ind = i % this->task_pool_size_;
-          for (size_t j = 0; j < v.size(); j++) {
-            // size_t location = v[j]->get_id();
-            for (size_t k = 0; k < v[j]->get_neighbor_size(); k++) {
-              count[ind][v[j]->get_neighbor_id(k)]++;
+          for (size_t j = 0; j < shard->get_size(); j++) {
+            for (size_t k = 0; k < shard->get_neighbor_size(j); k++) {
+              count[ind][shard->get_neighbor_id(j, k)]++;
             }
           }
           return 0;
@@ -894,10 +895,7 @@ int32_t GraphTable::make_complementary_graph(int idx, int64_t byte_size) {
   }
   std::string sample_type = "random";
   for (auto &shard : edge_shards[idx]) {
-    auto bucket = shard->get_bucket();
-    for (size_t i = 0; i < bucket.size(); i++) {
-      bucket[i]->build_sampler(sample_type);
-    }
+    shard->build_sampler(sample_type);
   }
 
   return 0;
@@ -905,6 +903,15 @@ int32_t GraphTable::make_complementary_graph(int idx, int64_t byte_size) {
 
 void GraphTable::graph_partition(bool is_edge) {
   std::string mode = FLAGS_graph_edges_split_mode;
+  // the partitions look up nodes across shards from many threads and delete
+  // the nodes of other ranks, so shards in csr storage go back to nodes
+  // before any of them starts
+  auto &shards = is_edge ? edge_shards : feature_shards;
+  for (size_t idx = 0; idx < shards.size(); ++idx) {
+    release_csr(is_edge ? GraphTableType::EDGE_TABLE
+                        : GraphTableType::FEATURE_TABLE,
+                idx);
+  }
   if (mode == "dbh" || mode == "DBH") {
     VLOG(0) << "Graph partitioning DBH";
     if (is_edge) {
@@ -1690,20 +1697,53 @@ void GraphTable::clear_graph() {
   VLOG(0) << "begin clear_graph";
   clear_edge_shard();
   clear_feature_shard();
+  if (sample_cache != nullptr) {
+    VLOG(0) << "neighbor sample cache "
+            << sample_cache->get_stats().ToString();
+    sample_cache->clear();
+  }
   VLOG(0) << "finish clear_graph";
 }
 
-std::vector<Node *> GraphShard::get_batch(int start, int end, int step) {
-  if (start < 0) start = 0;
-  std::vector<Node *> res;
-  for (int pos = start; pos < std::min(end, static_cast<int>(bucket.size()));
-       pos += step) {
-    res.push_back(bucket[pos]);
+size_t GraphShard::get_size() {
+  return csr != nullptr ? csr->size() : bucket.size();
+}
+
+bool GraphShard::build_csr(const std::string &sample_type) {
+  if (csr != nullptr) {
+    return true;
   }
-  return res;
+  std::unique_ptr<GraphCsrStorage> storage(new GraphCsrStorage());
+  if (!storage->build(bucket, sample_type)) {
+    return false;
+  }
+  for (auto &item : bucket) {
+    delete item;
+  }
+  std::vector<Node *>().swap(bucket);
+  csr = std::move(storage);
+  return true;
 }
 
-size_t GraphShard::get_size() { return bucket.size(); }
+void GraphShard::release_csr() {
+  std::lock_guard<std::mutex> guard(csr_mutex);
+  if (csr == nullptr) {
+    return;
+  }
+  VLOG(1) << "GraphShard release csr storage of " << csr->size() << " nodes";
+  bucket = csr->to_nodes();
+  csr.reset();
+}
+
+void GraphShard::build_sampler(const std::string &sample_type) {
+  if (csr != nullptr) {
+    csr->set_sample_type(sample_type);
+    return;
+  }
+  for (auto item : bucket) {
+    item->build_sampler(sample_type);
+  }
+}
 
 int32_t GraphTable::add_comm_edge(int idx, uint64_t src_id, uint64_t dst_id) {
   size_t src_shard_id = src_id % shard_num;
@@ -1777,6 +1817,7 @@ void GraphShard::clear() {
   }
   bucket.clear();
   node_location.clear();
+  csr.reset();
 }
 
 GraphShard::~GraphShard() { clear(); }
@@ -1784,6 +1825,7 @@ GraphShard::~GraphShard() { clear(); }
 void GraphShard::delete_node(uint64_t id) {
   auto iter = node_location.find(id);
   if (iter == node_location.end()) return;
+  release_csr();
   int pos = iter->second;
   delete bucket[pos];
   if (pos != static_cast<int>(bucket.size()) - 1) {
@@ -1794,6 +1836,7 @@ void GraphShard::delete_node(uint64_t id) {
   bucket.pop_back();
 }
 GraphNode *GraphShard::add_graph_node(uint64_t id) {
+  release_csr();
   if (node_location.find(id) == node_location.end()) {
     node_location[id] = bucket.size();
     bucket.push_back(new GraphNode(id));
@@ -1802,6 +1845,7 @@ GraphNode *GraphShard::add_graph_node(uint64_t id) {
 }
 
 GraphNode *GraphShard::add_graph_node(Node *node) {
+  release_csr();
   auto id = node->get_id();
   if (node_location.find(id) == node_location.end()) {
     node_location[id] = bucket.size();
@@ -1813,6 +1857,7 @@ GraphNode *GraphShard::add_graph_node(Node *node) {
 FeatureNode *GraphShard::add_feature_node(uint64_t id,
                                           bool is_overlap,
                                           int float_fea_num) {
+  release_csr();
   if (node_location.find(id) == node_location.end()) {
     node_location[id] = bucket.size();
     if (float_fea_num > 0) {
@@ -1829,10 +1874,12 @@ FeatureNode *GraphShard::add_feature_node(uint64_t id,
 }
 
 void GraphShard::add_neighbor(uint64_t id, uint64_t dst_id, float weight) {
+  release_csr();
   find_node(id)->add_edge(dst_id, weight);
 }
 
 Node *GraphShard::find_node(uint64_t id) {
+  release_csr();
   auto iter = node_location.find(id);
   return iter == node_location.end() ? nullptr : bucket[iter->second];
 }
@@ -2444,6 +2491,10 @@ int32_t GraphTable::load_nodes(const std::string &path,
   uint64_t count = 0;
   uint64_t valid_count = 0;
   int idx = 0;
+  // the loaders add nodes concurrently, restore them first
+  for (size_t i = 0; i < feature_shards.size(); ++i) {
+    release_csr(GraphTableType::FEATURE_TABLE, i);
+  }
   if (FLAGS_graph_load_in_parallel) {
     if (node_type.empty()) {
       VLOG(0) << "Begin GraphTable::load_nodes(), will load all node_type once";
@@ -2489,15 +2540,17 @@ int32_t GraphTable::load_nodes(const std::string &path,
 
   VLOG(0) << valid_count << "/" << count << " nodes in node_type[" << node_type
           << "] are loaded successfully!";
+  if (FLAGS_graph_csr_storage) {
+    for (size_t i = 0; i < feature_shards.size(); ++i) {
+      build_csr(GraphTableType::FEATURE_TABLE, i);
+    }
+  }
   return 0;
 }
 
 int32_t GraphTable::build_sampler(int idx, std::string sample_type) {
   for (auto &shard : edge_shards[idx]) {
-    auto bucket = shard->get_bucket();
-    for (auto item : bucket) {
-      item->build_sampler(sample_type);
-    }
+    shard->build_sampler(sample_type);
   }
   return 0;
 }
@@ -2609,6 +2662,8 @@ std::pair<uint64_t, uint64_t> GraphTable::load_edges(
   uint64_t valid_count = 0;
 
   VLOG(0) << "Begin GraphTable::load_edges() edge_type[" << edge_type << "]";
+  // the loaders add edges concurrently, restore the nodes first
+  release_csr(GraphTableType::EDGE_TABLE, idx);
   if (FLAGS_graph_load_in_parallel) {
     std::vector<std::future<std::pair<uint64_t, uint64_t>>> tasks;
     for (size_t i = 0; i < paths.size(); i++) {
@@ -2651,14 +2706,15 @@ std::pair<uint64_t, uint64_t> GraphTable::load_edges(
     // In order not to affect the sampler function of other scenario,
     // this optimization is only performed in load_edges function.
     VLOG(0) << "run in gpugraph mode!";
+  } else if (FLAGS_graph_csr_storage) {
+    // samples uniformly like the random samplers built otherwise
+    VLOG(0) << "build csr storage ... ";
+    build_csr(GraphTableType::EDGE_TABLE, idx);
   } else {
     std::string sample_type = "random";
     VLOG(0) << "build sampler ... ";
     for (auto &shard : edge_shards[idx]) {
-      auto bucket = shard->get_bucket();
-      for (auto item : bucket) {
-        item->build_sampler(sample_type);
-      }
+      shard->build_sampler(sample_type);
     }
   }
 
@@ -2704,6 +2760,61 @@ Node *GraphTable::find_node(GraphTableType table_type, int idx, uint64_t id) {
   Node *node = search_shards[index]->find_node(id);
   return node;
 }
+GraphShard *GraphTable::find_shard(GraphTableType table_type,
+                                   int idx,
+                                   uint64_t id) {
+  size_t shard_id = id % shard_num;
+  if (shard_id >= shard_end || shard_id < shard_start) {
+    return nullptr;
+  }
+  auto &search_shards =
+      table_type == GraphTableType::EDGE_TABLE      ? edge_shards[idx]
+      : table_type == GraphTableType::FEATURE_TABLE ? feature_shards[idx]
+                                                    : node_shards[idx];
+  return search_shards[shard_id - shard_start];
+}
+
+int32_t GraphTable::build_csr(GraphTableType table_type, int idx) {
+  auto &shards =
+      table_type == GraphTableType::EDGE_TABLE      ? edge_shards[idx]
+      : table_type == GraphTableType::FEATURE_TABLE ? feature_shards[idx]
+                                                    : node_shards[idx];
+  std::vector<std::future<int>> tasks;
+  for (size_t i = 0; i < shards.size(); ++i) {
+    tasks.push_back(_shards_task_pool[i % task_pool_size_]->enqueue(
+        [&shards, i]() -> int { return shards[i]->build_csr() ? 0 : 1; }));
+  }
+  int failed = 0;
+  for (auto &task : tasks) {
+    failed += task.get();
+  }
+  if (failed > 0) {
+    LOG(WARNING) << failed << " shards of table_type["
+                 << static_cast<int>(table_type) << "] idx[" << idx
+                 << "] can not be stored in csr, keep their nodes";
+  }
+  return 0;
+}
+
+int32_t GraphTable::release_csr(GraphTableType table_type, int idx) {
+  auto &shards =
+      table_type == GraphTableType::EDGE_TABLE      ? edge_shards[idx]
+      : table_type == GraphTableType::FEATURE_TABLE ? feature_shards[idx]
+                                                    : node_shards[idx];
+  std::vector<std::future<int>> tasks;
+  for (size_t i = 0; i < shards.size(); ++i) {
+    tasks.push_back(
+        _shards_task_pool[i % task_pool_size_]->enqueue([&shards, i]() -> int {
+          shards[i]->release_csr();
+          return 0;
+        }));
+  }
+  for (auto &task : tasks) {
+    task.get();
+  }
+  return 0;
+}
+
 uint32_t GraphTable::get_thread_pool_index(uint64_t node_id) {
   return node_id % shard_num % shard_num_per_server % task_pool_size_;
 }
@@ -2794,6 +2905,26 @@ int32_t GraphTable::random_sample_nodes(GraphTableType table_type,
   memcpy(pointer, res.data(), actual_size);
   return 0;
 }
+int32_t GraphTable::make_neighbor_sample_cache(size_t size_limit,
+                                               size_t ttl) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (sample_cache == nullptr) {
+    sample_cache = std::make_shared<NeighborSampleCache>(
+        task_pool_size_,
+        size_limit,
+        ttl,
+        FLAGS_graph_neighbor_sample_cache_value_bytes);
+    use_cache = true;
+  }
+  return 0;
+}
+
+NeighborSampleCache::Stats GraphTable::get_neighbor_sample_cache_stats() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return sample_cache == nullptr ? NeighborSampleCache::Stats()
+                                 : sample_cache->get_stats();
+}
+
 int32_t GraphTable::random_sample_neighbors(
     int idx,
     uint64_t *node_ids,
@@ -2821,7 +2952,7 @@ int32_t GraphTable::random_sample_neighbors(
       LRUResponse response = LRUResponse::blocked;
       if (use_cache) {
         response =
-            scaled_lru->query(i, id_list[i].data(), id_list[i].size(), r);
+            sample_cache->query(i, id_list[i].data(), id_list[i].size(), &r);
       }
       size_t index = 0;
       std::vector<SampleResult> sample_res;
@@ -2836,10 +2967,12 @@ int32_t GraphTable::random_sample_neighbors(
           index++;
         } else {
           node_id = id_list[i][k].node_key;
-          Node *node = find_node(GraphTableType::EDGE_TABLE, idx, node_id);
+          GraphShard *shard =
+              find_shard(GraphTableType::EDGE_TABLE, idx, node_id);
+          int pos = shard == nullptr ? -1 : shard->find_node_pos(node_id);
           int idy = seq_id[i][k];
           int &actual_size = actual_sizes[idy];
-          if (node == nullptr) {
+          if (pos < 0) {
 #ifdef PADDLE_WITH_HETERPS
             if (search_level == 2) {
               VLOG(2) << "enter sample from ssd for node_id " << node_id;
@@ -2856,8 +2989,13 @@ int32_t GraphTable::random_sample_neighbors(
             actual_size = 0;
             continue;
           }
+          // shards in csr storage are sampled without Node objects
+          const GraphCsrStorage *csr = shard->get_csr();
+          Node *node = csr == nullptr ? shard->get_bucket()[pos] : nullptr;
           std::shared_ptr<char> &buffer = buffers[idy];
-          std::vector<int> res = node->sample_k(sample_size, rng);
+          std::vector<int> res = csr != nullptr
+                                     ? csr->sample_k(pos, sample_size, rng)
+                                     : node->sample_k(sample_size, rng);
           actual_size =
               res.size() * (need_weight ? (Node::id_size + Node::weight_size)
                                         : Node::id_size);
@@ -2873,12 +3011,14 @@ int32_t GraphTable::random_sample_neighbors(
             buffer.reset(buffer_addr, char_del);
           }
           for (int &x : res) {
-            id = node->get_neighbor_id(x);
+            id = csr != nullptr ? csr->get_neighbor_id(pos, x)
+                                : node->get_neighbor_id(x);
             memcpy(buffer_addr + offset, &id, Node::id_size);
             offset += Node::id_size;
             if (need_weight) {
 #if defined(PADDLE_WITH_HETERPS) && defined(PADDLE_WITH_PSCORE)
-              weight = node->get_neighbor_weight(x);
+              weight = csr != nullptr ? csr->get_neighbor_weight(pos, x)
+                                      : node->get_neighbor_weight(x);
 #else
               weight = 1.0;
 #endif
@@ -2889,7 +3029,7 @@ int32_t GraphTable::random_sample_neighbors(
         }
       }
       if (!sample_res.empty()) {
-        scaled_lru->insert(
+        sample_cache->insert(
             i, sample_keys.data(), sample_res.data(), sample_keys.size());
       }
       return 0;
@@ -2965,18 +3105,23 @@ int32_t GraphTable::get_node_feat(int idx,
     uint64_t node_id = node_ids[idy];
     tasks.push_back(_shards_task_pool[get_thread_pool_index(node_id)]->enqueue(
         [&, idx, idy, node_id]() -> int {
-          Node *node = find_node(GraphTableType::FEATURE_TABLE, idx, node_id);
-
-          if (node == nullptr) {
+          GraphShard *shard =
+              find_shard(GraphTableType::FEATURE_TABLE, idx, node_id);
+          int pos = shard == nullptr ? -1 : shard->find_node_pos(node_id);
+          if (pos < 0) {
             return 0;
           }
+          const GraphCsrStorage *csr = shard->get_csr();
+          Node *node = csr == nullptr ? shard->get_bucket()[pos] : nullptr;
           for (size_t feat_idx = 0; feat_idx < feature_names.size();
                ++feat_idx) {
             const std::string &feature_name = feature_names[feat_idx];
             if (feat_id_map[idx].find(feature_name) != feat_id_map[idx].end()) {
               // res[feat_idx][idx] =
               // node->get_feature(feat_id_map[feature_name]);
-              auto feat = node->get_feature(feat_id_map[idx][feature_name]);
+              int feature_idx = feat_id_map[idx][feature_name];
+              auto feat = csr != nullptr ? csr->get_feature(pos, feature_idx)
+                                         : node->get_feature(feature_idx);
               res[feat_idx][idy] = feat;
             }
           }
@@ -3344,7 +3489,14 @@ int32_t GraphTable::pull_graph_list(GraphTableType table_type,
       table_type == GraphTableType::EDGE_TABLE      ? edge_shards[idx]
       : table_type == GraphTableType::FEATURE_TABLE ? feature_shards[idx]
                                                     : node_shards[idx];
-  std::vector<std::future<std::vector<Node *>>> tasks;
+  // the nodes start, start + step, ... of every shard, read by position so
+  // that shards in csr storage are served without creating nodes
+  struct Batch {
+    GraphShard *shard;
+    int start;
+    int end;
+  };
+  std::vector<Batch> batches;
   for (size_t i = 0; i < search_shards.size() && total_size > 0; i++) {
     cur_size = search_shards[i]->get_size();
     if (size + cur_size <= start) {
@@ -3353,32 +3505,24 @@ int32_t GraphTable::pull_graph_list(GraphTableType table_type,
     }
     int count = std::min(1 + (size + cur_size - start - 1) / step, total_size);
     int end = start + (count - 1) * step + 1;
-    tasks.push_back(_shards_task_pool[i % task_pool_size_]->enqueue(
-        [&search_shards, i, start, end, step, size]() -> std::vector<Node *> {
-          return search_shards[i]->get_batch(start - size, end - size, step);
-        }));
+    batches.push_back({search_shards[i], start - size, end - size});
     start += count * step;
     total_size -= count;
     size += cur_size;
   }
-  for (auto &task : tasks) {
-    task.wait();
-  }
   size = 0;
-  std::vector<std::vector<Node *>> res;
-  for (auto &task : tasks) {
-    res.push_back(task.get());
-    for (auto &item : res.back()) {
-      size += item->get_size(need_feature);
+  for (auto &batch : batches) {
+    for (int pos = batch.start; pos < batch.end; pos += step) {
+      size += batch.shard->get_node_buffer_size(pos, need_feature);
     }
   }
   char *buffer_addr = new char[size];
   buffer.reset(buffer_addr);
   int index = 0;
-  for (auto &items : res) {
-    for (size_t j = 0; j < items.size(); j++) {
-      items[j]->to_buffer(buffer_addr + index, need_feature);
-      index += items[j]->get_size(need_feature);
+  for (auto &batch : batches) {
+    for (int pos = batch.start; pos < batch.end; pos += step) {
+      batch.shard->node_to_buffer(pos, buffer_addr + index, need_feature);
+      index += batch.shard->get_node_buffer_size(pos, need_feature);
     }
   }
   actual_size = size;
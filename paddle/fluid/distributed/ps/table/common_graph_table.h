@@ -42,7 +42,9 @@
 #include "paddle/fluid/distributed/ps/table/accessor.h"
 #include "paddle/fluid/distributed/ps/table/common_table.h"
 #include "paddle/fluid/distributed/ps/table/graph/class_macro.h"
+#include "paddle/fluid/distributed/ps/table/graph/graph_csr.h"
 #include "paddle/fluid/distributed/ps/table/graph/graph_node.h"
+#include "paddle/fluid/distributed/ps/table/graph/graph_sample_cache.h"
 #include "paddle/fluid/distributed/ps/thirdparty/round_robin.h"
 #include "paddle/phi/core/utils/rw_lock.h"
 #include "paddle/utils/string/string_helper.h"
@@ -58,23 +60,51 @@ class GraphShard {
   size_t get_size();
   GraphShard() {}
   ~GraphShard();
-  std::vector<Node *> &get_bucket() { return bucket; }
-  std::vector<Node *> get_batch(int start, int end, int step);
+  // The nodes of the shard. A shard in csr storage creates them back first
+  // and stays in node storage, like when a node is added or deleted. The
+  // accessors by position below read either storage.
+  std::vector<Node *> &get_bucket() {
+    release_csr();
+    return bucket;
+  }
+  uint64_t get_node_id(size_t pos) {
+    return csr != nullptr ? csr->get_id(pos) : bucket[pos]->get_id();
+  }
+  size_t get_neighbor_size(size_t pos) {
+    return csr != nullptr ? csr->get_neighbor_size(pos)
+                          : bucket[pos]->get_neighbor_size();
+  }
+  uint64_t get_neighbor_id(size_t pos, size_t idx) {
+    return csr != nullptr ? csr->get_neighbor_id(pos, idx)
+                          : bucket[pos]->get_neighbor_id(idx);
+  }
+  // Same as Node::get_size and Node::to_buffer of the node at `pos`.
+  int get_node_buffer_size(size_t pos, bool need_feature) {
+    return csr != nullptr ? csr->get_buffer_size(pos, need_feature)
+                          : bucket[pos]->get_size(need_feature);
+  }
+  void node_to_buffer(size_t pos, char *buffer, bool need_feature) {
+    if (csr != nullptr) {
+      csr->to_buffer(pos, buffer, need_feature);
+    } else {
+      bucket[pos]->to_buffer(buffer, need_feature);
+    }
+  }
   void get_ids_by_range(int start, int end, std::vector<uint64_t> *res) {
     res->reserve(res->size() + end - start);
-    for (int i = start; i < end && i < static_cast<int>(bucket.size()); i++) {
-      res->emplace_back(bucket[i]->get_id());
+    for (int i = start; i < end && i < static_cast<int>(get_size()); i++) {
+      res->emplace_back(get_node_id(i));
     }
   }
   size_t get_all_id(std::vector<std::vector<uint64_t>> *shard_keys,
                     int slice_num) {
-    int bucket_num = bucket.size();
+    int bucket_num = get_size();
     shard_keys->resize(slice_num);
     for (int i = 0; i < slice_num; ++i) {
       (*shard_keys)[i].reserve(bucket_num / slice_num);
     }
     for (int i = 0; i < bucket_num; i++) {
-      uint64_t k = bucket[i]->get_id();
+      uint64_t k = get_node_id(i);
       (*shard_keys)[k % slice_num].emplace_back(k);
     }
     return bucket_num;
@@ -82,6 +112,10 @@ class GraphShard {
   size_t get_all_neighbor_id(std::vector<std::vector<uint64_t>> *total_res,
                              int slice_num) {
     std::vector<uint64_t> keys;
+    if (csr != nullptr) {
+      keys = csr->get_neighbor_ids();
+      return dedup2shard_keys(&keys, total_res, slice_num);
+    }
     for (size_t i = 0; i < bucket.size(); i++) {
       size_t neighbor_size = bucket[i]->get_neighbor_size();
       size_t n = keys.size();
@@ -95,6 +129,12 @@ class GraphShard {
   size_t get_all_feature_ids(std::vector<std::vector<uint64_t>> *total_res,
                              int slice_num) {
     std::vector<uint64_t> keys;
+    if (csr != nullptr) {
+      for (size_t i = 0; i < csr->size(); i++) {
+        csr->get_feature_ids(i, &keys);
+      }
+      return dedup2shard_keys(&keys, total_res, slice_num);
+    }
     for (size_t i = 0; i < bucket.size(); i++) {
       bucket[i]->get_feature_ids(&keys);
     }
@@ -130,11 +170,34 @@ class GraphShard {
   void delete_node(uint64_t id);
   void clear();
   void add_neighbor(uint64_t id, uint64_t dst_id, float weight);
+  // Moves the nodes into an immutable GraphCsrStorage and frees them, the
+  // positions in node_location are kept. The storage samples like samplers
+  // of `sample_type`. Returns false if the nodes can not be stored in csr,
+  // and the shard is unchanged.
+  bool build_csr(const std::string &sample_type = "random");
+  // Creates the nodes back from the csr storage, with samplers of its sample
+  // type. The functions adding, deleting or handing out nodes call it, so
+  // that incremental loads keep working. Concurrent calls create the nodes
+  // once, but must not overlap with reads of the csr storage.
+  void release_csr();
+  // Builds the samplers of the nodes, or sets the sample type of the csr
+  // storage.
+  void build_sampler(const std::string &sample_type);
+  bool is_csr() const { return csr != nullptr; }
+  const GraphCsrStorage *get_csr() const { return csr.get(); }
+  // The position of `id` in the bucket or the csr storage, -1 if missing.
+  int find_node_pos(uint64_t id) {
+    auto iter = node_location.find(id);
+    return iter == node_location.end() ? -1 : iter->second;
+  }
   std::unordered_map<uint64_t, int> &get_node_location() {
     return node_location;
   }
 
   void shrink_to_fit() {
+    if (csr != nullptr) {
+      return;
+    }
     bucket.shrink_to_fit();
     for (size_t i = 0; i < bucket.size(); i++) {
       bucket[i]->shrink_to_fit();
@@ -142,6 +205,8 @@ class GraphShard {
   }
 
   void merge_shard(GraphShard *&shard) {  // NOLINT
+    release_csr();
+    shard->release_csr();
     bucket.reserve(bucket.size() + shard->bucket.size());
     for (size_t i = 0; i < shard->bucket.size(); i++) {
       auto node_id = shard->bucket[i]->get_id();
@@ -159,288 +224,11 @@ class GraphShard {
  public:
   std::unordered_map<uint64_t, int> node_location;
   std::vector<Node *> bucket;
+  // set by build_csr, the bucket is empty then
+  std::unique_ptr<GraphCsrStorage> csr;
+  std::mutex csr_mutex;
 };
 
-enum LRUResponse { ok = 0, blocked = 1, err = 2 };
-
-struct SampleKey {
-  int idx;
-  uint64_t node_key;
-  size_t sample_size;
-  bool is_weighted;
-  SampleKey(int _idx,
-            uint64_t _node_key,
-            size_t _sample_size,
-            bool _is_weighted) {
-    idx = _idx;
-    node_key = _node_key;
-    sample_size = _sample_size;
-    is_weighted = _is_weighted;
-  }
-  bool operator==(const SampleKey &s) const {
-    return idx == s.idx && node_key == s.node_key &&
-           sample_size == s.sample_size && is_weighted == s.is_weighted;
-  }
-};
-
-class SampleResult {
- public:
-  size_t actual_size;
-  std::shared_ptr<char> buffer;
-  SampleResult(size_t _actual_size, std::shared_ptr<char> &_buffer)  // NOLINT
-      : actual_size(_actual_size), buffer(_buffer) {}
-  SampleResult(size_t _actual_size, char *_buffer)
-      : actual_size(_actual_size),
-        buffer(_buffer, [](char *p) { delete[] p; }) {}
-  ~SampleResult() {}
-};
-
-template <typename K, typename V>
-class LRUNode {
- public:
-  LRUNode(K _key, V _data, size_t _ttl) : key(_key), data(_data), ttl(_ttl) {
-    next = pre = NULL;
-  }
-  K key;
-  V data;
-  size_t ttl;
-  // time to live
-  LRUNode<K, V> *pre, *next;
-};
-template <typename K, typename V>
-class ScaledLRU;
-
-template <typename K, typename V>
-class RandomSampleLRU {
- public:
-  explicit RandomSampleLRU(ScaledLRU<K, V> *_father) {
-    father = _father;
-    remove_count = 0;
-    node_size = 0;
-    node_head = node_end = NULL;
-    global_ttl = father->ttl;
-    total_diff = 0;
-  }
-
-  ~RandomSampleLRU() {
-    LRUNode<K, V> *p;
-    while (node_head != NULL) {
-      p = node_head->next;
-      delete node_head;
-      node_head = p;
-    }
-  }
-  LRUResponse query(K *keys,
-                    size_t length,
-                    std::vector<std::pair<K, V>> &res) {  // NOLINT
-    if (pthread_rwlock_tryrdlock(&father->rwlock) != 0)
-      return LRUResponse::blocked;
-    // pthread_rwlock_rdlock(&father->rwlock);
-    int init_size = node_size - remove_count;
-    process_redundant(length * 3);
-
-    for (size_t i = 0; i < length; i++) {
-      auto iter = key_map.find(keys[i]);
-      if (iter != key_map.end()) {
-        res.emplace_back(keys[i], iter->second->data);
-        iter->second->ttl--;
-        if (iter->second->ttl == 0) {
-          remove(iter->second);
-          if (remove_count != 0) remove_count--;
-        } else {
-          move_to_tail(iter->second);
-        }
-      }
-    }
-    total_diff += node_size - remove_count - init_size;
-    if (total_diff >= 500 || total_diff < -500) {
-      father->handle_size_diff(total_diff);
-      total_diff = 0;
-    }
-    pthread_rwlock_unlock(&father->rwlock);
-    return LRUResponse::ok;
-  }
-  LRUResponse insert(K *keys, V *data, size_t length) {
-    if (pthread_rwlock_tryrdlock(&father->rwlock) != 0)
-      return LRUResponse::blocked;
-    // pthread_rwlock_rdlock(&father->rwlock);
-    int init_size = node_size - remove_count;
-    process_redundant(length * 3);
-    for (size_t i = 0; i < length; i++) {
-      auto iter = key_map.find(keys[i]);
-      if (iter != key_map.end()) {
-        move_to_tail(iter->second);
-        iter->second->ttl = global_ttl;
-        iter->second->data = data[i];
-      } else {
-        LRUNode<K, V> *temp = new LRUNode<K, V>(keys[i], data[i], global_ttl);
-        add_new(temp);
-      }
-    }
-    total_diff += node_size - remove_count - init_size;
-    if (total_diff >= 500 || total_diff < -500) {
-      father->handle_size_diff(total_diff);
-      total_diff = 0;
-    }
-
-    pthread_rwlock_unlock(&father->rwlock);
-    return LRUResponse::ok;
-  }
-  void remove(LRUNode<K, V> *node) {
-    fetch(node);
-    node_size--;
-    key_map.erase(node->key);
-    delete node;
-  }
-
-  void process_redundant(int process_size) {
-    int length = std::min(remove_count, process_size);
-    while (length--) {
-      remove(node_head);
-      remove_count--;
-    }
-  }
-
-  void move_to_tail(LRUNode<K, V> *node) {
-    fetch(node);
-    place_at_tail(node);
-  }
-
-  void add_new(LRUNode<K, V> *node) {
-    node->ttl = global_ttl;
-    place_at_tail(node);
-    node_size++;
-    key_map[node->key] = node;
-  }
-  void place_at_tail(LRUNode<K, V> *node) {
-    if (node_end == NULL) {
-      node_head = node_end = node;
-      node->next = node->pre = NULL;
-    } else {
-      node_end->next = node;
-      node->pre = node_end;
-      node->next = NULL;
-      node_end = node;
-    }
-  }
-
-  void fetch(LRUNode<K, V> *node) {
-    if (node->pre) {
-      node->pre->next = node->next;
-    } else {
-      node_head = node->next;
-    }
-    if (node->next) {
-      node->next->pre = node->pre;
-    } else {
-      node_end = node->pre;
-    }
-  }
-
- private:
-  std::unordered_map<K, LRUNode<K, V> *> key_map;
-  ScaledLRU<K, V> *father;
-  size_t global_ttl, size_limit;
-  int node_size, total_diff;
-  LRUNode<K, V> *node_head, *node_end;
-  friend class ScaledLRU<K, V>;
-  int remove_count;
-};
-
-template <typename K, typename V>
-class ScaledLRU {
- public:
-  ScaledLRU(size_t _shard_num, size_t size_limit, size_t _ttl)
-      : size_limit(size_limit), ttl(_ttl) {
-    shard_num = _shard_num;
-    pthread_rwlock_init(&rwlock, NULL);
-    stop = false;
-    thread_pool.reset(new ::ThreadPool(1));
-    global_count = 0;
-    lru_pool = std::vector<RandomSampleLRU<K, V>>(shard_num,
-                                                  RandomSampleLRU<K, V>(this));
-    shrink_job = std::thread([this]() -> void {
-      while (true) {
-        {
-          std::unique_lock<std::mutex> lock(mutex_);
-          cv_.wait_for(lock, std::chrono::milliseconds(20000));
-          if (stop) {
-            return;
-          }
-        }
-        auto status =
-            thread_pool->enqueue([this]() -> int { return Shrink(); });
-        status.wait();
-      }
-    });
-    shrink_job.detach();
-  }
-  ~ScaledLRU() {
-    std::unique_lock<std::mutex> lock(mutex_);
-    stop = true;
-    cv_.notify_one();
-  }
-  LRUResponse query(size_t index,
-                    K *keys,
-                    size_t length,
-                    std::vector<std::pair<K, V>> &res) {  // NOLINT
-    return lru_pool[index].query(keys, length, res);
-  }
-  LRUResponse insert(size_t index, K *keys, V *data, size_t length) {
-    return lru_pool[index].insert(keys, data, length);
-  }
-  int Shrink() {
-    size_t node_size = 0;
-    for (size_t i = 0; i < lru_pool.size(); i++) {
-      node_size += lru_pool[i].node_size - lru_pool[i].remove_count;
-    }
-
-    if (node_size <= static_cast<size_t>(1.1 * size_limit) + 1) return 0;
-    if (pthread_rwlock_wrlock(&rwlock) == 0) {
-      global_count = 0;
-      for (size_t i = 0; i < lru_pool.size(); i++) {
-        global_count += lru_pool[i].node_size - lru_pool[i].remove_count;
-      }
-      if (static_cast<size_t>(global_count) > size_limit) {
-        size_t remove = global_count - size_limit;
-        for (size_t i = 0; i < lru_pool.size(); i++) {
-          lru_pool[i].total_diff = 0;
-          lru_pool[i].remove_count +=
-              1.0 * (lru_pool[i].node_size - lru_pool[i].remove_count) /
-              global_count * remove;
-        }
-      }
-      pthread_rwlock_unlock(&rwlock);
-      return 0;
-    }
-    return 0;
-  }
-
-  void handle_size_diff(int diff) {
-    if (diff != 0) {
-      __sync_fetch_and_add(&global_count, diff);
-      if (global_count > static_cast<int>(1.25 * size_limit)) {
-        thread_pool->enqueue([this]() -> int { return Shrink(); });
-      }
-    }
-  }
-
-  size_t get_ttl() { return ttl; }
-
- private:
-  pthread_rwlock_t rwlock;
-  size_t shard_num;
-  int global_count;
-  size_t size_limit, total, hit;
-  size_t ttl;
-  bool stop;
-  std::thread shrink_job;
-  std::vector<RandomSampleLRU<K, V>> lru_pool;
-  mutable std::mutex mutex_;
-  std::condition_variable cv_;
-  std::shared_ptr<::ThreadPool> thread_pool;
-  friend class RandomSampleLRU<K, V>;
-};
 enum GraphTableType { EDGE_TABLE, FEATURE_TABLE, NODE_TABLE };
 class GraphTable : public Table {
   class GraphNodeRank {
@@ -638,6 +426,8 @@ class GraphTable : public Table {
   int32_t get_server_index_by_id(uint64_t id);
   Node *find_node(GraphTableType table_type, int idx, uint64_t id);
   Node *find_node(GraphTableType table_type, uint64_t id);
+  // The local shard holding `id`, nullptr if it is held by another server.
+  GraphShard *find_shard(GraphTableType table_type, int idx, uint64_t id);
   // query all ids rank
   void query_all_ids_rank(const size_t &total,
                           const uint64_t *ids,
@@ -704,17 +494,10 @@ class GraphTable : public Table {
   void release_graph();
   void release_graph_edge();
   void release_graph_node();
-  virtual int32_t make_neighbor_sample_cache(size_t size_limit, size_t ttl) {
-    {
-      std::unique_lock<std::mutex> lock(mutex_);
-      if (use_cache == false) {
-        scaled_lru.reset(new ScaledLRU<SampleKey, SampleResult>(
-            task_pool_size_, size_limit, ttl));
-        use_cache = true;
-      }
-    }
-    return 0;
-  }
+  virtual int32_t make_neighbor_sample_cache(size_t size_limit, size_t ttl);
+  // hits, misses and evictions of the neighbor sample cache, all zero when
+  // it is not enabled
+  virtual NeighborSampleCache::Stats get_neighbor_sample_cache_stats();
   virtual void load_node_weight(int type_id, int idx, std::string path);
 #ifdef PADDLE_WITH_HETERPS
   virtual void make_partitions(int idx, int64_t gb_size, int device_len);
@@ -770,6 +553,11 @@ class GraphTable : public Table {
 #endif
   virtual int32_t add_comm_edge(int idx, uint64_t src_id, uint64_t dst_id);
   virtual int32_t build_sampler(int idx, std::string sample_type = "random");
+  // Converts the shards of a table into csr storage, see GraphCsrStorage.
+  // Sampling, neighbor and feature queries read it directly, other accesses
+  // to the nodes need release_csr first.
+  virtual int32_t build_csr(GraphTableType table_type, int idx);
+  virtual int32_t release_csr(GraphTableType table_type, int idx);
   void set_slot_feature_separator(const std::string &ch);
   void set_feature_separator(const std::string &ch);
 
@@ -826,7 +614,7 @@ class GraphTable : public Table {
   std::vector<std::shared_ptr<::ThreadPool>> _cpu_worker_pool;
   std::vector<std::shared_ptr<std::mt19937_64>> _shards_task_rng_pool;
   std::shared_ptr<::ThreadPool> load_node_edge_task_pool;
-  std::shared_ptr<ScaledLRU<SampleKey, SampleResult>> scaled_lru;
+  std::shared_ptr<NeighborSampleCache> sample_cache;
   std::unordered_set<uint64_t> extra_nodes;
   std::unordered_map<uint64_t, size_t> extra_nodes_to_thread_index;
   bool use_cache, use_duplicate_nodes;
@@ -854,13 +642,3 @@ class GraphTable : public Table {
 }  // namespace distributed
 
 };  // namespace paddle
-
-namespace std {
-
-template <>
-struct hash<::paddle::distributed::SampleKey> {
-  size_t operator()(const ::paddle::distributed::SampleKey &s) const {
-    return s.idx ^ s.node_key ^ s.sample_size;
-  }
-};
-}  // namespace std
@@ -14,13 +14,85 @@
 
 #include "paddle/fluid/distributed/ps/table/ctr_accessor.h"
 
+#include <algorithm>
+#include <cmath>
+
 #include "glog/logging.h"
 #include "paddle/common/flags.h"
 #include "paddle/fluid/platform/enforce.h"
+#include "paddle/phi/common/float16.h"
 #include "paddle/utils/string/string_helper.h"
 
 namespace paddle::distributed {
 
+namespace {
+
+// Packs `dim` fp32 values into CtrCommonFeatureValue::StorageDim slots.
+void EncodeEmbedx(int storage_type, const float* src, int dim, float* dst) {
+  switch (storage_type) {
+    case CtrAccessorParameter::EMBEDX_FP16: {
+      auto* half = reinterpret_cast<phi::dtype::float16*>(dst);
+      for (int i = 0; i < dim; ++i) {
+        half[i] = static_cast<phi::dtype::float16>(src[i]);
+      }
+      if (dim % 2 != 0) {
+        half[dim] = static_cast<phi::dtype::float16>(0.0f);
+      }
+      return;
+    }
+    case CtrAccessorParameter::EMBEDX_INT8: {
+      if (dim == 0) {
+        return;
+      }
+      float max_abs = 0;
+      for (int i = 0; i < dim; ++i) {
+        max_abs = std::max(max_abs, std::fabs(src[i]));
+      }
+      float scale = max_abs / 127;
+      float inv_scale = scale > 0 ? 1 / scale : 0;
+      dst[0] = scale;
+      auto* quant = reinterpret_cast<int8_t*>(dst + 1);
+      for (int i = 0; i < dim; ++i) {
+        float q = std::nearbyint(src[i] * inv_scale);
+        quant[i] = static_cast<int8_t>(std::min(127.0f, std::max(-127.0f, q)));
+      }
+      for (int i = dim; i % 4 != 0; ++i) {
+        quant[i] = 0;
+      }
+      return;
+    }
+    default:
+      memcpy(dst, src, dim * sizeof(float));
+  }
+}
+
+void DecodeEmbedx(int storage_type, const float* src, int dim, float* dst) {
+  switch (storage_type) {
+    case CtrAccessorParameter::EMBEDX_FP16: {
+      const auto* half = reinterpret_cast<const phi::dtype::float16*>(src);
+      for (int i = 0; i < dim; ++i) {
+        dst[i] = static_cast<float>(half[i]);
+      }
+      return;
+    }
+    case CtrAccessorParameter::EMBEDX_INT8: {
+      if (dim == 0) {
+        return;
+      }
+      float scale = src[0];
+      const auto* quant = reinterpret_cast<const int8_t*>(src + 1);
+      for (int i = 0; i < dim; ++i) {
+        dst[i] = quant[i] * scale;
+      }
+      return;
+    }
+    default:
+      memcpy(dst, src, dim * sizeof(float));
+  }
+}
+
+}  // namespace
+
 int CtrCommonAccessor::Initialize() {
   auto name = _config.embed_sgd_param().name();
   _embed_sgd_rule = CREATE_PSCORE_CLASS(SparseValueSGDRule, name);
@@ -34,6 +106,25 @@ int CtrCommonAccessor::Initialize() {
   common_feature_value.embed_sgd_dim = _embed_sgd_rule->Dim();
   common_feature_value.embedx_dim = _config.embedx_dim();
   common_feature_value.embedx_sgd_dim = _embedx_sgd_rule->Dim();
+  common_feature_value.embedx_storage_type =
+      _config.ctr_accessor_param().embedx_storage_type();
+  common_feature_value.quantize_embedx_g2sum =
+      EmbedxQuantized() && _config.ctr_accessor_param().quantize_embedx_g2sum();
+  // the beta powers of adam lose too much precision when quantized
+  PADDLE_ENFORCE_EQ(
+      common_feature_value.quantize_embedx_g2sum &&
+          name.find("Adam") != std::string::npos,
+      false,
+      common::errors::InvalidArgument(
+          "quantize_embedx_g2sum only supports adagrad rules, but got %s.",
+          name));
+  _embedx_g2sum_storage_type = common_feature_value.quantize_embedx_g2sum
+                                   ? common_feature_value.embedx_storage_type
+                                   : CtrAccessorParameter::EMBEDX_FP32;
+  _embedx_w_index = common_feature_value.EmbedxWIndex();
+  _embedx_g2sum_index = common_feature_value.EmbedxG2SumIndex();
+  _embedx_row_dim =
+      common_feature_value.embedx_dim + common_feature_value.embedx_sgd_dim;
   _show_click_decay_rate = _config.ctr_accessor_param().show_click_decay_rate();
   _ssd_unseenday_threshold =
       _config.ctr_accessor_param().ssd_unseenday_threshold();
@@ -55,8 +146,37 @@ void CtrCommonAccessor::InitAccessorInfo() {
   _accessor_info.select_size = _accessor_info.select_dim * sizeof(float);
   _accessor_info.update_dim = 4 + embedx_dim;
   _accessor_info.update_size = _accessor_info.update_dim * sizeof(float);
-  _accessor_info.mf_size =
-      (embedx_dim + common_feature_value.embedx_sgd_dim) * sizeof(float);
+  _accessor_info.mf_size = (common_feature_value.EmbedxWDim() +
+                            common_feature_value.EmbedxG2SumDim()) *
+                           sizeof(float);
+}
+
+void CtrCommonAccessor::LoadEmbedx(const float* value,
+                                   float* embedx_w,
+                                   float* embedx_g2sum) {
+  auto& fv = common_feature_value;
+  DecodeEmbedx(fv.embedx_storage_type,
+               value + _embedx_w_index,
+               fv.embedx_dim,
+               embedx_w);
+  DecodeEmbedx(_embedx_g2sum_storage_type,
+               value + _embedx_g2sum_index,
+               fv.embedx_sgd_dim,
+               embedx_g2sum);
+}
+
+void CtrCommonAccessor::StoreEmbedx(float* value,
+                                    const float* embedx_w,
+                                    const float* embedx_g2sum) {
+  auto& fv = common_feature_value;
+  EncodeEmbedx(fv.embedx_storage_type,
+               embedx_w,
+               fv.embedx_dim,
+               value + _embedx_w_index);
+  EncodeEmbedx(_embedx_g2sum_storage_type,
+               embedx_g2sum,
+               fv.embedx_sgd_dim,
+               value + _embedx_g2sum_index);
 }
 
 bool CtrCommonAccessor::Shrink(float* value) {
@@ -180,6 +300,15 @@ int32_t CtrCommonAccessor::Create(float** values, size_t num) {
     _embed_sgd_rule->InitValue(value + common_feature_value.EmbedWIndex(),
                                value + common_feature_value.EmbedG2SumIndex(),
                                zero_init);
+    if (EmbedxQuantized()) {
+      thread_local std::vector<float> embedx;
+      embedx.resize(common_feature_value.embedx_dim +
+                    common_feature_value.embedx_sgd_dim);
+      float* embedx_g2sum = embedx.data() + common_feature_value.embedx_dim;
+      _embedx_sgd_rule->InitValue(embedx.data(), embedx_g2sum, false);
+      StoreEmbedx(value, embedx.data(), embedx_g2sum);
+      continue;
+    }
     _embedx_sgd_rule->InitValue(value + common_feature_value.EmbedxWIndex(),
                                 value + common_feature_value.EmbedxG2SumIndex(),
                                 false);
@@ -213,9 +342,10 @@ int32_t CtrCommonAccessor::Select(float** select_values,
         value[common_feature_value.ClickIndex()];
     select_value[CtrCommonPullValue::EmbedWIndex()] =
         value[common_feature_value.EmbedWIndex()];
-    memcpy(select_value + CtrCommonPullValue::EmbedxWIndex(),
-           value + common_feature_value.EmbedxWIndex(),
-           embedx_dim * sizeof(float));
+    DecodeEmbedx(common_feature_value.embedx_storage_type,
+                 value + common_feature_value.EmbedxWIndex(),
+                 embedx_dim,
+                 select_value + CtrCommonPullValue::EmbedxWIndex());
   }
   return 0;
 }
@@ -246,6 +376,8 @@ int32_t CtrCommonAccessor::Merge(float** update_values,
 int32_t CtrCommonAccessor::Update(float** update_values,
                                   const float** push_values,
                                   size_t num) {
+  thread_local std::vector<float> push_shows;
+  push_shows.resize(num);
   for (size_t value_item = 0; value_item < num; ++value_item) {
     float* update_value = update_values[value_item];
     const float* push_value = push_values[value_item];
@@ -265,16 +397,73 @@ int32_t CtrCommonAccessor::Update(float** update_values,
     }
     VLOG(3) << "accessor show scale:" << _show_scale
             << ", push_show:" << push_show;
-    _embed_sgd_rule->UpdateValue(
-        update_value + common_feature_value.EmbedWIndex(),
-        update_value + common_feature_value.EmbedG2SumIndex(),
-        push_value + CtrCommonPushValue::EmbedGIndex(),
-        push_show);
-    _embedx_sgd_rule->UpdateValue(
-        update_value + common_feature_value.EmbedxWIndex(),
-        update_value + common_feature_value.EmbedxG2SumIndex(),
-        push_value + CtrCommonPushValue::EmbedxGIndex(),
-        push_show);
+    push_shows[value_item] = push_show;
+  }
+  // the rules update all values of the batch in one vectorized pass
+  _embed_sgd_rule->UpdateValueBatch(update_values,
+                                    common_feature_value.EmbedWIndex(),
+                                    common_feature_value.EmbedG2SumIndex(),
+                                    push_values,
+                                    CtrCommonPushValue::EmbedGIndex(),
+                                    push_shows.data(),
+                                    num);
+  if (EmbedxQuantized()) {
+    return UpdateQuantizedEmbedx(
+        update_values, push_values, push_shows.data(), num);
+  }
+  _embedx_sgd_rule->UpdateValueBatch(update_values,
+                                     common_feature_value.EmbedxWIndex(),
+                                     common_feature_value.EmbedxG2SumIndex(),
+                                     push_values,
+                                     CtrCommonPushValue::EmbedxGIndex(),
+                                     push_shows.data(),
+                                     num);
+  return 0;
+}
+
+// dequantizes embedx into fp32 rows, updates them and quantizes them back
+int32_t CtrCommonAccessor::UpdateQuantizedEmbedx(float** values,
+                                                 const float** push_values,
+                                                 const float* push_shows,
+                                                 size_t num) {
+  size_t embedx_dim = common_feature_value.embedx_dim;
+  size_t row_dim = _embedx_row_dim;
+  thread_local QuantizedEmbedxScratch scratch;
+  auto& buffer = scratch.buffer;
+  auto& rows = scratch.rows;
+  auto& order = scratch.order;
+  buffer.resize(num * row_dim);
+  rows.resize(num);
+  order.resize(num);
+  for (size_t value_item = 0; value_item < num; ++value_item) {
+    order[value_item] = {values[value_item], value_item};
+  }
+  // a value pushed twice shares its row, so the updates still chain; sorting
+  // by address keeps the pushes of a value in order and next to each other
+  std::sort(order.begin(), order.end());
+  float* next_row = buffer.data();
+  for (size_t i = 0; i < num; ++i) {
+    if (i > 0 && order[i].first == order[i - 1].first) {
+      rows[order[i].second] = rows[order[i - 1].second];
+      continue;
+    }
+    LoadEmbedx(order[i].first, next_row, next_row + embedx_dim);
+    rows[order[i].second] = next_row;
+    next_row += row_dim;
+  }
+  _embedx_sgd_rule->UpdateValueBatch(rows.data(),
+                                     0,
+                                     embedx_dim,
+                                     push_values,
+                                     CtrCommonPushValue::EmbedxGIndex(),
+                                     push_shows,
+                                     num);
+  for (size_t i = 0; i < num; ++i) {
+    if (i > 0 && order[i].first == order[i - 1].first) {
+      continue;
+    }
+    float* row = rows[order[i].second];
+    StoreEmbedx(order[i].first, row, row + embedx_dim);
   }
   return 0;
 }
@@ -324,6 +513,18 @@ std::string CtrCommonAccessor::ParseToString(const float* v, int param) {
   auto score = ShowClickScore(show, click);
   if (score >= _config.embedx_threshold() &&
       param > common_feature_value.EmbedxWIndex()) {
+    if (EmbedxQuantized()) {
+      // checkpoints always hold fp32 text, whatever the storage type
+      thread_local std::vector<float> embedx;
+      embedx.resize(common_feature_value.embedx_dim +
+                    common_feature_value.embedx_sgd_dim);
+      LoadEmbedx(
+          v, embedx.data(), embedx.data() + common_feature_value.embedx_dim);
+      for (auto x : embedx) {
+        os << " " << x;
+      }
+      return os.str();
+    }
     for (auto i = common_feature_value.EmbedxWIndex();
          i < common_feature_value.Dim();
          ++i) {
@@ -334,6 +535,27 @@ std::string CtrCommonAccessor::ParseToString(const float* v, int param) {
 }
 
 int CtrCommonAccessor::ParseFromString(const std::string& str, float* value) {
+  if (EmbedxQuantized()) {
+    auto& fv = common_feature_value;
+    int embedx_index = fv.EmbedxWIndex();
+    thread_local std::vector<float> buffer;
+    buffer.resize(embedx_index + fv.embedx_dim + fv.embedx_sgd_dim);
+    float* embedx_w = buffer.data() + embedx_index;
+    float* embedx_g2sum = embedx_w + fv.embedx_dim;
+    _embedx_sgd_rule->InitValue(embedx_w, embedx_g2sum);
+    auto ret = paddle::string::str_to_float(str.data(), buffer.data());
+    PADDLE_ENFORCE_GE(
+        ret,
+        6UL,
+        common::errors::InvalidArgument(
+            "Invalid return value. Expect more than 6. But recieved %d.", ret));
+    memcpy(value, buffer.data(), embedx_index * sizeof(float));
+    if (ret <= embedx_index) {
+      return ret;
+    }
+    StoreEmbedx(value, embedx_w, embedx_g2sum);
+    return fv.Dim();
+  }
   _embedx_sgd_rule->InitValue(value + common_feature_value.EmbedxWIndex(),
                               value + common_feature_value.EmbedxG2SumIndex());
   auto ret = paddle::string::str_to_float(str.data(), value);
@@ -16,6 +16,7 @@
 #include <stdint.h>
 #include <stdio.h>
 
+#include <utility>
 #include <vector>
 
 #include "paddle/fluid/distributed/common/registerer.h"
@@ -41,8 +42,29 @@ class CtrCommonAccessor : public ValueAccessor {
        std::vector<float> embedx_w;
        std::<vector>float embedx_g2sum;
        */
+    // With a quantized embedx_storage_type, embedx_w (and embedx_g2sum if
+    // quantize_embedx_g2sum is set) are packed into the float slots: fp16
+    // keeps two values per slot, int8 keeps a fp32 scale followed by four
+    // values per slot.
 
-    int Dim() { return 6 + embed_sgd_dim + embedx_sgd_dim + embedx_dim; }
+    static int StorageDim(int storage_type, int dim) {
+      switch (storage_type) {
+        case CtrAccessorParameter::EMBEDX_FP16:
+          return (dim + 1) / 2;
+        case CtrAccessorParameter::EMBEDX_INT8:
+          return dim > 0 ? 1 + (dim + 3) / 4 : 0;
+        default:
+          return dim;
+      }
+    }
+    int EmbedxWDim() { return StorageDim(embedx_storage_type, embedx_dim); }
+    int EmbedxG2SumDim() {
+      int storage_type = quantize_embedx_g2sum
+                             ? embedx_storage_type
+                             : CtrAccessorParameter::EMBEDX_FP32;
+      return StorageDim(storage_type, embedx_sgd_dim);
+    }
+    int Dim() { return 6 + embed_sgd_dim + EmbedxWDim() + EmbedxG2SumDim(); }
     int DimSize(size_t dim, int embedx_dim) { return sizeof(float); }
     int Size() { return Dim() * sizeof(float); }
     int SlotIndex() { return 0; }
@@ -53,7 +75,7 @@ class CtrCommonAccessor : public ValueAccessor {
     int EmbedWIndex() { return ClickIndex() + 1; }
     int EmbedG2SumIndex() { return EmbedWIndex() + 1; }
     int EmbedxWIndex() { return EmbedG2SumIndex() + embed_sgd_dim; }
-    int EmbedxG2SumIndex() { return EmbedxWIndex() + embedx_dim; }
+    int EmbedxG2SumIndex() { return EmbedxWIndex() + EmbedxWDim(); }
 
     float& UnseenDays(float* val) { return val[UnseenDaysIndex()]; }
     float& DeltaScore(float* val) { return val[DeltaScoreIndex()]; }
@@ -68,6 +90,8 @@ class CtrCommonAccessor : public ValueAccessor {
     int embed_sgd_dim;
     int embedx_dim;
     int embedx_sgd_dim;
+    int embedx_storage_type = CtrAccessorParameter::EMBEDX_FP32;
+    bool quantize_embedx_g2sum = false;
   };
 
   struct CtrCommonPushValue {
@@ -187,7 +211,30 @@ class CtrCommonAccessor : public ValueAccessor {
     return 0.0;
   }
 
+  // Copies embedx_w and embedx_g2sum of a value with mf to fp32 buffers of
+  // embedx_dim and embedx_sgd_dim floats, and back.
+  void LoadEmbedx(const float* value, float* embedx_w, float* embedx_g2sum);
+  void StoreEmbedx(float* value,
+                   const float* embedx_w,
+                   const float* embedx_g2sum);
+
  private:
+  bool EmbedxQuantized() {
+    return common_feature_value.embedx_storage_type !=
+           CtrAccessorParameter::EMBEDX_FP32;
+  }
+  int32_t UpdateQuantizedEmbedx(float** values,
+                                const float** push_values,
+                                const float* push_shows,
+                                size_t num);
+
+  // per thread fp32 rows of UpdateQuantizedEmbedx, reused across pushes
+  struct QuantizedEmbedxScratch {
+    std::vector<float> buffer;
+    std::vector<float*> rows;
+    std::vector<std::pair<float*, size_t>> order;
+  };
+
   // float ShowClickScore(float show, float click);
 
   // SparseValueSGDRule* _embed_sgd_rule;
@@ -196,6 +243,11 @@ class CtrCommonAccessor : public ValueAccessor {
   float _show_click_decay_rate;
   int32_t _ssd_unseenday_threshold;
   bool _show_scale = false;
+  // embedx layout of a value, fixed at Initialize
+  int _embedx_g2sum_storage_type = CtrAccessorParameter::EMBEDX_FP32;
+  int _embedx_w_index = 0;
+  int _embedx_g2sum_index = 0;
+  size_t _embedx_row_dim = 0;
 
  public:  // TODO(zhaocaibei123): it should be private, but we make it public
           // for unit test
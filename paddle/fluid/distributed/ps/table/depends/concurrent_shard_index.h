@@ -0,0 +1,410 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>  // NOLINT
+#include <cstdint>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "paddle/fluid/platform/enforce.h"
+#include "paddle/phi/core/memory/allocation/spin_lock.h"
+
+namespace paddle {
+namespace distributed {
+
+// Open addressing index from feasign to value pointer, laid out like a Swiss
+// table: slots are grouped by 16 and every slot has a control byte holding
+// 7 bits of the hash, so one probe step compares a whole group at once.
+//
+// find() is lock-free and can run concurrently with insert() and erase().
+// Writers lock one of kStripeNum stripes chosen by the key's home group, so
+// writers of the same key are serialized while unrelated keys proceed in
+// parallel. Growing locks all stripes and publishes a new table; old tables
+// are kept until clear() or reclaim(), which may only run while no reader or
+// writer is in flight, see ConcurrentIndexGate.
+//
+// The index does not own the values. Callers keep them alive until the key
+// is erased and no reader can still hold the pointer.
+template <class VALUE>
+class ConcurrentShardIndex {
+ public:
+  static constexpr size_t kGroupWidth = 16;
+  static constexpr size_t kStripeNum = 256;
+  static constexpr size_t kMinGroupNum = 64;
+
+  ConcurrentShardIndex() { reset(kMinGroupNum); }
+  ConcurrentShardIndex(const ConcurrentShardIndex&) = delete;
+  ConcurrentShardIndex& operator=(const ConcurrentShardIndex&) = delete;
+
+  static uint64_t hash(uint64_t key) {
+    // murmur3 finalizer: feasigns are often sharded by their low bits
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+  }
+
+  VALUE* find(uint64_t key) const {
+    uint64_t h = hash(key);
+    return find_in(_table.load(std::memory_order_acquire), key, h);
+  }
+
+  // Inserts key -> value if the key is absent. Returns the value now mapped
+  // by the key, which is `value` only when the insertion happened.
+  VALUE* insert(uint64_t key, VALUE* value) {
+    uint64_t h = hash(key);
+    maybe_grow();
+    std::lock_guard<memory::SpinLock> guard(stripe(h));
+    Table* table = _table.load(std::memory_order_acquire);
+    VALUE* existing = find_in(table, key, h);
+    if (existing != nullptr) {
+      return existing;
+    }
+    uint8_t h2 = static_cast<uint8_t>(h & 0x7F);
+    for (size_t step = 0, g = h1(table, h); step < table->group_num;
+         g = (g + ++step) & table->group_mask) {
+      Group& group = table->groups[g];
+      for (size_t i = 0; i < kGroupWidth; ++i) {
+        uint8_t ctrl = group.ctrl[i].load(std::memory_order_relaxed);
+        if (ctrl != kEmpty && ctrl != kDeleted) {
+          continue;
+        }
+        // slots may also be claimed by writers holding other stripes
+        if (!group.ctrl[i].compare_exchange_strong(
+                ctrl, kBusy, std::memory_order_acq_rel)) {
+          continue;
+        }
+        group.keys[i].store(key, std::memory_order_relaxed);
+        group.values[i].store(value, std::memory_order_relaxed);
+        group.ctrl[i].store(h2, std::memory_order_release);
+        if (ctrl == kDeleted) {
+          _deleted.fetch_sub(1, std::memory_order_relaxed);
+        }
+        _size.fetch_add(1, std::memory_order_relaxed);
+        return value;
+      }
+    }
+    PADDLE_THROW(common::errors::ResourceExhausted(
+        "ConcurrentShardIndex is full, size is %d.", size()));
+  }
+
+  // Removes the key. Returns whether the key was present. A concurrent
+  // find() of the same key may still return the old value, and the slot may
+  // be reused right away, so erase keys while no reader looks them up.
+  bool erase(uint64_t key) {
+    uint64_t h = hash(key);
+    std::lock_guard<memory::SpinLock> guard(stripe(h));
+    Table* table = _table.load(std::memory_order_acquire);
+    std::atomic<uint8_t>* ctrl = nullptr;
+    find_in(table, key, h, &ctrl);
+    if (ctrl == nullptr) {
+      return false;
+    }
+    ctrl->store(kDeleted, std::memory_order_release);
+    _size.fetch_sub(1, std::memory_order_relaxed);
+    _deleted.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Not thread-safe: no other operation may run concurrently.
+  void clear() {
+    _retired.clear();
+    reset(kMinGroupNum);
+  }
+
+  // Not thread-safe: frees the tables replaced by earlier growth, so no
+  // other operation may run concurrently.
+  void reclaim() {
+    if (_retired.size() > 1) {
+      _retired.erase(_retired.begin(), _retired.end() - 1);
+    }
+  }
+
+  // Not thread-safe: sizes the table for `num` keys up front.
+  void reserve(size_t num) {
+    size_t group_num = kMinGroupNum;
+    while (group_num * kGroupWidth * 7 / 8 < num) {
+      group_num <<= 1;
+    }
+    if (group_num > _table.load()->group_num) {
+      rehash(group_num);
+    }
+  }
+
+  size_t size() const { return _size.load(std::memory_order_relaxed); }
+  size_t capacity() const {
+    return _table.load(std::memory_order_acquire)->group_num * kGroupWidth;
+  }
+
+  // Striped lock for callers that mutate the value of `key` in place.
+  memory::SpinLock& value_lock(uint64_t key) {
+    return _value_locks[hash(key) % kStripeNum].lock;
+  }
+
+ private:
+  static constexpr uint8_t kEmpty = 0x80;
+  static constexpr uint8_t kDeleted = 0xFE;
+  static constexpr uint8_t kBusy = 0xFD;
+
+  struct Group {
+    std::atomic<uint8_t> ctrl[kGroupWidth];
+    std::atomic<uint64_t> keys[kGroupWidth];
+    std::atomic<VALUE*> values[kGroupWidth];
+  };
+  struct Table {
+    explicit Table(size_t num)
+        : group_num(num), group_mask(num - 1), groups(new Group[num]) {
+      for (size_t g = 0; g < num; ++g) {
+        for (size_t i = 0; i < kGroupWidth; ++i) {
+          groups[g].ctrl[i].store(kEmpty, std::memory_order_relaxed);
+        }
+      }
+    }
+    size_t group_num;
+    size_t group_mask;
+    std::unique_ptr<Group[]> groups;
+  };
+  struct alignas(64) PaddedLock {
+    memory::SpinLock lock;
+  };
+
+  static size_t h1(const Table* table, uint64_t h) {
+    return (h >> 7) & table->group_mask;
+  }
+
+  // Bit i of the result is set when ctrl[i] equals `pattern`.
+  static uint32_t match(const Group& group, uint8_t pattern) {
+#if defined(__SSE2__)
+    // racy snapshot of the control bytes, candidates are re-checked with
+    // an acquire load before the slot is read
+    __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+        reinterpret_cast<const void*>(group.ctrl)));
+    return static_cast<uint32_t>(_mm_movemask_epi8(
+        _mm_cmpeq_epi8(ctrl, _mm_set1_epi8(static_cast<char>(pattern)))));
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < kGroupWidth; ++i) {
+      if (group.ctrl[i].load(std::memory_order_relaxed) == pattern) {
+        mask |= 1u << i;
+      }
+    }
+    return mask;
+#endif
+  }
+
+  static VALUE* find_in(const Table* table,
+                        uint64_t key,
+                        uint64_t h,
+                        std::atomic<uint8_t>** slot_ctrl = nullptr) {
+    uint8_t h2 = static_cast<uint8_t>(h & 0x7F);
+    for (size_t step = 0, g = h1(table, h); step < table->group_num;
+         g = (g + ++step) & table->group_mask) {
+      Group& group = table->groups[g];
+      for (uint32_t mask = match(group, h2); mask != 0; mask &= mask - 1) {
+        size_t i = __builtin_ctz(mask);
+        if (group.ctrl[i].load(std::memory_order_acquire) == h2 &&
+            group.keys[i].load(std::memory_order_relaxed) == key) {
+          if (slot_ctrl != nullptr) {
+            *slot_ctrl = &group.ctrl[i];
+          }
+          return group.values[i].load(std::memory_order_relaxed);
+        }
+      }
+      if (match(group, kEmpty) != 0) {
+        return nullptr;
+      }
+    }
+    return nullptr;
+  }
+
+  memory::SpinLock& stripe(uint64_t h) {
+    return _stripes[(h >> 7) % kStripeNum].lock;
+  }
+
+  void maybe_grow() {
+    Table* table = _table.load(std::memory_order_acquire);
+    size_t used = _size.load(std::memory_order_relaxed) +
+                  _deleted.load(std::memory_order_relaxed);
+    if (used < table->group_num * kGroupWidth * 7 / 8) {
+      return;
+    }
+    for (auto& s : _stripes) {
+      s.lock.lock();
+    }
+    if (_table.load(std::memory_order_acquire) == table) {
+      // only double when live keys need it, otherwise drop tombstones
+      size_t live = _size.load(std::memory_order_relaxed);
+      rehash(live * 2 >= table->group_num * kGroupWidth ? table->group_num * 2
+                                                        : table->group_num);
+    }
+    for (auto& s : _stripes) {
+      s.lock.unlock();
+    }
+  }
+
+  // Caller must exclude all writers.
+  void rehash(size_t group_num) {
+    Table* old_table = _table.load(std::memory_order_acquire);
+    std::unique_ptr<Table> table(new Table(group_num));
+    for (size_t g = 0; g < old_table->group_num; ++g) {
+      Group& group = old_table->groups[g];
+      for (size_t i = 0; i < kGroupWidth; ++i) {
+        uint8_t ctrl = group.ctrl[i].load(std::memory_order_relaxed);
+        if (ctrl & 0x80) {
+          continue;
+        }
+        uint64_t key = group.keys[i].load(std::memory_order_relaxed);
+        place(table.get(),
+              key,
+              hash(key),
+              group.values[i].load(std::memory_order_relaxed));
+      }
+    }
+    _deleted.store(0, std::memory_order_relaxed);
+    _table.store(table.get(), std::memory_order_release);
+    _retired.emplace_back(std::move(table));
+  }
+
+  // Inserts into a table that is not yet visible to other threads.
+  static void place(Table* table, uint64_t key, uint64_t h, VALUE* value) {
+    for (size_t step = 0, g = h1(table, h);;
+         g = (g + ++step) & table->group_mask) {
+      Group& group = table->groups[g];
+      uint32_t empty = match(group, kEmpty);
+      if (empty != 0) {
+        size_t i = __builtin_ctz(empty);
+        group.keys[i].store(key, std::memory_order_relaxed);
+        group.values[i].store(value, std::memory_order_relaxed);
+        group.ctrl[i].store(static_cast<uint8_t>(h & 0x7F),
+                            std::memory_order_relaxed);
+        return;
+      }
+    }
+  }
+
+  void reset(size_t group_num) {
+    std::unique_ptr<Table> table(new Table(group_num));
+    _table.store(table.get(), std::memory_order_release);
+    _retired.emplace_back(std::move(table));
+    _size.store(0, std::memory_order_relaxed);
+    _deleted.store(0, std::memory_order_relaxed);
+  }
+
+  std::atomic<Table*> _table{nullptr};
+  // the current table is the last one, the others may still be read
+  std::vector<std::unique_ptr<Table>> _retired;
+  std::atomic<size_t> _size{0};
+  std::atomic<size_t> _deleted{0};
+  PaddedLock _stripes[kStripeNum];
+  PaddedLock _value_locks[kStripeNum];
+};
+
+// Quiescence barrier for the users of concurrent indexes. Pulls and pushes
+// enter the gate around their lookups; drain() blocks new entries, waits for
+// the ones in flight to leave and is held until reopen(), so the holder may
+// clear the indexes, free their retired tables or rewrite the values behind
+// them. drain() is reentrant for the thread that holds it.
+class ConcurrentIndexGate {
+ public:
+  ConcurrentIndexGate() = default;
+  ConcurrentIndexGate(const ConcurrentIndexGate&) = delete;
+  ConcurrentIndexGate& operator=(const ConcurrentIndexGate&) = delete;
+
+  void enter() {
+    while (true) {
+      _active.fetch_add(1, std::memory_order_seq_cst);
+      if (!_draining.load(std::memory_order_seq_cst)) {
+        return;
+      }
+      // back off so the drainer can see the count reach zero
+      leave();
+      std::unique_lock<std::mutex> lock(_wait_mutex);
+      _reopened.wait(lock, [this] {
+        return !_draining.load(std::memory_order_seq_cst);
+      });
+    }
+  }
+
+  void leave() { _active.fetch_sub(1, std::memory_order_seq_cst); }
+
+  void drain() {
+    if (_owner.load(std::memory_order_relaxed) ==
+        std::this_thread::get_id()) {
+      ++_depth;
+      return;
+    }
+    _drain_mutex.lock();
+    _owner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+    _depth = 1;
+    _draining.store(true, std::memory_order_seq_cst);
+    while (_active.load(std::memory_order_seq_cst) != 0) {
+      std::this_thread::yield();
+    }
+  }
+
+  void reopen() {
+    if (--_depth > 0) {
+      return;
+    }
+    _owner.store(std::thread::id(), std::memory_order_relaxed);
+    {
+      std::lock_guard<std::mutex> lock(_wait_mutex);
+      _draining.store(false, std::memory_order_seq_cst);
+    }
+    _reopened.notify_all();
+    _drain_mutex.unlock();
+  }
+
+  class Entry {
+   public:
+    explicit Entry(ConcurrentIndexGate* gate) : _gate(gate) { _gate->enter(); }
+    ~Entry() { _gate->leave(); }
+
+   private:
+    ConcurrentIndexGate* _gate;
+  };
+
+  class Drain {
+   public:
+    explicit Drain(ConcurrentIndexGate* gate) : _gate(gate) { _gate->drain(); }
+    ~Drain() { _gate->reopen(); }
+
+   private:
+    ConcurrentIndexGate* _gate;
+  };
+
+ private:
+  std::atomic<size_t> _active{0};
+  std::atomic<bool> _draining{false};
+  std::atomic<std::thread::id> _owner{};
+  int _depth = 0;
+  std::mutex _drain_mutex;
+  std::mutex _wait_mutex;
+  std::condition_variable _reopened;
+};
+
+}  // namespace distributed
+}  // namespace paddle
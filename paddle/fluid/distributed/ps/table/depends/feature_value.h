@@ -14,6 +14,11 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include <mct/hash-map.hpp>
@@ -28,18 +33,189 @@ static const int CTR_SPARSE_SHARD_BUCKET_NUM_BITS = 6;
 static const size_t CTR_SPARSE_SHARD_BUCKET_NUM =
     static_cast<size_t>(1) << CTR_SPARSE_SHARD_BUCKET_NUM_BITS;
 
+// A value is a 16 byte header followed by its floats. A shard with a value
+// arena carves the header and some inline floats out of one arena block, so
+// a lookup finds the data in the cache line of the header. The data moves to
+// a block of its own only when it grows past the inline capacity, taken from
+// the arena holding the header, which is found from the header address. A
+// value outside of an arena, e.g. a copy, keeps its data on the heap. Newly
+// grown elements are zero filled like std::vector::resize.
+//
+// The dirty bit records whether the value changed since the table's last
+// checkpoint and is read by delta saves. It belongs to the key, not to the
+// storage, so it is kept when the data is moved.
 class FixedFeatureValue {
  public:
-  FixedFeatureValue() {}
-  ~FixedFeatureValue() {}
-  float* data() { return _data.data(); }
-  size_t size() { return _data.size(); }
-  void resize(size_t size) { _data.resize(size); }
-  void shrink_to_fit() { _data.shrink_to_fit(); }
+  static constexpr size_t kHeaderFloats = 4;
+  static constexpr size_t kMaxCapacity = (1 << 24) - 1;
+
+  FixedFeatureValue()
+      : _capacity(0), _chunk_shift(0), _inline(0), _spilled(0), _dirty(1) {}
+  FixedFeatureValue(const FixedFeatureValue& other) : FixedFeatureValue() {
+    assign(other);
+  }
+  FixedFeatureValue(FixedFeatureValue&& other) : FixedFeatureValue() {
+    if (other.heap_data()) {
+      steal(&other);
+    } else {
+      assign(other);
+    }
+  }
+  FixedFeatureValue& operator=(const FixedFeatureValue& other) {
+    if (this != &other) {
+      assign(other);
+    }
+    return *this;
+  }
+  FixedFeatureValue& operator=(FixedFeatureValue&& other) {
+    if (this != &other) {
+      // a header in an arena keeps its data there
+      if (_chunk_shift == 0 && other.heap_data()) {
+        deallocate();
+        steal(&other);
+      } else {
+        assign(other);
+      }
+    }
+    return *this;
+  }
+  ~FixedFeatureValue() { deallocate(); }
+
+  // Creates a value in a block of `arena` with room for `inline_dim` floats.
+  static FixedFeatureValue* create(FeatureValueArena* arena,
+                                   size_t inline_dim) {
+    uint32_t chunk_shift = 0;
+    float* block = arena->acquire(kHeaderFloats + inline_dim, &chunk_shift);
+    FixedFeatureValue* value = new (block) FixedFeatureValue();
+    value->_data = block + kHeaderFloats;
+    value->_capacity = static_cast<uint32_t>(inline_dim);
+    value->_chunk_shift = chunk_shift;
+    value->_inline = 1;
+    return value;
+  }
+  // Destroys a value made by create() and gives its block back.
+  static void destroy(FixedFeatureValue* value) {
+    FeatureValueArena* arena = value->arena();
+    size_t block_dim = kHeaderFloats + value->inline_capacity();
+    value->~FixedFeatureValue();
+    arena->release(reinterpret_cast<float*>(value), block_dim);
+  }
+
+  float* data() { return _data; }
+  size_t size() { return _size; }
+  bool dirty() const { return _dirty; }
+  void set_dirty(bool dirty) { _dirty = dirty; }
+  // Room for the floats in the block of the header.
+  size_t inline_capacity() const {
+    if (_inline) {
+      return _capacity;
+    }
+    return _spilled ? *reinterpret_cast<const uint32_t*>(this + 1) : 0;
+  }
+  void resize(size_t size) {
+    if (size > _capacity) {
+      PADDLE_ENFORCE_LE(size,
+                        kMaxCapacity,
+                        common::errors::InvalidArgument(
+                            "A feature value holds at most %d floats, but "
+                            "got %d.",
+                            kMaxCapacity,
+                            size));
+      float* data = allocate(size);
+      if (_size > 0) {
+        memcpy(data, _data, _size * sizeof(float));
+      }
+      deallocate();
+      _data = data;
+      _capacity = static_cast<uint32_t>(size);
+    }
+    if (size > _size) {
+      memset(_data + _size, 0, (size - _size) * sizeof(float));
+    }
+    _size = static_cast<uint32_t>(size);
+  }
+  void shrink_to_fit() {
+    if (_inline || _capacity == _size) {
+      return;
+    }
+    float* data = _size > 0 ? allocate(_size) : nullptr;
+    if (_size > 0) {
+      memcpy(data, _data, _size * sizeof(float));
+    }
+    deallocate();
+    _data = data;
+    _capacity = _size;
+  }
 
  private:
-  std::vector<float> _data;
+  FeatureValueArena* arena() const {
+    if (_chunk_shift == 0) {
+      return nullptr;
+    }
+    return FeatureValueArena::owner(this, _chunk_shift);
+  }
+  // The data is a malloc block that a move can take over.
+  bool heap_data() const { return _chunk_shift == 0; }
+  float* allocate(size_t size) {
+    FeatureValueArena* owner = arena();
+    if (owner != nullptr) {
+      return owner->acquire(size);
+    }
+    return reinterpret_cast<float*>(malloc(size * sizeof(float)));
+  }
+  // Frees the data unless it is inline. Leaving the inline floats records
+  // their number in them, so destroy() still knows the block size.
+  void deallocate() {
+    if (_inline) {
+      if (_capacity > 0) {
+        *reinterpret_cast<uint32_t*>(this + 1) = _capacity;
+        _spilled = 1;
+      }
+      _inline = 0;
+    } else if (_data != nullptr) {
+      FeatureValueArena* owner = arena();
+      if (owner != nullptr) {
+        owner->release(_data, _capacity);
+      } else {
+        free(_data);
+      }
+    }
+    _data = nullptr;
+    _capacity = 0;
+  }
+  void assign(const FixedFeatureValue& other) {
+    resize(other._size);
+    if (_size > 0) {
+      memcpy(_data, other._data, _size * sizeof(float));
+    }
+    _dirty = other._dirty;
+  }
+  // Takes the heap data of `other`, both headers are outside of an arena.
+  void steal(FixedFeatureValue* other) {
+    _data = other->_data;
+    _size = other->_size;
+    _capacity = other->_capacity;
+    _dirty = other->_dirty;
+    other->_data = nullptr;
+    other->_size = 0;
+    other->_capacity = 0;
+  }
+
+  float* _data = nullptr;
+  uint32_t _size = 0;
+  uint32_t _capacity : 24;
+  // log2 of the size of the arena chunk holding the header, 0 on the heap
+  uint32_t _chunk_shift : 5;
+  // the data is in the block of the header
+  uint32_t _inline : 1;
+  // the data left the block of the header, which records the inline floats
+  uint32_t _spilled : 1;
+  // new values are dirty until the first checkpoint contains them
+  uint32_t _dirty : 1;
 };
+static_assert(sizeof(FixedFeatureValue) ==
+                  FixedFeatureValue::kHeaderFloats * sizeof(float),
+              "the header of a FixedFeatureValue must be 16 bytes");
 
 template <class KEY, class VALUE>
 struct alignas(64) SparseTableShard {
@@ -93,8 +269,8 @@ struct alignas(64) SparseTableShard {
   };
 
   ~SparseTableShard() { clear(); }
-  bool empty() { return _alloc.size() == 0; }
-  size_t size() { return _alloc.size(); }
+  bool empty() { return _value_count == 0; }
+  size_t size() { return _value_count; }
   void set_max_load_factor(float x) {
     for (size_t bucket = 0; bucket < CTR_SPARSE_SHARD_BUCKET_NUM; bucket++) {
       _buckets[bucket].max_load_factor(x);
@@ -106,7 +282,7 @@ struct alignas(64) SparseTableShard {
     for (size_t bucket = 0; bucket < CTR_SPARSE_SHARD_BUCKET_NUM; bucket++) {
       map_type& data = _buckets[bucket];
       for (auto it = data.begin(); it != data.end(); ++it) {
-        _alloc.release((VALUE*)(void*)it->second);  // NOLINT
+        delete_value((VALUE*)(void*)it->second);  // NOLINT
       }
       data.clear();
     }
@@ -150,13 +326,13 @@ struct alignas(64) SparseTableShard {
     auto res = _buckets[bucket].insert_with_hash({key, NULL}, hash);
 
     if (res.second) {
-      res.first->second = _alloc.acquire(std::forward<ARGS>(args)...);
+      res.first->second = new_value(std::forward<ARGS>(args)...);
     }
 
     return {{res.first, bucket, _buckets}, res.second};
   }
   iterator erase(iterator it) {
-    _alloc.release((VALUE*)(void*)it.it->second);  // NOLINT
+    delete_value((VALUE*)(void*)it.it->second);  // NOLINT
     size_t bucket = it.bucket;
     auto it2 = _buckets[bucket].erase(it.it);
     while (it2 == _buckets[bucket].end() &&
@@ -166,15 +342,15 @@ struct alignas(64) SparseTableShard {
     return {it2, bucket, _buckets};
   }
   void quick_erase(iterator it) {
-    _alloc.release((VALUE*)(void*)it.it->second);  // NOLINT
+    delete_value((VALUE*)(void*)it.it->second);  // NOLINT
     _buckets[it.bucket].quick_erase(it.it);
   }
   local_iterator erase(size_t bucket, local_iterator it) {
-    _alloc.release((VALUE*)(void*)it.it->second);  // NOLINT
+    delete_value((VALUE*)(void*)it.it->second);  // NOLINT
     return {_buckets[bucket].erase(it.it)};
   }
   void quick_erase(size_t bucket, local_iterator it) {
-    _alloc.release((VALUE*)(void*)it.it->second);  // NOLINT
+    delete_value((VALUE*)(void*)it.it->second);  // NOLINT
     _buckets[bucket].quick_erase(it.it);
   }
   size_t erase(const KEY& key) {
@@ -185,6 +361,50 @@ struct alignas(64) SparseTableShard {
     quick_erase(it);
     return 1;
   }
+  // Values created afterwards are packed into a per-shard arena, each with
+  // room for `inline_dim` floats next to its header. Must be called while the
+  // shard is still empty.
+  void enable_value_arena(size_t inline_dim = 0) {
+    static_assert(std::is_same<VALUE, FixedFeatureValue>::value,
+                  "Only FixedFeatureValue can be kept in a value arena.");
+    PADDLE_ENFORCE_EQ(empty(),
+                      true,
+                      common::errors::PreconditionNotMet(
+                          "Value arena must be enabled on an empty shard."));
+    if (_arena == nullptr) {
+      _arena.reset(new FeatureValueArena());
+    }
+    _inline_dim = inline_dim;
+  }
+  FeatureValueArena* value_arena() { return _arena.get(); }
+  // Repacks all values into a fresh arena when the ratio of unused arena
+  // bytes exceeds `max_fragmentation`, e.g. after Shrink erased many keys.
+  // Every value gets its data inline again, grown ones included, so the
+  // pointers to the values change. Returns the number of bytes given back to
+  // the system.
+  size_t compact_values(double max_fragmentation) {
+    if (_arena == nullptr || _arena->fragmentation() <= max_fragmentation) {
+      return 0;
+    }
+    std::unique_ptr<FeatureValueArena> arena(new FeatureValueArena());
+    if constexpr (std::is_same<VALUE, FixedFeatureValue>::value) {
+      for (size_t bucket = 0; bucket < CTR_SPARSE_SHARD_BUCKET_NUM; bucket++) {
+        map_type& data = _buckets[bucket];
+        for (auto it = data.begin(); it != data.end(); ++it) {
+          VALUE* value = (VALUE*)(void*)it->second;  // NOLINT
+          VALUE* moved = VALUE::create(arena.get(),
+                                       std::max(_inline_dim, value->size()));
+          *moved = *value;
+          VALUE::destroy(value);
+          it->second = moved;
+        }
+      }
+    }
+    size_t old_bytes = _arena->reserved_bytes();
+    size_t new_bytes = arena->reserved_bytes();
+    _arena.swap(arena);
+    return old_bytes > new_bytes ? old_bytes - new_bytes : 0;
+  }
   size_t compute_bucket(size_t hash) {
     if (CTR_SPARSE_SHARD_BUCKET_NUM == 1) {
       return 0;
@@ -194,8 +414,36 @@ struct alignas(64) SparseTableShard {
   }
 
  private:
+  template <class... ARGS>
+  VALUE* new_value(ARGS&&... args) {
+    ++_value_count;
+    if constexpr (std::is_same<VALUE, FixedFeatureValue>::value) {
+      if (_arena != nullptr) {
+        VALUE* value = VALUE::create(_arena.get(), _inline_dim);
+        if constexpr (sizeof...(ARGS) > 0) {
+          *value = VALUE(std::forward<ARGS>(args)...);
+        }
+        return value;
+      }
+    }
+    return _alloc.acquire(std::forward<ARGS>(args)...);
+  }
+  void delete_value(VALUE* value) {
+    --_value_count;
+    if constexpr (std::is_same<VALUE, FixedFeatureValue>::value) {
+      if (_arena != nullptr) {
+        VALUE::destroy(value);
+        return;
+      }
+    }
+    _alloc.release(value);
+  }
+
   map_type _buckets[CTR_SPARSE_SHARD_BUCKET_NUM];
+  std::unique_ptr<FeatureValueArena> _arena;
+  size_t _inline_dim = 0;
   ChunkAllocator<VALUE> _alloc;
+  size_t _value_count = 0;
   std::hash<KEY> _hasher;
 };
 
@@ -0,0 +1,180 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <list>
+#include <mutex>  // NOLINT
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "paddle/fluid/distributed/common/frequency_sketch.h"
+
+namespace paddle {
+namespace distributed {
+
+// Admission-controlled cache of decoded feature values that were moved from
+// the memory shards to rocksdb. The cache is write-through: rocksdb always
+// holds the value as well, and the cache only saves the read.
+//
+// Every lookup that falls through the memory shard is counted in a
+// FrequencySketch. When the cache is full, a value is only admitted if it is
+// estimated to be looked up more often than the LRU victim it would evict.
+// The accessor's show counter seeds the estimate so that popular features
+// are preferred before the sketch has warmed up.
+class SSDValueCache {
+ public:
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t admissions = 0;
+    uint64_t rejections = 0;
+    uint64_t evictions = 0;
+    size_t size = 0;
+    size_t bytes = 0;
+    double HitRate() const {
+      uint64_t lookups = hits + misses;
+      return lookups == 0 ? 0.0 : static_cast<double>(hits) / lookups;
+    }
+    Stats& operator+=(const Stats& other) {
+      hits += other.hits;
+      misses += other.misses;
+      admissions += other.admissions;
+      rejections += other.rejections;
+      evictions += other.evictions;
+      size += other.size;
+      bytes += other.bytes;
+      return *this;
+    }
+  };
+
+  SSDValueCache(size_t capacity_bytes, size_t value_bytes)
+      : _capacity_bytes(capacity_bytes),
+        _sketch(capacity_bytes / std::max<size_t>(value_bytes, 1)) {}
+
+  // Removes the value of `key` from the cache and hands it to the caller,
+  // which moves it back into the memory shard. Every call counts as one
+  // access of `key`.
+  bool Take(uint64_t key, std::vector<float>* value) {
+    std::lock_guard<std::mutex> guard(_mutex);
+    _sketch.Increment(key);
+    auto it = _index.find(key);
+    if (it == _index.end()) {
+      ++_stats.misses;
+      return false;
+    }
+    ++_stats.hits;
+    value->swap(it->second->value);
+    RemoveLocked(it);
+    return true;
+  }
+
+  // Offers a value that was just written to rocksdb. Returns whether it was
+  // admitted.
+  bool Admit(uint64_t key, const float* data, size_t size, float show) {
+    size_t bytes = EntryBytes(size);
+    if (bytes > _capacity_bytes) {
+      return false;
+    }
+    std::lock_guard<std::mutex> guard(_mutex);
+    auto it = _index.find(key);
+    if (it != _index.end()) {
+      RemoveLocked(it);
+    }
+    uint32_t freq = Frequency(key, show);
+    while (_stats.bytes + bytes > _capacity_bytes) {
+      Entry& victim = _lru.back();
+      if (freq <= Frequency(victim.key, victim.show)) {
+        ++_stats.rejections;
+        return false;
+      }
+      RemoveLocked(_index.find(victim.key));
+      ++_stats.evictions;
+    }
+    _lru.emplace_front();
+    Entry& entry = _lru.front();
+    entry.key = key;
+    entry.show = show;
+    entry.bytes = bytes;
+    entry.value.assign(data, data + size);
+    _index[key] = _lru.begin();
+    _stats.bytes += bytes;
+    ++_stats.admissions;
+    return true;
+  }
+
+  void Erase(uint64_t key) {
+    std::lock_guard<std::mutex> guard(_mutex);
+    auto it = _index.find(key);
+    if (it != _index.end()) {
+      RemoveLocked(it);
+    }
+  }
+
+  // Drops all values, e.g. when rocksdb is rewritten by Load or Shrink.
+  // Frequencies and counters are kept.
+  void Clear() {
+    std::lock_guard<std::mutex> guard(_mutex);
+    _index.clear();
+    _lru.clear();
+    _stats.bytes = 0;
+  }
+
+  Stats GetStats() {
+    std::lock_guard<std::mutex> guard(_mutex);
+    Stats stats = _stats;
+    stats.size = _index.size();
+    return stats;
+  }
+
+ private:
+  struct Entry {
+    uint64_t key;
+    float show;
+    size_t bytes;
+    std::vector<float> value;
+  };
+  typedef std::list<Entry>::iterator entry_iterator;
+
+  static size_t EntryBytes(size_t size) {
+    // value plus list node and index overhead
+    return size * sizeof(float) + sizeof(Entry) + 4 * sizeof(void*);
+  }
+
+  uint32_t Frequency(uint64_t key, float show) const {
+    uint32_t prior = show > 0 ? static_cast<uint32_t>(std::log2(1 + show)) : 0;
+    return _sketch.Estimate(key) + prior;
+  }
+
+  void RemoveLocked(
+      std::unordered_map<uint64_t, entry_iterator>::iterator it) {
+    _stats.bytes -= it->second->bytes;
+    _lru.erase(it->second);
+    _index.erase(it);
+  }
+
+  std::mutex _mutex;
+  size_t _capacity_bytes;
+  FrequencySketch _sketch;
+  std::list<Entry> _lru;  // most recently admitted first
+  std::unordered_map<uint64_t, entry_iterator> _index;
+  Stats _stats;
+};
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,287 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/distributed/ps/table/graph/graph_csr.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+
+#include "paddle/common/enforce.h"
+
+namespace paddle::distributed {
+
+void GraphCsrStorage::clear() {
+  std::vector<uint64_t>().swap(ids);
+  std::vector<uint64_t>().swap(offsets);
+  std::vector<uint64_t>().swap(neighbor_ids);
+  std::vector<float>().swap(weights);
+  is_feature_node = false;
+  std::vector<int>().swap(feature_nums);
+  std::vector<FeatureColumn>().swap(features);
+}
+
+bool GraphCsrStorage::build(const std::vector<Node *> &nodes,
+                            const std::string &sample_type) {
+  clear();
+  this->sample_type = sample_type;
+  size_t edge_num = 0;
+  size_t graph_node_num = 0;
+  int feature_num = 0;
+  bool weighted = false;
+  for (auto *node : nodes) {
+    if (dynamic_cast<FloatFeatureNode *>(node) != nullptr) {
+      return false;
+    }
+    if (dynamic_cast<FeatureNode *>(node) != nullptr) {
+      feature_num = std::max(feature_num, node->get_feature_size());
+    } else if (dynamic_cast<GraphNode *>(node) != nullptr) {
+      ++graph_node_num;
+      size_t neighbor_size = node->get_neighbor_size();
+      edge_num += neighbor_size;
+      for (size_t j = 0; j < neighbor_size && !weighted; ++j) {
+        weighted = static_cast<float>(node->get_neighbor_weight(j)) != 1.0;
+      }
+    } else {
+      return false;
+    }
+  }
+  // a shard holds either graph nodes or feature nodes
+  if (graph_node_num != 0 && graph_node_num != nodes.size()) {
+    return false;
+  }
+
+  ids.reserve(nodes.size());
+  offsets.reserve(nodes.size() + 1);
+  offsets.push_back(0);
+  neighbor_ids.reserve(edge_num);
+  if (weighted) {
+    weights.reserve(edge_num);
+  }
+  for (auto *node : nodes) {
+    ids.push_back(node->get_id());
+    size_t neighbor_size = node->get_neighbor_size();
+    for (size_t j = 0; j < neighbor_size; ++j) {
+      neighbor_ids.push_back(node->get_neighbor_id(j));
+      if (weighted) {
+        weights.push_back(static_cast<float>(node->get_neighbor_weight(j)));
+      }
+    }
+    offsets.push_back(neighbor_ids.size());
+  }
+
+  is_feature_node = graph_node_num == 0 && !nodes.empty();
+  if (!is_feature_node) {
+    return true;
+  }
+  feature_nums.reserve(nodes.size());
+  features.resize(feature_num);
+  for (int f = 0; f < feature_num; ++f) {
+    size_t bytes = 0;
+    for (auto *node : nodes) {
+      if (f < node->get_feature_size()) {
+        bytes += node->get_feature(f).size();
+      }
+    }
+    auto &column = features[f];
+    column.offsets.reserve(nodes.size() + 1);
+    column.offsets.push_back(0);
+    column.data.reserve(bytes);
+    for (auto *node : nodes) {
+      if (f < node->get_feature_size()) {
+        std::string feature = node->get_feature(f);
+        column.data.insert(column.data.end(), feature.begin(), feature.end());
+      }
+      column.offsets.push_back(column.data.size());
+    }
+  }
+  for (auto *node : nodes) {
+    feature_nums.push_back(node->get_feature_size());
+  }
+  return true;
+}
+
+std::vector<Node *> GraphCsrStorage::to_nodes() const {
+  std::vector<Node *> nodes;
+  nodes.reserve(size());
+  for (size_t i = 0; i < size(); ++i) {
+    if (is_feature_node) {
+      auto *node = new FeatureNode(ids[i]);
+      node->set_feature_size(feature_nums[i]);
+      for (int f = 0; f < feature_nums[i]; ++f) {
+        node->set_feature(f, get_feature(i, f));
+      }
+      nodes.push_back(node);
+      continue;
+    }
+    auto *node = new GraphNode(ids[i]);
+    node->build_edges(is_weighted());
+    for (size_t j = 0; j < get_neighbor_size(i); ++j) {
+      node->add_edge(get_neighbor_id(i, j), get_neighbor_weight(i, j));
+    }
+    node->build_sampler(sample_type);
+    nodes.push_back(node);
+  }
+  return nodes;
+}
+
+std::vector<int> GraphCsrStorage::sample_k(
+    size_t pos, int k, const std::shared_ptr<std::mt19937_64> &rng) const {
+  int n = get_neighbor_size(pos);
+  std::vector<int> sample_result;
+  if (k >= n) {
+    sample_result.reserve(n);
+    for (int i = 0; i < n; i++) {
+      sample_result.push_back(i);
+    }
+    return sample_result;
+  }
+  sample_result.reserve(k);
+  if (!is_weighted() || sample_type == "random") {
+    // partial Fisher-Yates shuffle, as RandomSampler
+    std::unordered_map<int, int> replace_map;
+    while (k--) {
+      std::uniform_int_distribution<int> distrib(0, n - 1);
+      int rand_int = distrib(*rng);
+      auto iter = replace_map.find(rand_int);
+      sample_result.push_back(iter == replace_map.end() ? rand_int
+                                                        : iter->second);
+      iter = replace_map.find(n - 1);
+      replace_map[rand_int] = iter == replace_map.end() ? n - 1 : iter->second;
+      --n;
+    }
+    return sample_result;
+  }
+  // weighted sampling without replacement: keep the k largest keys
+  // u^(1/w), which draws the neighbors one by one with a probability
+  // proportional to the remaining weights, as WeightedSampler
+  std::uniform_real_distribution<double> distrib(0, 1);
+  typedef std::pair<double, int> KeyIdx;
+  std::priority_queue<KeyIdx, std::vector<KeyIdx>, std::greater<KeyIdx>> heap;
+  const float *w = weights.data() + offsets[pos];
+  for (int i = 0; i < n; ++i) {
+    if (w[i] <= 0) {
+      continue;
+    }
+    double key = std::log(distrib(*rng)) / w[i];
+    if (static_cast<int>(heap.size()) < k) {
+      heap.emplace(key, i);
+    } else if (key > heap.top().first) {
+      heap.pop();
+      heap.emplace(key, i);
+    }
+  }
+  while (!heap.empty()) {
+    sample_result.push_back(heap.top().second);
+    heap.pop();
+  }
+  return sample_result;
+}
+
+void GraphCsrStorage::get_feature_data(size_t pos,
+                                       int idx,
+                                       const char **data,
+                                       size_t *len) const {
+  if (idx < 0 || idx >= get_feature_size(pos)) {
+    *data = nullptr;
+    *len = 0;
+    return;
+  }
+  auto &column = features[idx];
+  *data = column.data.data() + column.offsets[pos];
+  *len = column.offsets[pos + 1] - column.offsets[pos];
+}
+
+std::string GraphCsrStorage::get_feature(size_t pos, int idx) const {
+  const char *data = nullptr;
+  size_t len = 0;
+  get_feature_data(pos, idx, &data, &len);
+  return std::string(data == nullptr ? "" : data, len);
+}
+
+int GraphCsrStorage::get_feature_ids(size_t pos,
+                                     std::vector<uint64_t> *res) const {
+  PADDLE_ENFORCE_NOT_NULL(
+      res,
+      common::errors::InvalidArgument("get_feature_ids res should not be null"));
+  for (int f = 0; f < get_feature_size(pos); ++f) {
+    const char *data = nullptr;
+    size_t len = 0;
+    get_feature_data(pos, f, &data, &len);
+    PADDLE_ENFORCE_EQ(len % sizeof(uint64_t),
+                      0,
+                      common::errors::PreconditionNotMet(
+                          "bad feature_item of node [%d]", ids[pos]));
+    size_t num = len / sizeof(uint64_t);
+    size_t n = res->size();
+    res->resize(n + num);
+    if (num > 0) {
+      memcpy(res->data() + n, data, len);
+    }
+  }
+  return 0;
+}
+
+int GraphCsrStorage::get_buffer_size(size_t pos, bool need_feature) const {
+  int size = Node::id_size + Node::int_size;  // id, feat_num
+  if (need_feature && is_feature_node) {
+    for (int f = 0; f < feature_nums[pos]; ++f) {
+      const char *data = nullptr;
+      size_t len = 0;
+      get_feature_data(pos, f, &data, &len);
+      size += Node::int_size + len;
+    }
+  }
+  return size;
+}
+
+void GraphCsrStorage::to_buffer(size_t pos,
+                                char *buffer,
+                                bool need_feature) const {
+  memcpy(buffer, &ids[pos], Node::id_size);
+  buffer += Node::id_size;
+  int feat_num = need_feature && is_feature_node ? feature_nums[pos] : 0;
+  memcpy(buffer, &feat_num, sizeof(int));
+  buffer += sizeof(int);
+  for (int f = 0; f < feat_num; ++f) {
+    const char *data = nullptr;
+    size_t len = 0;
+    get_feature_data(pos, f, &data, &len);
+    int feat_len = len;
+    memcpy(buffer, &feat_len, sizeof(int));
+    buffer += sizeof(int);
+    if (len > 0) {
+      memcpy(buffer, data, len);
+    }
+    buffer += len;
+  }
+}
+
+size_t GraphCsrStorage::memory_bytes() const {
+  size_t bytes = ids.capacity() * sizeof(uint64_t) +
+                 offsets.capacity() * sizeof(uint64_t) +
+                 neighbor_ids.capacity() * sizeof(uint64_t) +
+                 weights.capacity() * sizeof(float) +
+                 feature_nums.capacity() * sizeof(int);
+  for (auto &column : features) {
+    bytes += column.offsets.capacity() * sizeof(uint64_t) +
+             column.data.capacity();
+  }
+  return bytes;
+}
+
+}  // namespace paddle::distributed
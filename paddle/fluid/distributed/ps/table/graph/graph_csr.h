@@ -0,0 +1,109 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "paddle/fluid/distributed/ps/table/graph/graph_node.h"
+namespace paddle {
+namespace distributed {
+
+// Immutable compressed sparse row storage of the nodes of a GraphShard.
+// Node i has the neighbors neighbor_ids[offsets[i], offsets[i + 1]), with
+// the weights at the same positions when any edge is weighted. The features
+// of FeatureNodes are stored by column: feature f of every node lives in
+// one byte arena. Compared to a Node object per id, this saves the object,
+// edge blob and sampler allocations, and scans neighbors sequentially.
+class GraphCsrStorage {
+ public:
+  GraphCsrStorage() {}
+
+  // Builds from `nodes`, whose order is kept. Returns false, leaving the
+  // storage empty, if a node type can not be stored, e.g. FloatFeatureNode.
+  // `sample_type` names the sampler GraphNode::build_sampler would build.
+  bool build(const std::vector<Node *> &nodes,
+             const std::string &sample_type = "random");
+  // Creates the Node objects back, in the order of the storage, with
+  // samplers of the sample type.
+  std::vector<Node *> to_nodes() const;
+
+  const std::string &get_sample_type() const { return sample_type; }
+  void set_sample_type(const std::string &type) { sample_type = type; }
+
+  size_t size() const { return ids.size(); }
+  uint64_t get_id(size_t pos) const { return ids[pos]; }
+  bool is_weighted() const { return !weights.empty(); }
+
+  size_t get_neighbor_size(size_t pos) const {
+    return offsets[pos + 1] - offsets[pos];
+  }
+  uint64_t get_neighbor_id(size_t pos, size_t idx) const {
+    return neighbor_ids[offsets[pos] + idx];
+  }
+  // the neighbors of all the nodes
+  const std::vector<uint64_t> &get_neighbor_ids() const {
+    return neighbor_ids;
+  }
+  float get_neighbor_weight(size_t pos, size_t idx) const {
+    return weights.empty() ? 1.0 : weights[offsets[pos] + idx];
+  }
+  // Samples k distinct neighbor indices of node `pos` like the sampler of
+  // the sample type: uniformly for "random", otherwise with a probability
+  // proportional to the weights when the storage is weighted.
+  std::vector<int> sample_k(size_t pos,
+                            int k,
+                            const std::shared_ptr<std::mt19937_64> &rng) const;
+
+  int get_feature_size(size_t pos) const {
+    return feature_nums.empty() ? 0 : feature_nums[pos];
+  }
+  std::string get_feature(size_t pos, int idx) const;
+  // Same as FeatureNode::get_feature_ids(res), appends all the feature ids.
+  int get_feature_ids(size_t pos, std::vector<uint64_t> *res) const;
+  // Same as Node::get_size and Node::to_buffer of the node at `pos`, so
+  // pull_graph_list returns the same bytes in both storages.
+  int get_buffer_size(size_t pos, bool need_feature) const;
+  void to_buffer(size_t pos, char *buffer, bool need_feature) const;
+
+  size_t memory_bytes() const;
+
+ private:
+  struct FeatureColumn {
+    // node i has the bytes data[offsets[i], offsets[i + 1])
+    std::vector<uint64_t> offsets;
+    std::vector<char> data;
+  };
+
+  void clear();
+  void get_feature_data(size_t pos,
+                        int idx,
+                        const char **data,
+                        size_t *len) const;
+
+  std::vector<uint64_t> ids;
+  std::vector<uint64_t> offsets;
+  std::vector<uint64_t> neighbor_ids;
+  std::vector<float> weights;
+  std::string sample_type = "random";
+  bool is_feature_node = false;
+  std::vector<int> feature_nums;
+  std::vector<FeatureColumn> features;
+};
+
+}  // namespace distributed
+}  // namespace paddle
@@ -110,7 +110,9 @@ class GraphNode : public Node {
 #else
   virtual float get_neighbor_weight(int idx) { return edges->get_weight(idx); }
 #endif
-  virtual size_t get_neighbor_size() { return edges->size(); }
+  virtual size_t get_neighbor_size() {
+    return edges == nullptr ? 0 : edges->size();
+  }
 
  protected:
   Sampler *sampler;
@@ -0,0 +1,369 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/distributed/ps/table/graph/graph_sample_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <sstream>
+
+namespace paddle::distributed {
+
+namespace {
+
+constexpr size_t kWays = 8;
+constexpr size_t kReadBufferSize = 256;
+// a slot whose meta is 0 holds nothing
+constexpr uint64_t kValidMeta = 1ULL << 63;
+
+// idx, sample_size and is_weighted of a key, which fit in one word for any
+// sample size below 2^31
+uint64_t pack_meta(const SampleKey &key) {
+  return kValidMeta | (static_cast<uint64_t>(key.idx & 0x7fffffff) << 32) |
+         (static_cast<uint64_t>(key.sample_size) << 1) |
+         static_cast<uint64_t>(key.is_weighted);
+}
+
+// the version of a slot and the lookups left before its result expires share
+// one word, so that a lookup takes a use only from the entry it read
+uint64_t pack_state(uint32_t version, int32_t ttl) {
+  return (static_cast<uint64_t>(version) << 32) | static_cast<uint32_t>(ttl);
+}
+
+uint32_t state_version(uint64_t state) {
+  return static_cast<uint32_t>(state >> 32);
+}
+
+int32_t state_ttl(uint64_t state) { return static_cast<int32_t>(state); }
+
+uint64_t hash_key(uint64_t node_key, uint64_t meta) {
+  uint64_t h = node_key * 0x9E3779B97F4A7C15ULL ^ meta;
+  h ^= h >> 31;
+  h *= 0xBF58476D1CE4E5B9ULL;
+  h ^= h >> 29;
+  return h;
+}
+
+}  // namespace
+
+struct NeighborSampleCache::Shard {
+  struct Slot {
+    // pack_state of the version, odd while a writer rewrites the slot, and
+    // of the lookups left before the result expires
+    std::atomic<uint64_t> state{0};
+    std::atomic<uint64_t> node_key{0};
+    std::atomic<uint64_t> meta{0};
+    std::atomic<uint32_t> bytes{0};
+    // set by lookups, cleared by the CLOCK sweep
+    std::atomic<uint8_t> referenced{0};
+  };
+
+  Shard(size_t set_num, size_t value_words)
+      : set_mask(set_num - 1),
+        slots(set_num * kWays),
+        arena(set_num * kWays * value_words),
+        hands(set_num, 0),
+        sketch(set_num * kWays),
+        read_buffer(kReadBufferSize) {}
+
+  size_t set_mask;
+  std::vector<Slot> slots;
+  // slot i holds its result in the words [i * value_words, (i + 1) *
+  // value_words), atomic words so that racing readers are well defined
+  std::vector<std::atomic<uint64_t>> arena;
+
+  // written under the mutex
+  std::mutex mutex;
+  std::vector<uint8_t> hands;
+  FrequencySketch sketch;
+  size_t size = 0;
+
+  // hashes of the looked up keys, for the sketch
+  std::vector<std::atomic<uint64_t>> read_buffer;
+  std::atomic<uint64_t> read_pos{0};
+  std::atomic<uint64_t> drain_pos{0};
+
+  std::atomic<uint64_t> hits{0};
+  std::atomic<uint64_t> misses{0};
+  std::atomic<uint64_t> expirations{0};
+  std::atomic<uint64_t> insertions{0};
+  std::atomic<uint64_t> evictions{0};
+  std::atomic<uint64_t> rejections{0};
+};
+
+NeighborSampleCache::Stats &NeighborSampleCache::Stats::operator+=(
+    const Stats &other) {
+  hits += other.hits;
+  misses += other.misses;
+  expirations += other.expirations;
+  insertions += other.insertions;
+  evictions += other.evictions;
+  rejections += other.rejections;
+  size += other.size;
+  capacity += other.capacity;
+  return *this;
+}
+
+std::string NeighborSampleCache::Stats::ToString() const {
+  std::ostringstream os;
+  os << "hits:" << hits << " misses:" << misses << " hit_rate:" << HitRate()
+     << " expirations:" << expirations << " insertions:" << insertions
+     << " evictions:" << evictions << " rejections:" << rejections
+     << " size:" << size << "/" << capacity;
+  return os.str();
+}
+
+NeighborSampleCache::NeighborSampleCache(size_t shard_num,
+                                         size_t size_limit,
+                                         size_t ttl,
+                                         size_t value_bytes)
+    : ttl(ttl),
+      value_words((value_bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t)) {
+  shard_num = std::max<size_t>(shard_num, 1);
+  size_t shard_slots = (size_limit + shard_num - 1) / shard_num;
+  size_t set_num = 1;
+  while (set_num * kWays < shard_slots) {
+    set_num <<= 1;
+  }
+  for (size_t i = 0; i < shard_num; ++i) {
+    shards.emplace_back(new Shard(set_num, value_words));
+  }
+}
+
+NeighborSampleCache::~NeighborSampleCache() {}
+
+LRUResponse NeighborSampleCache::query(
+    size_t index,
+    SampleKey *keys,
+    size_t length,
+    std::vector<std::pair<SampleKey, SampleResult>> *res) {
+  Shard *shard = shards[index % shards.size()].get();
+  for (size_t i = 0; i < length; ++i) {
+    lookup(shard, keys[i], res);
+  }
+  // keep the sketch current when the shard sees few inserts
+  if (shard->read_pos.load(std::memory_order_relaxed) -
+          shard->drain_pos.load(std::memory_order_relaxed) >=
+      kReadBufferSize / 2) {
+    std::unique_lock<std::mutex> lock(shard->mutex, std::try_to_lock);
+    if (lock.owns_lock()) {
+      drain_read_buffer(shard);
+    }
+  }
+  return LRUResponse::ok;
+}
+
+bool NeighborSampleCache::lookup(
+    Shard *shard,
+    const SampleKey &key,
+    std::vector<std::pair<SampleKey, SampleResult>> *res) {
+  uint64_t meta = pack_meta(key);
+  uint64_t hash = hash_key(key.node_key, meta);
+  uint64_t pos = shard->read_pos.fetch_add(1, std::memory_order_relaxed);
+  shard->read_buffer[pos % kReadBufferSize].store(hash,
+                                                  std::memory_order_relaxed);
+
+  size_t set = hash & shard->set_mask;
+  for (size_t way = 0; way < kWays; ++way) {
+    size_t slot_id = set * kWays + way;
+    auto &slot = shard->slots[slot_id];
+    uint64_t state = slot.state.load(std::memory_order_acquire);
+    uint32_t version = state_version(state);
+    if ((version & 1) != 0 ||
+        slot.meta.load(std::memory_order_relaxed) != meta ||
+        slot.node_key.load(std::memory_order_relaxed) != key.node_key) {
+      continue;
+    }
+    if (state_ttl(state) <= 0) {
+      shard->expirations.fetch_add(1, std::memory_order_relaxed);
+      break;
+    }
+    size_t bytes = std::min<size_t>(slot.bytes.load(std::memory_order_relaxed),
+                                    value_words * sizeof(uint64_t));
+    std::unique_ptr<char[]> buffer(new char[bytes]);
+    const auto *data = shard->arena.data() + slot_id * value_words;
+    for (size_t offset = 0; offset < bytes; offset += sizeof(uint64_t)) {
+      uint64_t word =
+          data[offset / sizeof(uint64_t)].load(std::memory_order_relaxed);
+      memcpy(buffer.get() + offset,
+             &word,
+             std::min(sizeof(uint64_t), bytes - offset));
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // one use of the entry that was read, none if the slot was rewritten
+    // meanwhile: the new entry keeps all its uses
+    state = slot.state.load(std::memory_order_relaxed);
+    while (state_version(state) == version && state_ttl(state) > 0 &&
+           !slot.state.compare_exchange_weak(
+               state,
+               pack_state(version, state_ttl(state) - 1),
+               std::memory_order_relaxed)) {
+    }
+    if (state_version(state) != version) {
+      break;
+    }
+    if (state_ttl(state) <= 0) {
+      shard->expirations.fetch_add(1, std::memory_order_relaxed);
+      break;
+    }
+    slot.referenced.store(1, std::memory_order_relaxed);
+    res->emplace_back(key, SampleResult(bytes, buffer.release()));
+    shard->hits.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+  shard->misses.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+LRUResponse NeighborSampleCache::insert(size_t index,
+                                        SampleKey *keys,
+                                        SampleResult *data,
+                                        size_t length) {
+  Shard *shard = shards[index % shards.size()].get();
+  std::lock_guard<std::mutex> lock(shard->mutex);
+  drain_read_buffer(shard);
+  for (size_t i = 0; i < length; ++i) {
+    insert_one(shard, keys[i], data[i]);
+  }
+  return LRUResponse::ok;
+}
+
+void NeighborSampleCache::drain_read_buffer(Shard *shard) {
+  uint64_t end = shard->read_pos.load(std::memory_order_relaxed);
+  uint64_t begin = shard->drain_pos.load(std::memory_order_relaxed);
+  // the older entries were overwritten, and are lost to the sketch
+  begin = std::max(begin, end > kReadBufferSize ? end - kReadBufferSize : 0);
+  for (uint64_t pos = begin; pos < end; ++pos) {
+    shard->sketch.Increment(
+        shard->read_buffer[pos % kReadBufferSize].load(
+            std::memory_order_relaxed));
+  }
+  shard->drain_pos.store(end, std::memory_order_relaxed);
+}
+
+void NeighborSampleCache::insert_one(Shard *shard,
+                                     const SampleKey &key,
+                                     const SampleResult &data) {
+  if (data.actual_size > value_words * sizeof(uint64_t) ||
+      key.sample_size >= (1ULL << 31)) {
+    shard->rejections.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  uint64_t meta = pack_meta(key);
+  uint64_t hash = hash_key(key.node_key, meta);
+  size_t set = hash & shard->set_mask;
+  auto slot_at = [&](size_t way) -> Shard::Slot & {
+    return shard->slots[set * kWays + way];
+  };
+
+  // the same key, else a free or expired slot
+  size_t target = kWays;
+  for (size_t way = 0; way < kWays; ++way) {
+    auto &slot = slot_at(way);
+    uint64_t slot_meta = slot.meta.load(std::memory_order_relaxed);
+    if (slot_meta == meta &&
+        slot.node_key.load(std::memory_order_relaxed) == key.node_key) {
+      target = way;
+      break;
+    }
+    if (target == kWays &&
+        (slot_meta == 0 ||
+         state_ttl(slot.state.load(std::memory_order_relaxed)) <= 0)) {
+      target = way;
+    }
+  }
+  if (target == kWays) {
+    // CLOCK: the first slot not referenced since the hand last passed it,
+    // bounded as lookups keep setting the bits
+    uint8_t &hand = shard->hands[set];
+    for (size_t step = 0;
+         step < kWays &&
+         slot_at(hand).referenced.exchange(0, std::memory_order_relaxed);
+         ++step) {
+      hand = (hand + 1) % kWays;
+    }
+    target = hand;
+    hand = (hand + 1) % kWays;
+    auto &victim = slot_at(target);
+    uint64_t victim_hash =
+        hash_key(victim.node_key.load(std::memory_order_relaxed),
+                 victim.meta.load(std::memory_order_relaxed));
+    if (shard->sketch.Estimate(hash) <= shard->sketch.Estimate(victim_hash)) {
+      shard->rejections.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    shard->evictions.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  auto &slot = slot_at(target);
+  if (slot.meta.load(std::memory_order_relaxed) == 0) {
+    ++shard->size;
+  }
+  uint32_t version = state_version(slot.state.load(std::memory_order_relaxed));
+  slot.state.store(pack_state(version + 1, 0), std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.node_key.store(key.node_key, std::memory_order_relaxed);
+  slot.meta.store(meta, std::memory_order_relaxed);
+  slot.bytes.store(data.actual_size, std::memory_order_relaxed);
+  slot.referenced.store(0, std::memory_order_relaxed);
+  auto *words = shard->arena.data() + (set * kWays + target) * value_words;
+  const char *src = data.buffer.get();
+  for (size_t offset = 0; offset < data.actual_size;
+       offset += sizeof(uint64_t)) {
+    uint64_t word = 0;
+    memcpy(&word,
+           src + offset,
+           std::min(sizeof(uint64_t), data.actual_size - offset));
+    words[offset / sizeof(uint64_t)].store(word, std::memory_order_relaxed);
+  }
+  slot.state.store(pack_state(version + 2,
+                              ttl == 0 ? std::numeric_limits<int32_t>::max()
+                                       : static_cast<int32_t>(ttl)),
+                   std::memory_order_release);
+  shard->insertions.fetch_add(1, std::memory_order_relaxed);
+}
+
+void NeighborSampleCache::clear() {
+  for (auto &shard : shards) {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    for (auto &slot : shard->slots) {
+      uint32_t version =
+          state_version(slot.state.load(std::memory_order_relaxed));
+      slot.state.store(pack_state(version + 1, 0), std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      slot.meta.store(0, std::memory_order_relaxed);
+      slot.state.store(pack_state(version + 2, 0), std::memory_order_release);
+    }
+    shard->size = 0;
+  }
+}
+
+NeighborSampleCache::Stats NeighborSampleCache::get_stats() const {
+  Stats stats;
+  for (auto &shard : shards) {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    stats.hits += shard->hits.load(std::memory_order_relaxed);
+    stats.misses += shard->misses.load(std::memory_order_relaxed);
+    stats.expirations += shard->expirations.load(std::memory_order_relaxed);
+    stats.insertions += shard->insertions.load(std::memory_order_relaxed);
+    stats.evictions += shard->evictions.load(std::memory_order_relaxed);
+    stats.rejections += shard->rejections.load(std::memory_order_relaxed);
+    stats.size += shard->size;
+    stats.capacity += shard->slots.size();
+  }
+  return stats;
+}
+
+}  // namespace paddle::distributed
@@ -0,0 +1,148 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "paddle/fluid/distributed/common/frequency_sketch.h"
+namespace paddle {
+namespace distributed {
+
+enum LRUResponse { ok = 0, blocked = 1, err = 2 };
+
+struct SampleKey {
+  int idx;
+  uint64_t node_key;
+  size_t sample_size;
+  bool is_weighted;
+  SampleKey(int _idx,
+            uint64_t _node_key,
+            size_t _sample_size,
+            bool _is_weighted) {
+    idx = _idx;
+    node_key = _node_key;
+    sample_size = _sample_size;
+    is_weighted = _is_weighted;
+  }
+  bool operator==(const SampleKey &s) const {
+    return idx == s.idx && node_key == s.node_key &&
+           sample_size == s.sample_size && is_weighted == s.is_weighted;
+  }
+};
+
+class SampleResult {
+ public:
+  size_t actual_size;
+  std::shared_ptr<char> buffer;
+  SampleResult(size_t _actual_size, std::shared_ptr<char> &_buffer)  // NOLINT
+      : actual_size(_actual_size), buffer(_buffer) {}
+  SampleResult(size_t _actual_size, char *_buffer)
+      : actual_size(_actual_size),
+        buffer(_buffer, [](char *p) { delete[] p; }) {}
+  ~SampleResult() {}
+};
+
+// Cache of neighbor sample results, split into shards that match the sample
+// task pools of GraphTable. A shard is a set associative table of fixed slots
+// whose results are copied into one preallocated arena, so caching allocates
+// nothing after construction.
+//
+// Lookups take no lock: a slot is guarded by a version counter that writers
+// make odd while they rewrite it, and a reader retries nothing, it counts a
+// miss when the version moved under it. Inserts take the shard mutex. When a
+// set is full the victim is chosen by CLOCK over the slots referenced since
+// the last sweep, and only replaced if the TinyLFU sketch estimates the new
+// key to be sampled more often. Lookups reach the sketch through a lossy
+// ring buffer drained by the writers.
+//
+// As before, a result is served at most `ttl` times (0 for no limit), so that
+// repeated queries still see fresh samples. The ttl shares a word with the
+// version, and a lookup takes its use with one compare and swap that fails
+// once the slot was rewritten.
+class NeighborSampleCache {
+ public:
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    // lookups of a key whose ttl ran out
+    uint64_t expirations = 0;
+    uint64_t insertions = 0;
+    uint64_t evictions = 0;
+    // inserts refused by the admission policy or larger than a slot
+    uint64_t rejections = 0;
+    size_t size = 0;
+    size_t capacity = 0;
+    double HitRate() const {
+      uint64_t lookups = hits + misses;
+      return lookups == 0 ? 0.0 : static_cast<double>(hits) / lookups;
+    }
+    Stats &operator+=(const Stats &other);
+    std::string ToString() const;
+  };
+
+  // `size_limit` results of at most `value_bytes` each, over `shard_num`
+  // shards.
+  NeighborSampleCache(size_t shard_num,
+                      size_t size_limit,
+                      size_t ttl,
+                      size_t value_bytes);
+  ~NeighborSampleCache();
+
+  // Appends the cached results of `keys` to `res`, in the order of `keys`.
+  // Never blocked.
+  LRUResponse query(size_t index,
+                    SampleKey *keys,
+                    size_t length,
+                    std::vector<std::pair<SampleKey, SampleResult>> *res);
+  LRUResponse insert(size_t index,
+                     SampleKey *keys,
+                     SampleResult *data,
+                     size_t length);
+  void clear();
+
+  Stats get_stats() const;
+  size_t get_ttl() { return ttl; }
+
+ private:
+  struct Shard;
+
+  bool lookup(Shard *shard,
+              const SampleKey &key,
+              std::vector<std::pair<SampleKey, SampleResult>> *res);
+  void insert_one(Shard *shard, const SampleKey &key, const SampleResult &data);
+  void drain_read_buffer(Shard *shard);
+
+  std::vector<std::unique_ptr<Shard>> shards;
+  size_t ttl;
+  size_t value_words;
+};
+
+}  // namespace distributed
+}  // namespace paddle
+
+namespace std {
+
+template <>
+struct hash<::paddle::distributed::SampleKey> {
+  size_t operator()(const ::paddle::distributed::SampleKey &s) const {
+    return s.idx ^ s.node_key ^ s.sample_size;
+  }
+};
+}  // namespace std
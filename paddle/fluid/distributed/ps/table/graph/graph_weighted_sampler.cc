@@ -14,9 +14,15 @@
 
 #include "paddle/fluid/distributed/ps/table/graph/graph_weighted_sampler.h"
 
+#include <algorithm>
+#include <cmath>
+#include <functional>
 #include <iostream>
+#include <limits>
 #include <memory>
+#include <queue>
 #include <unordered_map>
+#include <utility>
 
 #include "paddle/phi/core/generator.h"
 namespace paddle::distributed {
@@ -165,4 +171,122 @@ int WeightedSampler::sample(
   subtract_count_map[this]++;
   return return_idx;
 }
+
+void AliasSampler::build(GraphEdgeBlob *edges) {
+  this->edges = edges;
+  int n = edges->size();
+  prob.assign(n, 1.0);
+  alias.resize(n);
+  std::vector<double> scaled(n);
+  double total = 0;
+  for (int i = 0; i < n; i++) {
+    scaled[i] = std::max(static_cast<double>(edges->get_weight(i)), 0.0);
+    total += scaled[i];
+  }
+  for (int i = 0; i < n; i++) {
+    // all zero weights sample uniformly
+    scaled[i] = total > 0 ? scaled[i] * n / total : 1.0;
+    alias[i] = i;
+  }
+  std::vector<int> small, large;
+  for (int i = n - 1; i >= 0; i--) {
+    (scaled[i] < 1.0 ? small : large).push_back(i);
+  }
+  while (!small.empty() && !large.empty()) {
+    int less = small.back();
+    int more = large.back();
+    small.pop_back();
+    prob[less] = scaled[less];
+    alias[less] = more;
+    scaled[more] -= 1.0 - scaled[less];
+    if (scaled[more] < 1.0) {
+      large.pop_back();
+      small.push_back(more);
+    }
+  }
+  // the rest is 1 up to rounding errors, and keeps prob 1
+}
+
+int AliasSampler::sample(std::mt19937_64 *rng) const {
+  int n = prob.size();
+  if (n == 0) {
+    return -1;
+  }
+  std::uniform_int_distribution<int> bucket(0, n - 1);
+  std::uniform_real_distribution<float> coin(0, 1.0);
+  int i = bucket(*rng);
+  return coin(*rng) < prob[i] ? i : alias[i];
+}
+
+std::vector<int> AliasSampler::sample_k(
+    int k, const std::shared_ptr<std::mt19937_64> rng) {
+  int n = prob.size();
+  std::vector<int> sample_result;
+  if (k >= n) {
+    sample_result.reserve(n);
+    for (int i = 0; i < n; i++) {
+      sample_result.push_back(i);
+    }
+    return sample_result;
+  }
+  // the duplicate check scans the result, so rejection is kept to small k
+  // on nodes of much larger degree
+  const int kMaxRejectK = 32;
+  if (k > kMaxRejectK || k * 4 > n) {
+    sample_by_keys(k, rng.get(), &sample_result);
+    return sample_result;
+  }
+  sample_result.reserve(k);
+  int budget = 4 * k + 16;
+  while (static_cast<int>(sample_result.size()) < k) {
+    if (budget-- == 0) {
+      // the picks so far stand, the keys draw the rest from the others
+      sample_by_keys(k, rng.get(), &sample_result);
+      break;
+    }
+    int idx = sample(rng.get());
+    if (std::find(sample_result.begin(), sample_result.end(), idx) ==
+        sample_result.end()) {
+      sample_result.push_back(idx);
+    }
+  }
+  return sample_result;
+}
+
+void AliasSampler::sample_by_keys(int k,
+                                  std::mt19937_64 *rng,
+                                  std::vector<int> *sample_result) const {
+  // keeping the k largest log(u) / w draws the edges one by one with a
+  // probability proportional to the remaining weights, zero weights last
+  int n = prob.size();
+  int picked = sample_result->size();
+  k -= picked;
+  std::vector<int> skip(sample_result->begin(), sample_result->end());
+  std::sort(skip.begin(), skip.end());
+  std::uniform_real_distribution<double> distrib(0, 1.0);
+  typedef std::pair<double, int> KeyIdx;
+  std::vector<KeyIdx> heap_data;
+  heap_data.reserve(k);
+  std::priority_queue<KeyIdx, std::vector<KeyIdx>, std::greater<KeyIdx>> heap(
+      std::greater<KeyIdx>(), std::move(heap_data));
+  for (int i = 0; i < n; i++) {
+    if (picked > 0 && std::binary_search(skip.begin(), skip.end(), i)) {
+      continue;
+    }
+    double weight = edges->get_weight(i);
+    double key = weight > 0 ? std::log(distrib(*rng)) / weight
+                            : -std::numeric_limits<double>::infinity();
+    if (static_cast<int>(heap.size()) < k) {
+      heap.emplace(key, i);
+    } else if (key > heap.top().first) {
+      heap.pop();
+      heap.emplace(key, i);
+    }
+  }
+  sample_result->resize(picked + heap.size());
+  for (int i = static_cast<int>(heap.size()) - 1; i >= 0; i--) {
+    (*sample_result)[picked + i] = heap.top().second;
+    heap.pop();
+  }
+}
 }  // namespace paddle::distributed
@@ -62,5 +62,34 @@ class WeightedSampler : public Sampler {
       std::unordered_map<WeightedSampler *, int> &subtract_count_map,  // NOLINT
       float &subtract);                                                // NOLINT
 };
+
+// Weighted sampling by Vose's alias method. build makes two arrays over the
+// edges, after which one draw is a uniform bucket plus a biased coin. sample_k
+// draws without replacement, with the same distribution as WeightedSampler:
+// each pick is proportional to the weights of the edges not picked yet.
+// Small k rejects the repeated draws, larger k, or draws rejected too often
+// because the picked edges hold most of the weight, switch to one pass of
+// exponential keys over the weights not picked yet.
+class AliasSampler : public Sampler {
+ public:
+  AliasSampler() : edges(nullptr) {}
+  virtual ~AliasSampler() {}
+  virtual void build(GraphEdgeBlob *edges);
+  virtual std::vector<int> sample_k(int k,
+                                    const std::shared_ptr<std::mt19937_64> rng);
+  // One draw with replacement, -1 if there is no edge.
+  int sample(std::mt19937_64 *rng) const;
+  GraphEdgeBlob *edges;
+
+ private:
+  // Fills sample_result up to k edges, drawn from the edges not in it.
+  void sample_by_keys(int k,
+                      std::mt19937_64 *rng,
+                      std::vector<int> *sample_result) const;
+
+  // bucket i keeps i with probability prob[i], otherwise yields alias[i]
+  std::vector<float> prob;
+  std::vector<int> alias;
+};
 }  // namespace distributed
 }  // namespace paddle
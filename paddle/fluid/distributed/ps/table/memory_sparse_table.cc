@@ -20,6 +20,7 @@
 #include "paddle/fluid/distributed/common/local_random.h"
 #include "paddle/fluid/distributed/common/topk_calculator.h"
 #include "paddle/fluid/distributed/ps/table/memory_sparse_table.h"
+#include "paddle/fluid/distributed/ps/table/sparse_table_loader.h"
 #include "paddle/fluid/framework/archive.h"
 #include "paddle/fluid/framework/io/fs.h"
 
@@ -38,9 +39,105 @@ PD_DEFINE_bool(pserver_enable_create_feasign_randomly,
 PD_DEFINE_int32(pserver_table_save_max_retry,
                 3,
                 "pserver_table_save_max_retry");
+PD_DEFINE_bool(pserver_sparse_value_arena,
+               false,
+               "pack sparse table values into per-shard arenas instead of "
+               "allocating every value on the heap");
+PD_DEFINE_double(pserver_sparse_value_arena_compact_ratio,
+                 0.3,
+                 "compact a shard's value arena in Shrink when the ratio of "
+                 "unused arena bytes exceeds this value");
+PD_DEFINE_bool(pserver_sparse_table_save_snapshot,
+               false,
+               "save checkpoints of sparse tables as binary snapshots that "
+               "are mapped on load instead of text");
+PD_DEFINE_bool(pserver_sparse_concurrent_index,
+               false,
+               "look up sparse keys through a lock-free index so that pulls "
+               "and pushes of the same shard run on many threads");
+PD_DEFINE_bool(pserver_sparse_table_delta_save,
+               false,
+               "track the keys changed and erased since the last checkpoint, "
+               "so that save param 6 writes a snapshot of only those keys");
+PD_DEFINE_bool(pserver_sparse_table_pipeline_load,
+               false,
+               "load sparse table text files with overlapped read, parse and "
+               "insert stages instead of one thread per file");
+PD_DEFINE_int32(pserver_sparse_table_load_parse_threads,
+                8,
+                "parser threads of the pipelined sparse table load");
+PD_DEFINE_int32(pserver_sparse_table_load_memory_mb,
+                1024,
+                "memory bound of the blocks buffered between the stages of "
+                "the pipelined sparse table load");
 
 namespace paddle::distributed {
 
+// Runs `func` on the data of `value` and marks the value dirty if the data
+// was changed.
+template <class Func>
+static void TrackValueChange(FixedFeatureValue *value, Func &&func) {
+  size_t size = value->size();
+  float before[size + 1];  // NOLINT
+  memcpy(before, value->data(), size * sizeof(float));
+  func(value->data());
+  if (memcmp(before, value->data(), size * sizeof(float)) != 0) {
+    value->set_dirty(true);
+  }
+}
+
+// Collects updates of values that already have their full size, so that the
+// accessor applies them in batches instead of one call per key. Pending
+// updates must be flushed before a value is changed in any other way.
+class SparsePushBatch {
+ public:
+  static constexpr size_t kMaxSize = 256;
+
+  SparsePushBatch(ValueAccessor *accessor,
+                  MemorySparseTable::shard_type *revert_shard)
+      : _accessor(accessor), _revert_shard(revert_shard) {
+    _values.reserve(kMaxSize);
+    _updates.reserve(kMaxSize);
+  }
+  ~SparsePushBatch() { Flush(); }
+
+  void Add(uint64_t key, FixedFeatureValue *value, const float *update) {
+    _values.push_back(value->data());
+    _updates.push_back(update);
+    if (_revert_shard != nullptr) {
+      _items.emplace_back(key, value);
+    }
+    if (_values.size() == kMaxSize) {
+      Flush();
+    }
+  }
+
+  void Flush() {
+    if (_values.empty()) {
+      return;
+    }
+    _accessor->Update(_values.data(), _updates.data(), _values.size());
+    for (auto &item : _items) {
+      FixedFeatureValue *feature_value_new = &((*_revert_shard)[item.first]);
+      auto new_size = item.second->size();
+      feature_value_new->resize(new_size);
+      memcpy(feature_value_new->data(),
+             item.second->data(),
+             new_size * sizeof(float));
+    }
+    _values.clear();
+    _updates.clear();
+    _items.clear();
+  }
+
+ private:
+  ValueAccessor *_accessor;
+  MemorySparseTable::shard_type *_revert_shard;
+  std::vector<float *> _values;
+  std::vector<const float *> _updates;
+  std::vector<std::pair<uint64_t, FixedFeatureValue *>> _items;
+};
+
 int32_t MemorySparseTable::Initialize() {
   auto &profiler = CostProfiler::instance();
   profiler.register_profiler("pserver_sparse_update_all");
@@ -77,6 +174,24 @@ int32_t MemorySparseTable::InitializeValue() {
           << " _use_gpu_graph:" << _use_gpu_graph;
 
   _local_shards.reset(new shard_type[_real_local_shard_num]);
+  if (FLAGS_pserver_sparse_value_arena) {
+    // the values are created without the embedx, which moves them out of
+    // the header block until the next compaction
+    size_t inline_dim = (_value_accessor->GetAccessorInfo().size -
+                         _value_accessor->GetAccessorInfo().mf_size) /
+                        sizeof(float);
+    for (int i = 0; i < _real_local_shard_num; ++i) {
+      _local_shards[i].enable_value_arena(inline_dim);
+    }
+  }
+  if (FLAGS_pserver_sparse_concurrent_index) {
+    _local_shard_indexes.reset(new shard_index_type[_real_local_shard_num]);
+    _local_shard_mutexes.reset(new std::mutex[_real_local_shard_num]);
+  }
+  if (FLAGS_pserver_sparse_table_delta_save) {
+    _local_shard_deleted_keys.reset(
+        new std::vector<uint64_t>[_real_local_shard_num]);
+  }
 
   if (_config.enable_revert()) {
     // calculate merged shard number based on config param;
@@ -122,15 +237,28 @@ int32_t MemorySparseTable::InitializeValue() {
 
 int32_t MemorySparseTable::Load(const std::string &path,
                                 const std::string &param) {
+  WaitSnapshotWarmup();
+  ConcurrentIndexGate::Drain drain(&_index_gate);
   std::string table_path = TableDir(path);
   auto file_list = _afs_client.list(table_path);
+  int load_param = atoi(param.c_str());
+  // param 6 loads only the delta snapshots, the others only the parts
+  file_list.erase(
+      std::remove_if(file_list.begin(),
+                     file_list.end(),
+                     [load_param](const std::string &file) {
+                       std::string name = file.substr(file.rfind('/') + 1);
+                       bool is_delta =
+                           name.rfind(PSERVER_SNAPSHOT_DELTA_PREFIX, 0) == 0;
+                       return is_delta != (load_param == 6);
+                     }),
+      file_list.end());
 
   std::sort(file_list.begin(), file_list.end());
   for (auto file : file_list) {
     VLOG(1) << "MemorySparseTable::Load() file list: " << file;
   }
 
-  int load_param = atoi(param.c_str());
   size_t expect_shard_num = _sparse_table_shard_num;
   if (file_list.size() != expect_shard_num) {
     LOG(WARNING) << "MemorySparseTable file_size:" << file_list.size()
@@ -152,6 +280,23 @@ int32_t MemorySparseTable::Load(const std::string &path,
     return 0;
   }
 
+  if (load_param == 6) {
+    return LoadDelta(file_list, file_start_idx);
+  }
+  if (TrackDelta()) {
+    for (int i = 0; i < _real_local_shard_num; ++i) {
+      _local_shard_deleted_keys[i].clear();
+    }
+  }
+
+  if (paddle::string::ends_with(file_list[file_start_idx],
+                                PSERVER_SNAPSHOT_SUFFIX)) {
+    return LoadSnapshot(file_list, file_start_idx, load_param);
+  }
+  if (FLAGS_pserver_sparse_table_pipeline_load) {
+    return LoadPipelined(file_list, file_start_idx, load_param);
+  }
+
   size_t feature_value_size =
       _value_accessor->GetAccessorInfo().size / sizeof(float);
   size_t mf_value_size =
@@ -183,6 +328,9 @@ int32_t MemorySparseTable::Load(const std::string &path,
     do {
       is_read_failed = false;
       err_no = 0;
+      // a retry reads the whole file again, count it once
+      mem_count = 0;
+      mem_mf_count = 0;
       std::string line_data;
       auto read_channel = _afs_client.open_r(channel_config, 0, &err_no);
       char *end = nullptr;
@@ -197,6 +345,7 @@ int32_t MemorySparseTable::Load(const std::string &path,
               _value_accessor->ParseFromString(++end, value.data());
           mem_count++;
           value.resize(parse_size);
+          value.set_dirty(false);
           if (parse_size >
               static_cast<int>(feature_value_size - mf_value_size)) {
             mem_mf_count++;
@@ -227,6 +376,96 @@ int32_t MemorySparseTable::Load(const std::string &path,
   LOG(INFO) << "MemorySparseTable load success, path from "
             << file_list[file_start_idx] << " to "
             << file_list[file_start_idx + _real_local_shard_num - 1];
+  RebuildShardIndex();
+  return 0;
+}
+
+int32_t MemorySparseTable::LoadPipelined(
+    const std::vector<std::string> &file_list,
+    size_t file_start_idx,
+    int load_param) {
+  size_t feature_value_size =
+      _value_accessor->GetAccessorInfo().size / sizeof(float);
+  size_t mf_value_size =
+      _value_accessor->GetAccessorInfo().mf_size / sizeof(float);
+  int thread_num = _real_local_shard_num < 15 ? _real_local_shard_num : 15;
+
+  SparseTableLoader::Options options;
+  options.reader_num = thread_num;
+  options.parser_num = FLAGS_pserver_sparse_table_load_parse_threads;
+  options.inserter_num = thread_num;
+  options.memory_cap =
+      static_cast<size_t>(FLAGS_pserver_sparse_table_load_memory_mb) << 20;
+  options.read_retry_num = FLAGS_pserver_table_save_max_retry;
+  options.parse_retry_num = FLAGS_pserver_table_save_max_retry;
+  SparseTableLoader loader(options, feature_value_size);
+
+  auto read = [&](size_t i, const std::function<void(std::string *)> &emit) {
+    FsChannelConfig channel_config = {};
+    channel_config.path = file_list[file_start_idx + i];
+    VLOG(1) << "MemorySparseTable::load begin load " << channel_config.path
+            << " into local shard " << i;
+    channel_config.converter = _value_accessor->Converter(load_param).converter;
+    channel_config.deconverter =
+        _value_accessor->Converter(load_param).deconverter;
+    // the loader retries a failed read
+    int err_no = 0;
+    std::string line_data;
+    try {
+      auto read_channel = _afs_client.open_r(channel_config, 0, &err_no);
+      while (read_channel->read_line(line_data) == 0 &&
+             line_data.size() > 1) {
+        emit(&line_data);
+      }
+      read_channel->close();
+      if (err_no != -1) {
+        return 0;
+      }
+      LOG(ERROR) << "MemorySparseTable load failed after read! path:"
+                 << channel_config.path;
+    } catch (...) {
+      LOG(ERROR) << "MemorySparseTable load failed! path:"
+                 << channel_config.path;
+    }
+    return -1;
+  };
+  auto parse = [&](const char *str, float *value) {
+    return _value_accessor->ParseFromString(str, value);
+  };
+  // every shard is inserted by one thread only. A retried file inserts its
+  // keys again, so only the keys new to the shard are counted.
+  std::vector<uint64_t> mem_count(_real_local_shard_num, 0);
+  std::vector<uint64_t> mem_mf_count(_real_local_shard_num, 0);
+  auto insert = [&](size_t i, uint64_t key, const float *data, size_t size) {
+    auto &value = _local_shards[i][key];
+    if (value.size() == 0) {
+      ++mem_count[i];
+      if (size > feature_value_size - mf_value_size) {
+        ++mem_mf_count[i];
+      }
+    }
+    value.resize(size);
+    memcpy(value.data(), data, size * sizeof(float));
+    value.set_dirty(false);
+  };
+  if (loader.Load(_real_local_shard_num, read, parse, insert) != 0) {
+    LOG(ERROR) << "MemorySparseTable load failed reach max limit!";
+    exit(-1);
+  }
+  uint64_t mem_count_all = 0;
+  uint64_t mem_mf_count_all = 0;
+  for (int i = 0; i < _real_local_shard_num; ++i) {
+    mem_count_all += mem_count[i];
+    mem_mf_count_all += mem_mf_count[i];
+  }
+  VLOG(0) << "Table>> load done. ALL[" << mem_count_all << "] MEM["
+          << mem_count_all << "] MEM_MF[" << mem_mf_count_all << "]";
+  LOG(INFO) << "MemorySparseTable pipelined load stats, "
+            << loader.GetStats().ToString();
+  LOG(INFO) << "MemorySparseTable load success, path from "
+            << file_list[file_start_idx] << " to "
+            << file_list[file_start_idx + _real_local_shard_num - 1];
+  RebuildShardIndex();
   return 0;
 }
 
@@ -327,10 +566,12 @@ int32_t MemorySparseTable::LoadPatch(const std::vector<std::string> &file_list,
   }
   LOG(INFO) << "MemorySparseTable load success, path from "
             << file_list[start_idx] << " to " << file_list[end_idx - 1];
+  RebuildShardIndex();
   return 0;
 }
 
 void MemorySparseTable::Revert() {
+  ConcurrentIndexGate::Drain drain(&_index_gate);
   for (int i = 0; i < _real_local_shard_num; ++i) {
     _local_shards_new[i].clear();
   }
@@ -356,6 +597,8 @@ int32_t MemorySparseTable::Save(const std::string &dirname,
     return 0;
   }
 
+  WaitSnapshotWarmup();
+  ConcurrentIndexGate::Drain drain(&_index_gate);
   VLOG(0) << "MemorySparseTable::save dirname: " << dirname;
   int save_param =
       atoi(param.c_str());  // checkpoint:0  xbox delta:1  xbox base:2
@@ -374,8 +617,22 @@ int32_t MemorySparseTable::Save(const std::string &dirname,
   TopkCalculator tk(_real_local_shard_num, tk_size);
 
   std::string table_path = TableDir(dirname);
+  if (save_param == 6) {
+    return SaveDelta(table_path);
+  }
+  // a checkpoint also ends the delta chain saved next to it
   _afs_client.remove(::paddle::string::format_string(
       "%s/part-%03d-*", table_path.c_str(), _shard_idx));
+  _afs_client.remove(::paddle::string::format_string(
+      "%s/" PSERVER_SNAPSHOT_DELTA_PREFIX "%03d-*",
+      table_path.c_str(),
+      _shard_idx));
+  // snapshots hold the raw values, so a converted save stays text
+  if (FLAGS_pserver_sparse_table_save_snapshot &&
+      (save_param == 0 || save_param == 3) &&
+      _value_accessor->Converter(save_param).converter.empty()) {
+    return SaveSnapshot(table_path, save_param);
+  }
   std::atomic<uint32_t> feasign_size_all{0};
 
   size_t file_start_idx = _avg_local_shard_num * _shard_idx;
@@ -431,7 +688,7 @@ int32_t MemorySparseTable::Save(const std::string &dirname,
           tk.push(i, _value_accessor->GetField(it.value().data(), "show"));
         }
 
-        if (_value_accessor->Save(it.value().data(), save_param)) {
+        if (SaveValue(&it.value(), save_param)) {
           std::string format_value = _value_accessor->ParseToString(
               it.value().data(), it.value().size());
           if (0 != write_channel->write_line(::paddle::string::format_string(
@@ -463,15 +720,7 @@ int32_t MemorySparseTable::Save(const std::string &dirname,
       }
     } while (is_write_failed);
     feasign_size_all += feasign_size;
-    if (!_use_gpu_graph) {
-      for (auto it = shard.begin(); it != shard.end(); ++it) {
-        _value_accessor->UpdateStatAfterSave(it.value().data(), save_param);
-      }
-    } else if (save_param != 3) {
-      for (auto it = shard.begin(); it != shard.end(); ++it) {
-        _value_accessor->UpdateStatAfterSave(it.value().data(), save_param);
-      }
-    }
+    UpdateShardAfterSave(i, save_param, !_use_gpu_graph || save_param != 3);
     LOG(INFO) << "MemorySparseTable save prefix success, path: "
               << channel_config.path << " feasign_size: " << feasign_size;
   }
@@ -488,6 +737,7 @@ int32_t MemorySparseTable::Save_v2(const std::string &dirname,
     return 0;
   }
 
+  ConcurrentIndexGate::Drain drain(&_index_gate);
   VLOG(0) << "MemorySparseTable::save dirname: " << dirname;
   int save_param =
       atoi(param.c_str());  // checkpoint:0  xbox delta:1  xbox base:2
@@ -781,6 +1031,7 @@ int64_t MemorySparseTable::CacheShuffle(
         &shuffled_channel,
     const std::vector<Table *> &table_ptrs) {
   LOG(INFO) << "cache shuffle with cache threshold: " << cache_threshold;
+  ConcurrentIndexGate::Drain drain(&_index_gate);
   int save_param = atoi(param.c_str());  // batch_model:0  xbox:1
   if (!_config.enable_sparse_table_cache() || cache_threshold < 0) {
     LOG(WARNING)
@@ -892,6 +1143,7 @@ int32_t MemorySparseTable::SaveCache(
   if (_shard_idx >= _config.sparse_table_cache_file_num()) {
     return 0;
   }
+  ConcurrentIndexGate::Drain drain(&_index_gate);
   int save_param = atoi(param.c_str());  // batch_model:0  xbox:1
   std::string table_path = ::paddle::string::format_string(
       "%s/%03d_cache/", path.c_str(), _config.table_id());
@@ -1013,6 +1265,9 @@ int32_t MemorySparseTable::Push(TableContext &context) {
 int32_t MemorySparseTable::PullSparse(float *pull_values,
                                       const PullSparseValue &pull_value) {
   CostTimer timer("pserver_sparse_select_all");
+  if (UseConcurrentIndex()) {
+    return PullSparseConcurrent(pull_values, pull_value);
+  }
   std::vector<std::future<int>> tasks(_real_local_shard_num);
 
   const size_t value_size =
@@ -1049,6 +1304,10 @@ int32_t MemorySparseTable::PullSparse(float *pull_values,
               for (auto &item : keys) {
                 uint64_t key = item.first;
                 auto itr = local_shard.find(key);
+                if (itr == local_shard.end() &&
+                    WarmFromSnapshot(shard_id, key) != nullptr) {
+                  itr = local_shard.find(key);
+                }
                 size_t data_size = value_size - mf_value_size;
                 if (itr == local_shard.end()) {
                   // ++missed_keys;
@@ -1093,6 +1352,9 @@ int32_t MemorySparseTable::PullSparsePtr(int shard_id,  // fake num
                                          size_t num,
                                          uint16_t pass_id) {
   CostTimer timer("pscore_sparse_select_all");
+  if (UseConcurrentIndex()) {
+    return PullSparsePtrConcurrent(pull_values, keys, num);
+  }
   size_t value_size = _value_accessor->GetAccessorInfo().size / sizeof(float);
   size_t mf_value_size =
       _value_accessor->GetAccessorInfo().mf_size / sizeof(float);
@@ -1121,6 +1383,10 @@ int32_t MemorySparseTable::PullSparsePtr(int shard_id,  // fake num
               for (auto &item : keys) {
                 uint64_t key = item.first;
                 auto itr = local_shard.find(key);
+                if (itr == local_shard.end() &&
+                    WarmFromSnapshot(shard_id, key) != nullptr) {
+                  itr = local_shard.find(key);
+                }
                 size_t data_size = value_size - mf_value_size;
                 FixedFeatureValue *ret = NULL;
                 if (itr == local_shard.end()) {
@@ -1150,6 +1416,16 @@ int32_t MemorySparseTable::PushSparse(const uint64_t *keys,
                                       const float *values,
                                       size_t num) {
   CostTimer timer("pserver_sparse_update_all");
+  if (UseConcurrentIndex()) {
+    const size_t update_value_col =
+        _value_accessor->GetAccessorInfo().update_size / sizeof(float);
+    std::vector<const float *> update_values(num);
+    for (size_t i = 0; i < num; ++i) {
+      update_values[i] = values + i * update_value_col;
+    }
+    return PushSparseConcurrent(
+        keys, update_values.data(), num, _config.enable_revert());
+  }
   std::vector<std::future<int>> tasks(_real_local_shard_num);
   std::vector<std::vector<std::pair<uint64_t, int>>> task_keys(
       _real_local_shard_num);
@@ -1179,12 +1455,19 @@ int32_t MemorySparseTable::PushSparse(const uint64_t *keys,
           auto &local_shard_new = _local_shards_new[shard_id];
           float data_buffer[value_col];  // NOLINT
           float *data_buffer_ptr = data_buffer;
+          SparsePushBatch batch(
+              _value_accessor.get(),
+              _config.enable_revert() ? &local_shard_new : nullptr);
           for (auto &item : keys) {
             uint64_t key = item.first;
             uint64_t push_data_idx = item.second;
             const float *update_data =
                 values + push_data_idx * update_value_col;
             auto itr = local_shard.find(key);
+            if (itr == local_shard.end() &&
+                WarmFromSnapshot(shard_id, key) != nullptr) {
+              itr = local_shard.find(key);
+            }
             if (itr == local_shard.end()) {
               if (FLAGS_pserver_enable_create_feasign_randomly &&
                   !_value_accessor->CreateValue(1, update_data)) {
@@ -1203,21 +1486,23 @@ int32_t MemorySparseTable::PushSparse(const uint64_t *keys,
             auto &feature_value = itr.value();
             float *value_data = feature_value.data();
             size_t value_size = feature_value.size();
+            feature_value.set_dirty(true);
 
             if (value_size == value_col) {  // 已拓展到最大size, 则就地update
-              _value_accessor->Update(&value_data, &update_data, 1);
-            } else {
-              // 拷入buffer区进行update，然后再回填，不需要的mf则回填时抛弃了
-              memcpy(data_buffer_ptr, value_data, value_size * sizeof(float));
-              _value_accessor->Update(&data_buffer_ptr, &update_data, 1);
-
-              if (_value_accessor->NeedExtendMF(data_buffer)) {
-                feature_value.resize(value_col);
-                value_data = feature_value.data();
-                _value_accessor->Create(&value_data, 1);
-              }
-              memcpy(value_data, data_buffer_ptr, value_size * sizeof(float));
+              batch.Add(key, &feature_value, update_data);
+              continue;
+            }
+            // pending values are full size, so none of them is this one
+            // 拷入buffer区进行update，然后再回填，不需要的mf则回填时抛弃了
+            memcpy(data_buffer_ptr, value_data, value_size * sizeof(float));
+            _value_accessor->Update(&data_buffer_ptr, &update_data, 1);
+
+            if (_value_accessor->NeedExtendMF(data_buffer)) {
+              feature_value.resize(value_col);
+              value_data = feature_value.data();
+              _value_accessor->Create(&value_data, 1);
             }
+            memcpy(value_data, data_buffer_ptr, value_size * sizeof(float));
             if (_config.enable_revert()) {
               FixedFeatureValue *feature_value_new = &(local_shard_new[key]);
               auto new_size = feature_value.size();
@@ -1227,6 +1512,7 @@ int32_t MemorySparseTable::PushSparse(const uint64_t *keys,
                      new_size * sizeof(float));
             }
           }
+          batch.Flush();
           return 0;
         });
   }
@@ -1240,6 +1526,9 @@ int32_t MemorySparseTable::PushSparse(const uint64_t *keys,
 int32_t MemorySparseTable::PushSparse(const uint64_t *keys,
                                       const float **values,
                                       size_t num) {
+  if (UseConcurrentIndex()) {
+    return PushSparseConcurrent(keys, values, num, false);
+  }
   std::vector<std::future<int>> tasks(_real_local_shard_num);
   std::vector<std::vector<std::pair<uint64_t, int>>> task_keys(
       _real_local_shard_num);
@@ -1259,11 +1548,16 @@ int32_t MemorySparseTable::PushSparse(const uint64_t *keys,
           auto &local_shard = _local_shards[shard_id];
           float data_buffer[value_col];  // NOLINT
           float *data_buffer_ptr = data_buffer;
+          SparsePushBatch batch(_value_accessor.get(), nullptr);
           for (auto &item : keys) {
             uint64_t key = item.first;
             uint64_t push_data_idx = item.second;
             const float *update_data = values[push_data_idx];
             auto itr = local_shard.find(key);
+            if (itr == local_shard.end() &&
+                WarmFromSnapshot(shard_id, key) != nullptr) {
+              itr = local_shard.find(key);
+            }
             if (itr == local_shard.end()) {
               if (FLAGS_pserver_enable_create_feasign_randomly &&
                   !_value_accessor->CreateValue(1, update_data)) {
@@ -1281,20 +1575,23 @@ int32_t MemorySparseTable::PushSparse(const uint64_t *keys,
             auto &feature_value = itr.value();
             float *value_data = feature_value.data();
             size_t value_size = feature_value.size();
+            feature_value.set_dirty(true);
             if (value_size == value_col) {  // 已拓展到最大size, 则就地update
-              _value_accessor->Update(&value_data, &update_data, 1);
-            } else {
-              // 拷入buffer区进行update，然后再回填，不需要的mf则回填时抛弃了
-              memcpy(data_buffer_ptr, value_data, value_size * sizeof(float));
-              _value_accessor->Update(&data_buffer_ptr, &update_data, 1);
-              if (_value_accessor->NeedExtendMF(data_buffer)) {
-                feature_value.resize(value_col);
-                value_data = feature_value.data();
-                _value_accessor->Create(&value_data, 1);
-              }
-              memcpy(value_data, data_buffer_ptr, value_size * sizeof(float));
+              batch.Add(key, &feature_value, update_data);
+              continue;
             }
+            // pending values are full size, so none of them is this one
+            // 拷入buffer区进行update，然后再回填，不需要的mf则回填时抛弃了
+            memcpy(data_buffer_ptr, value_data, value_size * sizeof(float));
+            _value_accessor->Update(&data_buffer_ptr, &update_data, 1);
+            if (_value_accessor->NeedExtendMF(data_buffer)) {
+              feature_value.resize(value_col);
+              value_data = feature_value.data();
+              _value_accessor->Create(&value_data, 1);
+            }
+            memcpy(value_data, data_buffer_ptr, value_size * sizeof(float));
           }
+          batch.Flush();
           return 0;
         });
   }
@@ -1305,11 +1602,555 @@ int32_t MemorySparseTable::PushSparse(const uint64_t *keys,
   return 0;
 }
 
-int32_t MemorySparseTable::Flush() { return 0; }
+int32_t MemorySparseTable::SaveSnapshot(const std::string &table_path,
+                                        int save_param) {
+  size_t file_start_idx = _avg_local_shard_num * _shard_idx;
+  uint32_t value_stride =
+      _value_accessor->GetAccessorInfo().size / sizeof(float);
+  std::atomic<uint32_t> feasign_size_all{0};
+  int thread_num = _real_local_shard_num < 20 ? _real_local_shard_num : 20;
+  omp_set_num_threads(thread_num);
+#pragma omp parallel for schedule(dynamic)
+  for (int i = 0; i < _real_local_shard_num; ++i) {
+    std::string path = ::paddle::string::format_string(
+        "%s/part-%03d-%05d" PSERVER_SNAPSHOT_SUFFIX,
+        table_path.c_str(),
+        _shard_idx,
+        file_start_idx + i);
+    auto &shard = _local_shards[i];
+    SparseSnapshotWriter writer(value_stride);
+    for (auto it = shard.begin(); it != shard.end(); ++it) {
+      if (SaveValue(&it.value(), save_param)) {
+        writer.Add(it.key(), it.value().data(), it.value().size());
+      }
+    }
+    int retry_num = 0;
+    while (writer.Write(path) != 0) {
+      _afs_client.remove(path);
+      ++retry_num;
+      LOG(ERROR) << "MemorySparseTable save snapshot failed, retry it! path:"
+                 << path << " , retry_num=" << retry_num;
+      if (retry_num > FLAGS_pserver_table_save_max_retry) {
+        LOG(ERROR) << "MemorySparseTable save snapshot failed reach max limit!";
+        exit(-1);
+      }
+    }
+    feasign_size_all += writer.size();
+    UpdateShardAfterSave(i, save_param, !_use_gpu_graph || save_param != 3);
+    LOG(INFO) << "MemorySparseTable save snapshot success, path: " << path
+              << " feasign_size: " << writer.size();
+  }
+  LOG(INFO) << "MemorySparseTable save snapshot success, feasign_size: "
+            << feasign_size_all;
+  return 0;
+}
+
+int32_t MemorySparseTable::LoadSnapshot(
+    const std::vector<std::string> &file_list,
+    size_t file_start_idx,
+    int load_param) {
+  // snapshots are only saved for these params and hold the raw values
+  PADDLE_ENFORCE_EQ(
+      load_param == 0 || load_param == 3,
+      true,
+      common::errors::InvalidArgument(
+          "Binary snapshots are loaded with param 0 or 3, but received %d.",
+          load_param));
+  PADDLE_ENFORCE_EQ(
+      _value_accessor->Converter(load_param).converter.empty(),
+      true,
+      common::errors::Unimplemented(
+          "Binary snapshots cannot be loaded through the converter of "
+          "param %d, save the table as text instead.",
+          load_param));
+  uint32_t value_stride =
+      _value_accessor->GetAccessorInfo().size / sizeof(float);
+  std::vector<std::unique_ptr<SparseSnapshotReader>> snapshots(
+      _real_local_shard_num);
+  std::atomic<int> failed_num{0};
+  int thread_num = _real_local_shard_num < 15 ? _real_local_shard_num : 15;
+  omp_set_num_threads(thread_num);
+#pragma omp parallel for schedule(dynamic)
+  for (int i = 0; i < _real_local_shard_num; ++i) {
+    const std::string &path = file_list[file_start_idx + i];
+    snapshots[i].reset(new SparseSnapshotReader());
+    int32_t ret = -1;
+    try {
+      ret = snapshots[i]->Open(path);
+    } catch (const std::exception &e) {
+      LOG(ERROR) << e.what();
+    }
+    if (ret != 0 || snapshots[i]->value_stride() != value_stride) {
+      LOG(ERROR) << "MemorySparseTable load snapshot failed, path:" << path
+                 << " expect value_stride:" << value_stride;
+      ++failed_num;
+    } else if (snapshots[i]->is_delta()) {
+      LOG(ERROR) << "MemorySparseTable load snapshot failed, path:" << path
+                 << " is a delta, load it with param 6";
+      ++failed_num;
+    }
+  }
+  if (failed_num > 0) {
+    return -1;
+  }
+  // Warm-up skips the keys already in memory, which pulls and pushes may
+  // have warmed meanwhile. Keys present before the load are overwritten
+  // here instead, as a text load overwrites them.
+#pragma omp parallel for schedule(dynamic)
+  for (int i = 0; i < _real_local_shard_num; ++i) {
+    auto &shard = _local_shards[i];
+    for (auto it = shard.begin(); it != shard.end(); ++it) {
+      uint32_t dim = 0;
+      const float *data = snapshots[i]->Find(it.key(), &dim);
+      if (data == nullptr) {
+        continue;
+      }
+      auto &feature_value = it.value();
+      feature_value.resize(dim);
+      memcpy(feature_value.data(), data, dim * sizeof(float));
+      feature_value.set_dirty(false);
+    }
+  }
+  _snapshots.swap(snapshots);
+  // pulls warm single keys on demand, the rest is copied in the background
+  _snapshot_warm_thread =
+      std::thread(std::bind(&MemorySparseTable::WarmSnapshots, this));
+  if (UseConcurrentIndex()) {
+    // the concurrent index is built from fully materialized shards
+    WaitSnapshotWarmup();
+    RebuildShardIndex();
+  }
+  LOG(INFO) << "MemorySparseTable load snapshot success, path from "
+            << file_list[file_start_idx] << " to "
+            << file_list[file_start_idx + _real_local_shard_num - 1];
+  return 0;
+}
+
+FixedFeatureValue *MemorySparseTable::WarmFromSnapshot(int shard_id,
+                                                       uint64_t key) {
+  if (_snapshots.empty() || _snapshots[shard_id] == nullptr) {
+    return nullptr;
+  }
+  uint32_t dim = 0;
+  const float *data = _snapshots[shard_id]->Find(key, &dim);
+  if (data == nullptr) {
+    return nullptr;
+  }
+  auto &feature_value = _local_shards[shard_id][key];
+  feature_value.resize(dim);
+  memcpy(feature_value.data(), data, dim * sizeof(float));
+  feature_value.set_dirty(false);
+  return &feature_value;
+}
+
+void MemorySparseTable::WarmSnapshots() {
+  // copy in blocks on the shard task threads, so that warm-up interleaves
+  // with pulls and pushes of the same shard instead of racing with them
+  const size_t block_size = 8192;
+  std::vector<size_t> offsets(_real_local_shard_num, 0);
+  std::vector<size_t> sizes(_real_local_shard_num, 0);
+  for (int shard_id = 0; shard_id < _real_local_shard_num; ++shard_id) {
+    sizes[shard_id] = _snapshots[shard_id]->size();
+  }
+  uint64_t warm_count = 0;
+  bool done = false;
+  while (!done) {
+    done = true;
+    std::vector<std::future<int>> tasks;
+    for (int shard_id = 0; shard_id < _real_local_shard_num; ++shard_id) {
+      if (offsets[shard_id] == sizes[shard_id] + 1) {
+        continue;
+      }
+      size_t begin = offsets[shard_id];
+      size_t end = std::min(begin + block_size, sizes[shard_id]);
+      bool last = end == sizes[shard_id];
+      offsets[shard_id] = last ? end + 1 : end;
+      done = done && last;
+      tasks.push_back(
+          _shards_task_pool[shard_id % _shards_task_pool.size()]->enqueue(
+              [this, shard_id, begin, end, last]() -> int {
+                auto &snapshot = *_snapshots[shard_id];
+                auto &shard = _local_shards[shard_id];
+                int count = 0;
+                for (size_t k = begin; k < end; ++k) {
+                  uint64_t key = snapshot.key(k);
+                  if (shard.find(key) != shard.end()) {
+                    continue;
+                  }
+                  auto &feature_value = shard[key];
+                  feature_value.resize(snapshot.dim(k));
+                  memcpy(feature_value.data(),
+                         snapshot.value(k),
+                         snapshot.dim(k) * sizeof(float));
+                  feature_value.set_dirty(false);
+                  ++count;
+                }
+                if (last) {
+                  _snapshots[shard_id].reset();
+                }
+                return count;
+              }));
+    }
+    for (auto &task : tasks) {
+      warm_count += task.get();
+    }
+  }
+  LOG(INFO) << "MemorySparseTable snapshot warm-up done, feasign_size: "
+            << warm_count;
+}
+
+void MemorySparseTable::WaitSnapshotWarmup() {
+  if (_snapshot_warm_thread.joinable()) {
+    _snapshot_warm_thread.join();
+  }
+  _snapshots.clear();
+}
+
+int32_t MemorySparseTable::SaveDelta(const std::string &table_path) {
+  if (!TrackDelta()) {
+    LOG(ERROR) << "MemorySparseTable save delta needs "
+                  "FLAGS_pserver_sparse_table_delta_save, path:"
+               << table_path;
+    return -1;
+  }
+  // the base parts of the chain are kept
+  _afs_client.remove(::paddle::string::format_string(
+      "%s/" PSERVER_SNAPSHOT_DELTA_PREFIX "%03d-*",
+      table_path.c_str(),
+      _shard_idx));
+  size_t file_start_idx = _avg_local_shard_num * _shard_idx;
+  uint32_t value_stride =
+      _value_accessor->GetAccessorInfo().size / sizeof(float);
+  std::atomic<uint64_t> feasign_size_all{0};
+  std::atomic<uint64_t> deleted_size_all{0};
+  int thread_num = _real_local_shard_num < 20 ? _real_local_shard_num : 20;
+  omp_set_num_threads(thread_num);
+#pragma omp parallel for schedule(dynamic)
+  for (int i = 0; i < _real_local_shard_num; ++i) {
+    std::string path = ::paddle::string::format_string(
+        "%s/" PSERVER_SNAPSHOT_DELTA_PREFIX "%03d-%05d" PSERVER_SNAPSHOT_SUFFIX,
+        table_path.c_str(),
+        _shard_idx,
+        file_start_idx + i);
+    auto &shard = _local_shards[i];
+    auto &deleted_keys = _local_shard_deleted_keys[i];
+    SparseSnapshotWriter writer(value_stride);
+    writer.set_delta(true);
+    for (auto it = shard.begin(); it != shard.end(); ++it) {
+      if (it.value().dirty()) {
+        writer.Add(it.key(), it.value().data(), it.value().size());
+      }
+    }
+    for (uint64_t key : deleted_keys) {
+      writer.AddDeleted(key);
+    }
+    int retry_num = 0;
+    while (writer.Write(path) != 0) {
+      _afs_client.remove(path);
+      ++retry_num;
+      LOG(ERROR) << "MemorySparseTable save delta failed, retry it! path:"
+                 << path << " , retry_num=" << retry_num;
+      if (retry_num > FLAGS_pserver_table_save_max_retry) {
+        LOG(ERROR) << "MemorySparseTable save delta failed reach max limit!";
+        exit(-1);
+      }
+    }
+    feasign_size_all += writer.size();
+    deleted_size_all += writer.deleted_size();
+    for (auto it = shard.begin(); it != shard.end(); ++it) {
+      it.value().set_dirty(false);
+    }
+    deleted_keys.clear();
+    VLOG(1) << "MemorySparseTable save delta success, path: " << path
+            << " feasign_size: " << writer.size()
+            << " deleted_size: " << writer.deleted_size();
+  }
+  LOG(INFO) << "MemorySparseTable save delta success, path: " << table_path
+            << " feasign_size: " << feasign_size_all
+            << " deleted_size: " << deleted_size_all;
+  return 0;
+}
+
+int32_t MemorySparseTable::LoadDelta(const std::vector<std::string> &file_list,
+                                     size_t file_start_idx) {
+  uint32_t value_stride =
+      _value_accessor->GetAccessorInfo().size / sizeof(float);
+  std::atomic<int> failed_num{0};
+  int thread_num = _real_local_shard_num < 15 ? _real_local_shard_num : 15;
+  omp_set_num_threads(thread_num);
+#pragma omp parallel for schedule(dynamic)
+  for (int i = 0; i < _real_local_shard_num; ++i) {
+    const std::string &path = file_list[file_start_idx + i];
+    SparseSnapshotReader delta;
+    int32_t ret = -1;
+    try {
+      ret = delta.Open(path);
+    } catch (const std::exception &e) {
+      LOG(ERROR) << e.what();
+    }
+    if (ret != 0 || delta.value_stride() != value_stride ||
+        !delta.is_delta()) {
+      LOG(ERROR) << "MemorySparseTable load delta failed, path:" << path
+                 << " expect a delta snapshot with value_stride:"
+                 << value_stride;
+      ++failed_num;
+      continue;
+    }
+    auto &shard = _local_shards[i];
+    // erase first, a key listed as well was created again after the erase
+    for (size_t k = 0; k < delta.deleted_size(); ++k) {
+      shard.erase(delta.deleted_key(k));
+    }
+    for (size_t k = 0; k < delta.size(); ++k) {
+      auto &feature_value = shard[delta.key(k)];
+      feature_value.resize(delta.dim(k));
+      memcpy(feature_value.data(),
+             delta.value(k),
+             delta.dim(k) * sizeof(float));
+      feature_value.set_dirty(false);
+    }
+    if (TrackDelta()) {
+      _local_shard_deleted_keys[i].clear();
+    }
+    VLOG(1) << "MemorySparseTable load delta " << path << " into local shard "
+            << i << ", feasign_size: " << delta.size()
+            << " deleted_size: " << delta.deleted_size();
+  }
+  RebuildShardIndex();
+  if (failed_num > 0) {
+    return -1;
+  }
+  LOG(INFO) << "MemorySparseTable load delta success, path from "
+            << file_list[file_start_idx] << " to "
+            << file_list[file_start_idx + _real_local_shard_num - 1];
+  return 0;
+}
+
+bool MemorySparseTable::SaveValue(FixedFeatureValue *value, int save_param) {
+  if (!TrackDelta()) {
+    return _value_accessor->Save(value->data(), save_param);
+  }
+  // Save() may reset stats of the value, e.g. the delta score of xbox base
+  bool saved = false;
+  TrackValueChange(value, [&](float *data) {
+    saved = _value_accessor->Save(data, save_param);
+  });
+  if (save_param == 0 || save_param == 3) {
+    // a checkpoint is the new base of the delta chain
+    value->set_dirty(!saved);
+  }
+  return saved;
+}
+
+void MemorySparseTable::UpdateShardAfterSave(int shard_id,
+                                             int save_param,
+                                             bool update_stat) {
+  auto &shard = _local_shards[shard_id];
+  if (update_stat) {
+    for (auto it = shard.begin(); it != shard.end(); ++it) {
+      if (TrackDelta()) {
+        TrackValueChange(&it.value(), [&](float *data) {
+          _value_accessor->UpdateStatAfterSave(data, save_param);
+        });
+      } else {
+        _value_accessor->UpdateStatAfterSave(it.value().data(), save_param);
+      }
+    }
+  }
+  if (TrackDelta() && (save_param == 0 || save_param == 3)) {
+    _local_shard_deleted_keys[shard_id].clear();
+  }
+}
+
+void MemorySparseTable::RebuildShardIndex() {
+  if (!UseConcurrentIndex()) {
+    return;
+  }
+  omp_set_num_threads(_real_local_shard_num < 15 ? _real_local_shard_num : 15);
+#pragma omp parallel for schedule(dynamic)
+  for (int shard_id = 0; shard_id < _real_local_shard_num; ++shard_id) {
+    auto &shard = _local_shards[shard_id];
+    auto &index = _local_shard_indexes[shard_id];
+    index.clear();
+    index.reserve(shard.size());
+    for (auto it = shard.begin(); it != shard.end(); ++it) {
+      index.insert(it.key(), it.value_ptr());
+    }
+  }
+}
+
+void MemorySparseTable::RunOnKeyBlocks(
+    size_t num, std::function<void(size_t, size_t)> func) {
+  const size_t min_block_size = 256;
+  size_t pool_size = _shards_task_pool.size();
+  size_t block_size =
+      std::max(min_block_size, (num + pool_size - 1) / pool_size);
+  std::vector<std::future<int>> tasks;
+  for (size_t begin = 0; begin < num; begin += block_size) {
+    size_t end = std::min(num, begin + block_size);
+    tasks.push_back(
+        _shards_task_pool[tasks.size() % pool_size]->enqueue([&func,
+                                                               begin,
+                                                               end]() -> int {
+          func(begin, end);
+          return 0;
+        }));
+  }
+  for (auto &task : tasks) {
+    task.wait();
+  }
+}
+
+FixedFeatureValue *MemorySparseTable::FindOrCreateValue(
+    uint64_t key, const float *update_data, float *data_buffer) {
+  int shard_id = (key % _sparse_table_shard_num) % _avg_local_shard_num;
+  auto &index = _local_shard_indexes[shard_id];
+  FixedFeatureValue *value = index.find(key);
+  if (value != nullptr) {
+    return value;
+  }
+  if (update_data != nullptr && FLAGS_pserver_enable_create_feasign_randomly &&
+      !_value_accessor->CreateValue(1, update_data)) {
+    return nullptr;
+  }
+  size_t value_size = (_value_accessor->GetAccessorInfo().size -
+                       _value_accessor->GetAccessorInfo().mf_size) /
+                      sizeof(float);
+  _value_accessor->Create(&data_buffer, 1);
+  std::lock_guard<std::mutex> guard(_local_shard_mutexes[shard_id]);
+  value = index.find(key);
+  if (value != nullptr) {
+    return value;
+  }
+  auto &feature_value = _local_shards[shard_id][key];
+  feature_value.resize(value_size);
+  memcpy(feature_value.data(), data_buffer, value_size * sizeof(float));
+  // published to readers only after the value is initialized
+  return index.insert(key, &feature_value);
+}
+
+int32_t MemorySparseTable::PullSparseConcurrent(
+    float *pull_values, const PullSparseValue &pull_value) {
+  const size_t value_size =
+      _value_accessor->GetAccessorInfo().size / sizeof(float);
+  size_t select_value_size =
+      _value_accessor->GetAccessorInfo().select_size / sizeof(float);
+  ConcurrentIndexGate::Entry entry(&_index_gate);
+  RunOnKeyBlocks(pull_value.numel_, [&](size_t begin, size_t end) {
+    float data_buffer[value_size];  // NOLINT
+    float *data_buffer_ptr = data_buffer;
+    for (size_t i = begin; i < end; ++i) {
+      uint64_t key = pull_value.feasigns_[i];
+      int shard_id = (key % _sparse_table_shard_num) % _avg_local_shard_num;
+      auto &index = _local_shard_indexes[shard_id];
+      FixedFeatureValue *feature_value = index.find(key);
+      if (feature_value == nullptr && !FLAGS_pserver_create_value_when_push) {
+        feature_value = FindOrCreateValue(key, nullptr, data_buffer);
+      }
+      size_t data_size = 0;
+      if (feature_value != nullptr) {
+        std::lock_guard<memory::SpinLock> guard(index.value_lock(key));
+        data_size = feature_value->size();
+        memcpy(
+            data_buffer, feature_value->data(), data_size * sizeof(float));
+      }
+      for (size_t idx = data_size; idx < value_size; ++idx) {
+        data_buffer[idx] = 0.0;
+      }
+      float *select_data = pull_values + select_value_size * i;
+      _value_accessor->Select(
+          &select_data, (const float **)&data_buffer_ptr, 1);
+    }
+  });
+  return 0;
+}
+
+int32_t MemorySparseTable::PullSparsePtrConcurrent(char **pull_values,
+                                                   const uint64_t *keys,
+                                                   size_t num) {
+  size_t value_size = _value_accessor->GetAccessorInfo().size / sizeof(float);
+  ConcurrentIndexGate::Entry entry(&_index_gate);
+  RunOnKeyBlocks(num, [&](size_t begin, size_t end) {
+    float data_buffer[value_size];  // NOLINT
+    for (size_t i = begin; i < end; ++i) {
+      pull_values[i] = reinterpret_cast<char *>(
+          FindOrCreateValue(keys[i], nullptr, data_buffer));
+    }
+  });
+  return 0;
+}
+
+int32_t MemorySparseTable::PushSparseConcurrent(const uint64_t *keys,
+                                                const float **values,
+                                                size_t num,
+                                                bool record_revert) {
+  size_t value_col = _value_accessor->GetAccessorInfo().size / sizeof(float);
+  ConcurrentIndexGate::Entry entry(&_index_gate);
+  RunOnKeyBlocks(num, [&](size_t begin, size_t end) {
+    float data_buffer[value_col];  // NOLINT
+    float *data_buffer_ptr = data_buffer;
+    for (size_t i = begin; i < end; ++i) {
+      uint64_t key = keys[i];
+      const float *update_data = values[i];
+      FixedFeatureValue *feature_value =
+          FindOrCreateValue(key, update_data, data_buffer);
+      if (feature_value == nullptr) {
+        continue;
+      }
+      int shard_id = (key % _sparse_table_shard_num) % _avg_local_shard_num;
+      std::lock_guard<memory::SpinLock> guard(
+          _local_shard_indexes[shard_id].value_lock(key));
+      float *value_data = feature_value->data();
+      size_t value_size = feature_value->size();
+      if (value_size == value_col) {
+        _value_accessor->Update(&value_data, &update_data, 1);
+      } else {
+        memcpy(data_buffer_ptr, value_data, value_size * sizeof(float));
+        _value_accessor->Update(&data_buffer_ptr, &update_data, 1);
+        if (_value_accessor->NeedExtendMF(data_buffer)) {
+          // the value arena of the shard is shared with the inserts
+          std::lock_guard<std::mutex> shard_guard(
+              _local_shard_mutexes[shard_id]);
+          feature_value->resize(value_col);
+          value_data = feature_value->data();
+          _value_accessor->Create(&value_data, 1);
+        }
+        memcpy(value_data, data_buffer_ptr, value_size * sizeof(float));
+      }
+      feature_value->set_dirty(true);
+      if (record_revert) {
+        std::lock_guard<std::mutex> shard_guard(
+            _local_shard_mutexes[shard_id]);
+        FixedFeatureValue *feature_value_new =
+            &(_local_shards_new[shard_id][key]);
+        auto new_size = feature_value->size();
+        feature_value_new->resize(new_size);
+        memcpy(
+            feature_value_new->data(), value_data, new_size * sizeof(float));
+      }
+    }
+  });
+  return 0;
+}
+
+int32_t MemorySparseTable::Flush() {
+  // the index tables replaced by growth are freed once the in-flight pulls
+  // and pushes have left
+  if (UseConcurrentIndex()) {
+    ConcurrentIndexGate::Drain drain(&_index_gate);
+    for (int shard_id = 0; shard_id < _real_local_shard_num; ++shard_id) {
+      _local_shard_indexes[shard_id].reclaim();
+    }
+  }
+  return 0;
+}
 
 int32_t MemorySparseTable::Shrink(const std::string &param) {
   VLOG(0) << "MemorySparseTable::Shrink";
+  WaitSnapshotWarmup();
+  ConcurrentIndexGate::Drain drain(&_index_gate);
   std::atomic<uint32_t> shrink_size_all{0};
+  std::atomic<uint64_t> compact_size_all{0};
   int thread_num = _real_local_shard_num;
   omp_set_num_threads(thread_num);
 #pragma omp parallel for schedule(dynamic)
@@ -1318,7 +2159,19 @@ int32_t MemorySparseTable::Shrink(const std::string &param) {
     int feasign_size = 0;
     auto &shard = _local_shards[shard_id];
     for (auto it = shard.begin(); it != shard.end();) {
-      if (_value_accessor->Shrink(it.value().data())) {
+      bool erase = false;
+      if (TrackDelta()) {
+        // shrink also decays the kept values
+        TrackValueChange(&it.value(), [&](float *data) {
+          erase = _value_accessor->Shrink(data);
+        });
+        if (erase) {
+          _local_shard_deleted_keys[shard_id].push_back(it.key());
+        }
+      } else {
+        erase = _value_accessor->Shrink(it.value().data());
+      }
+      if (erase) {
         it = shard.erase(it);
         ++feasign_size;
       } else {
@@ -1326,9 +2179,12 @@ int32_t MemorySparseTable::Shrink(const std::string &param) {
       }
     }
     shrink_size_all += feasign_size;
+    compact_size_all += shard.compact_values(
+        FLAGS_pserver_sparse_value_arena_compact_ratio);
   }
   VLOG(0) << "MemorySparseTable::Shrink success, shrink size:"
-          << shrink_size_all;
+          << shrink_size_all << ", compacted bytes:" << compact_size_all;
+  RebuildShardIndex();
   return 0;
 }
 
@@ -18,6 +18,7 @@
 #include <assert.h>
 #include <pthread.h>
 
+#include <functional>
 #include <memory>
 #include <mutex>  // NOLINT
 #include <string>
@@ -28,7 +29,9 @@
 #include "Eigen/Dense"
 #include "paddle/fluid/distributed/ps/table/accessor.h"
 #include "paddle/fluid/distributed/ps/table/common_table.h"
+#include "paddle/fluid/distributed/ps/table/depends/concurrent_shard_index.h"
 #include "paddle/fluid/distributed/ps/table/depends/feature_value.h"
+#include "paddle/fluid/distributed/ps/table/sparse_snapshot.h"
 #include "paddle/utils/string/string_helper.h"
 
 #define PSERVER_SAVE_SUFFIX ".shard"
@@ -39,8 +42,9 @@ namespace distributed {
 class MemorySparseTable : public Table {
  public:
   typedef SparseTableShard<uint64_t, FixedFeatureValue> shard_type;
+  typedef ConcurrentShardIndex<FixedFeatureValue> shard_index_type;
   MemorySparseTable() {}
-  virtual ~MemorySparseTable() {}
+  virtual ~MemorySparseTable() { WaitSnapshotWarmup(); }
 
   // unused method end
   static int32_t sparse_local_shard_num(uint32_t shard_num,
@@ -119,12 +123,64 @@ class MemorySparseTable : public Table {
   virtual int32_t LoadPatch(const std::vector<std::string>& file_list,
                             int save_param);
 
+  // binary snapshots, see FLAGS_pserver_sparse_table_save_snapshot
+  int32_t SaveSnapshot(const std::string& table_path, int save_param);
+  int32_t LoadSnapshot(const std::vector<std::string>& file_list,
+                       size_t file_start_idx,
+                       int load_param);
+  FixedFeatureValue* WarmFromSnapshot(int shard_id, uint64_t key);
+  void WarmSnapshots();
+  void WaitSnapshotWarmup();
+
+  // see FLAGS_pserver_sparse_table_pipeline_load
+  int32_t LoadPipelined(const std::vector<std::string>& file_list,
+                        size_t file_start_idx,
+                        int load_param);
+
+  // delta checkpoints, see FLAGS_pserver_sparse_table_delta_save
+  bool TrackDelta() const { return _local_shard_deleted_keys != nullptr; }
+  int32_t SaveDelta(const std::string& table_path);
+  int32_t LoadDelta(const std::vector<std::string>& file_list,
+                    size_t file_start_idx);
+  bool SaveValue(FixedFeatureValue* value, int save_param);
+  void UpdateShardAfterSave(int shard_id, int save_param, bool update_stat);
+
+  // concurrent index mode, see FLAGS_pserver_sparse_concurrent_index
+  bool UseConcurrentIndex() const { return _local_shard_indexes != nullptr; }
+  void RebuildShardIndex();
+  void RunOnKeyBlocks(size_t num, std::function<void(size_t, size_t)> func);
+  FixedFeatureValue* FindOrCreateValue(uint64_t key,
+                                       const float* update_data,
+                                       float* data_buffer);
+  int32_t PullSparseConcurrent(float* values,
+                               const PullSparseValue& pull_value);
+  int32_t PullSparsePtrConcurrent(char** pull_values,
+                                  const uint64_t* keys,
+                                  size_t num);
+  int32_t PushSparseConcurrent(const uint64_t* keys,
+                               const float** values,
+                               size_t num,
+                               bool record_revert);
+
   int _task_pool_size = 24;
   int _avg_local_shard_num;
   int _real_local_shard_num;
   int _sparse_table_shard_num;
   std::vector<std::shared_ptr<::ThreadPool>> _shards_task_pool;
   std::unique_ptr<shard_type[]> _local_shards;
+  // lock-free lookup in front of each local shard, inserts into a shard are
+  // serialized by its mutex
+  std::unique_ptr<shard_index_type[]> _local_shard_indexes;
+  std::unique_ptr<std::mutex[]> _local_shard_mutexes;
+  // concurrent pulls and pushes enter it, whatever clears or rewrites the
+  // shards behind the indexes drains it first
+  ConcurrentIndexGate _index_gate;
+  // mapped snapshots of the local shards that are still being warmed into
+  // memory, only touched by the shard task threads while warming
+  std::vector<std::unique_ptr<SparseSnapshotReader>> _snapshots;
+  std::thread _snapshot_warm_thread;
+  // keys erased by Shrink since the last checkpoint, per local shard
+  std::unique_ptr<std::vector<uint64_t>[]> _local_shard_deleted_keys;
 
   // for patch model
   int _m_avg_local_shard_num;
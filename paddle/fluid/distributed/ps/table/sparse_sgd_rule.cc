@@ -14,16 +14,258 @@
 
 #include "paddle/fluid/distributed/ps/table/sparse_sgd_rule.h"
 
+#ifdef PADDLE_WITH_AVX
+#include <immintrin.h>
+#endif
+
 #include "glog/logging.h"
 
 #include "paddle/common/flags.h"
 
 #include "paddle/common/enforce.h"
+#include "paddle/phi/backends/cpu/cpu_info.h"
 
 PD_DEFINE_bool(enable_show_scale_gradient, true, "enable show scale gradient");
 
 namespace paddle::distributed {
 
+namespace {
+
+// The build only enables AVX, so the rules keep one generic batch loop and
+// RunLanes() instantiates it per vector width: the AVX and AVX-512 copies are
+// flattened into functions compiled for their target, and the widest one the
+// CPU supports is picked at runtime.
+#if defined(__GNUC__)
+#define SGD_TARGET(isa) __attribute__((target(isa)))
+#define SGD_KERNEL(isa) __attribute__((target(isa), flatten))
+#else
+#define SGD_TARGET(isa)
+#define SGD_KERNEL(isa)
+#endif
+
+// Minimal float vector types for the batched updates, other CPUs fall back
+// to scalars.
+struct ScalarF {
+  static constexpr size_t kWidth = 1;
+  float v;
+  static ScalarF Load(const float *p) { return {*p}; }
+  static ScalarF Set(float x) { return {x}; }
+  void Store(float *p) const { *p = v; }
+  float Sum() const { return v; }
+  friend ScalarF operator+(ScalarF a, ScalarF b) { return {a.v + b.v}; }
+  friend ScalarF operator-(ScalarF a, ScalarF b) { return {a.v - b.v}; }
+  friend ScalarF operator*(ScalarF a, ScalarF b) { return {a.v * b.v}; }
+  friend ScalarF operator/(ScalarF a, ScalarF b) { return {a.v / b.v}; }
+  friend ScalarF Sqrt(ScalarF a) { return {sqrtf(a.v)}; }
+  // the second operand is returned for NaN, as by the SIMD instructions
+  friend ScalarF Max(ScalarF a, ScalarF b) { return {a.v > b.v ? a.v : b.v}; }
+  friend ScalarF Min(ScalarF a, ScalarF b) { return {a.v < b.v ? a.v : b.v}; }
+};
+
+// The vector registers are passed around in the generic loops, which are
+// only inlined into the kernel of their target, so the ABI of such calls is
+// moot. gcc also flags the undefined lanes inside some AVX-512 intrinsics.
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#if !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#endif
+
+#ifdef PADDLE_WITH_AVX
+struct VecAVX {
+  static constexpr size_t kWidth = 8;
+  __m256 v;
+  SGD_TARGET("avx") static VecAVX Load(const float *p) {
+    return {_mm256_loadu_ps(p)};
+  }
+  SGD_TARGET("avx") static VecAVX Set(float x) { return {_mm256_set1_ps(x)}; }
+  SGD_TARGET("avx") void Store(float *p) const { _mm256_storeu_ps(p, v); }
+  SGD_TARGET("avx") float Sum() const {
+    __m128 x = _mm_add_ps(_mm256_castps256_ps128(v),
+                          _mm256_extractf128_ps(v, 1));
+    x = _mm_add_ps(x, _mm_movehl_ps(x, x));
+    x = _mm_add_ss(x, _mm_shuffle_ps(x, x, 1));
+    return _mm_cvtss_f32(x);
+  }
+  SGD_TARGET("avx") friend VecAVX operator+(VecAVX a, VecAVX b) {
+    return {_mm256_add_ps(a.v, b.v)};
+  }
+  SGD_TARGET("avx") friend VecAVX operator-(VecAVX a, VecAVX b) {
+    return {_mm256_sub_ps(a.v, b.v)};
+  }
+  SGD_TARGET("avx") friend VecAVX operator*(VecAVX a, VecAVX b) {
+    return {_mm256_mul_ps(a.v, b.v)};
+  }
+  SGD_TARGET("avx") friend VecAVX operator/(VecAVX a, VecAVX b) {
+    return {_mm256_div_ps(a.v, b.v)};
+  }
+  SGD_TARGET("avx") friend VecAVX Sqrt(VecAVX a) {
+    return {_mm256_sqrt_ps(a.v)};
+  }
+  SGD_TARGET("avx") friend VecAVX Max(VecAVX a, VecAVX b) {
+    return {_mm256_max_ps(a.v, b.v)};
+  }
+  SGD_TARGET("avx") friend VecAVX Min(VecAVX a, VecAVX b) {
+    return {_mm256_min_ps(a.v, b.v)};
+  }
+};
+#endif
+
+#ifdef PADDLE_WITH_AVX512F
+struct VecAVX512 {
+  static constexpr size_t kWidth = 16;
+  __m512 v;
+  SGD_TARGET("avx512f") static VecAVX512 Load(const float *p) {
+    return {_mm512_loadu_ps(p)};
+  }
+  SGD_TARGET("avx512f") static VecAVX512 Set(float x) {
+    return {_mm512_set1_ps(x)};
+  }
+  SGD_TARGET("avx512f") void Store(float *p) const {
+    _mm512_storeu_ps(p, v);
+  }
+  SGD_TARGET("avx512f") float Sum() const {
+    alignas(64) float lanes[kWidth];
+    _mm512_store_ps(lanes, v);
+    float sum = 0;
+    for (size_t i = 0; i < kWidth; ++i) {
+      sum += lanes[i];
+    }
+    return sum;
+  }
+  SGD_TARGET("avx512f") friend VecAVX512 operator+(VecAVX512 a, VecAVX512 b) {
+    return {_mm512_add_ps(a.v, b.v)};
+  }
+  SGD_TARGET("avx512f") friend VecAVX512 operator-(VecAVX512 a, VecAVX512 b) {
+    return {_mm512_sub_ps(a.v, b.v)};
+  }
+  SGD_TARGET("avx512f") friend VecAVX512 operator*(VecAVX512 a, VecAVX512 b) {
+    return {_mm512_mul_ps(a.v, b.v)};
+  }
+  SGD_TARGET("avx512f") friend VecAVX512 operator/(VecAVX512 a, VecAVX512 b) {
+    return {_mm512_div_ps(a.v, b.v)};
+  }
+  SGD_TARGET("avx512f") friend VecAVX512 Sqrt(VecAVX512 a) {
+    return {_mm512_sqrt_ps(a.v)};
+  }
+  SGD_TARGET("avx512f") friend VecAVX512 Max(VecAVX512 a, VecAVX512 b) {
+    return {_mm512_max_ps(a.v, b.v)};
+  }
+  SGD_TARGET("avx512f") friend VecAVX512 Min(VecAVX512 a, VecAVX512 b) {
+    return {_mm512_min_ps(a.v, b.v)};
+  }
+};
+#endif
+
+#ifdef PADDLE_WITH_AVX
+template <class Body>
+SGD_KERNEL("avx") void RunLanesAVX(Body &&body) {
+  body(VecAVX());
+}
+#endif
+
+#ifdef PADDLE_WITH_AVX512F
+template <class Body>
+SGD_KERNEL("avx512f") void RunLanesAVX512(Body &&body) {
+  body(VecAVX512());
+}
+#endif
+
+// The widest vector the CPU supports, in floats.
+inline size_t LaneWidth() {
+  static const size_t width = [] {
+#ifdef PADDLE_WITH_AVX512F
+    if (phi::backends::cpu::MayIUse(phi::backends::cpu::avx512f)) {
+      return size_t{16};
+    }
+#endif
+#ifdef PADDLE_WITH_AVX
+    if (phi::backends::cpu::MayIUse(phi::backends::cpu::avx)) {
+      return size_t{8};
+    }
+#endif
+    return size_t{1};
+  }();
+  return width;
+}
+
+// Calls body(V()) with the widest vector type V the CPU supports.
+template <class Body>
+void RunLanes(Body &&body) {
+#ifdef PADDLE_WITH_AVX512F
+  if (LaneWidth() == VecAVX512::kWidth) {
+    RunLanesAVX512(body);
+    return;
+  }
+#endif
+#ifdef PADDLE_WITH_AVX
+  if (LaneWidth() == VecAVX::kWidth) {
+    RunLanesAVX(body);
+    return;
+  }
+#endif
+  body(ScalarF());
+}
+
+// Calls body(V(), i) for lanes [i, i + V::kWidth) covering [0, dim), the
+// tail that does not fill a vector is done with scalars.
+template <class V, class Body>
+inline void ForEachLane(size_t dim, Body &&body) {
+  size_t i = 0;
+  for (; i + V::kWidth <= dim; i += V::kWidth) {
+    body(V(), i);
+  }
+  for (; i < dim; ++i) {
+    body(ScalarF(), i);
+  }
+}
+
+// Same clamping as SparseValueSGDRule::BoundValue, NaN becomes `lo`.
+template <class V>
+inline V Bound(V w, float lo, float hi) {
+  return Min(Max(w, V::Set(lo)), V::Set(hi));
+}
+
+template <class V>
+inline double SumSquares(const float *g, size_t dim) {
+  double sum = 0;
+  ForEachLane<V>(dim, [&](auto v, size_t i) {
+    using L = decltype(v);
+    L x = L::Load(g + i);
+    sum += (x * x).Sum();
+  });
+  return sum;
+}
+
+// w[i] = bound(w[i] - coef * g[i])
+template <class V>
+inline void AxpyBound(
+    float *w, const float *g, float coef, size_t dim, float lo, float hi) {
+  ForEachLane<V>(dim, [&](auto v, size_t i) {
+    using L = decltype(v);
+    Bound(L::Load(w + i) - L::Set(coef) * L::Load(g + i), lo, hi)
+        .Store(w + i);
+  });
+}
+
+// The rows of a batch are scattered over the shard, fetch the next one
+// while the current one is updated.
+inline void PrefetchRow(float *const *values,
+                        size_t w_index,
+                        const float *const *grads,
+                        size_t grad_index,
+                        size_t next,
+                        size_t num) {
+  if (next < num) {
+    __builtin_prefetch(values[next] + w_index, 1);
+    __builtin_prefetch(grads[next] + grad_index, 0);
+  }
+}
+
+}  // namespace
+
 void SparseNaiveSGDRule::LoadConfig(const SparseCommonSGDRuleParameter &param,
                                     size_t emb_dim) {
   _embedding_dim = emb_dim;
@@ -54,6 +296,27 @@ void SparseNaiveSGDRule::UpdateValueWork(float *w,
   }
 }
 
+void SparseNaiveSGDRule::UpdateValueBatchWork(float **values,
+                                              size_t w_index,
+                                              size_t sgd_index,
+                                              const float **grads,
+                                              size_t grad_index,
+                                              const float *scales,
+                                              size_t num) {
+  RunLanes([&](auto lanes) {
+    using V = decltype(lanes);
+    for (size_t r = 0; r < num; ++r) {
+      PrefetchRow(values, w_index, grads, grad_index, r + 1, num);
+      AxpyBound<V>(values[r] + w_index,
+                   grads[r] + grad_index,
+                   learning_rate_,
+                   _embedding_dim,
+                   _min_bound,
+                   _max_bound);
+    }
+  });
+}
+
 void SparseNaiveSGDRule::InitValueWork(float *value,
                                        float *sgd,
                                        bool zero_init) {
@@ -111,6 +374,35 @@ void SparseAdaGradSGDRule::UpdateValueWork(float *w,
   g2sum += add_g2sum / _embedding_dim;
 }
 
+void SparseAdaGradSGDRule::UpdateValueBatchWork(float **values,
+                                                size_t w_index,
+                                                size_t sgd_index,
+                                                const float **grads,
+                                                size_t grad_index,
+                                                const float *scales,
+                                                size_t num) {
+  RunLanes([&](auto lanes) {
+    using V = decltype(lanes);
+    for (size_t r = 0; r < num; ++r) {
+      PrefetchRow(values, w_index, grads, grad_index, r + 1, num);
+      float &g2sum = values[r][sgd_index + G2SumIndex()];
+      const float *grad = grads[r] + grad_index;
+      double scale = scales[r];
+      double coef =
+          learning_rate_ * sqrt(_initial_g2sum / (_initial_g2sum + g2sum)) /
+          scale;
+      AxpyBound<V>(values[r] + w_index,
+                   grad,
+                   static_cast<float>(coef),
+                   _embedding_dim,
+                   _min_bound,
+                   _max_bound);
+      g2sum += SumSquares<V>(grad, _embedding_dim) / (scale * scale) /
+               _embedding_dim;
+    }
+  });
+}
+
 void SparseAdaGradSGDRule::InitValueWork(float *value,
                                          float *sgd,
                                          bool zero_init) {
@@ -166,6 +458,35 @@ void StdAdaGradSGDRule::UpdateValueWork(float *w,
   }
 }
 
+void StdAdaGradSGDRule::UpdateValueBatchWork(float **values,
+                                             size_t w_index,
+                                             size_t sgd_index,
+                                             const float **grads,
+                                             size_t grad_index,
+                                             const float *scales,
+                                             size_t num) {
+  RunLanes([&](auto lanes) {
+    using V = decltype(lanes);
+    for (size_t r = 0; r < num; ++r) {
+      PrefetchRow(values, w_index, grads, grad_index, r + 1, num);
+      float *w = values[r] + w_index;
+      float *g2sum = values[r] + sgd_index + G2SumIndex();
+      const float *grad = grads[r] + grad_index;
+      float scale = scales[r];
+      ForEachLane<V>(_embedding_dim, [&](auto v, size_t i) {
+        using L = decltype(v);
+        L scaled_grad = L::Load(grad + i) / L::Set(scale);
+        L init = L::Set(_initial_g2sum);
+        L g2 = L::Load(g2sum + i);
+        L w_new = L::Load(w + i) - L::Set(learning_rate_) * scaled_grad *
+                                       Sqrt(init / (init + g2));
+        Bound(w_new, _min_bound, _max_bound).Store(w + i);
+        (g2 + scaled_grad * scaled_grad).Store(g2sum + i);
+      });
+    }
+  });
+}
+
 void StdAdaGradSGDRule::InitValueWork(float *value,
                                       float *sgd,
                                       bool zero_init) {
@@ -236,6 +557,46 @@ void SparseAdamSGDRule::UpdateValueWork(float *w,
   (*beta2_pow) *= _beta2_decay_rate;
 }
 
+void SparseAdamSGDRule::UpdateValueBatchWork(float **values,
+                                             size_t w_index,
+                                             size_t sgd_index,
+                                             const float **grads,
+                                             size_t grad_index,
+                                             const float *scales,
+                                             size_t num) {
+  RunLanes([&](auto lanes) {
+    using V = decltype(lanes);
+    for (size_t r = 0; r < num; ++r) {
+      PrefetchRow(values, w_index, grads, grad_index, r + 1, num);
+      float *w = values[r] + w_index;
+      float *sgd = values[r] + sgd_index;
+      float *gsum = sgd + GSumIndex();
+      float *g2sum = sgd + G2SumIndex();
+      float *beta1_pow = sgd + Beta1PowIndex();
+      float *beta2_pow = sgd + Beta2PowIndex();
+      const float *g = grads[r] + grad_index;
+      float lr = learning_rate_;
+      lr *= sqrt(1 - *beta2_pow) / (1 - *beta1_pow);
+      ForEachLane<V>(_embedding_dim, [&](auto v, size_t i) {
+        using L = decltype(v);
+        L grad = L::Load(g + i);
+        L new_gsum = L::Set(_beta1_decay_rate) * L::Load(gsum + i) +
+                     L::Set(1 - _beta1_decay_rate) * grad;
+        L new_g2sum = L::Set(_beta2_decay_rate) * L::Load(g2sum + i) +
+                      L::Set(1 - _beta2_decay_rate) * grad * grad;
+        L w_new = L::Load(w + i) -
+                  L::Set(lr) *
+                      (new_gsum / (Sqrt(new_g2sum) + L::Set(_ada_epsilon)));
+        new_gsum.Store(gsum + i);
+        new_g2sum.Store(g2sum + i);
+        Bound(w_new, _min_bound, _max_bound).Store(w + i);
+      });
+      (*beta1_pow) *= _beta1_decay_rate;
+      (*beta2_pow) *= _beta2_decay_rate;
+    }
+  });
+}
+
 void SparseAdamSGDRule::InitValueWork(float *value,
                                       float *sgd,
                                       bool zero_init) {
@@ -321,6 +682,52 @@ void SparseSharedAdamSGDRule::UpdateValueWork(float *w,
   (*beta2_pow) *= _beta2_decay_rate;
 }
 
+void SparseSharedAdamSGDRule::UpdateValueBatchWork(float **values,
+                                                   size_t w_index,
+                                                   size_t sgd_index,
+                                                   const float **grads,
+                                                   size_t grad_index,
+                                                   const float *scales,
+                                                   size_t num) {
+  RunLanes([&](auto lanes) {
+    using V = decltype(lanes);
+    for (size_t r = 0; r < num; ++r) {
+      PrefetchRow(values, w_index, grads, grad_index, r + 1, num);
+      float *w = values[r] + w_index;
+      float *sgd = values[r] + sgd_index;
+      float *gsum = sgd + GSumIndex();
+      float *g2sum = sgd + G2SumIndex();
+      float *beta1_pow = sgd + Beta1PowIndex();
+      float *beta2_pow = sgd + Beta2PowIndex();
+      const float *g = grads[r] + grad_index;
+      float lr = learning_rate_;
+      lr *= sqrt(1 - *beta2_pow) / (1 - *beta1_pow);
+      float gsum_ = *gsum;
+      float g2sum_ = *g2sum;
+      double sum_gsum = 0.0;
+      double sum_g2sum = 0.0;
+      ForEachLane<V>(_embedding_dim, [&](auto v, size_t i) {
+        using L = decltype(v);
+        L grad = L::Load(g + i);
+        L new_gsum = L::Set(_beta1_decay_rate * gsum_) +
+                     L::Set(1 - _beta1_decay_rate) * grad;
+        L new_g2sum = L::Set(_beta2_decay_rate * g2sum_) +
+                      L::Set(1 - _beta2_decay_rate) * grad * grad;
+        L w_new = L::Load(w + i) -
+                  L::Set(lr) *
+                      (new_gsum / (Sqrt(new_g2sum) + L::Set(_ada_epsilon)));
+        Bound(w_new, _min_bound, _max_bound).Store(w + i);
+        sum_gsum += new_gsum.Sum();
+        sum_g2sum += new_g2sum.Sum();
+      });
+      (*gsum) = sum_gsum / _embedding_dim;
+      (*g2sum) = sum_g2sum / _embedding_dim;
+      (*beta1_pow) *= _beta1_decay_rate;
+      (*beta2_pow) *= _beta2_decay_rate;
+    }
+  });
+}
+
 void SparseSharedAdamSGDRule::InitValueWork(float *value,
                                             float *sgd,
                                             bool zero_init) {
@@ -389,6 +796,34 @@ void SparseAdaGradV2SGDRule::UpdateValueWork(float *w,
   }
 }
 
+void SparseAdaGradV2SGDRule::UpdateValueBatchWork(float **values,
+                                                  size_t w_index,
+                                                  size_t sgd_index,
+                                                  const float **grads,
+                                                  size_t grad_index,
+                                                  const float *scales,
+                                                  size_t num) {
+  float epsilon = 1e-8;
+  RunLanes([&](auto lanes) {
+    using V = decltype(lanes);
+    for (size_t r = 0; r < num; ++r) {
+      PrefetchRow(values, w_index, grads, grad_index, r + 1, num);
+      float &g2sum = values[r][sgd_index + G2SumIndex()];
+      const float *grad = grads[r] + grad_index;
+      double scale = scales[r];
+      g2sum += SumSquares<V>(grad, _embedding_dim) / (scale * scale) /
+               _embedding_dim;
+      double coef = learning_rate_ / (sqrt(g2sum) + epsilon) / scale;
+      AxpyBound<V>(values[r] + w_index,
+                   grad,
+                   static_cast<float>(coef),
+                   _embedding_dim,
+                   _min_bound,
+                   _max_bound);
+    }
+  });
+}
+
 void SparseAdaGradV2SGDRule::InitValueWork(float *value,
                                            float *sgd,
                                            bool zero_init) {
@@ -408,4 +843,8 @@ void SparseAdaGradV2SGDRule::InitValueWork(float *value,
   sgd[G2SumIndex()] = 0;
 }
 
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
 }  // namespace paddle::distributed
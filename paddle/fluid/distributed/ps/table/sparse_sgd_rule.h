@@ -39,6 +39,24 @@ class SparseValueSGDRule {
                                float* sgd,
                                const float* push_value,
                                float scale) = 0;
+  // Updates `num` rows at once: row i keeps its weights at values[i] +
+  // w_index, its rule state at values[i] + sgd_index and reads its gradient
+  // from grads[i] + grad_index. Rows are applied in order, so a value may
+  // appear more than once.
+  virtual void UpdateValueBatchWork(float** values,
+                                    size_t w_index,
+                                    size_t sgd_index,
+                                    const float** grads,
+                                    size_t grad_index,
+                                    const float* scales,
+                                    size_t num) {
+    for (size_t i = 0; i < num; ++i) {
+      UpdateValueWork(values[i] + w_index,
+                      values[i] + sgd_index,
+                      grads[i] + grad_index,
+                      scales[i]);
+    }
+  }
   virtual void InitValueWork(float* value, float* sgd, bool zero_init) = 0;
   virtual size_t Dim() = 0;
   const std::string& GetName() const { return _name; }
@@ -51,6 +69,16 @@ class SparseValueSGDRule {
                    float scale = 1) {
     UpdateValueWork(w, sgd, push_value, scale);
   }
+  void UpdateValueBatch(float** values,
+                        size_t w_index,
+                        size_t sgd_index,
+                        const float** grads,
+                        size_t grad_index,
+                        const float* scales,
+                        size_t num) {
+    UpdateValueBatchWork(
+        values, w_index, sgd_index, grads, grad_index, scales, num);
+  }
   template <class T>
   void BoundValue(T& w) {  // NOLINT
     if (!(w >= _min_bound)) {
@@ -82,6 +110,13 @@ class SparseNaiveSGDRule : public SparseValueSGDRule {
                                float* sgd,
                                const float* push_value,
                                float scale);
+  virtual void UpdateValueBatchWork(float** values,
+                                    size_t w_index,
+                                    size_t sgd_index,
+                                    const float** grads,
+                                    size_t grad_index,
+                                    const float* scales,
+                                    size_t num);
   virtual void InitValueWork(float* value, float* sgd, bool zero_init);
   virtual size_t Dim() { return 0; }
 
@@ -97,6 +132,13 @@ class SparseAdaGradSGDRule : public SparseValueSGDRule {
                                float* sgd,
                                const float* push_value,
                                float scale);
+  virtual void UpdateValueBatchWork(float** values,
+                                    size_t w_index,
+                                    size_t sgd_index,
+                                    const float** grads,
+                                    size_t grad_index,
+                                    const float* scales,
+                                    size_t num);
   virtual void InitValueWork(float* value, float* sgd, bool zero_init);
   virtual size_t Dim() { return 1; }
   size_t G2SumIndex() { return 0; }
@@ -117,6 +159,13 @@ class SparseAdaGradV2SGDRule : public SparseValueSGDRule {
                                float* sgd,
                                const float* push_value,
                                float scale);
+  virtual void UpdateValueBatchWork(float** values,
+                                    size_t w_index,
+                                    size_t sgd_index,
+                                    const float** grads,
+                                    size_t grad_index,
+                                    const float* scales,
+                                    size_t num);
   virtual void InitValueWork(float* value, float* sgd, bool zero_init);
   virtual size_t Dim() { return 1; }
   size_t G2SumIndex() { return 0; }
@@ -134,6 +183,13 @@ class StdAdaGradSGDRule : public SparseValueSGDRule {
                                float* sgd,
                                const float* push_value,
                                float scale);
+  virtual void UpdateValueBatchWork(float** values,
+                                    size_t w_index,
+                                    size_t sgd_index,
+                                    const float** grads,
+                                    size_t grad_index,
+                                    const float* scales,
+                                    size_t num);
   virtual void InitValueWork(float* value, float* sgd, bool zero_init);
   virtual size_t Dim() { return _embedding_dim; }
   size_t G2SumIndex() { return 0; }
@@ -151,6 +207,13 @@ class SparseAdamSGDRule : public SparseValueSGDRule {
                                float* sgd,
                                const float* push_value,
                                float scale);
+  virtual void UpdateValueBatchWork(float** values,
+                                    size_t w_index,
+                                    size_t sgd_index,
+                                    const float** grads,
+                                    size_t grad_index,
+                                    const float* scales,
+                                    size_t num);
   virtual void InitValueWork(float* value, float* sgd, bool zero_init);
   virtual size_t Dim() { return _embedding_dim * 2 + 2; }
   size_t GSumIndex() { return 0; }
@@ -173,6 +236,13 @@ class SparseSharedAdamSGDRule : public SparseValueSGDRule {
                                float* sgd,
                                const float* push_value,
                                float scale);
+  virtual void UpdateValueBatchWork(float** values,
+                                    size_t w_index,
+                                    size_t sgd_index,
+                                    const float** grads,
+                                    size_t grad_index,
+                                    const float* scales,
+                                    size_t num);
   virtual void InitValueWork(float* value, float* sgd, bool zero_init);
   virtual size_t Dim() { return 4; }
   size_t GSumIndex() { return 0; }
@@ -0,0 +1,331 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/distributed/ps/table/sparse_snapshot.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#include "glog/logging.h"
+#include "paddle/fluid/framework/io/fs.h"
+#include "paddle/fluid/platform/enforce.h"
+
+namespace paddle::distributed {
+
+namespace {
+
+const char kSnapshotMagic[8] = {'P', 'D', 'S', 'P', 'S', 'N', 'A', 'P'};
+const uint32_t kSnapshotVersion = 1;
+const uint64_t kSnapshotAlignment = 64;
+
+uint64_t AlignUp(uint64_t x) {
+  return (x + kSnapshotAlignment - 1) / kSnapshotAlignment * kSnapshotAlignment;
+}
+
+bool WriteAll(FILE* fp, const void* data, size_t size) {
+  return size == 0 || fwrite(data, 1, size, fp) == size;
+}
+
+bool WritePadding(FILE* fp, uint64_t from, uint64_t to) {
+  static const char zeros[kSnapshotAlignment] = {0};
+  return WriteAll(fp, zeros, to - from);
+}
+
+// Whether `num` elements of `elem_size` bytes at `offset` are aligned, lie
+// after the header and end within `length` bytes, without overflowing.
+bool SectionInFile(uint64_t offset,
+                   uint64_t num,
+                   uint64_t elem_size,
+                   uint64_t length) {
+  if (offset % kSnapshotAlignment != 0 ||
+      offset < sizeof(SparseSnapshotHeader) || offset > length) {
+    return false;
+  }
+  return elem_size == 0 || num <= (length - offset) / elem_size;
+}
+
+}  // namespace
+
+int32_t SparseSnapshotWriter::Write(const std::string& path) {
+  std::sort(_entries.begin(), _entries.end(), [](const auto& a, const auto& b) {
+    return std::get<0>(a) < std::get<0>(b);
+  });
+  std::sort(_deleted.begin(), _deleted.end());
+  _deleted.erase(std::unique(_deleted.begin(), _deleted.end()), _deleted.end());
+
+  uint64_t key_num = _entries.size();
+  SparseSnapshotHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+  header.version = kSnapshotVersion;
+  header.value_stride = _value_stride;
+  header.key_num = key_num;
+  header.keys_offset = AlignUp(sizeof(header));
+  header.dims_offset = AlignUp(header.keys_offset + key_num * sizeof(uint64_t));
+  header.values_offset =
+      AlignUp(header.dims_offset + key_num * sizeof(uint32_t));
+  header.deleted_offset = AlignUp(header.values_offset +
+                                  key_num * _value_stride * sizeof(float));
+  header.deleted_num = static_cast<uint32_t>(_deleted.size());
+  header.flags = _delta ? SPARSE_SNAPSHOT_FLAG_DELTA : 0;
+
+  int err_no = 0;
+  std::shared_ptr<FILE> fp = framework::fs_open_write(path, &err_no, "");
+  if (fp == nullptr || err_no != 0) {
+    LOG(ERROR) << "SparseSnapshotWriter open failed, path:" << path;
+    return -1;
+  }
+  bool ok = WriteAll(fp.get(), &header, sizeof(header));
+  ok = ok && WritePadding(fp.get(), sizeof(header), header.keys_offset);
+  for (size_t i = 0; ok && i < key_num; ++i) {
+    uint64_t key = std::get<0>(_entries[i]);
+    ok = WriteAll(fp.get(), &key, sizeof(key));
+  }
+  ok = ok && WritePadding(fp.get(),
+                          header.keys_offset + key_num * sizeof(uint64_t),
+                          header.dims_offset);
+  for (size_t i = 0; ok && i < key_num; ++i) {
+    uint32_t dim = std::min(std::get<2>(_entries[i]), _value_stride);
+    ok = WriteAll(fp.get(), &dim, sizeof(dim));
+  }
+  ok = ok && WritePadding(fp.get(),
+                          header.dims_offset + key_num * sizeof(uint32_t),
+                          header.values_offset);
+  std::vector<float> block(_value_stride);
+  for (size_t i = 0; ok && i < key_num; ++i) {
+    uint32_t dim = std::min(std::get<2>(_entries[i]), _value_stride);
+    std::fill(block.begin() + dim, block.end(), 0.0f);
+    memcpy(block.data(), std::get<1>(_entries[i]), dim * sizeof(float));
+    ok = WriteAll(fp.get(), block.data(), block.size() * sizeof(float));
+  }
+  if (!_deleted.empty()) {
+    ok = ok && WritePadding(fp.get(),
+                            header.values_offset +
+                                key_num * _value_stride * sizeof(float),
+                            header.deleted_offset);
+    ok = ok && WriteAll(fp.get(),
+                        _deleted.data(),
+                        _deleted.size() * sizeof(uint64_t));
+  }
+  if (ok && fflush(fp.get()) != 0) {
+    ok = false;
+  }
+  fp.reset();
+  if (!ok) {
+    LOG(ERROR) << "SparseSnapshotWriter write failed, path:" << path;
+    return -1;
+  }
+  return 0;
+}
+
+int32_t SparseSnapshotReader::Open(const std::string& path) {
+  Close();
+  if (framework::fs_select_internal(path) == 0) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      LOG(ERROR) << "SparseSnapshotReader open failed, path:" << path;
+      return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+      close(fd);
+      LOG(ERROR) << "SparseSnapshotReader stat failed, path:" << path;
+      return -1;
+    }
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+      LOG(ERROR) << "SparseSnapshotReader mmap failed, path:" << path;
+      return -1;
+    }
+    // pulls touch the mapping at random, warm-up reads it in order
+    madvise(data, st.st_size, MADV_RANDOM);
+    _data = reinterpret_cast<char*>(data);
+    _length = st.st_size;
+    _mapped = true;
+  } else {
+    int err_no = 0;
+    std::shared_ptr<FILE> fp = framework::fs_open_read(path, &err_no, "");
+    if (fp == nullptr || err_no != 0) {
+      LOG(ERROR) << "SparseSnapshotReader open failed, path:" << path;
+      return -1;
+    }
+    char buf[1 << 16];
+    size_t n = 0;
+    while ((n = fread(buf, 1, sizeof(buf), fp.get())) > 0) {
+      _buffer.insert(_buffer.end(), buf, buf + n);
+    }
+    _data = _buffer.data();
+    _length = _buffer.size();
+  }
+
+  SparseSnapshotHeader header;
+  std::string error;
+  if (_length < sizeof(header)) {
+    error = "the file is shorter than the header";
+  } else {
+    memcpy(&header, _data, sizeof(header));
+    uint64_t value_bytes =
+        static_cast<uint64_t>(header.value_stride) * sizeof(float);
+    if (memcmp(header.magic, kSnapshotMagic, sizeof(header.magic)) != 0) {
+      error = "the magic does not match";
+    } else if (header.version != kSnapshotVersion) {
+      error = "the version is not supported";
+    } else if (!SectionInFile(header.keys_offset,
+                              header.key_num,
+                              sizeof(uint64_t),
+                              _length) ||
+               !SectionInFile(header.dims_offset,
+                              header.key_num,
+                              sizeof(uint32_t),
+                              _length) ||
+               !SectionInFile(header.values_offset,
+                              header.key_num,
+                              value_bytes,
+                              _length)) {
+      error = "the keys, dims or values exceed the file";
+    } else if (header.deleted_num > 0 &&
+               !SectionInFile(header.deleted_offset,
+                              header.deleted_num,
+                              sizeof(uint64_t),
+                              _length)) {
+      error = "the deleted keys exceed the file";
+    }
+  }
+  if (!error.empty()) {
+    size_t length = _length;
+    Close();
+    PADDLE_THROW(common::errors::InvalidArgument(
+        "Invalid sparse snapshot %s of %d bytes: %s.",
+        path,
+        length,
+        error));
+  }
+  _value_stride = header.value_stride;
+  _flags = header.flags;
+  _key_num = header.key_num;
+  _deleted_num = header.deleted_num;
+  _keys = reinterpret_cast<const uint64_t*>(_data + header.keys_offset);
+  _dims = reinterpret_cast<const uint32_t*>(_data + header.dims_offset);
+  _values = reinterpret_cast<const float*>(_data + header.values_offset);
+  _deleted = reinterpret_cast<const uint64_t*>(_data + header.deleted_offset);
+  return 0;
+}
+
+void SparseSnapshotReader::Close() {
+  if (_mapped && _data != nullptr) {
+    munmap(_data, _length);
+  }
+  _data = nullptr;
+  _length = 0;
+  _mapped = false;
+  std::vector<char>().swap(_buffer);
+  _value_stride = 0;
+  _flags = 0;
+  _key_num = 0;
+  _deleted_num = 0;
+  _keys = nullptr;
+  _dims = nullptr;
+  _values = nullptr;
+  _deleted = nullptr;
+}
+
+const float* SparseSnapshotReader::Find(uint64_t key, uint32_t* dim) const {
+  const uint64_t* it = std::lower_bound(_keys, _keys + _key_num, key);
+  if (it == _keys + _key_num || *it != key) {
+    return nullptr;
+  }
+  size_t i = it - _keys;
+  *dim = this->dim(i);
+  return value(i);
+}
+
+int32_t MergeSparseSnapshots(const std::vector<std::string>& paths,
+                             const std::string& output) {
+  if (paths.empty()) {
+    LOG(ERROR) << "MergeSparseSnapshots got no input, output:" << output;
+    return -1;
+  }
+  std::vector<std::unique_ptr<SparseSnapshotReader>> readers(paths.size());
+  for (size_t j = 0; j < paths.size(); ++j) {
+    readers[j].reset(new SparseSnapshotReader());
+    if (readers[j]->Open(paths[j]) != 0) {
+      return -1;
+    }
+    if (readers[j]->value_stride() != readers[0]->value_stride()) {
+      LOG(ERROR) << "MergeSparseSnapshots value_stride mismatch, path:"
+                 << paths[j];
+      return -1;
+    }
+  }
+  bool delta = readers[0]->is_delta();
+  SparseSnapshotWriter writer(readers[0]->value_stride());
+  writer.set_delta(delta);
+
+  // k-way merge over the sorted keys and deleted keys of all files. Events
+  // of later files win, and within a file the value wins over the erase.
+  std::vector<size_t> key_pos(readers.size(), 0);
+  std::vector<size_t> deleted_pos(readers.size(), 0);
+  while (true) {
+    bool found = false;
+    uint64_t key = 0;
+    for (size_t j = 0; j < readers.size(); ++j) {
+      const auto& reader = *readers[j];
+      if (key_pos[j] < reader.size() &&
+          (!found || reader.key(key_pos[j]) < key)) {
+        key = reader.key(key_pos[j]);
+        found = true;
+      }
+      if (deleted_pos[j] < reader.deleted_size() &&
+          (!found || reader.deleted_key(deleted_pos[j]) < key)) {
+        key = reader.deleted_key(deleted_pos[j]);
+        found = true;
+      }
+    }
+    if (!found) {
+      break;
+    }
+    bool erased = false;
+    const float* value = nullptr;
+    uint32_t dim = 0;
+    for (size_t j = 0; j < readers.size(); ++j) {
+      const auto& reader = *readers[j];
+      if (deleted_pos[j] < reader.deleted_size() &&
+          reader.deleted_key(deleted_pos[j]) == key) {
+        ++deleted_pos[j];
+        erased = true;
+      }
+      if (key_pos[j] < reader.size() && reader.key(key_pos[j]) == key) {
+        value = reader.value(key_pos[j]);
+        dim = reader.dim(key_pos[j]);
+        ++key_pos[j];
+        erased = false;
+      }
+    }
+    if (!erased) {
+      writer.Add(key, value, dim);
+    } else if (delta) {
+      writer.AddDeleted(key);
+    }
+  }
+  return writer.Write(output);
+}
+
+}  // namespace paddle::distributed
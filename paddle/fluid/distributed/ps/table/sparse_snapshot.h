@@ -0,0 +1,140 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace paddle {
+namespace distributed {
+
+#define PSERVER_SNAPSHOT_SUFFIX ".snap"
+// delta snapshots are named delta-*, so they can sit next to the part-*
+// files of their base checkpoint
+#define PSERVER_SNAPSHOT_DELTA_PREFIX "delta-"
+
+// Binary snapshot of one sparse table shard. The file is laid out so that it
+// can be mapped and queried without parsing:
+//
+//   SparseSnapshotHeader                      64 bytes
+//   keys[key_num]       uint64, ascending     64-byte aligned
+//   dims[key_num]       uint32, floats used   64-byte aligned
+//   values[key_num]     value_stride floats   64-byte aligned
+//   deleted[deleted_num] uint64, ascending    64-byte aligned
+//
+// Values shorter than value_stride (e.g. without mf) are zero padded, so the
+// value of the i-th key starts at values + i * value_stride.
+//
+// A delta snapshot (SPARSE_SNAPSHOT_FLAG_DELTA) holds only the keys changed
+// since the previous checkpoint of the chain, plus the keys erased since
+// then. A key that is both erased and listed was created again afterwards.
+// Base snapshots have no deleted keys.
+#define SPARSE_SNAPSHOT_FLAG_DELTA 0x1
+
+struct SparseSnapshotHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t value_stride;
+  uint64_t key_num;
+  uint64_t keys_offset;
+  uint64_t dims_offset;
+  uint64_t values_offset;
+  uint64_t deleted_offset;
+  uint32_t deleted_num;
+  uint32_t flags;
+};
+static_assert(sizeof(SparseSnapshotHeader) == 64,
+              "SparseSnapshotHeader must be 64 bytes");
+
+class SparseSnapshotWriter {
+ public:
+  explicit SparseSnapshotWriter(uint32_t value_stride)
+      : _value_stride(value_stride) {}
+
+  // `value` must stay valid until Write() returns.
+  void Add(uint64_t key, const float* value, uint32_t dim) {
+    _entries.emplace_back(key, value, dim);
+  }
+  // Only written by delta snapshots.
+  void AddDeleted(uint64_t key) { _deleted.push_back(key); }
+  void set_delta(bool delta) { _delta = delta; }
+  size_t size() const { return _entries.size(); }
+  size_t deleted_size() const { return _deleted.size(); }
+
+  // Writes the snapshot to a local or remote path, returns 0 on success.
+  int32_t Write(const std::string& path);
+
+ private:
+  uint32_t _value_stride;
+  bool _delta = false;
+  std::vector<std::tuple<uint64_t, const float*, uint32_t>> _entries;
+  std::vector<uint64_t> _deleted;
+};
+
+// Read-only view of a snapshot. Local files are mapped, remote files are
+// read into memory once.
+class SparseSnapshotReader {
+ public:
+  SparseSnapshotReader() {}
+  SparseSnapshotReader(const SparseSnapshotReader&) = delete;
+  SparseSnapshotReader& operator=(const SparseSnapshotReader&) = delete;
+  ~SparseSnapshotReader() { Close(); }
+
+  // Returns 0 on success and -1 if the file cannot be read. Throws
+  // InvalidArgument if the file is not a well-formed snapshot.
+  int32_t Open(const std::string& path);
+  void Close();
+
+  size_t size() const { return _key_num; }
+  uint32_t value_stride() const { return _value_stride; }
+  uint64_t key(size_t i) const { return _keys[i]; }
+  // a corrupt dim never reaches past the value of the key
+  uint32_t dim(size_t i) const { return std::min(_dims[i], _value_stride); }
+  const float* value(size_t i) const { return _values + i * _value_stride; }
+  bool is_delta() const { return _flags & SPARSE_SNAPSHOT_FLAG_DELTA; }
+  size_t deleted_size() const { return _deleted_num; }
+  uint64_t deleted_key(size_t i) const { return _deleted[i]; }
+
+  // Binary search over the sorted keys, returns nullptr if absent.
+  const float* Find(uint64_t key, uint32_t* dim) const;
+
+ private:
+  char* _data = nullptr;
+  size_t _length = 0;
+  bool _mapped = false;
+  std::vector<char> _buffer;
+
+  uint32_t _value_stride = 0;
+  uint32_t _flags = 0;
+  size_t _key_num = 0;
+  size_t _deleted_num = 0;
+  const uint64_t* _keys = nullptr;
+  const uint32_t* _dims = nullptr;
+  const float* _values = nullptr;
+  const uint64_t* _deleted = nullptr;
+};
+
+// Merges a chain of snapshots of the same shard, oldest first, into one
+// file: the latest value of every key wins and erased keys are dropped. The
+// result is a base snapshot when paths[0] is a base, otherwise a delta that
+// still lists the erased keys. Returns 0 on success.
+int32_t MergeSparseSnapshots(const std::vector<std::string>& paths,
+                             const std::string& output);
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,341 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/distributed/ps/table/sparse_table_loader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cstdlib>
+#include <mutex>  // NOLINT
+#include <numeric>
+#include <sstream>
+#include <thread>  // NOLINT
+
+#include "glog/logging.h"
+#include "paddle/fluid/framework/channel.h"
+
+namespace paddle::distributed {
+
+namespace {
+
+struct LineBlock {
+  size_t pos = 0;  // position of the file in the files being loaded
+  int attempt = 0;  // read attempt of the file the lines come from
+  size_t bytes = 0;
+  std::vector<std::string> lines;
+};
+
+struct ValueBlock {
+  size_t file_idx = 0;
+  int attempt = 0;
+  std::vector<uint64_t> keys;
+  std::vector<uint32_t> sizes;
+  std::vector<float> values;
+};
+
+double Now() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Accumulates the time of one thread and adds it to the stage on exit.
+class StageRecorder {
+ public:
+  StageRecorder(SparseTableLoader::StageStats* stage, std::mutex* mutex)
+      : _stage(stage), _mutex(mutex), _start(Now()) {}
+  ~StageRecorder() {
+    double elapsed = Now() - _start;
+    std::lock_guard<std::mutex> guard(*_mutex);
+    _stage->busy_seconds += elapsed - _stats.wait_seconds;
+    _stage->wait_seconds += _stats.wait_seconds;
+  }
+
+  // Runs a blocking channel operation and counts it as waiting.
+  template <class Func>
+  bool Wait(Func&& func) {
+    double start = Now();
+    bool ret = func();
+    _stats.wait_seconds += Now() - start;
+    return ret;
+  }
+
+ private:
+  SparseTableLoader::StageStats* _stage;
+  std::mutex* _mutex;
+  double _start;
+  SparseTableLoader::StageStats _stats;
+};
+
+void AppendStage(std::ostringstream& os,
+                 const char* name,
+                 const SparseTableLoader::StageStats& stage,
+                 double seconds) {
+  double rate = seconds > 0 ? stage.records / seconds : 0;
+  os << " " << name << "[records:" << stage.records
+     << " MB:" << stage.bytes / 1048576.0 << " records/s:" << rate
+     << " busy:" << stage.busy_seconds << "s wait:" << stage.wait_seconds
+     << "s]";
+}
+
+}  // namespace
+
+std::string SparseTableLoader::Stats::ToString() const {
+  std::ostringstream os;
+  os << "cost:" << seconds << "s";
+  AppendStage(os, "read", read, seconds);
+  AppendStage(os, "parse", parse, seconds);
+  AppendStage(os, "insert", insert, seconds);
+  return os.str();
+}
+
+int32_t SparseTableLoader::Load(size_t file_num,
+                                const ReadFunc& read,
+                                const ParseFunc& parse,
+                                const InsertFunc& insert) {
+  _stats = Stats();
+  double start = Now();
+  std::vector<FileStats> file_stats(file_num);
+  std::vector<size_t> files(file_num);
+  std::iota(files.begin(), files.end(), 0);
+  int32_t ret = 0;
+  for (int retry_num = 0; !files.empty(); ++retry_num) {
+    std::vector<size_t> parse_failed;
+    if (LoadFiles(
+            files, read, parse, insert, &file_stats, &parse_failed) != 0) {
+      ret = -1;
+      break;
+    }
+    if (!parse_failed.empty() && retry_num >= _options.parse_retry_num) {
+      LOG(ERROR) << "SparseTableLoader parse failed reach max limit!";
+      ret = -1;
+      break;
+    }
+    // inserting the lines of a file again is harmless
+    for (size_t file_idx : parse_failed) {
+      LOG(ERROR) << "SparseTableLoader parse failed, retry it! file_idx:"
+                 << file_idx << " , retry_num=" << retry_num + 1;
+    }
+    files.swap(parse_failed);
+  }
+  for (auto& file : file_stats) {
+    _stats.read.records += file.read.records;
+    _stats.read.bytes += file.read.bytes;
+    _stats.parse.records += file.parse.records;
+    _stats.parse.bytes += file.parse.bytes;
+    _stats.insert.records += file.insert.records;
+    _stats.insert.bytes += file.insert.bytes;
+  }
+  _stats.seconds = Now() - start;
+  return ret;
+}
+
+int32_t SparseTableLoader::LoadFiles(const std::vector<size_t>& files,
+                                     const ReadFunc& read,
+                                     const ParseFunc& parse,
+                                     const InsertFunc& insert,
+                                     std::vector<FileStats>* file_stats,
+                                     std::vector<size_t>* parse_failed) {
+  int reader_num = std::max(1, _options.reader_num);
+  int parser_num = std::max(1, _options.parser_num);
+  int inserter_num = std::max(1, _options.inserter_num);
+  size_t block_bytes = std::max<size_t>(1, _options.block_bytes);
+  // half of the budget for text blocks, half for parsed ones
+  size_t block_num = std::max<size_t>(2, _options.memory_cap / block_bytes);
+  auto line_channel =
+      framework::MakeChannel<LineBlock>(std::max<size_t>(1, block_num / 2));
+  std::vector<framework::Channel<ValueBlock>> value_channels(inserter_num);
+  for (auto& channel : value_channels) {
+    channel = framework::MakeChannel<ValueBlock>(
+        std::max<size_t>(1, block_num / 2 / inserter_num));
+  }
+  // a parsed value is larger than its text, so parsed blocks are cut by
+  // their own size
+  size_t record_bytes =
+      sizeof(uint64_t) + sizeof(uint32_t) + _value_size * sizeof(float);
+  size_t block_records = std::max<size_t>(1, block_bytes / record_bytes);
+
+  std::mutex stats_mutex;
+  std::atomic<size_t> next_file(0);
+  std::atomic<bool> failed(false);
+  std::vector<char> file_parse_failed(files.size(), 0);
+  // a block is counted only if no later attempt of its file has started,
+  // so the lines of a failed read are not counted twice
+  auto account = [&](size_t file_idx,
+                     int attempt,
+                     StageStats FileStats::*stage,
+                     uint64_t records,
+                     uint64_t bytes) {
+    std::lock_guard<std::mutex> guard(stats_mutex);
+    auto& file = (*file_stats)[file_idx];
+    if (file.attempt == attempt) {
+      (file.*stage).records += records;
+      (file.*stage).bytes += bytes;
+    }
+  };
+
+  std::vector<std::thread> readers;
+  for (int i = 0; i < reader_num; ++i) {
+    readers.emplace_back([&]() {
+      StageRecorder recorder(&_stats.read, &stats_mutex);
+      size_t pos = 0;
+      while ((pos = next_file++) < files.size()) {
+        size_t file_idx = files[pos];
+        LineBlock block;
+        auto flush = [&]() {
+          if (block.lines.empty()) {
+            return;
+          }
+          account(file_idx,
+                  block.attempt,
+                  &FileStats::read,
+                  block.lines.size(),
+                  block.bytes);
+          int attempt = block.attempt;
+          recorder.Wait([&]() { return line_channel->Put(std::move(block)); });
+          block = LineBlock();
+          block.pos = pos;
+          block.attempt = attempt;
+        };
+        auto emit = [&](std::string* line) {
+          block.bytes += line->size();
+          block.lines.emplace_back(std::move(*line));
+          if (block.bytes + block.lines.size() * sizeof(std::string) >=
+              block_bytes) {
+            flush();
+          }
+        };
+        for (int retry_num = 0;; ++retry_num) {
+          {
+            // a new attempt drops the counts of the previous ones
+            std::lock_guard<std::mutex> guard(stats_mutex);
+            auto& file = (*file_stats)[file_idx];
+            int attempt = file.attempt + 1;
+            file = FileStats();
+            file.attempt = attempt;
+            block = LineBlock();
+            block.pos = pos;
+            block.attempt = attempt;
+          }
+          int32_t ret = read(file_idx, emit);
+          flush();
+          if (ret == 0) {
+            break;
+          }
+          if (retry_num >= _options.read_retry_num) {
+            LOG(ERROR) << "SparseTableLoader read failed reach max limit! "
+                       << "file_idx:" << file_idx;
+            failed = true;
+            break;
+          }
+          LOG(ERROR) << "SparseTableLoader read failed, retry it! file_idx:"
+                     << file_idx << " , retry_num=" << retry_num + 1;
+        }
+      }
+    });
+  }
+
+  std::vector<std::thread> parsers;
+  for (int i = 0; i < parser_num; ++i) {
+    parsers.emplace_back([&]() {
+      StageRecorder recorder(&_stats.parse, &stats_mutex);
+      LineBlock block;
+      while (recorder.Wait([&]() { return line_channel->Get(block); })) {
+        size_t file_idx = files[block.pos];
+        auto& channel = value_channels[file_idx % inserter_num];
+        uint64_t parsed = 0;
+        for (size_t begin = 0; begin < block.lines.size();
+             begin += block_records) {
+          size_t end = std::min(block.lines.size(), begin + block_records);
+          ValueBlock out;
+          out.file_idx = file_idx;
+          out.attempt = block.attempt;
+          out.keys.reserve(end - begin);
+          out.sizes.reserve(end - begin);
+          out.values.resize((end - begin) * _value_size);
+          for (size_t j = begin; j < end; ++j) {
+            const std::string& line = block.lines[j];
+            char* str = nullptr;
+            uint64_t key = std::strtoul(line.data(), &str, 10);
+            float* value = out.values.data() + out.keys.size() * _value_size;
+            int size = 0;
+            try {
+              size = parse(++str, value);
+            } catch (...) {
+              LOG(ERROR) << "SparseTableLoader parse failed, file_idx:"
+                         << file_idx << " line:" << line;
+              std::lock_guard<std::mutex> guard(stats_mutex);
+              if ((*file_stats)[file_idx].attempt == block.attempt) {
+                file_parse_failed[block.pos] = 1;
+              }
+              continue;
+            }
+            out.keys.push_back(key);
+            out.sizes.push_back(size);
+          }
+          parsed += out.keys.size();
+          recorder.Wait([&]() { return channel->Put(std::move(out)); });
+        }
+        account(
+            file_idx, block.attempt, &FileStats::parse, parsed, block.bytes);
+      }
+    });
+  }
+
+  std::vector<std::thread> inserters;
+  for (int i = 0; i < inserter_num; ++i) {
+    inserters.emplace_back([&, i]() {
+      StageRecorder recorder(&_stats.insert, &stats_mutex);
+      ValueBlock block;
+      while (recorder.Wait([&]() { return value_channels[i]->Get(block); })) {
+        uint64_t bytes = 0;
+        for (size_t j = 0; j < block.keys.size(); ++j) {
+          insert(block.file_idx,
+                 block.keys[j],
+                 block.values.data() + j * _value_size,
+                 block.sizes[j]);
+          bytes += block.sizes[j] * sizeof(float);
+        }
+        account(block.file_idx,
+                block.attempt,
+                &FileStats::insert,
+                block.keys.size(),
+                bytes);
+      }
+    });
+  }
+
+  for (auto& t : readers) {
+    t.join();
+  }
+  line_channel->Close();
+  for (auto& t : parsers) {
+    t.join();
+  }
+  for (auto& channel : value_channels) {
+    channel->Close();
+  }
+  for (auto& t : inserters) {
+    t.join();
+  }
+  for (size_t pos = 0; pos < files.size(); ++pos) {
+    if (file_parse_failed[pos]) {
+      parse_failed->push_back(files[pos]);
+    }
+  }
+  return failed ? -1 : 0;
+}
+
+}  // namespace paddle::distributed
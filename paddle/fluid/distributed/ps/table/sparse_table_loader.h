@@ -0,0 +1,125 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace paddle {
+namespace distributed {
+
+// Loads the text shard files of a sparse table with three overlapped stages:
+//
+//   reader threads   --(raw line blocks)-->   parser threads
+//   parser threads   --(parsed values)-->     inserter threads
+//
+// The stages are connected by bounded framework::Channels whose capacity is
+// derived from `memory_cap`, so a slow stage stalls the ones before it
+// instead of buffering whole files. Half of the budget goes to the text
+// blocks and half to the parsed ones, and both kinds of block are cut at
+// about `block_bytes`. File i holds the keys of shard i, and every shard is
+// owned by exactly one inserter thread, so the insert callback never races
+// on a shard.
+//
+// A file that fails to read is read again from the start, up to
+// `read_retry_num` times, and a file with a line that fails to parse is
+// loaded again, up to `parse_retry_num` times, like the sequential load
+// retries them. The stats count every file once, by its last attempt.
+class SparseTableLoader {
+ public:
+  struct Options {
+    int reader_num = 1;
+    int parser_num = 1;
+    int inserter_num = 1;
+    // bytes per block passed between the stages
+    size_t block_bytes = 1 << 20;
+    // approximate bound of the bytes buffered between the stages
+    size_t memory_cap = 1UL << 30;
+    // times a file is read again after a read failure
+    int read_retry_num = 3;
+    // times a file is loaded again after a parse failure
+    int parse_retry_num = 3;
+  };
+
+  struct StageStats {
+    uint64_t records = 0;
+    uint64_t bytes = 0;
+    // time spent working and time spent blocked on a channel, summed over
+    // the threads of the stage
+    double busy_seconds = 0;
+    double wait_seconds = 0;
+  };
+
+  struct Stats {
+    StageStats read;
+    StageStats parse;
+    StageStats insert;
+    double seconds = 0;
+    std::string ToString() const;
+  };
+
+  // Calls `emit` with every line of file `file_idx`, returns 0 on success.
+  // A failed read is retried from the start of the file, as inserting the
+  // same value twice is harmless.
+  typedef std::function<int32_t(size_t file_idx,
+                                const std::function<void(std::string*)>& emit)>
+      ReadFunc;
+  // Parses the text after the key into `value`, returns the floats used.
+  typedef std::function<int(const char* str, float* value)> ParseFunc;
+  // Stores one parsed value into shard `shard_idx`.
+  typedef std::function<void(
+      size_t shard_idx, uint64_t key, const float* value, size_t size)>
+      InsertFunc;
+
+  SparseTableLoader(const Options& options, size_t value_size)
+      : _options(options), _value_size(value_size) {}
+
+  // Returns 0 on success, -1 if any file could not be read or still fails
+  // to parse after the retries.
+  int32_t Load(size_t file_num,
+               const ReadFunc& read,
+               const ParseFunc& parse,
+               const InsertFunc& insert);
+
+  const Stats& GetStats() const { return _stats; }
+
+ private:
+  // The records and bytes of one file in every stage, for its latest read
+  // attempt only.
+  struct FileStats {
+    int attempt = 0;
+    StageStats read;
+    StageStats parse;
+    StageStats insert;
+  };
+
+  // Runs the three stages over `files` once. The files with a line that
+  // failed to parse are appended to `parse_failed`.
+  int32_t LoadFiles(const std::vector<size_t>& files,
+                    const ReadFunc& read,
+                    const ParseFunc& parse,
+                    const InsertFunc& insert,
+                    std::vector<FileStats>* file_stats,
+                    std::vector<size_t>* parse_failed);
+
+  Options _options;
+  size_t _value_size;
+  Stats _stats;
+};
+
+}  // namespace distributed
+}  // namespace paddle
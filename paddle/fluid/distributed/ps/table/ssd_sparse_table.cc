@@ -23,8 +23,13 @@
 PD_DECLARE_bool(pserver_print_missed_key_num_every_push);
 PD_DECLARE_bool(pserver_create_value_when_push);
 PD_DECLARE_bool(pserver_enable_create_feasign_randomly);
+PD_DECLARE_double(pserver_sparse_value_arena_compact_ratio);
 PD_DEFINE_bool(pserver_open_strict_check, false, "pserver_open_strict_check");
 PD_DEFINE_int32(pserver_load_batch_size, 5000, "load batch size for ssd");
+PD_DEFINE_int32(pserver_ssd_value_cache_mb,
+                0,
+                "memory budget of the frequency-aware cache of values "
+                "evicted to rocksdb per table, 0 disables the cache");
 PHI_DEFINE_EXPORTED_string(rocksdb_path,
                            "database",
                            "path of sparse table rocksdb file");
@@ -34,8 +39,22 @@ namespace distributed {
 
 int32_t SSDSparseTable::Initialize() {
   MemorySparseTable::Initialize();
+  // values move between memory and rocksdb outside of the concurrent index
+  _local_shard_indexes.reset();
+  _local_shard_mutexes.reset();
+  // keys also leave memory for rocksdb, delta checkpoints are not supported
+  _local_shard_deleted_keys.reset();
   _db = ::paddle::distributed::RocksDBHandler::GetInstance();
   _db->initialize(FLAGS_rocksdb_path, _real_local_shard_num);
+  if (FLAGS_pserver_ssd_value_cache_mb > 0 && _real_local_shard_num > 0) {
+    size_t shard_bytes = static_cast<size_t>(FLAGS_pserver_ssd_value_cache_mb)
+                         << 20;
+    shard_bytes /= _real_local_shard_num;
+    size_t value_bytes = _value_accessor->GetAccessorInfo().size;
+    for (int i = 0; i < _real_local_shard_num; ++i) {
+      _value_caches.emplace_back(new SSDValueCache(shard_bytes, value_bytes));
+    }
+  }
   VLOG(0) << "initialize SSDSparseTable succ";
   VLOG(0) << "SSD FLAGS_pserver_print_missed_key_num_every_push:"
           << FLAGS_pserver_print_missed_key_num_every_push;
@@ -129,7 +148,16 @@ int32_t SSDSparseTable::PullSparse(float* pull_values,
                   uint64_t key = keys[i].first;
                   auto itr = local_shard.find(key);
                   size_t data_size = value_size - mf_value_size;
+                  FixedFeatureValue* cached = nullptr;
                   if (itr == local_shard.end()) {
+                    cached = TakeFromValueCache(shard_id, key);
+                  }
+                  if (cached != nullptr) {
+                    data_size = cached->size();
+                    memcpy(data_buffer_ptr,
+                           cached->data(),
+                           data_size * sizeof(float));
+                  } else if (itr == local_shard.end()) {
                     // pull rocksdb
                     std::string tmp_string("");
                     if (_db->get(shard_id,
@@ -217,7 +245,14 @@ int32_t SSDSparseTable::PullSparsePtr(int shard_id,
     for (size_t i = 0; i < num; ++i) {
       uint64_t key = pull_keys[i];
       auto itr = local_shard.find(key);
-      if (itr == local_shard.end()) {
+      if (itr == local_shard.end() &&
+          (ret = TakeFromValueCache(shard_id, key)) != nullptr) {
+        _value_accessor->UpdateTimeDecay(ret->data(), true);
+#ifdef PADDLE_WITH_PSLIB
+        _value_accessor->UpdatePassId(ret->data(), pass_id);
+#endif
+        pull_values[i] = reinterpret_cast<char*>(ret);
+      } else if (itr == local_shard.end()) {
         cur_ctx->batch_index.push_back(i);
         cur_ctx->batch_keys.emplace_back(
             reinterpret_cast<const char*>(&(pull_keys[i])), sizeof(uint64_t));
@@ -531,6 +566,7 @@ int32_t SSDSparseTable::PushSparse(const uint64_t* keys,
 }
 
 int32_t SSDSparseTable::Shrink(const std::string& param) {
+  ClearValueCache();
   int thread_num = _real_local_shard_num < 20 ? _real_local_shard_num : 20;
   omp_set_num_threads(thread_num);
 #pragma omp parallel for schedule(dynamic)
@@ -563,8 +599,11 @@ int32_t SSDSparseTable::Shrink(const std::string& param) {
       }
     }
     delete it;
+    size_t compact_bytes =
+        shard.compact_values(FLAGS_pserver_sparse_value_arena_compact_ratio);
     LOG(INFO) << "SSDSparseTable shrink success. shard:" << i << " delete MEM["
-              << mem_count << "] SSD[" << ssd_count << "]";
+              << mem_count << "] SSD[" << ssd_count
+              << "] compacted bytes:" << compact_bytes;
     // _db->flush(i);
   }
   return 0;
@@ -582,6 +621,13 @@ int32_t SSDSparseTable::UpdateTable() {
                  sizeof(uint64_t),
                  reinterpret_cast<const char*>(it.value().data()),
                  it.value().size() * sizeof(float));
+        if (!_value_caches.empty()) {
+          _value_caches[i]->Admit(
+              it.key(),
+              it.value().data(),
+              it.value().size(),
+              _value_accessor->GetField(it.value().data(), "show"));
+        }
         count++;
         it = shard.erase(it);
       } else {
@@ -2582,6 +2628,7 @@ int32_t SSDSparseTable::SaveCache(
 int32_t SSDSparseTable::Load(const std::string& path,
                              const std::string& param) {
   VLOG(0) << "LOAD FLAGS_rocksdb_path:" << FLAGS_rocksdb_path;
+  ClearValueCache();
   std::string table_path = TableDir(path);
   auto file_list = _afs_client.list(::paddle::string::format_string(
       "%s/part-%03d*", table_path.c_str(), _shard_idx));
@@ -3047,9 +3094,49 @@ int32_t SSDSparseTable::LoadWithBinary(const std::string& path, int param) {
 
 std::pair<int64_t, int64_t> SSDSparseTable::PrintTableStat() {
   int64_t feasign_size = LocalSize();
+  if (!_value_caches.empty()) {
+    auto stats = GetValueCacheStats();
+    LOG(INFO) << "SSDSparseTable value cache hit_rate:" << stats.HitRate()
+              << " hits:" << stats.hits << " misses:" << stats.misses
+              << " admissions:" << stats.admissions
+              << " rejections:" << stats.rejections
+              << " evictions:" << stats.evictions << " size:" << stats.size
+              << " bytes:" << stats.bytes;
+  }
   return {feasign_size, -1};
 }
 
+SSDValueCache::Stats SSDSparseTable::GetValueCacheStats() {
+  SSDValueCache::Stats stats;
+  for (auto& cache : _value_caches) {
+    stats += cache->GetStats();
+  }
+  return stats;
+}
+
+FixedFeatureValue* SSDSparseTable::TakeFromValueCache(int shard_id,
+                                                      uint64_t key) {
+  if (_value_caches.empty()) {
+    return nullptr;
+  }
+  std::vector<float> value;
+  if (!_value_caches[shard_id]->Take(key, &value)) {
+    return nullptr;
+  }
+  // from cache to mem, like a value read from rocksdb
+  auto& feature_value = _local_shards[shard_id][key];
+  feature_value.resize(value.size());
+  memcpy(feature_value.data(), value.data(), value.size() * sizeof(float));
+  _db->del_data(shard_id, reinterpret_cast<char*>(&key), sizeof(uint64_t));
+  return &feature_value;
+}
+
+void SSDSparseTable::ClearValueCache() {
+  for (auto& cache : _value_caches) {
+    cache->Clear();
+  }
+}
+
 int32_t SSDSparseTable::CacheTable(uint16_t pass_id) {
   std::lock_guard<std::mutex> guard(_table_mutex);
   VLOG(0) << "cache_table";
@@ -16,6 +16,7 @@
 
 #include "paddle/common/flags.h"
 #include "paddle/fluid/distributed/ps/table/depends/rocksdb_warpper.h"
+#include "paddle/fluid/distributed/ps/table/depends/ssd_value_cache.h"
 #include "paddle/fluid/distributed/ps/table/memory_sparse_table.h"
 
 #if defined(PADDLE_WITH_HETERPS) && defined(PADDLE_WITH_PSCORE)
@@ -134,8 +135,18 @@ class SSDSparseTable : public MemorySparseTable {
 
   void SetDayId(int day_id) override;
 
+  // summed over all local shards, empty when the value cache is disabled
+  SSDValueCache::Stats GetValueCacheStats();
+
  private:
+  // moves the value of `key` from the value cache back into the memory
+  // shard and drops it from rocksdb, returns nullptr on a cache miss
+  FixedFeatureValue* TakeFromValueCache(int shard_id, uint64_t key);
+  void ClearValueCache();
+
   RocksDBHandler* _db;
+  // hot values evicted to rocksdb, see FLAGS_pserver_ssd_value_cache_mb
+  std::vector<std::unique_ptr<SSDValueCache>> _value_caches;
   int64_t _cache_tk_size;
   double _local_show_threshold{0.0};
   std::vector<paddle::framework::Channel<std::string>> _fs_channel;
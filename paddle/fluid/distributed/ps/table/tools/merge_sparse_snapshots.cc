@@ -0,0 +1,48 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Collapses a chain of snapshots of one sparse table shard into a single
+// file, e.g. a checkpoint part and the delta snapshots saved after it:
+//
+//   merge_sparse_snapshots OUTPUT part-000-00000.snap delta-000-00000.snap
+//
+// Inputs are given oldest first and may be local or remote paths.
+
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "paddle/fluid/distributed/ps/table/sparse_snapshot.h"
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    std::cerr << "usage: " << argv[0] << " OUTPUT INPUT [INPUT...]\n"
+              << "merges snapshots of one shard, oldest first, into OUTPUT"
+              << std::endl;
+    return 2;
+  }
+  std::string output = argv[1];
+  std::vector<std::string> inputs(argv + 2, argv + argc);
+  try {
+    if (paddle::distributed::MergeSparseSnapshots(inputs, output) != 0) {
+      std::cerr << "merge into " << output << " failed" << std::endl;
+      return 1;
+    }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
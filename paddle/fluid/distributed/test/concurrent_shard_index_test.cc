@@ -0,0 +1,238 @@
+/* Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/distributed/ps/table/depends/concurrent_shard_index.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cmath>
+#include <mutex>  // NOLINT
+#include <random>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+#include "paddle/fluid/distributed/ps/table/depends/feature_value.h"
+
+namespace paddle::distributed {
+
+typedef SparseTableShard<uint64_t, FixedFeatureValue> shard_type;
+typedef ConcurrentShardIndex<FixedFeatureValue> index_type;
+
+// Keys drawn from a Zipfian distribution over [0, key_num), like the skewed
+// feasign traffic a hot shard sees.
+std::vector<uint64_t> ZipfianKeys(size_t key_num, size_t num, double s) {
+  std::vector<double> cdf(key_num);
+  double sum = 0;
+  for (size_t i = 0; i < key_num; ++i) {
+    sum += 1.0 / std::pow(static_cast<double>(i + 1), s);
+    cdf[i] = sum;
+  }
+  std::mt19937_64 engine(2024);
+  std::uniform_real_distribution<double> dist(0, sum);
+  std::vector<uint64_t> keys(num);
+  for (auto& key : keys) {
+    size_t rank = std::lower_bound(cdf.begin(), cdf.end(), dist(engine)) -
+                  cdf.begin();
+    // spread the ranks over the key space like real feasigns
+    key = rank * 0x9E3779B97F4A7C15ULL;
+  }
+  return keys;
+}
+
+TEST(ConcurrentShardIndex, InsertFindErase) {
+  index_type index;
+  std::vector<FixedFeatureValue> values(10000);
+  for (uint64_t key = 0; key < values.size(); ++key) {
+    ASSERT_EQ(index.insert(key, &values[key]), &values[key]);
+  }
+  ASSERT_EQ(index.size(), values.size());
+  ASSERT_GE(index.capacity(), values.size());
+  for (uint64_t key = 0; key < values.size(); ++key) {
+    ASSERT_EQ(index.find(key), &values[key]);
+    // a second insert keeps the first value
+    ASSERT_EQ(index.insert(key, &values[0]), &values[key]);
+  }
+  ASSERT_EQ(index.find(values.size()), nullptr);
+
+  for (uint64_t key = 0; key < values.size(); key += 2) {
+    ASSERT_TRUE(index.erase(key));
+  }
+  ASSERT_FALSE(index.erase(0));
+  ASSERT_EQ(index.size(), values.size() / 2);
+  for (uint64_t key = 0; key < values.size(); ++key) {
+    ASSERT_EQ(index.find(key), key % 2 ? &values[key] : nullptr);
+  }
+  index.reclaim();
+  index.clear();
+  ASSERT_EQ(index.size(), 0UL);
+  ASSERT_EQ(index.find(1), nullptr);
+}
+
+TEST(ConcurrentShardIndex, ConcurrentInsert) {
+  index_type index;
+  shard_type shard;
+  std::mutex shard_mutex;
+  const int thread_num = 8;
+  auto keys = ZipfianKeys(50000, 200000, 1.0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < thread_num; ++t) {
+    threads.emplace_back([&, t]() {
+      for (size_t i = t; i < keys.size(); i += thread_num) {
+        if (index.find(keys[i]) != nullptr) {
+          continue;
+        }
+        std::lock_guard<std::mutex> guard(shard_mutex);
+        if (index.find(keys[i]) == nullptr) {
+          index.insert(keys[i], &shard[keys[i]]);
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(index.size(), shard.size());
+  for (auto it = shard.begin(); it != shard.end(); ++it) {
+    ASSERT_EQ(index.find(it.key()), it.value_ptr());
+  }
+}
+
+TEST(ConcurrentIndexGate, ReclaimWhileReading) {
+  index_type index;
+  shard_type shard;
+  std::mutex shard_mutex;
+  ConcurrentIndexGate gate;
+  const int thread_num = 4;
+  auto keys = ZipfianKeys(50000, 200000, 1.0);
+  std::atomic<bool> stop{false};
+  std::atomic<size_t> found{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < thread_num; ++t) {
+    threads.emplace_back([&, t]() {
+      for (size_t i = t; !stop.load(); i = (i + thread_num) % keys.size()) {
+        // one entry per batch of lookups, like a pull request
+        ConcurrentIndexGate::Entry entry(&gate);
+        for (size_t j = i; j < std::min(i + 64, keys.size()); ++j) {
+          FixedFeatureValue* value = index.find(keys[j]);
+          if (value == nullptr) {
+            std::lock_guard<std::mutex> guard(shard_mutex);
+            value = index.find(keys[j]);
+            if (value == nullptr) {
+              value = index.insert(keys[j], &shard[keys[j]]);
+            }
+          }
+          ASSERT_NE(value, nullptr);
+          found.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+    });
+  }
+  for (int round = 0; round < 50; ++round) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    ConcurrentIndexGate::Drain drain(&gate);
+    // nested drains of the holder do not block
+    ConcurrentIndexGate::Drain nested(&gate);
+    index.reclaim();
+    if (round % 10 == 9) {
+      // rebuild the index from the shard like Shrink and Load do
+      index.clear();
+      for (auto it = shard.begin(); it != shard.end(); ++it) {
+        index.insert(it.key(), it.value_ptr());
+      }
+    }
+  }
+  stop.store(true);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_GT(found.load(), 0UL);
+  ASSERT_EQ(index.size(), shard.size());
+  for (auto it = shard.begin(); it != shard.end(); ++it) {
+    ASSERT_EQ(index.find(it.key()), it.value_ptr());
+  }
+}
+
+TEST(BENCHMARK, ConcurrentShardIndexZipfian) {
+  const size_t value_dim = 16;
+  const size_t op_num = 2000000;
+  const int thread_num = 8;
+  for (double s : {0.8, 1.1}) {
+    auto keys = ZipfianKeys(1000000, op_num, s);
+
+    // current path: every op of a shard runs on its single task thread
+    shard_type shard;
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t key : keys) {
+      auto itr = shard.find(key);
+      if (itr == shard.end()) {
+        shard[key].resize(value_dim);
+        itr = shard.find(key);
+      }
+      itr.value().data()[0] += 1.0;
+    }
+    double shard_seconds = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+
+    // concurrent index: lock-free lookups, striped inserts and updates
+    shard_type index_shard;
+    std::mutex shard_mutex;
+    index_type index;
+    start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_num; ++t) {
+      threads.emplace_back([&, t]() {
+        size_t block = keys.size() / thread_num;
+        for (size_t i = t * block; i < (t + 1) * block; ++i) {
+          uint64_t key = keys[i];
+          FixedFeatureValue* value = index.find(key);
+          if (value == nullptr) {
+            std::lock_guard<std::mutex> guard(shard_mutex);
+            value = index.find(key);
+            if (value == nullptr) {
+              value = &index_shard[key];
+              value->resize(value_dim);
+              index.insert(key, value);
+            }
+          }
+          std::lock_guard<memory::SpinLock> guard(index.value_lock(key));
+          value->data()[0] += 1.0;
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    double index_seconds = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+
+    ASSERT_EQ(index.size(), shard.size());
+    double sum = 0;
+    for (auto it = index_shard.begin(); it != index_shard.end(); ++it) {
+      sum += it.value().data()[0];
+    }
+    ASSERT_DOUBLE_EQ(sum, static_cast<double>(op_num));
+    LOG(INFO) << "zipf s=" << s << " keys=" << shard.size()
+              << " closed_hash_map 1 thread: "
+              << op_num / shard_seconds / 1e6 << " Mops/s"
+              << ", concurrent index " << thread_num
+              << " threads: " << op_num / index_seconds / 1e6 << " Mops/s";
+  }
+}
+
+}  // namespace paddle::distributed
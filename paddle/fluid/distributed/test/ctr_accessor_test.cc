@@ -314,4 +314,108 @@ TEST(downpour_feature_value_accessor_test, test_string_related) {
     ASSERT_FLOAT_EQ(value[i], 0);
   }
 }
+
+TEST(downpour_feature_value_accessor_test, test_quantized_embedx) {
+  TableAccessorParameter parameter = gen_param();
+  parameter.set_embedx_threshold(0);
+  parameter.mutable_embedx_sgd_param()->set_name("StdAdaGradSGDRule");
+  auto* adagrad_param = parameter.mutable_embedx_sgd_param()->mutable_adagrad();
+  adagrad_param->set_learning_rate(0.1);
+  adagrad_param->set_initial_range(0.3);
+  adagrad_param->set_initial_g2sum(0.0);
+  adagrad_param->add_weight_bounds(-10.0);
+  adagrad_param->add_weight_bounds(10.0);
+  CtrCommonAccessor fp32_acc;
+  ASSERT_EQ(fp32_acc.Configure(parameter), 0);
+  ASSERT_EQ(fp32_acc.Initialize(), 0);
+
+  const int embedx_dim = 8;
+  const int item_size = 4;
+  for (auto storage_type : {CtrAccessorParameter::EMBEDX_FP16,
+                            CtrAccessorParameter::EMBEDX_INT8}) {
+    parameter.mutable_ctr_accessor_param()->set_embedx_storage_type(
+        storage_type);
+    parameter.mutable_ctr_accessor_param()->set_quantize_embedx_g2sum(true);
+    CtrCommonAccessor acc;
+    ASSERT_EQ(acc.Configure(parameter), 0);
+    ASSERT_EQ(acc.Initialize(), 0);
+    int packed_dim =
+        storage_type == CtrAccessorParameter::EMBEDX_FP16 ? 4 : 1 + 2;
+    ASSERT_EQ(acc.GetAccessorInfo().dim, 7u + 2 * packed_dim);
+    ASSERT_EQ(acc.GetAccessorInfo().mf_size, 2 * packed_dim * sizeof(float));
+    ASSERT_EQ(acc.GetAccessorInfo().select_dim,
+              fp32_acc.GetAccessorInfo().select_dim);
+    float tolerance =
+        storage_type == CtrAccessorParameter::EMBEDX_FP16 ? 1e-3 : 2e-2;
+
+    std::vector<std::vector<float>> values(
+        item_size, std::vector<float>(acc.GetAccessorInfo().dim));
+    std::vector<std::vector<float>> fp32_values(
+        item_size, std::vector<float>(fp32_acc.GetAccessorInfo().dim));
+    std::vector<std::vector<float>> grads(
+        item_size, std::vector<float>(acc.GetAccessorInfo().update_dim));
+    std::vector<float*> value_ptrs(item_size);
+    std::vector<float*> fp32_value_ptrs(item_size);
+    std::vector<const float*> grad_ptrs(item_size);
+    for (int i = 0; i < item_size; ++i) {
+      value_ptrs[i] = values[i].data();
+      fp32_value_ptrs[i] = fp32_values[i].data();
+      grad_ptrs[i] = grads[i].data();
+      for (size_t j = 0; j < grads[i].size(); ++j) {
+        grads[i][j] = 0.1f * (i + 1) * (j % 2 == 0 ? 1 : -1);
+      }
+      grads[i][CtrCommonAccessor::CtrCommonPushValue::ShowIndex()] = 1;
+    }
+    ASSERT_EQ(acc.Create(value_ptrs.data(), item_size), 0);
+
+    // start the fp32 values from the dequantized ones
+    std::vector<float> embedx(embedx_dim * 2);
+    for (int i = 0; i < item_size; ++i) {
+      int embedx_index = acc.common_feature_value.EmbedxWIndex();
+      memcpy(fp32_values[i].data(),
+             values[i].data(),
+             embedx_index * sizeof(float));
+      acc.LoadEmbedx(values[i].data(), embedx.data(), embedx.data() + 8);
+      memcpy(fp32_values[i].data() + embedx_index,
+             embedx.data(),
+             embedx.size() * sizeof(float));
+      for (int j = 0; j < embedx_dim; ++j) {
+        ASSERT_LE(std::fabs(embedx[j]), 0.3f);
+        ASSERT_FLOAT_EQ(embedx[embedx_dim + j], 0);
+      }
+    }
+    // the last item is pushed twice
+    value_ptrs[item_size - 1] = value_ptrs[0];
+    fp32_value_ptrs[item_size - 1] = fp32_value_ptrs[0];
+    ASSERT_EQ(acc.Update(value_ptrs.data(), grad_ptrs.data(), item_size), 0);
+    ASSERT_EQ(
+        fp32_acc.Update(fp32_value_ptrs.data(), grad_ptrs.data(), item_size),
+        0);
+
+    std::vector<float> pull(acc.GetAccessorInfo().select_dim);
+    std::vector<float> fp32_pull(acc.GetAccessorInfo().select_dim);
+    for (int i = 0; i < item_size - 1; ++i) {
+      const float* value = values[i].data();
+      const float* fp32_value = fp32_values[i].data();
+      float* pull_ptr = pull.data();
+      float* fp32_pull_ptr = fp32_pull.data();
+      acc.Select(&pull_ptr, &value, 1);
+      fp32_acc.Select(&fp32_pull_ptr, &fp32_value, 1);
+      for (size_t j = 0; j < pull.size(); ++j) {
+        ASSERT_NEAR(pull[j], fp32_pull[j], tolerance);
+      }
+
+      // checkpoints hold fp32 text and load back into the packed value
+      std::string str = acc.ParseToString(value, values[i].size());
+      std::vector<float> loaded(acc.GetAccessorInfo().dim);
+      ASSERT_EQ(acc.ParseFromString(str, loaded.data()),
+                static_cast<int>(loaded.size()));
+      const float* loaded_value = loaded.data();
+      acc.Select(&fp32_pull_ptr, &loaded_value, 1);
+      for (size_t j = 0; j < pull.size(); ++j) {
+        ASSERT_NEAR(pull[j], fp32_pull[j], 1e-5);
+      }
+    }
+  }
+}
 }  // namespace paddle::distributed
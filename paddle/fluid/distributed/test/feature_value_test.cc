@@ -14,6 +14,7 @@ limitations under the License. */
 
 #include "paddle/fluid/distributed/ps/table/depends/feature_value.h"
 
+#include <utility>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -45,4 +46,102 @@ TEST(BENCHMARK, LargeScaleKV) {
   ASSERT_FLOAT_EQ(value_data[3], 0.3);
 }
 
+TEST(BENCHMARK, LargeScaleKVWithArena) {
+  typedef SparseTableShard<uint64_t, FixedFeatureValue> shard_type;
+  shard_type shard;
+  const size_t base_dim = 5;
+  const size_t mf_dim = 13;
+  shard.enable_value_arena(base_dim);
+  ASSERT_TRUE(shard.value_arena() != nullptr);
+
+  for (uint64_t key = 0; key < 1000; ++key) {
+    auto& feature_value = shard[key];
+    feature_value.resize(base_dim);
+    for (size_t i = 0; i < base_dim; ++i) {
+      feature_value.data()[i] = key + i * 0.1;
+    }
+    if (key % 2 == 0) {
+      feature_value.resize(mf_dim);
+      ASSERT_FLOAT_EQ(feature_value.data()[base_dim], 0.0);
+    }
+  }
+  // a header block holds 4 + 5 floats, the grown values spill 13 floats
+  ASSERT_EQ(shard.value_arena()->used_bytes(),
+            1000 * 10 * sizeof(float) + 500 * 14 * sizeof(float));
+  ASSERT_EQ(shard.find(1).value().data(),
+            reinterpret_cast<float*>(shard.find(1).value_ptr() + 1));
+
+  for (uint64_t key = 0; key < 1000; ++key) {
+    if (key % 10 != 0) {
+      shard.erase(key);
+    }
+  }
+  ASSERT_EQ(shard.size(), 100UL);
+  size_t reserved = shard.value_arena()->reserved_bytes();
+  ASSERT_EQ(shard.compact_values(1.0), 0UL);
+  ASSERT_GT(shard.compact_values(0.1), 0UL);
+  ASSERT_LT(shard.value_arena()->reserved_bytes(), reserved);
+
+  // the compacted values hold all of their 13 floats inline
+  ASSERT_EQ(shard.value_arena()->used_bytes(), 100 * 18 * sizeof(float));
+  for (uint64_t key = 0; key < 1000; key += 10) {
+    auto itr = shard.find(key);
+    ASSERT_TRUE(itr != shard.end());
+    ASSERT_EQ(itr.value().size(), mf_dim);
+    ASSERT_EQ(itr.value().data(),
+              reinterpret_cast<float*>(itr.value_ptr() + 1));
+    for (size_t i = 0; i < base_dim; ++i) {
+      ASSERT_FLOAT_EQ(itr.value().data()[i], key + i * 0.1);
+    }
+  }
+}
+
+TEST(FixedFeatureValue, DirtyBit) {
+  typedef SparseTableShard<uint64_t, FixedFeatureValue> shard_type;
+  shard_type shard;
+  shard.enable_value_arena();
+  auto& feature_value = shard[1];
+  ASSERT_TRUE(feature_value.dirty());
+  feature_value.resize(4);
+  feature_value.set_dirty(false);
+  // growing and moving the data keeps the bit of the key
+  feature_value.resize(16);
+  ASSERT_FALSE(feature_value.dirty());
+  shard[2].resize(4);
+  shard.erase(2);
+  ASSERT_GT(shard.compact_values(0.0), 0UL);
+  ASSERT_FALSE(shard.find(1).value().dirty());
+  ASSERT_EQ(shard.find(1).value().size(), 16UL);
+}
+
+TEST(FixedFeatureValue, CopyAndMoveOwnData) {
+  typedef SparseTableShard<uint64_t, FixedFeatureValue> shard_type;
+  shard_type shard;
+  shard.enable_value_arena(2);
+  auto& in_arena = shard[1];
+  in_arena.resize(8);
+  for (size_t i = 0; i < 8; ++i) {
+    in_arena.data()[i] = i;
+  }
+  FixedFeatureValue copied(in_arena);
+  FixedFeatureValue moved(std::move(in_arena));
+  shard.erase(1);
+  ASSERT_EQ(shard.value_arena()->used_bytes(), 0UL);
+  ASSERT_EQ(copied.size(), 8UL);
+  ASSERT_EQ(moved.size(), 8UL);
+  for (size_t i = 0; i < 8; ++i) {
+    ASSERT_FLOAT_EQ(copied.data()[i], i);
+    ASSERT_FLOAT_EQ(moved.data()[i], i);
+  }
+
+  // a heap value moves its data, an arena value copies it in
+  float* data = moved.data();
+  FixedFeatureValue heap(std::move(moved));
+  ASSERT_EQ(heap.data(), data);
+  auto& target = shard[2];
+  target = std::move(heap);
+  ASSERT_NE(target.data(), data);
+  ASSERT_FLOAT_EQ(target.data()[7], 7);
+}
+
 }  // namespace paddle::distributed
@@ -0,0 +1,323 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/distributed/ps/table/graph/graph_csr.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "paddle/common/flags.h"
+#include "paddle/fluid/distributed/ps/table/common_graph_table.h"
+
+COMMON_DECLARE_bool(graph_csr_storage);
+
+namespace paddle::distributed {
+
+namespace {
+
+// node i has the neighbors 100 * i + j, j < i, with weight j + 1
+std::vector<Node *> MakeGraphNodes(int num, bool weighted) {
+  std::vector<Node *> nodes;
+  for (int i = 0; i < num; ++i) {
+    auto *node = new GraphNode(i);
+    node->build_edges(weighted);
+    for (int j = 0; j < i; ++j) {
+      node->add_edge(100 * i + j, weighted ? j + 1 : 1);
+    }
+    nodes.push_back(node);
+  }
+  return nodes;
+}
+
+void DeleteNodes(std::vector<Node *> *nodes) {
+  for (auto *node : *nodes) {
+    delete node;
+  }
+  nodes->clear();
+}
+
+}  // namespace
+
+TEST(GraphCsrStorage, Neighbors) {
+  auto nodes = MakeGraphNodes(10, false);
+  GraphCsrStorage csr;
+  ASSERT_TRUE(csr.build(nodes));
+  ASSERT_EQ(csr.size(), 10UL);
+  ASSERT_FALSE(csr.is_weighted());
+  ASSERT_EQ(csr.get_neighbor_ids().size(), 45UL);
+  auto rng = std::make_shared<std::mt19937_64>(0);
+  for (size_t i = 0; i < csr.size(); ++i) {
+    ASSERT_EQ(csr.get_id(i), i);
+    ASSERT_EQ(csr.get_neighbor_size(i), i);
+    for (size_t j = 0; j < i; ++j) {
+      ASSERT_EQ(csr.get_neighbor_id(i, j), 100 * i + j);
+      ASSERT_EQ(csr.get_neighbor_weight(i, j), 1.0);
+    }
+    auto res = csr.sample_k(i, 4, rng);
+    ASSERT_EQ(res.size(), std::min<size_t>(i, 4));
+    std::set<int> distinct(res.begin(), res.end());
+    ASSERT_EQ(distinct.size(), res.size());
+    for (int x : res) {
+      ASSERT_LT(x, static_cast<int>(i));
+    }
+  }
+
+  auto restored = csr.to_nodes();
+  ASSERT_EQ(restored.size(), nodes.size());
+  for (size_t i = 0; i < restored.size(); ++i) {
+    ASSERT_EQ(restored[i]->get_id(), nodes[i]->get_id());
+    ASSERT_EQ(restored[i]->get_neighbor_size(), i);
+    for (size_t j = 0; j < i; ++j) {
+      ASSERT_EQ(restored[i]->get_neighbor_id(j), nodes[i]->get_neighbor_id(j));
+    }
+  }
+  DeleteNodes(&restored);
+  DeleteNodes(&nodes);
+}
+
+TEST(GraphCsrStorage, WeightedSample) {
+  auto nodes = MakeGraphNodes(5, true);
+  GraphCsrStorage csr;
+  ASSERT_TRUE(csr.build(nodes, "weighted"));
+  ASSERT_TRUE(csr.is_weighted());
+  ASSERT_EQ(csr.get_neighbor_weight(4, 3), 4.0);
+  // node 4 has the weights 1, 2, 3, 4, the heaviest is drawn 4 times out of
+  // 10 when sampling one neighbor
+  auto rng = std::make_shared<std::mt19937_64>(0);
+  std::map<int, int> count;
+  const int kTimes = 20000;
+  for (int t = 0; t < kTimes; ++t) {
+    auto res = csr.sample_k(4, 1, rng);
+    ASSERT_EQ(res.size(), 1UL);
+    ++count[res[0]];
+  }
+  for (int j = 0; j < 4; ++j) {
+    ASSERT_NEAR(count[j] * 1.0 / kTimes, (j + 1) / 10.0, 0.02);
+  }
+  auto res = csr.sample_k(4, 3, rng);
+  ASSERT_EQ(std::set<int>(res.begin(), res.end()).size(), 3UL);
+
+  // the random sampler ignores the weights
+  csr.set_sample_type("random");
+  count.clear();
+  for (int t = 0; t < kTimes; ++t) {
+    ++count[csr.sample_k(4, 1, rng)[0]];
+  }
+  for (int j = 0; j < 4; ++j) {
+    ASSERT_NEAR(count[j] * 1.0 / kTimes, 0.25, 0.02);
+  }
+  DeleteNodes(&nodes);
+}
+
+TEST(GraphShard, SampleAfterReleaseCsr) {
+  GraphShard shard;
+  for (uint64_t i = 0; i < 10; ++i) {
+    shard.add_graph_node(i)->build_edges(false);
+    for (uint64_t j = 0; j < i; ++j) {
+      shard.add_neighbor(i, 100 * i + j, 1.0);
+    }
+  }
+  ASSERT_TRUE(shard.build_csr());
+  ASSERT_TRUE(shard.is_csr());
+  // adding a node releases the csr storage, the restored nodes keep
+  // sampling
+  shard.add_graph_node(10)->build_edges(false);
+  ASSERT_FALSE(shard.is_csr());
+  auto rng = std::make_shared<std::mt19937_64>(0);
+  for (uint64_t i = 0; i < 10; ++i) {
+    Node *node = shard.find_node(i);
+    ASSERT_TRUE(node != nullptr);
+    auto res = node->sample_k(4, rng);
+    ASSERT_EQ(res.size(), std::min<size_t>(i, 4));
+    for (int x : res) {
+      ASSERT_EQ(node->get_neighbor_id(x) / 100, i);
+    }
+  }
+}
+
+TEST(GraphCsrStorage, Features) {
+  std::vector<Node *> nodes;
+  for (uint64_t i = 0; i < 4; ++i) {
+    auto *node = new FeatureNode(i);
+    node->set_feature_size(i % 2 + 1);
+    std::vector<uint64_t> feas = {i, i + 10};
+    node->set_feature(0,
+                      std::string(reinterpret_cast<char *>(feas.data()),
+                                  feas.size() * sizeof(uint64_t)));
+    if (i % 2) {
+      node->set_feature(1, "text" + std::to_string(i));
+    }
+    nodes.push_back(node);
+  }
+  GraphCsrStorage csr;
+  ASSERT_TRUE(csr.build(nodes));
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    ASSERT_EQ(csr.get_feature_size(i), nodes[i]->get_feature_size());
+    ASSERT_EQ(csr.get_neighbor_size(i), 0UL);
+    for (int f = 0; f < 3; ++f) {
+      ASSERT_EQ(csr.get_feature(i, f), nodes[i]->get_feature(f));
+    }
+  }
+  std::vector<uint64_t> ids;
+  csr.get_feature_ids(2, &ids);
+  ASSERT_EQ(ids, std::vector<uint64_t>({2, 12}));
+
+  // pull_graph_list gets the bytes of FeatureNode::to_buffer
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    for (bool need_feature : {false, true}) {
+      int size = nodes[i]->get_size(need_feature);
+      ASSERT_EQ(csr.get_buffer_size(i, need_feature), size);
+      std::vector<char> expected(size), actual(size);
+      nodes[i]->to_buffer(expected.data(), need_feature);
+      csr.to_buffer(i, actual.data(), need_feature);
+      ASSERT_EQ(actual, expected);
+    }
+  }
+
+  auto restored = csr.to_nodes();
+  for (size_t i = 0; i < restored.size(); ++i) {
+    ASSERT_EQ(restored[i]->get_feature(0), nodes[i]->get_feature(0));
+    ASSERT_EQ(restored[i]->get_feature(1), nodes[i]->get_feature(1));
+  }
+  DeleteNodes(&restored);
+
+  // float features are not supported
+  nodes.push_back(new FloatFeatureNode(4));
+  ASSERT_FALSE(csr.build(nodes));
+  ASSERT_EQ(csr.size(), 0UL);
+  DeleteNodes(&nodes);
+}
+
+TEST(GraphTable, PullAndSampleCsr) {
+  FLAGS_graph_csr_storage = true;
+  const char *path = "graph_csr_test_edges.txt";
+  {
+    // node i has the neighbors 100 * i + j, j <= i % 5
+    std::ofstream file(path);
+    for (uint64_t i = 0; i < 20; ++i) {
+      for (uint64_t j = 0; j <= i % 5; ++j) {
+        file << i << "\t" << 100 * i + j << std::endl;
+      }
+    }
+  }
+  GraphParameter param;
+  param.set_task_pool_size(4);
+  param.set_shard_num(8);
+  param.add_edge_types("u2u");
+  param.add_node_types("u");
+  param.add_graph_feature();
+  GraphTable table;
+  ASSERT_EQ(table.Initialize(param), 0);
+  table.load_edges(path, false, "u2u");
+  auto all_csr = [&]() {
+    for (auto *shard : table.edge_shards[0]) {
+      if (!shard->is_csr()) {
+        return false;
+      }
+    }
+    return true;
+  };
+  ASSERT_TRUE(all_csr());
+
+  int node_size = Node::id_size + Node::int_size;
+  std::unique_ptr<char[]> buffer;
+  int actual_size = 0;
+  ASSERT_EQ(table.pull_graph_list(GraphTableType::EDGE_TABLE,
+                                  0,
+                                  0,
+                                  100,
+                                  buffer,
+                                  actual_size,
+                                  true,
+                                  1),
+            0);
+  ASSERT_EQ(actual_size, 20 * node_size);
+  std::set<uint64_t> ids;
+  for (int i = 0; i < 20; ++i) {
+    uint64_t id = 0;
+    int feat_num = -1;
+    memcpy(&id, buffer.get() + i * node_size, Node::id_size);
+    memcpy(&feat_num,
+           buffer.get() + i * node_size + Node::id_size,
+           Node::int_size);
+    ids.insert(id);
+    ASSERT_EQ(feat_num, 0);
+  }
+  ASSERT_EQ(ids.size(), 20UL);
+  ASSERT_EQ(*ids.rbegin(), 19UL);
+  std::vector<char> csr_list(buffer.get(), buffer.get() + actual_size);
+  // every second node from the second one
+  ASSERT_EQ(table.pull_graph_list(GraphTableType::EDGE_TABLE,
+                                  0,
+                                  1,
+                                  100,
+                                  buffer,
+                                  actual_size,
+                                  false,
+                                  2),
+            0);
+  ASSERT_EQ(actual_size, 10 * node_size);
+
+  std::vector<uint64_t> node_ids;
+  for (uint64_t i = 0; i < 20; ++i) {
+    node_ids.push_back(i);
+  }
+  node_ids.push_back(1000);
+  std::vector<std::shared_ptr<char>> buffers(node_ids.size());
+  std::vector<int> actual_sizes(node_ids.size());
+  ASSERT_EQ(table.random_sample_neighbors(
+                0, node_ids.data(), 3, buffers, actual_sizes, false),
+            0);
+  for (uint64_t i = 0; i < 20; ++i) {
+    size_t num = std::min<size_t>(3, i % 5 + 1);
+    ASSERT_EQ(actual_sizes[i], static_cast<int>(num * Node::id_size));
+    std::set<uint64_t> neighbors;
+    for (size_t j = 0; j < num; ++j) {
+      uint64_t id = 0;
+      memcpy(&id, buffers[i].get() + j * Node::id_size, Node::id_size);
+      ASSERT_EQ(id / 100, i);
+      neighbors.insert(id);
+    }
+    ASSERT_EQ(neighbors.size(), num);
+  }
+  ASSERT_EQ(actual_sizes[20], 0);
+  // the queries read the csr storage in place
+  ASSERT_TRUE(all_csr());
+
+  // and return the same nodes as the node storage
+  table.release_csr(GraphTableType::EDGE_TABLE, 0);
+  ASSERT_FALSE(table.edge_shards[0][0]->is_csr());
+  ASSERT_EQ(table.pull_graph_list(GraphTableType::EDGE_TABLE,
+                                  0,
+                                  0,
+                                  100,
+                                  buffer,
+                                  actual_size,
+                                  true,
+                                  1),
+            0);
+  ASSERT_EQ(std::vector<char>(buffer.get(), buffer.get() + actual_size),
+            csr_list);
+  FLAGS_graph_csr_storage = false;
+  std::remove(path);
+}
+
+}  // namespace paddle::distributed
@@ -0,0 +1,204 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/distributed/ps/table/graph/graph_sample_cache.h"
+
+#include <cstring>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace paddle {
+namespace distributed {
+
+namespace {
+
+// a result of `n` ids, all equal to `node_key`
+SampleResult MakeResult(uint64_t node_key, size_t n) {
+  char *buffer = new char[n * sizeof(uint64_t)];
+  for (size_t i = 0; i < n; ++i) {
+    memcpy(buffer + i * sizeof(uint64_t), &node_key, sizeof(uint64_t));
+  }
+  return SampleResult(n * sizeof(uint64_t), buffer);
+}
+
+bool CheckResult(const std::pair<SampleKey, SampleResult> &res) {
+  const SampleResult &result = res.second;
+  if (result.actual_size != res.first.sample_size * sizeof(uint64_t)) {
+    return false;
+  }
+  for (size_t i = 0; i < res.first.sample_size; ++i) {
+    uint64_t id;
+    memcpy(&id, result.buffer.get() + i * sizeof(uint64_t), sizeof(id));
+    if (id != res.first.node_key) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void Insert(NeighborSampleCache *cache, uint64_t node_key, size_t n) {
+  SampleKey key(0, node_key, n, false);
+  SampleResult result = MakeResult(node_key, n);
+  cache->insert(0, &key, &result, 1);
+}
+
+bool Query(NeighborSampleCache *cache, uint64_t node_key, size_t n) {
+  SampleKey key(0, node_key, n, false);
+  std::vector<std::pair<SampleKey, SampleResult>> res;
+  cache->query(0, &key, 1, &res);
+  return !res.empty() && CheckResult(res[0]);
+}
+
+}  // namespace
+
+TEST(NeighborSampleCache, QueryAndTtl) {
+  NeighborSampleCache cache(1, 64, 3, 128);
+  Insert(&cache, 1, 4);
+  Insert(&cache, 2, 16);
+  // larger than a slot
+  Insert(&cache, 3, 17);
+  ASSERT_FALSE(Query(&cache, 1, 5));
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_TRUE(Query(&cache, 1, 4));
+    ASSERT_TRUE(Query(&cache, 2, 16));
+  }
+  ASSERT_FALSE(Query(&cache, 1, 4));
+  ASSERT_FALSE(Query(&cache, 3, 17));
+  // the expired slot is reused
+  Insert(&cache, 1, 4);
+  ASSERT_TRUE(Query(&cache, 1, 4));
+
+  auto stats = cache.get_stats();
+  ASSERT_EQ(stats.hits, 7UL);
+  ASSERT_EQ(stats.misses, 3UL);
+  ASSERT_EQ(stats.expirations, 1UL);
+  ASSERT_EQ(stats.insertions, 3UL);
+  ASSERT_EQ(stats.rejections, 1UL);
+  ASSERT_EQ(stats.size, 2UL);
+  ASSERT_EQ(stats.capacity, 64UL);
+
+  // results in the order of the keys
+  Insert(&cache, 2, 16);
+  std::vector<SampleKey> keys = {SampleKey(0, 2, 16, false),
+                                 SampleKey(0, 5, 16, false),
+                                 SampleKey(0, 1, 4, false)};
+  std::vector<std::pair<SampleKey, SampleResult>> res;
+  cache.query(0, keys.data(), keys.size(), &res);
+  ASSERT_EQ(res.size(), 2UL);
+  ASSERT_EQ(res[0].first.node_key, 2UL);
+  ASSERT_EQ(res[1].first.node_key, 1UL);
+
+  cache.clear();
+  ASSERT_FALSE(Query(&cache, 1, 4));
+  ASSERT_EQ(cache.get_stats().size, 0UL);
+}
+
+TEST(NeighborSampleCache, FrequencyAdmission) {
+  // one set of 8 slots, no ttl
+  NeighborSampleCache cache(1, 8, 0, 64);
+  for (uint64_t key = 0; key < 8; ++key) {
+    Insert(&cache, key, 1);
+  }
+  // keys 0..7 are popular
+  for (int round = 0; round < 4; ++round) {
+    for (uint64_t key = 0; key < 8; ++key) {
+      ASSERT_TRUE(Query(&cache, key, 1));
+    }
+  }
+  // a scan of keys seen once does not flush them
+  for (uint64_t key = 100; key < 200; ++key) {
+    ASSERT_FALSE(Query(&cache, key, 1));
+    Insert(&cache, key, 1);
+  }
+  for (uint64_t key = 0; key < 8; ++key) {
+    ASSERT_TRUE(Query(&cache, key, 1));
+  }
+  auto stats = cache.get_stats();
+  ASSERT_EQ(stats.rejections, 100UL);
+  ASSERT_EQ(stats.evictions, 0UL);
+
+  // a key looked up more often than the residents replaces one of them
+  for (int i = 0; i < 20; ++i) {
+    Query(&cache, 1000, 1);
+  }
+  Insert(&cache, 1000, 1);
+  ASSERT_TRUE(Query(&cache, 1000, 1));
+  ASSERT_EQ(cache.get_stats().evictions, 1UL);
+}
+
+TEST(NeighborSampleCache, ConcurrentTtl) {
+  // racing lookups share the ttl uses of one entry, none is lost or doubled
+  NeighborSampleCache cache(1, 64, 100, 64);
+  const int kThreads = 4;
+  for (int round = 0; round < 20; ++round) {
+    Insert(&cache, 1, 4);
+    std::vector<std::thread> threads;
+    std::vector<int> hits(kThreads, 0);
+    for (int t = 0; t < kThreads; ++t) {
+      threads.emplace_back([&cache, &hits, t]() {
+        for (int i = 0; i < 100; ++i) {
+          hits[t] += Query(&cache, 1, 4);
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    int total = 0;
+    for (int t = 0; t < kThreads; ++t) {
+      total += hits[t];
+    }
+    ASSERT_EQ(total, 100);
+  }
+}
+
+TEST(NeighborSampleCache, Concurrent) {
+  NeighborSampleCache cache(2, 256, 0, 64);
+  const int kThreads = 4;
+  std::vector<std::thread> threads;
+  std::vector<int> bad(kThreads, 0);
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&cache, &bad, t]() {
+      std::vector<std::pair<SampleKey, SampleResult>> res;
+      for (int i = 0; i < 20000; ++i) {
+        uint64_t node_key = (i * 7 + t) % 1024;
+        size_t n = node_key % 8 + 1;
+        size_t index = node_key % 2;
+        SampleKey key(0, node_key, n, false);
+        res.clear();
+        cache.query(index, &key, 1, &res);
+        if (res.empty()) {
+          SampleResult result = MakeResult(node_key, n);
+          cache.insert(index, &key, &result, 1);
+        } else if (!CheckResult(res[0])) {
+          ++bad[t];
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (int t = 0; t < kThreads; ++t) {
+    ASSERT_EQ(bad[t], 0);
+  }
+  auto stats = cache.get_stats();
+  ASSERT_EQ(stats.hits + stats.misses, 80000UL);
+  ASSERT_GT(stats.hits, 0UL);
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,200 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/distributed/ps/table/graph/graph_weighted_sampler.h"
+
+#include <chrono>  // NOLINT
+#include <cmath>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+namespace paddle {
+namespace distributed {
+
+namespace {
+
+std::unique_ptr<WeightedGraphEdgeBlob> MakeEdges(
+    const std::vector<float> &weights) {
+  std::unique_ptr<WeightedGraphEdgeBlob> edges(new WeightedGraphEdgeBlob());
+  for (size_t i = 0; i < weights.size(); ++i) {
+    edges->add_edge(i, weights[i]);
+  }
+  return edges;
+}
+
+// The frequency of each edge over `times` draws of k edges, against the exact
+// inclusion probability of sequential weighted draws without replacement.
+void CheckSampleK(Sampler *sampler,
+                  const std::vector<float> &weights,
+                  int k,
+                  int times) {
+  int n = weights.size();
+  auto rng = std::make_shared<std::mt19937_64>(2024);
+  std::vector<int> count(n, 0);
+  for (int t = 0; t < times; ++t) {
+    auto res = sampler->sample_k(k, rng);
+    ASSERT_EQ(static_cast<int>(res.size()), std::min(k, n));
+    std::set<int> distinct(res.begin(), res.end());
+    ASSERT_EQ(distinct.size(), res.size());
+    for (int x : res) {
+      ASSERT_GE(x, 0);
+      ASSERT_LT(x, n);
+      ++count[x];
+    }
+  }
+  if (k != 2) {
+    return;
+  }
+  // P(i in sample) = p_i + sum_{j != i} p_j * w_i / (W - w_j)
+  double total = 0;
+  for (float w : weights) {
+    total += w;
+  }
+  for (int i = 0; i < n; ++i) {
+    double expected = weights[i] / total;
+    for (int j = 0; j < n; ++j) {
+      if (j != i) {
+        expected += weights[j] / total * weights[i] / (total - weights[j]);
+      }
+    }
+    EXPECT_NEAR(count[i] * 1.0 / times, expected, 0.01) << "edge " << i;
+  }
+}
+
+}  // namespace
+
+TEST(AliasSampler, Sample) {
+  std::vector<float> weights = {0.5, 1, 4, 0.25, 2, 8, 1, 0.25};
+  auto edges = MakeEdges(weights);
+  AliasSampler sampler;
+  sampler.build(edges.get());
+
+  std::mt19937_64 engine(2024);
+  std::vector<int> count(weights.size(), 0);
+  const int kTimes = 100000;
+  for (int t = 0; t < kTimes; ++t) {
+    ++count[sampler.sample(&engine)];
+  }
+  for (size_t i = 0; i < weights.size(); ++i) {
+    EXPECT_NEAR(count[i] * 1.0 / kTimes, weights[i] / 17, 0.005);
+  }
+
+  // rejection and exponential keys
+  CheckSampleK(&sampler, weights, 2, 100000);
+  CheckSampleK(&sampler, weights, 5, 1000);
+  CheckSampleK(&sampler, weights, 8, 10);
+  WeightedSampler tree;
+  tree.build(edges.get());
+  CheckSampleK(&tree, weights, 2, 100000);
+}
+
+TEST(AliasSampler, SkewedWeights) {
+  // the first edge is drawn again and again, so most rejections run out of
+  // budget after the first pick and the keys complete the sample
+  std::vector<float> weights = {1000, 1, 2, 4, 8, 1, 2, 4, 8};
+  auto edges = MakeEdges(weights);
+  AliasSampler sampler;
+  sampler.build(edges.get());
+  CheckSampleK(&sampler, weights, 2, 100000);
+
+  // the second pick follows the small weights, 1 / 30 ... 8 / 30
+  auto rng = std::make_shared<std::mt19937_64>(7);
+  std::vector<int> count(weights.size(), 0);
+  int times = 0;
+  for (int t = 0; t < 100000; ++t) {
+    auto res = sampler.sample_k(2, rng);
+    if (res[0] == 0) {
+      ++count[res[1]];
+      ++times;
+    }
+  }
+  ASSERT_GT(times, 90000);
+  ASSERT_EQ(count[0], 0);
+  for (size_t i = 1; i < weights.size(); ++i) {
+    EXPECT_NEAR(count[i] * 1.0 / times, weights[i] / 30, 0.005) << "edge " << i;
+  }
+}
+
+TEST(AliasSampler, ZeroWeights) {
+  auto edges = MakeEdges({0, 3, 0, 1});
+  AliasSampler sampler;
+  sampler.build(edges.get());
+  auto rng = std::make_shared<std::mt19937_64>(0);
+  for (int t = 0; t < 100; ++t) {
+    auto res = sampler.sample_k(2, rng);
+    ASSERT_EQ(std::set<int>(res.begin(), res.end()), std::set<int>({1, 3}));
+    // the zero weight edges come last
+    res = sampler.sample_k(3, rng);
+    ASSERT_EQ(res.size(), 3UL);
+    ASSERT_EQ(std::set<int>(res.begin(), res.begin() + 2),
+              std::set<int>({1, 3}));
+  }
+  auto empty = MakeEdges({});
+  sampler.build(empty.get());
+  ASSERT_TRUE(sampler.sample_k(3, rng).empty());
+}
+
+TEST(BENCHMARK, weighted_sample_power_law) {
+  // degrees follow a power law of exponent 1.5, from 1 to 100000
+  std::mt19937_64 engine(2024);
+  std::uniform_real_distribution<double> uniform(0, 1.0);
+  std::vector<std::unique_ptr<WeightedGraphEdgeBlob>> edges;
+  size_t edge_num = 0;
+  for (int i = 0; i < 2000; ++i) {
+    int degree = std::min(100000.0, std::pow(1 - uniform(engine), -2));
+    std::vector<float> weights(degree);
+    for (auto &w : weights) {
+      w = uniform(engine) * 10;
+    }
+    edges.push_back(MakeEdges(weights));
+    edge_num += degree;
+  }
+  auto rng = std::make_shared<std::mt19937_64>(2024);
+  for (int k : {5, 25}) {
+    double seconds[2] = {0, 0};
+    for (int s = 0; s < 2; ++s) {
+      std::vector<std::unique_ptr<Sampler>> samplers;
+      for (auto &blob : edges) {
+        samplers.emplace_back(s == 0 ? static_cast<Sampler *>(
+                                           new WeightedSampler())
+                                     : new AliasSampler());
+        samplers.back()->build(blob.get());
+      }
+      auto start = std::chrono::steady_clock::now();
+      size_t sampled = 0;
+      for (int round = 0; round < 20; ++round) {
+        for (auto &sampler : samplers) {
+          sampled += sampler->sample_k(k, rng).size();
+        }
+      }
+      seconds[s] =
+          std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                        start)
+              .count();
+      ASSERT_GT(sampled, 0UL);
+    }
+    LOG(INFO) << edges.size() << " nodes, " << edge_num
+              << " edges, sample_k(" << k
+              << ") tree: " << 20 * edges.size() / seconds[0] / 1e3
+              << " Knodes/s, alias: "
+              << 20 * edges.size() / seconds[1] / 1e3 << " Knodes/s";
+  }
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -17,27 +17,30 @@ limitations under the License. */
 #include <ThreadPool.h>
 #include <unistd.h>
 
+#include <atomic>
+#include <cstdlib>
+#include <memory>
 #include <string>
 #include <thread>  // NOLINT
+#include <vector>
 
 #include "google/protobuf/text_format.h"
 #include "gtest/gtest.h"
 #include "paddle/fluid/distributed/ps/table/table.h"
 #include "paddle/fluid/distributed/the_one_ps.pb.h"
 
+PD_DECLARE_bool(pserver_sparse_table_save_snapshot);
+PD_DECLARE_bool(pserver_sparse_concurrent_index);
+PD_DECLARE_bool(pserver_sparse_table_delta_save);
+
 namespace paddle {
 namespace distributed {
 
-TEST(MemorySparseTable, SGD) {
-  int emb_dim = 8;
-  int trainers = 2;
-
+// a CtrCommonAccessor table with naive sgd rules and 8 dim embedx
+TableParameter CtrTableConfig() {
   TableParameter table_config;
   table_config.set_table_class("MemorySparseTable");
   table_config.set_shard_num(10);
-  FsClientParameter fs_config;
-  Table *table = new MemorySparseTable();
-  table->SetShard(0, 1);
 
   TableAccessorParameter *accessor_config = table_config.mutable_accessor();
   accessor_config->set_accessor_class("CtrCommonAccessor");
@@ -66,6 +69,17 @@ TEST(MemorySparseTable, SGD) {
   naive_param->set_initial_range(0.3);
   naive_param->add_weight_bounds(-10.0);
   naive_param->add_weight_bounds(10.0);
+  return table_config;
+}
+
+TEST(MemorySparseTable, SGD) {
+  int emb_dim = 8;
+  int trainers = 2;
+
+  TableParameter table_config = CtrTableConfig();
+  FsClientParameter fs_config;
+  Table *table = new MemorySparseTable();
+  table->SetShard(0, 1);
 
   auto ret = table->Initialize(table_config, fs_config);
   ASSERT_EQ(ret, 0);
@@ -152,5 +166,173 @@ TEST(MemorySparseTable, SGD) {
   }
 }
 
+
+TEST(MemorySparseTable, LoadSnapshotIntoPopulatedTable) {
+  const int emb_dim = 8;
+  const size_t select_dim = emb_dim + 3;
+  TableParameter table_config = CtrTableConfig();
+  FsClientParameter fs_config;
+  std::unique_ptr<Table> table(new MemorySparseTable());
+  table->SetShard(0, 1);
+  ASSERT_EQ(table->Initialize(table_config, fs_config), 0);
+
+  std::vector<uint64_t> keys;
+  for (uint64_t key = 0; key < 100; ++key) {
+    keys.push_back(key);
+  }
+  std::vector<uint32_t> fres(keys.size(), 1);
+  auto pull_value = PullSparseValue(keys, fres, emb_dim);
+  auto pull = [&](std::vector<float> *values) {
+    values->assign(keys.size() * select_dim, 0.0);
+    TableContext context;
+    context.value_type = Sparse;
+    context.pull_context.pull_value = pull_value;
+    context.pull_context.values = values->data();
+    table->Pull(context);
+  };
+  std::vector<float> saved_values;
+  pull(&saved_values);
+
+  FLAGS_pserver_sparse_table_save_snapshot = true;
+  const std::string model_dir = "memory_sparse_table_snapshot_test";
+  ASSERT_EQ(table->Save(model_dir, "0"), 0);
+  FLAGS_pserver_sparse_table_save_snapshot = false;
+
+  // change every saved value before loading the snapshot back
+  std::vector<float> gradients;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    for (int k = 0; k < emb_dim + 4; ++k) {
+      gradients.push_back(0.5);
+    }
+  }
+  TableContext push_context;
+  push_context.value_type = Sparse;
+  push_context.push_context.keys = keys.data();
+  push_context.push_context.values = gradients.data();
+  push_context.num = keys.size();
+  table->Push(push_context);
+  std::vector<float> pushed_values;
+  pull(&pushed_values);
+  ASSERT_NE(pushed_values, saved_values);
+
+  ASSERT_EQ(table->Load(model_dir, "0"), 0);
+  std::vector<float> loaded_values;
+  pull(&loaded_values);
+  for (size_t i = 0; i < loaded_values.size(); ++i) {
+    ASSERT_FLOAT_EQ(loaded_values[i], saved_values[i]) << "index " << i;
+  }
+  ASSERT_EQ(system(("rm -rf " + model_dir).c_str()), 0);
+}
+
+TEST(MemorySparseTable, ConcurrentIndexPullDuringSaveAndShrink) {
+  const int emb_dim = 8;
+  const size_t select_dim = emb_dim + 3;
+  FLAGS_pserver_sparse_concurrent_index = true;
+  TableParameter table_config = CtrTableConfig();
+  FsClientParameter fs_config;
+  std::unique_ptr<Table> table(new MemorySparseTable());
+  table->SetShard(0, 1);
+  ASSERT_EQ(table->Initialize(table_config, fs_config), 0);
+  FLAGS_pserver_sparse_concurrent_index = false;
+
+  // every pull also creates new keys, so the indexes keep growing while
+  // the table is saved, shrunk and flushed
+  const int thread_num = 4;
+  const uint64_t batch = 512;
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> pulled{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < thread_num; ++t) {
+    threads.emplace_back([&, t]() {
+      for (uint64_t round = 0; !stop.load(); ++round) {
+        std::vector<uint64_t> keys;
+        for (uint64_t i = 0; i < batch; ++i) {
+          keys.push_back(((round * thread_num + t) * batch / 2 + i) %
+                         (1 << 20));
+        }
+        std::vector<uint32_t> fres(keys.size(), 1);
+        auto pull_value = PullSparseValue(keys, fres, emb_dim);
+        std::vector<float> values(keys.size() * select_dim, 0.0);
+        TableContext context;
+        context.value_type = Sparse;
+        context.pull_context.pull_value = pull_value;
+        context.pull_context.values = values.data();
+        ASSERT_EQ(table->Pull(context), 0);
+        pulled.fetch_add(keys.size());
+      }
+    });
+  }
+
+  const std::string model_dir = "memory_sparse_table_concurrent_test";
+  for (int round = 0; round < 3; ++round) {
+    ASSERT_EQ(table->Save(model_dir, "0"), 0);
+    ASSERT_EQ(table->Shrink(""), 0);
+    ASSERT_EQ(table->Flush(), 0);
+  }
+  stop.store(true);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  ASSERT_GT(pulled.load(), 0UL);
+  ASSERT_GT(dynamic_cast<MemorySparseTable *>(table.get())->LocalSize(), 0);
+  ASSERT_EQ(system(("rm -rf " + model_dir).c_str()), 0);
+}
+
+TEST(MemorySparseTable, DeltaSaveKeepsBaseParts) {
+  const int emb_dim = 8;
+  const size_t select_dim = emb_dim + 3;
+  FLAGS_pserver_sparse_table_delta_save = true;
+  TableParameter table_config = CtrTableConfig();
+  FsClientParameter fs_config;
+  std::unique_ptr<Table> table(new MemorySparseTable());
+  table->SetShard(0, 1);
+  ASSERT_EQ(table->Initialize(table_config, fs_config), 0);
+  std::unique_ptr<Table> loaded(new MemorySparseTable());
+  loaded->SetShard(0, 1);
+  ASSERT_EQ(loaded->Initialize(table_config, fs_config), 0);
+  FLAGS_pserver_sparse_table_delta_save = false;
+
+  std::vector<uint64_t> keys;
+  for (uint64_t key = 0; key < 100; ++key) {
+    keys.push_back(key);
+  }
+  std::vector<uint32_t> fres(keys.size(), 1);
+  auto pull_value = PullSparseValue(keys, fres, emb_dim);
+  auto pull = [&](Table *from, std::vector<float> *values) {
+    values->assign(keys.size() * select_dim, 0.0);
+    TableContext context;
+    context.value_type = Sparse;
+    context.pull_context.pull_value = pull_value;
+    context.pull_context.values = values->data();
+    from->Pull(context);
+  };
+  std::vector<float> values;
+  pull(table.get(), &values);
+  const std::string model_dir = "memory_sparse_table_delta_test";
+  FLAGS_pserver_sparse_table_save_snapshot = true;
+  ASSERT_EQ(table->Save(model_dir, "0"), 0);
+  FLAGS_pserver_sparse_table_save_snapshot = false;
+
+  // the delta of the pushed keys is saved next to the base parts
+  std::vector<float> gradients(keys.size() / 2 * (emb_dim + 4), 0.5);
+  TableContext push_context;
+  push_context.value_type = Sparse;
+  push_context.push_context.keys = keys.data();
+  push_context.push_context.values = gradients.data();
+  push_context.num = keys.size() / 2;
+  table->Push(push_context);
+  ASSERT_EQ(table->Save(model_dir, "6"), 0);
+  pull(table.get(), &values);
+
+  std::vector<float> loaded_values;
+  ASSERT_EQ(loaded->Load(model_dir, "0"), 0);
+  ASSERT_EQ(loaded->Load(model_dir, "6"), 0);
+  pull(loaded.get(), &loaded_values);
+  for (size_t i = 0; i < values.size(); ++i) {
+    ASSERT_FLOAT_EQ(loaded_values[i], values[i]) << "index " << i;
+  }
+  ASSERT_EQ(system(("rm -rf " + model_dir).c_str()), 0);
+}
+
 }  // namespace distributed
 }  // namespace paddle
@@ -14,8 +14,12 @@ limitations under the License. */
 
 #include "paddle/fluid/distributed/ps/table/sparse_sgd_rule.h"
 
+#include <chrono>  // NOLINT
 #include <cmath>
 #include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "paddle/fluid/distributed/the_one_ps.pb.h"
@@ -205,5 +209,143 @@ TEST(downpour_sparse_adam_test, test_init_and_update) {
     ASSERT_FLOAT_EQ(value[i], label[i]) << "i is " << i;
   }
 }
+
+SparseCommonSGDRuleParameter BatchTestParam(const std::string& name) {
+  SparseCommonSGDRuleParameter param;
+  param.set_name(name);
+  auto* naive_param = param.mutable_naive();
+  naive_param->set_learning_rate(0.1);
+  naive_param->add_weight_bounds(-1.0);
+  naive_param->add_weight_bounds(1.0);
+  auto* adagrad_param = param.mutable_adagrad();
+  adagrad_param->set_learning_rate(0.1);
+  adagrad_param->set_initial_g2sum(3.0);
+  adagrad_param->add_weight_bounds(-1.0);
+  adagrad_param->add_weight_bounds(1.0);
+  auto* adam_param = param.mutable_adam();
+  adam_param->set_learning_rate(0.1);
+  adam_param->set_beta1_decay_rate(0.9);
+  adam_param->set_beta2_decay_rate(0.999);
+  adam_param->set_ada_epsilon(1e-08);
+  adam_param->add_weight_bounds(-1.0);
+  adam_param->add_weight_bounds(1.0);
+  return param;
+}
+
+// Rows live at an offset inside the values like in the accessors, and some
+// values are pushed more than once per batch.
+void CheckBatchUpdate(SparseValueSGDRule* rule, size_t dim) {
+  const size_t value_num = 64;
+  const size_t row_num = 96;
+  const size_t w_index = 3;
+  const size_t sgd_index = w_index + dim;
+  const size_t grad_index = 2;
+  const size_t value_dim = sgd_index + rule->Dim();
+  std::mt19937 engine(2024);
+  std::uniform_real_distribution<float> dist(-2.0, 2.0);
+
+  std::vector<std::vector<float>> expect(value_num,
+                                         std::vector<float>(value_dim));
+  for (auto& value : expect) {
+    rule->InitValue(value.data() + w_index, value.data() + sgd_index, false);
+    value[0] = dist(engine);
+  }
+  auto actual = expect;
+  std::vector<std::vector<float>> push(row_num,
+                                       std::vector<float>(grad_index + dim));
+  std::vector<float> scales(row_num);
+  std::vector<float*> rows(row_num);
+  std::vector<const float*> grads(row_num);
+  for (size_t r = 0; r < row_num; ++r) {
+    for (auto& g : push[r]) {
+      g = dist(engine);
+    }
+    // large gradients push some weights onto the bounds
+    push[r][grad_index] *= 50;
+    scales[r] = 1 + r % 4;
+    size_t v = (r * 7) % value_num;
+    rows[r] = actual[v].data();
+    grads[r] = push[r].data();
+    rule->UpdateValue(expect[v].data() + w_index,
+                      expect[v].data() + sgd_index,
+                      push[r].data() + grad_index,
+                      scales[r]);
+  }
+  rule->UpdateValueBatch(rows.data(),
+                         w_index,
+                         sgd_index,
+                         grads.data(),
+                         grad_index,
+                         scales.data(),
+                         row_num);
+  for (size_t v = 0; v < value_num; ++v) {
+    for (size_t i = 0; i < value_dim; ++i) {
+      ASSERT_NEAR(actual[v][i],
+                  expect[v][i],
+                  1e-5 * std::max(1.0f, std::abs(expect[v][i])))
+          << rule->GetName() << " dim " << dim << " value " << v << " i "
+          << i;
+    }
+  }
+}
+
+TEST(sparse_sgd_rule_batch_test, matches_single_update) {
+  for (size_t dim : {1, 8, 13, 64}) {
+    std::vector<std::unique_ptr<SparseValueSGDRule>> rules;
+    rules.emplace_back(new SparseNaiveSGDRule());
+    rules.emplace_back(new SparseAdaGradSGDRule());
+    rules.emplace_back(new SparseAdaGradV2SGDRule());
+    rules.emplace_back(new StdAdaGradSGDRule());
+    rules.emplace_back(new SparseAdamSGDRule());
+    rules.emplace_back(new SparseSharedAdamSGDRule());
+    const char* names[] = {
+        "naive", "adagrad", "adagrad_v2", "std_adagrad", "adam", "shared_adam"};
+    for (size_t k = 0; k < rules.size(); ++k) {
+      rules[k]->LoadConfig(BatchTestParam(names[k]), dim);
+      CheckBatchUpdate(rules[k].get(), dim);
+    }
+  }
+}
+
+TEST(BENCHMARK, sparse_adagrad_batch_update) {
+  const size_t dim = 64;
+  const size_t value_num = 1 << 16;
+  const size_t value_dim = 1 + dim + 1;
+  const int rounds = 20;
+  SparseAdaGradSGDRule rule;
+  rule.LoadConfig(BatchTestParam("adagrad"), dim);
+  std::vector<float> values(value_num * value_dim, 0.0f);
+  std::vector<float> push(value_num * dim, 0.01f);
+  std::vector<float*> rows(value_num);
+  std::vector<const float*> grads(value_num);
+  std::vector<float> scales(value_num, 1.0f);
+  std::mt19937 engine(2024);
+  for (size_t r = 0; r < value_num; ++r) {
+    rows[r] = values.data() + (engine() % value_num) * value_dim;
+    grads[r] = push.data() + r * dim;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for (int k = 0; k < rounds; ++k) {
+    for (size_t r = 0; r < value_num; ++r) {
+      rule.UpdateValue(rows[r], rows[r] + dim, grads[r], scales[r]);
+    }
+  }
+  double single_seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+  start = std::chrono::steady_clock::now();
+  for (int k = 0; k < rounds; ++k) {
+    rule.UpdateValueBatch(
+        rows.data(), 0, dim, grads.data(), 0, scales.data(), value_num);
+  }
+  double batch_seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+  LOG(INFO) << "adagrad dim " << dim << " single update: "
+            << rounds * value_num / single_seconds / 1e6
+            << " Mrows/s, batch update: "
+            << rounds * value_num / batch_seconds / 1e6 << " Mrows/s";
+}
 }  // namespace distributed
 }  // namespace paddle
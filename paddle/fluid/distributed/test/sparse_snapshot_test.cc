@@ -0,0 +1,257 @@
+/* Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/distributed/ps/table/sparse_snapshot.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "paddle/common/flags.h"
+
+PD_DEFINE_string(merge_sparse_snapshots,
+                 "",
+                 "Path of the merge_sparse_snapshots tool.");
+
+namespace paddle::distributed {
+
+TEST(SparseSnapshot, WriteAndMap) {
+  const uint32_t stride = 6;
+  std::vector<std::vector<float>> values;
+  std::vector<uint64_t> keys;
+  for (uint64_t i = 0; i < 1000; ++i) {
+    // keys are added out of order, some values are shorter than the stride
+    keys.push_back((i * 7919) % 1000 * 3 + 1);
+    values.emplace_back(i % 2 ? stride : 4, static_cast<float>(i));
+  }
+  SparseSnapshotWriter writer(stride);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    writer.Add(keys[i], values[i].data(), values[i].size());
+  }
+  std::string path = "sparse_snapshot_test.snap";
+  ASSERT_EQ(writer.Write(path), 0);
+
+  SparseSnapshotReader reader;
+  ASSERT_EQ(reader.Open(path), 0);
+  ASSERT_EQ(reader.size(), keys.size());
+  ASSERT_EQ(reader.value_stride(), stride);
+  for (size_t i = 1; i < reader.size(); ++i) {
+    ASSERT_LT(reader.key(i - 1), reader.key(i));
+  }
+  for (size_t i = 0; i < keys.size(); ++i) {
+    uint32_t dim = 0;
+    const float* value = reader.Find(keys[i], &dim);
+    ASSERT_TRUE(value != nullptr);
+    ASSERT_EQ(dim, values[i].size());
+    for (uint32_t j = 0; j < dim; ++j) {
+      ASSERT_FLOAT_EQ(value[j], values[i][j]);
+    }
+  }
+  uint32_t dim = 0;
+  ASSERT_TRUE(reader.Find(0, &dim) == nullptr);
+  ASSERT_TRUE(reader.Find(3000, &dim) == nullptr);
+  reader.Close();
+  ASSERT_EQ(reader.size(), 0UL);
+
+  // a text checkpoint is rejected
+  FILE* fp = fopen(path.c_str(), "w");
+  fprintf(fp, "1 0.1 0.2 0.3\n");
+  fclose(fp);
+  ASSERT_ANY_THROW(reader.Open(path));
+  ASSERT_EQ(reader.size(), 0UL);
+  ASSERT_NE(reader.Open("sparse_snapshot_test_missing.snap"), 0);
+  remove(path.c_str());
+}
+
+TEST(SparseSnapshot, RejectCorruptHeader) {
+  const uint32_t stride = 4;
+  std::vector<float> value(stride, 1.0f);
+  SparseSnapshotWriter writer(stride);
+  for (uint64_t key = 0; key < 100; ++key) {
+    writer.Add(key, value.data(), stride);
+  }
+  std::string path = "sparse_snapshot_corrupt_test.snap";
+  ASSERT_EQ(writer.Write(path), 0);
+  SparseSnapshotHeader header;
+  FILE* fp = fopen(path.c_str(), "rb");
+  ASSERT_EQ(fread(&header, sizeof(header), 1, fp), 1UL);
+  fclose(fp);
+
+  auto open_with = [&](const SparseSnapshotHeader& corrupt) {
+    FILE* fp = fopen(path.c_str(), "r+b");
+    fwrite(&corrupt, sizeof(corrupt), 1, fp);
+    fclose(fp);
+    SparseSnapshotReader reader;
+    return reader.Open(path);
+  };
+  std::vector<SparseSnapshotHeader> corrupts(6, header);
+  // the keys would wrap around the address space
+  corrupts[0].key_num = UINT64_MAX / 4;
+  // the offsets point past the file or into the header
+  corrupts[1].keys_offset = UINT64_MAX - 63;
+  corrupts[2].dims_offset = 0;
+  corrupts[3].values_offset = header.values_offset + 64 * 1024;
+  // a misaligned section cannot be read in place
+  corrupts[4].dims_offset = header.dims_offset + 4;
+  corrupts[5].deleted_num = 1;
+  corrupts[5].deleted_offset = header.deleted_offset + 64;
+  for (const auto& corrupt : corrupts) {
+    ASSERT_ANY_THROW(open_with(corrupt));
+  }
+  // the value stride times the key count overflows 64 bits
+  SparseSnapshotHeader overflow = header;
+  overflow.value_stride = UINT32_MAX;
+  overflow.key_num = (1ULL << 62) + 1;
+  ASSERT_ANY_THROW(open_with(overflow));
+  ASSERT_EQ(open_with(header), 0);
+  remove(path.c_str());
+}
+
+TEST(SparseSnapshot, MergeDeltaChain) {
+  const uint32_t stride = 4;
+  // base holds keys 0..99, delta1 updates the even keys and erases keys
+  // 90..99, delta2 creates key 95 again and erases key 0
+  std::map<uint64_t, std::vector<float>> expect;
+  std::vector<std::vector<float>> base_values(100, std::vector<float>(stride));
+  SparseSnapshotWriter base(stride);
+  for (uint64_t key = 0; key < 100; ++key) {
+    base_values[key][0] = key;
+    base.Add(key, base_values[key].data(), stride);
+    expect[key] = base_values[key];
+  }
+  ASSERT_EQ(base.Write("merge_base.snap"), 0);
+
+  std::vector<std::vector<float>> delta_values(100, std::vector<float>(2));
+  SparseSnapshotWriter delta1(stride);
+  delta1.set_delta(true);
+  for (uint64_t key = 0; key < 90; key += 2) {
+    delta_values[key][0] = key + 1000;
+    delta1.Add(key, delta_values[key].data(), 2);
+    expect[key] = delta_values[key];
+  }
+  for (uint64_t key = 90; key < 100; ++key) {
+    delta1.AddDeleted(key);
+    expect.erase(key);
+  }
+  ASSERT_EQ(delta1.Write("merge_delta1.snap"), 0);
+
+  std::vector<float> recreated(stride, 95.5f);
+  SparseSnapshotWriter delta2(stride);
+  delta2.set_delta(true);
+  delta2.AddDeleted(95);
+  delta2.Add(95, recreated.data(), stride);
+  delta2.AddDeleted(0);
+  ASSERT_EQ(delta2.Write("merge_delta2.snap"), 0);
+  expect[95] = recreated;
+  expect.erase(0);
+
+  SparseSnapshotReader reader;
+  ASSERT_EQ(reader.Open("merge_delta1.snap"), 0);
+  ASSERT_TRUE(reader.is_delta());
+  ASSERT_EQ(reader.size(), 45UL);
+  ASSERT_EQ(reader.deleted_size(), 10UL);
+  ASSERT_EQ(reader.deleted_key(0), 90UL);
+
+  // base + deltas collapse into a base without erased keys
+  ASSERT_EQ(MergeSparseSnapshots(
+                {"merge_base.snap", "merge_delta1.snap", "merge_delta2.snap"},
+                "merge_out.snap"),
+            0);
+  ASSERT_EQ(reader.Open("merge_out.snap"), 0);
+  ASSERT_FALSE(reader.is_delta());
+  ASSERT_EQ(reader.deleted_size(), 0UL);
+  ASSERT_EQ(reader.size(), expect.size());
+  size_t i = 0;
+  for (auto& kv : expect) {
+    ASSERT_EQ(reader.key(i), kv.first);
+    ASSERT_EQ(reader.dim(i), kv.second.size());
+    for (size_t j = 0; j < kv.second.size(); ++j) {
+      ASSERT_FLOAT_EQ(reader.value(i)[j], kv.second[j]);
+    }
+    ++i;
+  }
+
+  // deltas alone collapse into one delta that keeps the erased keys
+  ASSERT_EQ(MergeSparseSnapshots({"merge_delta1.snap", "merge_delta2.snap"},
+                                 "merge_out.snap"),
+            0);
+  ASSERT_EQ(reader.Open("merge_out.snap"), 0);
+  ASSERT_TRUE(reader.is_delta());
+  ASSERT_EQ(reader.size(), 45UL);
+  ASSERT_EQ(reader.deleted_size(), 10UL);
+  uint32_t dim = 0;
+  ASSERT_TRUE(reader.Find(0, &dim) == nullptr);
+  ASSERT_TRUE(reader.Find(95, &dim) != nullptr);
+  reader.Close();
+
+  for (const char* path : {"merge_base.snap",
+                           "merge_delta1.snap",
+                           "merge_delta2.snap",
+                           "merge_out.snap"}) {
+    remove(path);
+  }
+}
+
+TEST(SparseSnapshot, MergeTool) {
+  if (FLAGS_merge_sparse_snapshots.empty()) {
+    GTEST_SKIP() << "--merge_sparse_snapshots is not set";
+  }
+  const uint32_t stride = 2;
+  std::vector<float> old_value = {1.0f, 2.0f};
+  std::vector<float> new_value = {3.0f, 4.0f};
+  SparseSnapshotWriter base(stride);
+  base.Add(1, old_value.data(), stride);
+  base.Add(2, old_value.data(), stride);
+  base.Add(3, old_value.data(), stride);
+  ASSERT_EQ(base.Write("tool_part-000-00000.snap"), 0);
+  SparseSnapshotWriter delta(stride);
+  delta.set_delta(true);
+  delta.Add(2, new_value.data(), stride);
+  delta.AddDeleted(3);
+  ASSERT_EQ(delta.Write("tool_delta-000-00000.snap"), 0);
+
+  std::string tool = FLAGS_merge_sparse_snapshots;
+  ASSERT_EQ(system((tool + " tool_out.snap tool_part-000-00000.snap "
+                           "tool_delta-000-00000.snap")
+                       .c_str()),
+            0);
+  SparseSnapshotReader reader;
+  ASSERT_EQ(reader.Open("tool_out.snap"), 0);
+  ASSERT_FALSE(reader.is_delta());
+  ASSERT_EQ(reader.size(), 2UL);
+  uint32_t dim = 0;
+  const float* value = reader.Find(1, &dim);
+  ASSERT_TRUE(value != nullptr);
+  ASSERT_FLOAT_EQ(value[0], 1.0f);
+  value = reader.Find(2, &dim);
+  ASSERT_TRUE(value != nullptr);
+  ASSERT_FLOAT_EQ(value[1], 4.0f);
+  ASSERT_TRUE(reader.Find(3, &dim) == nullptr);
+  reader.Close();
+
+  // missing inputs and usage errors fail
+  ASSERT_NE(system((tool + " tool_out.snap tool_missing.snap").c_str()), 0);
+  ASSERT_NE(system(tool.c_str()), 0);
+  for (const char* path : {"tool_part-000-00000.snap",
+                           "tool_delta-000-00000.snap",
+                           "tool_out.snap"}) {
+    remove(path);
+  }
+}
+
+}  // namespace paddle::distributed
@@ -0,0 +1,218 @@
+/* Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/distributed/ps/table/sparse_table_loader.h"
+
+#include <map>
+#include <mutex>  // NOLINT
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+#include "paddle/utils/string/string_helper.h"
+
+namespace paddle::distributed {
+
+namespace {
+
+const size_t kFileNum = 5;
+const size_t kKeyNum = 2000;
+const size_t kValueSize = 4;
+
+// file i holds the keys k with k % kFileNum == i, every second value is
+// shorter than kValueSize
+std::vector<std::vector<std::string>> MakeFiles() {
+  std::vector<std::vector<std::string>> files(kFileNum);
+  for (uint64_t key = 0; key < kKeyNum; ++key) {
+    std::string line = std::to_string(key);
+    size_t size = key % 2 ? kValueSize : kValueSize - 1;
+    for (size_t j = 0; j < size; ++j) {
+      line += " " + std::to_string(key + j);
+    }
+    files[key % kFileNum].push_back(line);
+  }
+  return files;
+}
+
+}  // namespace
+
+TEST(SparseTableLoader, LoadAllFiles) {
+  auto files = MakeFiles();
+  SparseTableLoader::Options options;
+  options.reader_num = 2;
+  options.parser_num = 3;
+  options.inserter_num = 2;
+  // tiny blocks and budget, so that every stage waits on its neighbours
+  options.block_bytes = 256;
+  options.memory_cap = 1024;
+  SparseTableLoader loader(options, kValueSize);
+
+  auto read = [&](size_t i, const std::function<void(std::string*)>& emit) {
+    for (auto line : files[i]) {
+      emit(&line);
+    }
+    return 0;
+  };
+  auto parse = [](const char* str, float* value) {
+    return paddle::string::str_to_float(str, value);
+  };
+  std::vector<std::map<uint64_t, std::vector<float>>> shards(kFileNum);
+  auto insert = [&](size_t i, uint64_t key, const float* value, size_t size) {
+    shards[i][key].assign(value, value + size);
+  };
+  ASSERT_EQ(loader.Load(kFileNum, read, parse, insert), 0);
+
+  for (size_t i = 0; i < kFileNum; ++i) {
+    ASSERT_EQ(shards[i].size(), kKeyNum / kFileNum);
+    for (auto& item : shards[i]) {
+      uint64_t key = item.first;
+      ASSERT_EQ(key % kFileNum, i);
+      ASSERT_EQ(item.second.size(), key % 2 ? kValueSize : kValueSize - 1);
+      for (size_t j = 0; j < item.second.size(); ++j) {
+        ASSERT_FLOAT_EQ(item.second[j], key + j);
+      }
+    }
+  }
+  const auto& stats = loader.GetStats();
+  ASSERT_EQ(stats.read.records, kKeyNum);
+  ASSERT_EQ(stats.parse.records, kKeyNum);
+  ASSERT_EQ(stats.insert.records, kKeyNum);
+  ASSERT_EQ(stats.read.bytes, stats.parse.bytes);
+  ASSERT_GT(stats.insert.bytes, 0u);
+  VLOG(0) << stats.ToString();
+}
+
+TEST(SparseTableLoader, ReadFailure) {
+  auto files = MakeFiles();
+  SparseTableLoader::Options options;
+  options.reader_num = 2;
+  options.read_retry_num = 0;
+  SparseTableLoader loader(options, kValueSize);
+  size_t inserted = 0;
+  auto read = [&](size_t i, const std::function<void(std::string*)>& emit) {
+    for (auto line : files[i]) {
+      emit(&line);
+    }
+    return i == 3 ? -1 : 0;
+  };
+  auto parse = [](const char* str, float* value) {
+    return paddle::string::str_to_float(str, value);
+  };
+  auto insert = [&](size_t i, uint64_t key, const float* value, size_t size) {
+    ++inserted;
+  };
+  ASSERT_EQ(loader.Load(kFileNum, read, parse, insert), -1);
+  // the lines read before the failure are still delivered
+  ASSERT_EQ(inserted, kKeyNum);
+}
+
+TEST(SparseTableLoader, ReadRetry) {
+  auto files = MakeFiles();
+  SparseTableLoader::Options options;
+  options.reader_num = 2;
+  options.read_retry_num = 2;
+  options.block_bytes = 256;
+  SparseTableLoader loader(options, kValueSize);
+  // file 3 fails after half of its lines, twice
+  int fail_num = 2;
+  auto read = [&](size_t i, const std::function<void(std::string*)>& emit) {
+    size_t num = files[i].size();
+    if (i == 3 && fail_num > 0) {
+      --fail_num;
+      num /= 2;
+    }
+    for (size_t j = 0; j < num; ++j) {
+      auto line = files[i][j];
+      emit(&line);
+    }
+    return num == files[i].size() ? 0 : -1;
+  };
+  auto parse = [](const char* str, float* value) {
+    return paddle::string::str_to_float(str, value);
+  };
+  std::mutex insert_mutex;
+  size_t inserted = 0;
+  std::vector<std::map<uint64_t, std::vector<float>>> shards(kFileNum);
+  auto insert = [&](size_t i, uint64_t key, const float* value, size_t size) {
+    std::lock_guard<std::mutex> guard(insert_mutex);
+    ++inserted;
+    shards[i][key].assign(value, value + size);
+  };
+  ASSERT_EQ(loader.Load(kFileNum, read, parse, insert), 0);
+  ASSERT_EQ(fail_num, 0);
+  ASSERT_EQ(inserted, kKeyNum + kKeyNum / kFileNum);
+  for (size_t i = 0; i < kFileNum; ++i) {
+    ASSERT_EQ(shards[i].size(), kKeyNum / kFileNum);
+  }
+  // the lines of the failed reads are not counted
+  const auto& stats = loader.GetStats();
+  ASSERT_EQ(stats.read.records, kKeyNum);
+  ASSERT_EQ(stats.parse.records, kKeyNum);
+  ASSERT_EQ(stats.insert.records, kKeyNum);
+  ASSERT_EQ(stats.read.bytes, stats.parse.bytes);
+
+  // a file that never reads fails the load after the retries
+  fail_num = 10;
+  ASSERT_EQ(loader.Load(kFileNum, read, parse, insert), -1);
+  ASSERT_EQ(fail_num, 7);
+}
+
+TEST(SparseTableLoader, ParseRetry) {
+  auto files = MakeFiles();
+  SparseTableLoader::Options options;
+  options.parser_num = 2;
+  options.parse_retry_num = 2;
+  SparseTableLoader loader(options, kValueSize);
+  auto read = [&](size_t i, const std::function<void(std::string*)>& emit) {
+    for (auto line : files[i]) {
+      emit(&line);
+    }
+    return 0;
+  };
+  // the line of key 7 fails `fail_num` times, then parses
+  int fail_num = 2;
+  std::mutex fail_mutex;
+  auto parse = [&](const char* str, float* value) {
+    if (std::string(str).find("7 8 9 10") == 0) {
+      std::lock_guard<std::mutex> guard(fail_mutex);
+      if (fail_num > 0) {
+        --fail_num;
+        throw std::runtime_error("parse failed");
+      }
+    }
+    return paddle::string::str_to_float(str, value);
+  };
+  std::vector<std::map<uint64_t, std::vector<float>>> shards(kFileNum);
+  auto insert = [&](size_t i, uint64_t key, const float* value, size_t size) {
+    shards[i][key].assign(value, value + size);
+  };
+  ASSERT_EQ(loader.Load(kFileNum, read, parse, insert), 0);
+  ASSERT_EQ(fail_num, 0);
+  for (size_t i = 0; i < kFileNum; ++i) {
+    ASSERT_EQ(shards[i].size(), kKeyNum / kFileNum);
+  }
+  ASSERT_EQ(shards[2][7].size(), kValueSize);
+  // the file of key 7 is read again, but counted once
+  ASSERT_EQ(loader.GetStats().read.records, kKeyNum);
+  ASSERT_EQ(loader.GetStats().insert.records, kKeyNum);
+
+  // a line that never parses fails the load after the retries
+  fail_num = 10;
+  ASSERT_EQ(loader.Load(kFileNum, read, parse, insert), -1);
+  ASSERT_EQ(fail_num, 7);
+}
+
+}  // namespace paddle::distributed
@@ -0,0 +1,76 @@
+/* Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/distributed/ps/table/depends/ssd_value_cache.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace paddle::distributed {
+
+TEST(SSDValueCache, TakeMovesValueOut) {
+  SSDValueCache cache(1 << 20, 8 * sizeof(float));
+  std::vector<float> value = {1.0, 2.0, 3.0};
+  ASSERT_TRUE(cache.Admit(7, value.data(), value.size(), 0));
+
+  std::vector<float> out;
+  ASSERT_FALSE(cache.Take(8, &out));
+  ASSERT_TRUE(cache.Take(7, &out));
+  ASSERT_EQ(out, value);
+  ASSERT_FALSE(cache.Take(7, &out));
+
+  auto stats = cache.GetStats();
+  ASSERT_EQ(stats.hits, 1UL);
+  ASSERT_EQ(stats.misses, 2UL);
+  ASSERT_EQ(stats.admissions, 1UL);
+  ASSERT_EQ(stats.size, 0UL);
+  ASSERT_EQ(stats.bytes, 0UL);
+  ASSERT_DOUBLE_EQ(stats.HitRate(), 1.0 / 3);
+}
+
+TEST(SSDValueCache, FrequencyAwareAdmission) {
+  const size_t dim = 8;
+  std::vector<float> value(dim, 1.0);
+  // room for a handful of entries only
+  SSDValueCache cache(1024, dim * sizeof(float));
+  uint64_t key = 0;
+  while (cache.Admit(key, value.data(), dim, 0)) {
+    ++key;
+    ASSERT_EQ(cache.GetStats().evictions, 0UL);
+  }
+  size_t capacity = key;
+  ASSERT_GT(capacity, 1UL);
+  ASSERT_EQ(cache.GetStats().rejections, 1UL);
+
+  // a key that keeps missing the cache wins against cold residents
+  uint64_t hot_key = 1000;
+  std::vector<float> out;
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_FALSE(cache.Take(hot_key, &out));
+  }
+  ASSERT_TRUE(cache.Admit(hot_key, value.data(), dim, 0));
+  ASSERT_EQ(cache.GetStats().evictions, 1UL);
+
+  // a high show count counts as frequency as well
+  ASSERT_TRUE(cache.Admit(2000, value.data(), dim, 1000.0));
+  ASSERT_EQ(cache.GetStats().size, capacity);
+
+  ASSERT_TRUE(cache.Take(hot_key, &out));
+  cache.Clear();
+  ASSERT_EQ(cache.GetStats().size, 0UL);
+  ASSERT_FALSE(cache.Take(2000, &out));
+}
+
+}  // namespace paddle::distributed
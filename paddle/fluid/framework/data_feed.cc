@@ -604,6 +604,92 @@ void InMemoryDataFeed<T>::LoadIntoMemory() {
 #endif
 }
 
+template <typename T>
+void InMemoryDataFeed<T>::LoadIntoMemoryByPool(WorkStealingPool* pool,
+                                               int parse_stage,
+                                               size_t chunk_lines) {
+#ifdef _LINUX
+  PADDLE_ENFORCE_EQ(SupportParseFromLine(),
+                    true,
+                    common::errors::Unimplemented(
+                        "This DataFeed can not parse lines in a pool."));
+  VLOG(3) << "LoadIntoMemoryByPool() begin, thread_id=" << thread_id_;
+  PADDLE_ENFORCE_GT(chunk_lines,
+                    0UL,
+                    common::errors::InvalidArgument(
+                        "A chunk should hold at least one line."));
+  // enough chunks for the idle threads to steal, but a bounded number of
+  // lines held in memory
+  size_t pending_limit = 2 * pool->ThreadNum();
+  auto parse = [this](const std::vector<std::string>& lines) {
+    std::vector<T> instances(lines.size());
+    size_t num = 0;
+    uint64_t fea_num = 0;
+    for (auto& line : lines) {
+      if (ParseOneInstanceFromLine(line.c_str(), &instances[num], &fea_num)) {
+        ++num;
+      }
+    }
+    if (num > 0) {
+      instances.resize(num);
+      input_channel_->Write(std::move(instances));
+    }
+    STAT_ADD(STAT_total_feasign_num_in_mem, fea_num);
+    std::lock_guard<std::mutex> flock(*mutex_for_fea_num_);
+    *total_fea_num_ += fea_num;
+  };
+  std::string filename;
+  while (this->PickOneFile(&filename)) {
+    VLOG(3) << "PickOneFile, filename=" << filename
+            << ", thread_id=" << thread_id_;
+    std::shared_ptr<FILE> fp;
+#ifdef PADDLE_WITH_BOX_PS
+    if (BoxWrapper::GetInstance()->UseAfsApi()) {
+      fp = BoxWrapper::GetInstance()->afs_manager->GetFile(filename,
+                                                           this->pipe_command_);
+    } else {
+#endif
+      int err_no = 0;
+      fp = fs_open_read(filename, &err_no, this->pipe_command_, true);
+#ifdef PADDLE_WITH_BOX_PS
+    }
+#endif
+    PADDLE_ENFORCE_EQ(fp != nullptr,
+                      true,
+                      common::errors::InvalidArgument(
+                          "This fp should not be null, please check!"));
+    __fsetlocking(&*fp, FSETLOCKING_BYCALLER);
+    platform::Timer timeline;
+    timeline.Start();
+    string::LineFileReader reader;
+    std::vector<std::string> lines;
+    lines.reserve(chunk_lines);
+    auto flush = [&]() {
+      if (lines.empty()) {
+        return;
+      }
+      pool->Run(parse_stage,
+                [parse, lines = std::move(lines)]() { parse(lines); });
+      lines = std::vector<std::string>();
+      lines.reserve(chunk_lines);
+      pool->RunPendingTasks(pending_limit);
+    };
+    while (reader.getline(&*fp)) {
+      lines.emplace_back(reader.get(), reader.length());
+      if (lines.size() >= chunk_lines) {
+        flush();
+      }
+    }
+    flush();
+    timeline.Pause();
+    VLOG(3) << "LoadIntoMemoryByPool() read all lines, file=" << filename
+            << ", cost time=" << timeline.ElapsedSec()
+            << " seconds, thread_id=" << thread_id_;
+  }
+  VLOG(3) << "LoadIntoMemoryByPool() end, thread_id=" << thread_id_;
+#endif
+}
+
 template <typename T>
 void InMemoryDataFeed<T>::LoadIntoMemoryFromSo() {
 #if (defined _LINUX) && (defined PADDLE_WITH_HETERPS)
@@ -1148,7 +1234,7 @@ void MultiSlotInMemoryDataFeed::Init(
 void MultiSlotInMemoryDataFeed::GetMsgFromLogKey(const std::string& log_key,
                                                  uint64_t* search_id,
                                                  uint32_t* cmatch,
-                                                 uint32_t* rank) {
+                                                 uint32_t* rank) const {
   std::string searchid_str = log_key.substr(16, 16);
   *search_id = (uint64_t)strtoull(searchid_str.c_str(), nullptr, 16);
 
@@ -1174,139 +1260,149 @@ bool MultiSlotInMemoryDataFeed::ParseOneInstanceFromPipe(Record* instance) {
 
   if (!reader.getline(&*(fp_.get()))) {
     return false;
-  } else {
-    const char* str = reader.get();
-    std::string line = std::string(str);
-    // VLOG(3) << line;
-    char* endptr = const_cast<char*>(str);
-    int pos = 0;
-    if (parse_ins_id_) {
-      int num = static_cast<int>(strtol(&str[pos], &endptr, 10));
-      PADDLE_ENFORCE_EQ(num == 1,
-                        true,
-                        common::errors::InvalidArgument(
-                            "Num should be equal to 1, but received %d.", num));
-      pos = static_cast<int>(endptr - str + 1);
-      size_t len = 0;
-      while (str[pos + len] != ' ') {
-        ++len;
-      }
-      instance->ins_id_ = std::string(str + pos, len);
-      pos += static_cast<int>(len) + 1;
-      VLOG(3) << "ins_id " << instance->ins_id_;
-    }
-    if (parse_content_) {
-      int num = static_cast<int>(strtol(&str[pos], &endptr, 10));
-      PADDLE_ENFORCE_EQ(num == 1,
-                        true,
-                        common::errors::InvalidArgument(
-                            "Num should be equal to 1, but received %d.", num));
-      pos = static_cast<int>(endptr - str + 1);
-      size_t len = 0;
-      while (str[pos + len] != ' ') {
-        ++len;
-      }
-      instance->content_ = std::string(str + pos, len);
-      pos += static_cast<int>(len) + 1;
-      VLOG(3) << "content " << instance->content_;
-    }
-    if (parse_logkey_) {
-      int num = static_cast<int>(strtol(&str[pos], &endptr, 10));
-      PADDLE_ENFORCE_EQ(num == 1,
-                        true,
-                        common::errors::InvalidArgument(
-                            "Num should be equal to 1, but received %d.", num));
-      pos = static_cast<int>(endptr - str + 1);
-      size_t len = 0;
-      while (str[pos + len] != ' ') {
-        ++len;
-      }
-      // parse_logkey
-      std::string log_key = std::string(str + pos, len);
-      uint64_t search_id;
-      uint32_t cmatch;
-      uint32_t rank;
-      GetMsgFromLogKey(log_key, &search_id, &cmatch, &rank);
-
-      instance->ins_id_ = log_key;
-      instance->search_id = search_id;
-      instance->cmatch = cmatch;
-      instance->rank = rank;
-      pos += static_cast<int>(len) + 1;
+  }
+  uint64_t fea_num = 0;
+  bool ret = ParseOneInstanceFromLine(reader.get(), instance, &fea_num);
+  fea_num_ += fea_num;
+  return ret;
+#else
+  return false;
+#endif
+}
+
+bool MultiSlotInMemoryDataFeed::ParseOneInstanceFromLine(
+    const char* str, Record* instance, uint64_t* fea_num) const {
+#ifdef _LINUX
+  std::string line = std::string(str);
+  // VLOG(3) << line;
+  char* endptr = const_cast<char*>(str);
+  int pos = 0;
+  if (parse_ins_id_) {
+    int num = static_cast<int>(strtol(&str[pos], &endptr, 10));
+    PADDLE_ENFORCE_EQ(num == 1,
+                      true,
+                      common::errors::InvalidArgument(
+                          "Num should be equal to 1, but received %d.", num));
+    pos = static_cast<int>(endptr - str + 1);
+    size_t len = 0;
+    while (str[pos + len] != ' ') {
+      ++len;
     }
-    for (size_t i = 0; i < use_slots_index_.size(); ++i) {
-      int idx = use_slots_index_[i];
-      int num = strtol(&str[pos], &endptr, 10);
-      PADDLE_ENFORCE_NE(
-          num,
-          0,
-          common::errors::InvalidArgument(
-              "The number of ids can not be zero, you need padding "
-              "it in data generator; or if there is something wrong with "
-              "the data, please check if the data contains unresolvable "
-              "characters.\nplease check this error line: %s, \n Specifically, "
-              "something wrong happened(the length of this slot's feasign is 0)"
-              "when we parse the %d th slots."
-              "Maybe something wrong around this slot"
-              "\nWe detect the feasign number of this slot is %d, "
-              "which is illegal.",
-              str,
-              i,
-              num));
+    instance->ins_id_ = std::string(str + pos, len);
+    pos += static_cast<int>(len) + 1;
+    VLOG(3) << "ins_id " << instance->ins_id_;
+  }
+  if (parse_content_) {
+    int num = static_cast<int>(strtol(&str[pos], &endptr, 10));
+    PADDLE_ENFORCE_EQ(num == 1,
+                      true,
+                      common::errors::InvalidArgument(
+                          "Num should be equal to 1, but received %d.", num));
+    pos = static_cast<int>(endptr - str + 1);
+    size_t len = 0;
+    while (str[pos + len] != ' ') {
+      ++len;
+    }
+    instance->content_ = std::string(str + pos, len);
+    pos += static_cast<int>(len) + 1;
+    VLOG(3) << "content " << instance->content_;
+  }
+  if (parse_logkey_) {
+    int num = static_cast<int>(strtol(&str[pos], &endptr, 10));
+    PADDLE_ENFORCE_EQ(num == 1,
+                      true,
+                      common::errors::InvalidArgument(
+                          "Num should be equal to 1, but received %d.", num));
+    pos = static_cast<int>(endptr - str + 1);
+    size_t len = 0;
+    while (str[pos + len] != ' ') {
+      ++len;
+    }
+    // parse_logkey
+    std::string log_key = std::string(str + pos, len);
+    uint64_t search_id;
+    uint32_t cmatch;
+    uint32_t rank;
+    GetMsgFromLogKey(log_key, &search_id, &cmatch, &rank);
+
+    instance->ins_id_ = log_key;
+    instance->search_id = search_id;
+    instance->cmatch = cmatch;
+    instance->rank = rank;
+    pos += static_cast<int>(len) + 1;
+  }
+  for (size_t i = 0; i < use_slots_index_.size(); ++i) {
+    int idx = use_slots_index_[i];
+    int num = strtol(&str[pos], &endptr, 10);
+    PADDLE_ENFORCE_NE(
+        num,
+        0,
+        common::errors::InvalidArgument(
+            "The number of ids can not be zero, you need padding "
+            "it in data generator; or if there is something wrong with "
+            "the data, please check if the data contains unresolvable "
+            "characters.\nplease check this error line: %s, \n Specifically, "
+            "something wrong happened(the length of this slot's feasign is 0)"
+            "when we parse the %d th slots."
+            "Maybe something wrong around this slot"
+            "\nWe detect the feasign number of this slot is %d, "
+            "which is illegal.",
+            str,
+            i,
+            num));
 #ifdef PADDLE_WITH_PSLIB
-      if (parse_uid_ && all_slots_[i] == uid_slot_) {
-        PADDLE_ENFORCE(num == 1 && all_slots_type_[i][0] == 'u',
-                       common::errors::PreconditionNotMet(
-                           "The uid has to be uint64 and single.\n"
-                           "please check this error line: %s",
-                           str));
+    if (parse_uid_ && all_slots_[i] == uid_slot_) {
+      PADDLE_ENFORCE(num == 1 && all_slots_type_[i][0] == 'u',
+                     common::errors::PreconditionNotMet(
+                         "The uid has to be uint64 and single.\n"
+                         "please check this error line: %s",
+                         str));
 
-        char* uidptr = endptr;
-        uint64_t feasign = (uint64_t)strtoull(uidptr, &uidptr, 10);
-        instance->uid_ = feasign;
-      }
+      char* uidptr = endptr;
+      uint64_t feasign = (uint64_t)strtoull(uidptr, &uidptr, 10);
+      instance->uid_ = feasign;
+    }
 #endif
-      if (idx != -1) {
-        if (all_slots_type_[i][0] == 'f') {  // float
-          for (int j = 0; j < num; ++j) {
-            float feasign = strtof(endptr, &endptr);
-            // if float feasign is equal to zero, ignore it
-            // except when slot is dense
-            if (fabs(feasign) < 1e-6 && !use_slots_is_dense_[i]) {
-              continue;
-            }
-            FeatureFeasign f;
-            f.float_feasign_ = feasign;
-            instance->float_feasigns_.emplace_back(f, idx);
-          }
-        } else if (all_slots_type_[i][0] == 'u') {  // uint64
-          for (int j = 0; j < num; ++j) {
-            uint64_t feasign = (uint64_t)strtoull(endptr, &endptr, 10);
-            // if uint64 feasign is equal to zero, ignore it
-            // except when slot is dense
-            if (feasign == 0 && !use_slots_is_dense_[i]) {
-              continue;
-            }
-            FeatureFeasign f;
-            f.uint64_feasign_ = feasign;
-            instance->uint64_feasigns_.emplace_back(f, idx);
+    if (idx != -1) {
+      if (all_slots_type_[i][0] == 'f') {  // float
+        for (int j = 0; j < num; ++j) {
+          float feasign = strtof(endptr, &endptr);
+          // if float feasign is equal to zero, ignore it
+          // except when slot is dense
+          if (fabs(feasign) < 1e-6 && !use_slots_is_dense_[i]) {
+            continue;
           }
+          FeatureFeasign f;
+          f.float_feasign_ = feasign;
+          instance->float_feasigns_.emplace_back(f, idx);
         }
-        pos = endptr - str;
-      } else {
-        for (int j = 0; j <= num; ++j) {
-          // pos = line.find_first_of(' ', pos + 1);
-          while (line[pos + 1] != ' ') {
-            pos++;
+      } else if (all_slots_type_[i][0] == 'u') {  // uint64
+        for (int j = 0; j < num; ++j) {
+          uint64_t feasign = (uint64_t)strtoull(endptr, &endptr, 10);
+          // if uint64 feasign is equal to zero, ignore it
+          // except when slot is dense
+          if (feasign == 0 && !use_slots_is_dense_[i]) {
+            continue;
           }
+          FeatureFeasign f;
+          f.uint64_feasign_ = feasign;
+          instance->uint64_feasigns_.emplace_back(f, idx);
+        }
+      }
+      pos = endptr - str;
+    } else {
+      for (int j = 0; j <= num; ++j) {
+        // pos = line.find_first_of(' ', pos + 1);
+        while (line[pos + 1] != ' ') {
+          pos++;
         }
       }
     }
-    instance->float_feasigns_.shrink_to_fit();
-    instance->uint64_feasigns_.shrink_to_fit();
-    fea_num_ += instance->uint64_feasigns_.size();
-    return true;
   }
+  instance->float_feasigns_.shrink_to_fit();
+  instance->uint64_feasigns_.shrink_to_fit();
+  *fea_num += instance->uint64_feasigns_.size();
+  return true;
 #else
   return false;
 #endif
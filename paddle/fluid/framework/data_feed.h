@@ -38,6 +38,7 @@ limitations under the License. */
 #include "paddle/fluid/framework/fleet/fleet_wrapper.h"
 #include "paddle/fluid/framework/lod_tensor.h"
 #include "paddle/fluid/framework/variable.h"
+#include "paddle/fluid/framework/work_stealing_pool.h"
 #include "paddle/phi/core/framework/data_feed.pb.h"
 #include "paddle/phi/core/framework/reader.h"
 #include "paddle/phi/core/platform/timer.h"
@@ -1554,6 +1555,16 @@ class InMemoryDataFeed : public DataFeed {
   virtual void SetCurrentPhase(int current_phase);
   virtual void LoadIntoMemory();
   virtual void LoadIntoMemoryFromSo();
+  // Whether the feed can parse a line on its own, which LoadIntoMemoryByPool
+  // needs.
+  virtual bool SupportParseFromLine() const { return false; }
+  // Picks files like LoadIntoMemory, but only reads them here: the lines are
+  // handed to `pool` in chunks of `chunk_lines` parsed by tasks of stage
+  // `parse_stage`, which any idle thread of the pool may steal. Runs as a
+  // task of `pool`.
+  virtual void LoadIntoMemoryByPool(WorkStealingPool* pool,
+                                    int parse_stage,
+                                    size_t chunk_lines);
   virtual void SetRecord(T* records) { records_ = records; }
   int GetDefaultBatchSize() { return default_batch_size_; }
   void AddBatchOffset(const std::pair<int, int>& offset) {
@@ -1563,6 +1574,14 @@ class InMemoryDataFeed : public DataFeed {
  protected:
   virtual bool ParseOneInstance(T* instance) = 0;
   virtual bool ParseOneInstanceFromPipe(T* instance) = 0;
+  // Parses one line into `instance` and adds its feasign num to `fea_num`,
+  // may be called by several threads at a time, so it must not modify the
+  // feed.
+  virtual bool ParseOneInstanceFromLine(const char* str UNUSED,
+                                        T* instance UNUSED,
+                                        uint64_t* fea_num UNUSED) const {
+    return false;
+  }
   virtual void ParseOneInstanceFromSo(const char* str UNUSED,
                                       T* instance UNUSED,
                                       CustomParser* parser UNUSED) {}
@@ -1945,11 +1964,17 @@ class MultiSlotInMemoryDataFeed : public InMemoryDataFeed<Record> {
   MultiSlotInMemoryDataFeed() {}
   virtual ~MultiSlotInMemoryDataFeed() {}
   virtual void Init(const DataFeedDesc& data_feed_desc);
+  bool SupportParseFromLine() const override {
+    return so_parser_name_.empty();
+  }
   // void SetRecord(Record* records) { records_ = records; }
 
  protected:
   virtual bool ParseOneInstance(Record* instance);
   virtual bool ParseOneInstanceFromPipe(Record* instance);
+  virtual bool ParseOneInstanceFromLine(const char* str,
+                                        Record* instance,
+                                        uint64_t* fea_num) const;
   virtual void ParseOneInstanceFromSo(const char* str UNUSED,
                                       Record* instance UNUSED,
                                       CustomParser* parser UNUSED) {}
@@ -1961,7 +1986,7 @@ class MultiSlotInMemoryDataFeed : public InMemoryDataFeed<Record> {
   virtual void GetMsgFromLogKey(const std::string& log_key,
                                 uint64_t* search_id,
                                 uint32_t* cmatch,
-                                uint32_t* rank);
+                                uint32_t* rank) const;
   virtual void PutToFeedVec(const Record* ins_vec, int num);
 };
 
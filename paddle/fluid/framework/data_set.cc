@@ -42,6 +42,8 @@ COMMON_DECLARE_bool(graph_get_neighbor_id);
 COMMON_DECLARE_int32(gpugraph_storage_mode);
 COMMON_DECLARE_string(graph_edges_split_mode);
 COMMON_DECLARE_bool(query_dest_rank_by_multi_node);
+COMMON_DECLARE_bool(dataset_pipeline_load);
+COMMON_DECLARE_int32(dataset_pipeline_chunk_lines);
 
 namespace paddle {
 namespace framework {
@@ -578,6 +580,8 @@ void DatasetImpl<T>::LoadIntoMemory() {
     VLOG(1) << "end add edge into gpu_graph_total_keys_ size[" << node_num
             << "]";
 #endif
+  } else if (FLAGS_dataset_pipeline_load && CanLoadByPool()) {
+    LoadIntoMemoryByPool();
   } else {
     std::vector<std::thread> load_threads;
     for (int64_t i = 0; i < thread_num_; ++i) {
@@ -598,6 +602,47 @@ void DatasetImpl<T>::LoadIntoMemory() {
           << ", cost time=" << timeline.ElapsedSec() << " seconds";
 }
 
+template <typename T>
+bool DatasetImpl<T>::CanLoadByPool() {
+  if (readers_.empty()) {
+    return false;
+  }
+  for (auto& reader : readers_) {
+    auto* feed = dynamic_cast<InMemoryDataFeed<T>*>(reader.get());
+    if (feed == nullptr || !feed->SupportParseFromLine()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// every reader reads the files it picks in a task of the pool, and spawns
+// the parsing of their lines as smaller tasks, so the threads done with
+// their files help the ones stuck on a large or slow file
+template <typename T>
+void DatasetImpl<T>::LoadIntoMemoryByPool() {
+  WorkStealingPool pool(thread_num_);
+  int read_stage = pool.AddStage("read");
+  int parse_stage = pool.AddStage("parse");
+  PADDLE_ENFORCE_GT(FLAGS_dataset_pipeline_chunk_lines,
+                    0,
+                    common::errors::InvalidArgument(
+                        "FLAGS_dataset_pipeline_chunk_lines should be "
+                        "positive, but got %d.",
+                        FLAGS_dataset_pipeline_chunk_lines));
+  size_t chunk_lines = FLAGS_dataset_pipeline_chunk_lines;
+  for (int64_t i = 0; i < thread_num_; ++i) {
+    auto* feed = dynamic_cast<InMemoryDataFeed<T>*>(readers_[i].get());
+    pool.Run(read_stage, [feed, &pool, parse_stage, chunk_lines]() {
+      feed->LoadIntoMemoryByPool(&pool, parse_stage, chunk_lines);
+    });
+  }
+  pool.Wait();
+  load_pipeline_stats_ = pool.GetStats().ToString();
+  VLOG(1) << "DatasetImpl<T>::LoadIntoMemoryByPool() stats: "
+          << load_pipeline_stats_;
+}
+
 template <typename T>
 void DatasetImpl<T>::PreLoadIntoMemory() {
   VLOG(3) << "DatasetImpl<T>::PreLoadIntoMemory() begin";
@@ -728,7 +773,11 @@ void DatasetImpl<T>::LocalShuffle() {
   input_channel_->Close();
   std::vector<T> data;
   input_channel_->ReadAll(data);
-  std::shuffle(data.begin(), data.end(), fleet_ptr->LocalRandomEngine());
+  if (FLAGS_dataset_pipeline_load && thread_num_ > 1) {
+    LocalShuffleByPool(&data);
+  } else {
+    std::shuffle(data.begin(), data.end(), fleet_ptr->LocalRandomEngine());
+  }
   input_channel_->Open();
   input_channel_->Write(std::move(data));
   data.clear();
@@ -740,6 +789,67 @@ void DatasetImpl<T>::LocalShuffle() {
           << timeline.ElapsedSec() << " seconds";
 }
 
+// a parallel uniform shuffle: every chunk of data scatters its records into
+// random buckets, then every bucket is shuffled on its own and the buckets
+// are concatenated
+template <typename T>
+void DatasetImpl<T>::LocalShuffleByPool(std::vector<T>* data) {
+  WorkStealingPool pool(thread_num_);
+  int scatter_stage = pool.AddStage("scatter");
+  int shuffle_stage = pool.AddStage("shuffle");
+  size_t part_num = thread_num_;
+  size_t chunk_size = (data->size() + part_num - 1) / part_num;
+  std::vector<uint64_t> seeds(part_num * 2);
+  auto& engine = framework::FleetWrapper::GetInstance()->LocalRandomEngine();
+  for (auto& seed : seeds) {
+    seed = engine();
+  }
+  // buckets[c][b]: the records of chunk c falling into bucket b
+  std::vector<std::vector<std::vector<T>>> buckets(
+      part_num, std::vector<std::vector<T>>(part_num));
+  for (size_t c = 0; c < part_num; ++c) {
+    pool.Run(scatter_stage, [&, c]() {
+      std::default_random_engine rng(seeds[c]);
+      std::uniform_int_distribution<size_t> dist(0, part_num - 1);
+      size_t begin = std::min(c * chunk_size, data->size());
+      size_t end = std::min(begin + chunk_size, data->size());
+      for (size_t i = begin; i < end; ++i) {
+        buckets[c][dist(rng)].push_back(std::move((*data)[i]));
+      }
+    });
+  }
+  pool.Wait();
+
+  std::vector<size_t> offsets(part_num + 1, 0);
+  for (size_t b = 0; b < part_num; ++b) {
+    offsets[b + 1] = offsets[b];
+    for (size_t c = 0; c < part_num; ++c) {
+      offsets[b + 1] += buckets[c][b].size();
+    }
+  }
+  for (size_t b = 0; b < part_num; ++b) {
+    pool.Run(shuffle_stage, [&, b]() {
+      auto out = data->begin() + offsets[b];
+      for (size_t c = 0; c < part_num; ++c) {
+        out = std::move(buckets[c][b].begin(), buckets[c][b].end(), out);
+        std::vector<T>().swap(buckets[c][b]);
+      }
+      std::default_random_engine rng(seeds[part_num + b]);
+      std::shuffle(data->begin() + offsets[b], out, rng);
+    });
+  }
+  pool.Wait();
+  shuffle_pipeline_stats_ = pool.GetStats().ToString();
+  VLOG(1) << "DatasetImpl<T>::LocalShuffleByPool() stats: "
+          << shuffle_pipeline_stats_;
+}
+
+template <typename T>
+std::string DatasetImpl<T>::GetPipelineStats() {
+  return "load: " + load_pipeline_stats_ +
+         "\nlocal_shuffle: " + shuffle_pipeline_stats_;
+}
+
 template <typename T>
 void DatasetImpl<T>::DumpWalkPath(std::string dump_path, size_t dump_rate) {
   VLOG(3) << "DatasetImpl<T>::DumpWalkPath() begin";
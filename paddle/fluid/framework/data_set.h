@@ -138,6 +138,9 @@ class Dataset {
   virtual int64_t GetPvDataSize() = 0;
   // get shuffle data size
   virtual int64_t GetShuffleDataSize() = 0;
+  // get the utilization of the work-stealing pool used by the last
+  // LoadIntoMemory and LocalShuffle with FLAGS_dataset_pipeline_load
+  virtual std::string GetPipelineStats() = 0;
   // merge by ins id
   virtual void MergeByInsId() = 0;
   // merge pv instance
@@ -258,6 +261,7 @@ class DatasetImpl : public Dataset {
   virtual int64_t GetMemoryDataSize();
   virtual int64_t GetPvDataSize();
   virtual int64_t GetShuffleDataSize();
+  virtual std::string GetPipelineStats();
   virtual void MergeByInsId() {}
   virtual void PreprocessInstance() {}
   virtual void PostprocessInstance() {}
@@ -316,6 +320,11 @@ class DatasetImpl : public Dataset {
     // TODO(yaoxuefeng) for SlotRecordDataset
     return -1;
   }
+  // split parsing and shuffling into tasks of a WorkStealingPool
+  virtual bool CanLoadByPool();
+  virtual void LoadIntoMemoryByPool();
+  virtual void LocalShuffleByPool(std::vector<T>* data);
+
   std::vector<std::shared_ptr<paddle::framework::DataFeed>> readers_;
   std::vector<std::shared_ptr<paddle::framework::DataFeed>> preload_readers_;
   paddle::framework::Channel<T> input_channel_;
@@ -378,6 +387,8 @@ class DatasetImpl : public Dataset {
   // vector: refer to multi gpu card.
   std::vector<std::shared_ptr<HashTable<uint64_t, uint32_t>>> keys2rank_tables_;
   uint32_t pass_id_ = 0;
+  std::string load_pipeline_stats_;
+  std::string shuffle_pipeline_stats_;
 };
 
 // use std::vector<MultiSlotType> or Record as data type
@@ -104,18 +104,19 @@ int AllInGpuGraphSampler::load_from_ssd(std::string path) {
             ->enqueue([&, i, this]() -> int {
               if (this->status == GraphSamplerStatus::terminating) return 0;
               paddle::framework::GpuPsNodeInfo info;
-              std::vector<paddle::distributed::Node *> &v =
-                  this->graph_table->shards[i]->get_bucket();
+              // read by position, shards in csr storage have no nodes
+              auto *shard = this->graph_table->shards[i];
               size_t ind = i % this->graph_table->task_pool_size_;
-              for (size_t j = 0; j < v.size(); j++) {
-                info.neighbor_size = v[j]->get_neighbor_size();
+              for (size_t j = 0; j < shard->get_size(); j++) {
+                info.neighbor_size = shard->get_neighbor_size(j);
                 info.neighbor_offset =
                     sample_neighbors_ex[ind][location].size();
                 sample_node_infos_ex[ind][location].emplace_back(info);
-                sample_node_ids_ex[ind][location].emplace_back(v[j]->get_id());
+                sample_node_ids_ex[ind][location].emplace_back(
+                    shard->get_node_id(j));
                 for (int k = 0; k < node.neighbor_size; k++)
                   sample_neighbors_ex[ind][location].push_back(
-                      v[j]->get_neighbor_id(k));
+                      shard->get_neighbor_id(j, k));
               }
               return 0;
             }));
@@ -19,6 +19,7 @@ limitations under the License. */
 #include <memory>
 
 #include "glog/logging.h"
+#include "paddle/fluid/framework/io/native_fs.h"
 #include "paddle/fluid/platform/enforce.h"
 
 namespace paddle {
@@ -110,8 +111,41 @@ size_t localfs_buffer_size() { return localfs_buffer_size_internal(); }
 
 void localfs_set_buffer_size(size_t x) { localfs_buffer_size_internal() = x; }
 
+static bool& localfs_native_io_internal() {
+  static bool x = true;
+  return x;
+}
+
+bool localfs_native_io() {
+  return localfs_native_io_internal() && native_fs_supported();
+}
+
+void localfs_set_native_io(bool x) { localfs_native_io_internal() = x; }
+
+static bool& localfs_direct_io_internal() {
+  static bool x = false;
+  return x;
+}
+
+bool localfs_direct_io() { return localfs_direct_io_internal(); }
+
+void localfs_set_direct_io(bool x) { localfs_direct_io_internal() = x; }
+
+static std::string fs_dirname_internal(const std::string& path) {
+  size_t pos = path.rfind('/');
+  return pos == std::string::npos ? "" : path.substr(0, pos);
+}
+
 std::shared_ptr<FILE> localfs_open_read(std::string path,
                                         const std::string& converter) {
+  if (converter.empty() && localfs_native_io()) {
+    return native_fopen(path,
+                        "r",
+                        fs_end_with_internal(path, ".gz"),
+                        localfs_buffer_size(),
+                        localfs_direct_io());
+  }
+
   bool is_pipe = false;
 
   if (fs_end_with_internal(path, ".gz")) {
@@ -124,6 +158,15 @@ std::shared_ptr<FILE> localfs_open_read(std::string path,
 
 std::shared_ptr<FILE> localfs_open_write(std::string path,
                                          const std::string& converter) {
+  if (converter.empty() && localfs_native_io()) {
+    native_mkdir(fs_dirname_internal(path));
+    return native_fopen(path,
+                        "w",
+                        fs_end_with_internal(path, ".gz"),
+                        localfs_buffer_size(),
+                        localfs_direct_io());
+  }
+
   shell_execute(
       string::format_string("mkdir -p $(dirname \"%s\")", path.c_str()));
 
@@ -139,6 +182,15 @@ std::shared_ptr<FILE> localfs_open_write(std::string path,
 
 std::shared_ptr<FILE> localfs_open_append_write(std::string path,
                                                 const std::string& converter) {
+  if (converter.empty() && localfs_native_io()) {
+    native_mkdir(fs_dirname_internal(path));
+    return native_fopen(path,
+                        "a",
+                        fs_end_with_internal(path, ".gz"),
+                        localfs_buffer_size(),
+                        localfs_direct_io());
+  }
+
   shell_execute(
       string::format_string("mkdir -p $(dirname \"%s\")", path.c_str()));
 
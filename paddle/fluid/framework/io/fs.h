@@ -35,6 +35,17 @@ extern size_t localfs_buffer_size();
 
 extern void localfs_set_buffer_size(size_t x);
 
+// Local files without a converter, including .gz ones, are read and written
+// in process instead of through shell pipelines. Enabled by default.
+extern bool localfs_native_io();
+
+extern void localfs_set_native_io(bool x);
+
+// Whether natively opened plain files use O_DIRECT. Disabled by default.
+extern bool localfs_direct_io();
+
+extern void localfs_set_direct_io(bool x);
+
 extern std::shared_ptr<FILE> localfs_open_read(std::string path,
                                                const std::string& converter);
 
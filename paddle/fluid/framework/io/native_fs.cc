@@ -0,0 +1,328 @@
+/* Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/framework/io/native_fs.h"
+
+#include "paddle/fluid/framework/io/shell.h"
+
+#if !defined(_WIN32) && !defined(__APPLE__) && !defined(PADDLE_ARM)
+#define PADDLE_NATIVE_FS
+#endif
+
+#ifdef PADDLE_NATIVE_FS
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#endif
+
+#include "glog/logging.h"
+#include "paddle/fluid/platform/enforce.h"
+
+namespace paddle {
+namespace framework {
+
+#ifdef PADDLE_NATIVE_FS
+
+namespace {
+
+const size_t kNativeBufferSize = 1 << 20;
+// O_DIRECT needs the buffer, the size and the file offset of every io
+// aligned to the logical block size, 4k covers the common devices
+const size_t kDirectAlignment = 4096;
+
+struct AlignedFree {
+  void operator()(char* p) const { free(p); }
+};
+
+struct NativeFile {
+  std::string path;
+  int fd = -1;
+  gzFile gz = nullptr;
+  bool write = false;
+  bool direct = false;
+  size_t buffer_size = 0;
+  // the FILE buffer, so that stdio calls us with large blocks
+  std::unique_ptr<char[]> stdio_buffer;
+  // O_DIRECT bounce buffer, data in [begin, end) is not consumed/written
+  std::unique_ptr<char, AlignedFree> direct_buffer;
+  size_t begin = 0;
+  size_t end = 0;
+};
+
+ssize_t ReadFull(int fd, char* buf, size_t size) {
+  size_t done = 0;
+  while (done < size) {
+    ssize_t n = read(fd, buf + done, size - done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      return -1;
+    }
+    if (n == 0) {
+      break;
+    }
+    done += n;
+  }
+  return done;
+}
+
+bool WriteFull(int fd, const char* buf, size_t size) {
+  while (size > 0) {
+    ssize_t n = write(fd, buf, size);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      return false;
+    }
+    buf += n;
+    size -= n;
+  }
+  return true;
+}
+
+ssize_t NativeRead(void* cookie, char* buf, size_t size) {
+  auto* file = static_cast<NativeFile*>(cookie);
+  if (file->gz != nullptr) {
+    return gzread(file->gz, buf, std::min<size_t>(size, INT_MAX));
+  }
+  if (!file->direct) {
+    ssize_t n = 0;
+    do {
+      n = read(file->fd, buf, size);
+    } while (n < 0 && errno == EINTR);
+    return n;
+  }
+  if (file->begin == file->end) {
+    ssize_t n =
+        ReadFull(file->fd, file->direct_buffer.get(), file->buffer_size);
+    if (n <= 0) {
+      return n;
+    }
+    file->begin = 0;
+    file->end = n;
+  }
+  size_t n = std::min(size, file->end - file->begin);
+  memcpy(buf, file->direct_buffer.get() + file->begin, n);
+  file->begin += n;
+  return n;
+}
+
+bool FlushDirect(NativeFile* file, bool last) {
+  size_t size = file->end;
+  size_t aligned = last ? size : size / kDirectAlignment * kDirectAlignment;
+  if (last && size % kDirectAlignment != 0) {
+    // the tail is not a whole block, write it through the page cache
+    int flags = fcntl(file->fd, F_GETFL);
+    if (flags < 0 || fcntl(file->fd, F_SETFL, flags & ~O_DIRECT) != 0) {
+      return false;
+    }
+    file->direct = false;
+  }
+  if (!WriteFull(file->fd, file->direct_buffer.get(), aligned)) {
+    return false;
+  }
+  memmove(file->direct_buffer.get(),
+          file->direct_buffer.get() + aligned,
+          size - aligned);
+  file->end = size - aligned;
+  return true;
+}
+
+ssize_t NativeWrite(void* cookie, const char* buf, size_t size) {
+  auto* file = static_cast<NativeFile*>(cookie);
+  if (file->gz != nullptr) {
+    size = std::min<size_t>(size, INT_MAX);
+    int n = gzwrite(file->gz, buf, size);
+    return n > 0 ? n : -1;
+  }
+  if (!file->direct) {
+    return WriteFull(file->fd, buf, size) ? size : -1;
+  }
+  size_t done = 0;
+  while (done < size) {
+    size_t n = std::min(size - done, file->buffer_size - file->end);
+    memcpy(file->direct_buffer.get() + file->end, buf + done, n);
+    file->end += n;
+    done += n;
+    if (file->end == file->buffer_size && !FlushDirect(file, false)) {
+      return -1;
+    }
+  }
+  return size;
+}
+
+int NativeClose(void* cookie) {
+  auto* file = static_cast<NativeFile*>(cookie);
+  bool ok = true;
+  if (file->gz != nullptr) {
+    // gzclose closes the descriptor as well
+    ok = gzclose(file->gz) == Z_OK;
+    file->gz = nullptr;
+    file->fd = -1;
+  }
+  if (file->write && file->direct && file->end > 0) {
+    ok = FlushDirect(file, true) && ok;
+  }
+  if (file->fd >= 0) {
+    ok = close(file->fd) == 0 && ok;
+    file->fd = -1;
+  }
+  return ok ? 0 : EOF;
+}
+
+}  // namespace
+
+bool native_fs_supported() { return true; }
+
+std::shared_ptr<FILE> native_fopen(const std::string& path,
+                                   const std::string& mode,
+                                   bool gzip,
+                                   size_t buffer_size,
+                                   bool direct_io) {
+  if (shell_verbose()) {
+    LOG(INFO) << "Opening file[" << path << "] with mode[" << mode
+              << "] natively";
+  }
+  int flags = 0;
+  if (mode == "r") {
+    flags = O_RDONLY;
+  } else if (mode == "w") {
+    flags = O_WRONLY | O_CREAT | O_TRUNC;
+  } else if (mode == "a") {
+    flags = O_WRONLY | O_CREAT | O_APPEND;
+    // appends start at unaligned offsets
+    direct_io = false;
+  } else {
+    PADDLE_THROW(common::errors::InvalidArgument(
+        "Unsupported mode[%s] of native file, path[%s].", mode, path));
+  }
+  std::unique_ptr<NativeFile> file(new NativeFile());
+  file->path = path;
+  file->write = mode != "r";
+  file->buffer_size = buffer_size > 0 ? buffer_size : kNativeBufferSize;
+  file->direct = direct_io && !gzip;
+  if (file->direct) {
+    file->buffer_size = (file->buffer_size + kDirectAlignment - 1) /
+                        kDirectAlignment * kDirectAlignment;
+    file->fd = open(path.c_str(), flags | O_DIRECT, 0644);
+    if (file->fd < 0 && errno == EINVAL) {
+      // e.g. tmpfs, fall back to the page cache
+      file->direct = false;
+    }
+  }
+  if (!file->direct) {
+    file->fd = open(path.c_str(), flags, 0644);
+  }
+  if (file->fd < 0) {
+    PADDLE_THROW(common::errors::Unavailable(
+        "Failed to open file, path[%s], mode[%s].", path, mode));
+  }
+  if (mode == "r") {
+    posix_fadvise(file->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  }
+  if (file->direct) {
+    void* buffer = nullptr;
+    PADDLE_ENFORCE_EQ(
+        posix_memalign(&buffer, kDirectAlignment, file->buffer_size),
+        0,
+        common::errors::ResourceExhausted(
+            "Failed to allocate %d bytes for file[%s].",
+            file->buffer_size,
+            path));
+    file->direct_buffer.reset(static_cast<char*>(buffer));
+  }
+  if (gzip) {
+    file->gz = gzdopen(file->fd, mode == "r" ? "rb" : "wb");
+    if (file->gz == nullptr) {
+      close(file->fd);
+      PADDLE_THROW(common::errors::Unavailable(
+          "Failed to open gzip stream, path[%s], mode[%s].", path, mode));
+    }
+    gzbuffer(file->gz, file->buffer_size);
+  }
+
+  cookie_io_functions_t io = {};
+  if (mode == "r") {
+    io.read = NativeRead;
+  } else {
+    io.write = NativeWrite;
+  }
+  io.close = NativeClose;
+  FILE* fp = fopencookie(file.get(), mode.c_str(), io);
+  if (fp == nullptr) {
+    NativeClose(file.get());
+    PADDLE_THROW(common::errors::Unavailable(
+        "Failed to open file stream, path[%s], mode[%s].", path, mode));
+  }
+  file->stdio_buffer.reset(new char[file->buffer_size]);
+  setvbuf(fp, file->stdio_buffer.get(), _IOFBF, file->buffer_size);
+  // the buffers are used by fclose, so they are released after it
+  return {fp, [file = file.release()](FILE* fp) {
+            std::unique_ptr<NativeFile> holder(file);
+            if (shell_verbose()) {
+              LOG(INFO) << "Closing file[" << holder->path << "]";
+            }
+            if (0 != fclose(fp)) {
+              PADDLE_THROW(common::errors::Unavailable(
+                  "Failed to close file, path[%s].", holder->path));
+            }
+          }};
+}
+
+void native_mkdir(const std::string& path) {
+  std::string dir;
+  size_t pos = 0;
+  while (pos != std::string::npos) {
+    pos = path.find('/', pos + 1);
+    dir = path.substr(0, pos);
+    if (dir.empty() || mkdir(dir.c_str(), 0755) == 0 || errno == EEXIST) {
+      continue;
+    }
+    PADDLE_THROW(common::errors::Unavailable(
+        "Failed to create directory[%s] of path[%s].", dir, path));
+  }
+}
+
+#else
+
+bool native_fs_supported() { return false; }
+
+std::shared_ptr<FILE> native_fopen(const std::string& path,
+                                   const std::string& mode,
+                                   bool gzip,
+                                   size_t buffer_size,
+                                   bool direct_io) {
+  PADDLE_THROW(common::errors::Unimplemented(
+      "Native file access is not supported on this platform."));
+  return nullptr;
+}
+
+void native_mkdir(const std::string& path) {
+  PADDLE_THROW(common::errors::Unimplemented(
+      "Native file access is not supported on this platform."));
+}
+
+#endif
+
+}  // namespace framework
+}  // namespace paddle
@@ -0,0 +1,45 @@
+/* Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#pragma once
+
+#include <stdio.h>
+
+#include <memory>
+#include <string>
+
+namespace paddle {
+namespace framework {
+
+// In-process access to local files, used by localfs instead of the zcat/gzip
+// pipelines and mkdir commands, which cost a fork and exec per file.
+
+// Whether native_fopen is available on this platform.
+extern bool native_fs_supported();
+
+// Opens a local file with mode "r", "w" or "a" as a FILE stream backed by a
+// buffer of `buffer_size` bytes (a default size if 0). With `gzip` the data
+// is (de)compressed by zlib in the calling thread. `direct_io` asks for
+// O_DIRECT on plain files, and is ignored where the file system refuses it.
+extern std::shared_ptr<FILE> native_fopen(const std::string& path,
+                                          const std::string& mode,
+                                          bool gzip,
+                                          size_t buffer_size,
+                                          bool direct_io);
+
+// Creates `path` and its missing parents, like mkdir -p.
+extern void native_mkdir(const std::string& path);
+
+}  // namespace framework
+}  // namespace paddle
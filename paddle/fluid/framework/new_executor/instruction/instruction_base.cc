@@ -186,6 +186,7 @@ static double GetDenseTensorEleSum(const Scope& scope,
 InstructionBase::InstructionBase(size_t id, const phi::Place& place)
     : next_instrs_in_different_thread_(),
       next_instrs_in_same_thread_(),
+      next_instrs_inline_(),
       events_to_wait_info_(),
       events_to_wait_(),
       gc_check_vars_(),
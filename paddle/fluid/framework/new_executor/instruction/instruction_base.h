@@ -83,6 +83,13 @@ class InstructionBase {
     next_instrs_in_same_thread_.push_back(id);
   }
 
+  // trivial successors that run right after this instruction, see
+  // ExecutionConfig::inline_trivial_instructions
+  const std::vector<size_t>& NextInstrsInline() const {
+    return next_instrs_inline_;
+  }
+  void AddNextInstrInline(size_t id) { next_instrs_inline_.push_back(id); }
+
   bool IsForceRecordEvent() const { return force_record_event_; }
   void SetForceRecordEvent(bool force_record) {
     force_record_event_ = force_record;
@@ -200,6 +207,8 @@ class InstructionBase {
 
   std::vector<size_t> next_instrs_in_same_thread_;
 
+  std::vector<size_t> next_instrs_inline_;
+
   bool force_record_event_{false};
 
   std::vector<std::string> events_to_wait_info_;
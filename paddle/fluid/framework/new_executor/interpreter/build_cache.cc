@@ -0,0 +1,318 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/new_executor/interpreter/build_cache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+#include "paddle/common/flags.h"
+#include "paddle/fluid/framework/new_executor/instruction/instruction_base.h"
+#include "paddle/fluid/framework/new_executor/instruction/phi_kernel_instruction.h"
+#include "paddle/fluid/framework/new_executor/interpreter/interpreter_util.h"
+#include "paddle/phi/core/device_context.h"
+
+COMMON_DECLARE_bool(new_executor_sequential_run);
+COMMON_DECLARE_bool(add_dependency_for_communication_op);
+
+namespace paddle {
+namespace framework {
+namespace interpreter {
+
+namespace {
+
+// bump it when the dependency analysis changes
+constexpr uint64_t kBuildCacheVersion = 2;
+constexpr char kBuildCacheMagic[8] = {'P', 'D', 'D', 'E', 'P', 'S', '0', '2'};
+
+class SignatureWriter {
+ public:
+  void Add(uint64_t value) {
+    signature_.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+  void Add(const std::string& str) {
+    Add(str.size());
+    signature_.append(str);
+  }
+  std::string Release() { return std::move(signature_); }
+
+ private:
+  std::string signature_;
+};
+
+void AddVarIds(
+    const std::unordered_map<::pir::Value, std::vector<int>>& value_to_ids,
+    SignatureWriter* writer) {
+  // the order of an unordered_map differs between processes
+  std::vector<int> ids;
+  for (auto& item : value_to_ids) {
+    ids.insert(ids.end(), item.second.begin(), item.second.end());
+  }
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+  writer->Add(ids.size());
+  for (int id : ids) {
+    writer->Add(static_cast<uint64_t>(id));
+  }
+}
+
+template <typename T>
+void WritePod(std::ostream& os, const T& value) {
+  os.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+bool ReadPod(std::istream& is, T* value) {
+  is.read(reinterpret_cast<char*>(value), sizeof(*value));
+  return static_cast<bool>(is);
+}
+
+}  // namespace
+
+DependencyBuildCache& DependencyBuildCache::Instance() {
+  static DependencyBuildCache* cache = new DependencyBuildCache;
+  return *cache;
+}
+
+std::string DependencyBuildCache::Signature(
+    const std::vector<paddle::framework::InstructionBase*>& instructions) {
+  SignatureWriter writer;
+  writer.Add(kBuildCacheVersion);
+  writer.Add(static_cast<uint64_t>(FLAGS_new_executor_sequential_run));
+  writer.Add(static_cast<uint64_t>(FLAGS_add_dependency_for_communication_op));
+  writer.Add(instructions.size());
+  for (auto* instr : instructions) {
+    writer.Add(instr->Name());
+    uint64_t kind = 0;
+    if (dynamic_cast<PhiKernelInstruction*>(instr) != nullptr) {
+      kind |= 1;
+    }
+    if (instr->Operation() != nullptr &&
+        IsCommunicationOp(instr->Operation())) {
+      kind |= 2;
+    }
+    writer.Add(kind);
+    // the passes add different dependencies for asynchronous kernels
+    writer.Add(static_cast<uint64_t>(instr->KernelType()));
+    writer.Add(instr->DeviceContext().GetPlace().DebugString());
+    AddVarIds(instr->Inputs(), &writer);
+    AddVarIds(instr->Outputs(), &writer);
+  }
+  return writer.Release();
+}
+
+uint64_t DependencyBuildCache::Hash(const std::string& signature) {
+  // FNV-1a, stable across processes unlike std::hash
+  uint64_t hash = 14695981039346656037ULL;
+  for (unsigned char byte : signature) {
+    hash = (hash ^ byte) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+bool DependencyBuildCache::Get(const std::string& signature,
+                               size_t op_num,
+                               const std::string& cache_dir,
+                               std::shared_ptr<DownstreamMap>* downstream_map,
+                               std::shared_ptr<HappensBefore>* happens_before) {
+  uint64_t hash = Hash(signature);
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto iter = entries_.find(hash);
+    if (iter != entries_.end()) {
+      auto cached_downstream_map = iter->second.downstream_map.lock();
+      auto cached_happens_before = iter->second.happens_before.lock();
+      // a hash collision is not a hit
+      if (cached_downstream_map && cached_happens_before &&
+          iter->second.signature == signature &&
+          cached_happens_before->size() == op_num) {
+        *downstream_map = cached_downstream_map;
+        *happens_before = cached_happens_before;
+        VLOG(4) << "Hit the dependency build cache in process, hash = "
+                << hash;
+        return true;
+      }
+      entries_.erase(iter);
+    }
+  }
+
+  if (cache_dir.empty()) {
+    return false;
+  }
+  auto loaded_downstream_map = std::make_shared<DownstreamMap>();
+  auto loaded_happens_before = std::make_shared<HappensBefore>();
+  if (!Load(FilePath(cache_dir, hash),
+            signature,
+            op_num,
+            loaded_downstream_map.get(),
+            loaded_happens_before.get())) {
+    return false;
+  }
+  VLOG(4) << "Hit the dependency build cache in " << cache_dir
+          << ", hash = " << hash;
+  *downstream_map = loaded_downstream_map;
+  *happens_before = loaded_happens_before;
+  std::lock_guard<std::mutex> guard(mutex_);
+  entries_[hash] = {signature, loaded_downstream_map, loaded_happens_before};
+  return true;
+}
+
+void DependencyBuildCache::Put(
+    const std::string& signature,
+    const std::string& cache_dir,
+    const std::shared_ptr<DownstreamMap>& downstream_map,
+    const std::shared_ptr<HappensBefore>& happens_before) {
+  uint64_t hash = Hash(signature);
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    entries_[hash] = {signature, downstream_map, happens_before};
+  }
+  if (cache_dir.empty()) {
+    return;
+  }
+  std::string path = FilePath(cache_dir, hash);
+  if (!Save(path, signature, *downstream_map, *happens_before)) {
+    LOG(WARNING) << "Failed to save the dependency build cache to " << path;
+  }
+}
+
+std::string DependencyBuildCache::FilePath(const std::string& cache_dir,
+                                           uint64_t hash) {
+  std::ostringstream os;
+  os << cache_dir << "/pir_dependency_" << std::hex << hash << ".bin";
+  return os.str();
+}
+
+bool DependencyBuildCache::Save(const std::string& path,
+                                const std::string& signature,
+                                const DownstreamMap& downstream_map,
+                                const HappensBefore& happens_before) {
+  // write aside and rename, so that readers never see a partial file
+  std::ostringstream tmp_path;
+  tmp_path << path << ".tmp" << std::random_device()();
+  {
+    std::ofstream os(tmp_path.str(), std::ios::binary | std::ios::trunc);
+    if (!os) {
+      return false;
+    }
+    os.write(kBuildCacheMagic, sizeof(kBuildCacheMagic));
+    WritePod<uint64_t>(os, signature.size());
+    os.write(signature.data(), signature.size());
+    size_t op_num = happens_before.size();
+    WritePod<uint64_t>(os, op_num);
+
+    WritePod<uint64_t>(os, downstream_map.size());
+    for (auto& item : downstream_map) {
+      WritePod<uint64_t>(os, item.first);
+      WritePod<uint64_t>(os, item.second.size());
+      for (size_t next : item.second) {
+        WritePod<uint64_t>(os, next);
+      }
+    }
+
+    // the matrix, one row of 64-bit words per instruction
+    std::vector<uint64_t> words((op_num + 63) / 64);
+    for (auto& row : happens_before) {
+      std::fill(words.begin(), words.end(), 0);
+      for (size_t j = 0; j < row.size(); ++j) {
+        if (row[j]) {
+          words[j / 64] |= 1ULL << (j % 64);
+        }
+      }
+      os.write(reinterpret_cast<const char*>(words.data()),
+               words.size() * sizeof(uint64_t));
+    }
+    if (!os) {
+      std::remove(tmp_path.str().c_str());
+      return false;
+    }
+  }
+  if (std::rename(tmp_path.str().c_str(), path.c_str()) != 0) {
+    std::remove(tmp_path.str().c_str());
+    return false;
+  }
+  return true;
+}
+
+bool DependencyBuildCache::Load(const std::string& path,
+                                const std::string& signature,
+                                size_t op_num,
+                                DownstreamMap* downstream_map,
+                                HappensBefore* happens_before) {
+  std::ifstream is(path, std::ios::binary);
+  if (!is) {
+    return false;
+  }
+  char magic[sizeof(kBuildCacheMagic)];
+  uint64_t signature_size = 0;
+  if (!is.read(magic, sizeof(magic)) ||
+      std::memcmp(magic, kBuildCacheMagic, sizeof(magic)) != 0 ||
+      !ReadPod(is, &signature_size) || signature_size != signature.size()) {
+    VLOG(4) << "Ignore the mismatched dependency build cache " << path;
+    return false;
+  }
+  // the whole signature, a hash collision is not a hit
+  std::string file_signature(signature_size, '\0');
+  uint64_t file_op_num = 0, entry_num = 0;
+  if (!is.read(&file_signature[0], signature_size) ||
+      file_signature != signature || !ReadPod(is, &file_op_num) ||
+      file_op_num != op_num || !ReadPod(is, &entry_num) || entry_num > op_num) {
+    VLOG(4) << "Ignore the mismatched dependency build cache " << path;
+    return false;
+  }
+
+  downstream_map->clear();
+  for (uint64_t i = 0; i < entry_num; ++i) {
+    uint64_t op = 0, next_num = 0;
+    if (!ReadPod(is, &op) || !ReadPod(is, &next_num) || op >= op_num ||
+        next_num > op_num) {
+      return false;
+    }
+    std::set<size_t>& nexts = (*downstream_map)[op];
+    for (uint64_t j = 0; j < next_num; ++j) {
+      uint64_t next = 0;
+      if (!ReadPod(is, &next) || next >= op_num) {
+        return false;
+      }
+      nexts.insert(next);
+    }
+  }
+
+  happens_before->assign(op_num, std::vector<bool>(op_num, false));
+  std::vector<uint64_t> words((op_num + 63) / 64);
+  for (size_t i = 0; i < op_num; ++i) {
+    if (!is.read(reinterpret_cast<char*>(words.data()),
+                 words.size() * sizeof(uint64_t))) {
+      return false;
+    }
+    std::vector<bool>& row = (*happens_before)[i];
+    for (size_t w = 0; w < words.size(); ++w) {
+      uint64_t word = words[w];
+      for (size_t j = w * 64; word != 0 && j < op_num; ++j, word >>= 1) {
+        if (word & 1) {
+          row[j] = true;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+}  // namespace interpreter
+}  // namespace framework
+}  // namespace paddle
@@ -0,0 +1,98 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace paddle {
+namespace framework {
+class InstructionBase;
+namespace interpreter {
+
+// DependencyBuildCache keeps the dependencies built by PirDependencyBuilder,
+// keyed by the signature of everything they are computed from: the names,
+// kinds, kernel types, places and read and written variables of the
+// instructions, and the flags changing the analysis. Entries are found by the
+// hash of the signature and only hit when the whole signature is equal. The
+// interpreters of a program share one copy while any of them is alive, and
+// with a cache directory the dependencies are also saved to disk, so that the
+// next process running the program skips the analysis.
+//
+// Only the dependency analysis is cached. Kernel selection and the
+// construction of the instructions run on every build, in parallel over the
+// ops with FLAGS_new_executor_build_num_threads.
+class DependencyBuildCache {
+ public:
+  using DownstreamMap = std::map<size_t, std::set<size_t>>;
+  using HappensBefore = std::vector<std::vector<bool>>;
+
+  static DependencyBuildCache& Instance();
+
+  static std::string Signature(
+      const std::vector<paddle::framework::InstructionBase*>& instructions);
+  static uint64_t Hash(const std::string& signature);
+
+  // Looks for the dependencies of the program of `signature`, with `op_num`
+  // instructions, in the process and then in `cache_dir` if not empty.
+  bool Get(const std::string& signature,
+           size_t op_num,
+           const std::string& cache_dir,
+           std::shared_ptr<DownstreamMap>* downstream_map,
+           std::shared_ptr<HappensBefore>* happens_before);
+
+  void Put(const std::string& signature,
+           const std::string& cache_dir,
+           const std::shared_ptr<DownstreamMap>& downstream_map,
+           const std::shared_ptr<HappensBefore>& happens_before);
+
+  static std::string FilePath(const std::string& cache_dir, uint64_t hash);
+
+  // Returns false when the file can not be written, or read back as the
+  // dependencies of the program of `signature` with `op_num` instructions.
+  static bool Save(const std::string& path,
+                   const std::string& signature,
+                   const DownstreamMap& downstream_map,
+                   const HappensBefore& happens_before);
+  static bool Load(const std::string& path,
+                   const std::string& signature,
+                   size_t op_num,
+                   DownstreamMap* downstream_map,
+                   HappensBefore* happens_before);
+
+ private:
+  DependencyBuildCache() = default;
+
+  struct Entry {
+    std::string signature;
+    std::weak_ptr<DownstreamMap> downstream_map;
+    std::weak_ptr<HappensBefore> happens_before;
+  };
+
+  std::mutex mutex_;
+  // by the hash of the signature
+  std::unordered_map<uint64_t, Entry> entries_;
+};
+
+}  // namespace interpreter
+}  // namespace framework
+}  // namespace paddle
@@ -14,12 +14,14 @@
 
 #include "paddle/fluid/framework/new_executor/interpreter/dependency_builder.h"
 
+#include <algorithm>
 #include <queue>
 #include <sstream>
 #include <stack>
 #include "paddle/common/flags.h"
 #include "paddle/fluid/framework/new_executor/instruction/instruction_base.h"
 #include "paddle/fluid/framework/new_executor/instruction/phi_kernel_instruction.h"
+#include "paddle/fluid/framework/new_executor/interpreter/build_cache.h"
 #include "paddle/fluid/framework/new_executor/interpreter/interpreter_util.h"
 #include "paddle/fluid/pir/dialect/operator/ir/pd_op.h"
 #include "paddle/phi/common/reduce_type.h"
@@ -41,6 +43,8 @@ PHI_DEFINE_EXPORTED_bool(new_executor_sequential_run,
                          "Enable sequential execution for standalone "
                          "executor, only applied to GPU OPs.");
 COMMON_DECLARE_int32(enable_adjust_op_order);
+COMMON_DECLARE_int32(new_executor_build_num_threads);
+COMMON_DECLARE_string(new_executor_build_cache_dir);
 // add debug info
 PHI_DEFINE_EXPORTED_bool(enable_dependency_builder_debug_info,
                          false,
@@ -526,32 +530,41 @@ void DependencyBuilder::ShrinkDownstreamMap() {
   // b: c
 
   // shrink, find the downstream op that has no other op in the
-  // downstream list happens before it
+  // downstream list happens before it. The ops are independent of each
+  // other, so they are shrunk in parallel.
+  std::vector<size_t> op_ids;
   for (size_t i = 0; i < op_num_; ++i) {
-    if (op_downstream_map_->find(i) == op_downstream_map_->end()) {
-      continue;
+    if (op_downstream_map_->find(i) != op_downstream_map_->end()) {
+      op_ids.push_back(i);
     }
-
-    std::set<size_t> minumum_nexts;
-    for (size_t item : op_downstream_map_->at(i)) {
-      bool not_after_any = true;
-      // find the op that is not executed after any
-      for (size_t other_item : op_downstream_map_->at(i)) {
-        if (OpHappensBefore(other_item, item)) {
-          VLOG(8) << "happens_before: " << other_item << "->" << item
-                  << ", so skip " << item;
-          not_after_any = false;
-          break;
+  }
+  std::vector<std::set<size_t>> minumum_nexts(op_ids.size());
+  ParallelFor(
+      op_ids.size(),
+      std::max(FLAGS_new_executor_build_num_threads, 1),
+      [this, &op_ids, &minumum_nexts](size_t k) {
+        size_t i = op_ids[k];
+        for (size_t item : op_downstream_map_->at(i)) {
+          bool not_after_any = true;
+          // find the op that is not executed after any
+          for (size_t other_item : op_downstream_map_->at(i)) {
+            if (OpHappensBefore(other_item, item)) {
+              VLOG(8) << "happens_before: " << other_item << "->" << item
+                      << ", so skip " << item;
+              not_after_any = false;
+              break;
+            }
+          }
+          if (not_after_any) {
+            VLOG(8) << "downstream op of " << i << ": " << item;
+            minumum_nexts[k].insert(item);
+          }
         }
-      }
-      if (not_after_any) {
-        VLOG(8) << "downstream op of " << i << ": " << item;
-        minumum_nexts.insert(item);
-      }
-    }
-    // NOTE(Ruibiao): op_happens_before will not be changed when shrink
-    // downstream map
-    (*op_downstream_map_)[i] = minumum_nexts;
+      });
+  // NOTE(Ruibiao): op_happens_before will not be changed when shrink
+  // downstream map
+  for (size_t k = 0; k < op_ids.size(); ++k) {
+    (*op_downstream_map_)[op_ids[k]] = std::move(minumum_nexts[k]);
   }
   VLOG(8) << "Finish shrink downstream map";
   VLOG(8) << "downstream count: " << CountDownstreamMap(*op_downstream_map_);
@@ -660,6 +673,21 @@ const std::map<size_t, std::set<size_t>>& PirDependencyBuilder::Build(
   instructions_ = instructions;
   op_num_ = instructions_.size();
 
+  DependencyBuildCache& build_cache = DependencyBuildCache::Instance();
+  std::string build_signature = DependencyBuildCache::Signature(instructions_);
+  const std::string& build_cache_dir = build_cache_dir_.empty()
+                                           ? FLAGS_new_executor_build_cache_dir
+                                           : build_cache_dir_;
+  if (build_cache.Get(build_signature,
+                      op_num_,
+                      build_cache_dir,
+                      &op_downstream_map_,
+                      &op_happens_before_)) {
+    VLOG(6) << "Load dependency from the build cache";
+    is_build_ = true;
+    return *op_downstream_map_;
+  }
+
   ops_before_.assign(op_num_, {});
   ops_behind_.assign(op_num_, {});
   op_happens_before_->assign(op_num_, std::vector<bool>(op_num_, false));
@@ -688,6 +716,10 @@ const std::map<size_t, std::set<size_t>>& PirDependencyBuilder::Build(
   VLOG(8) << "downstream_map: " << std::endl
           << StringizeDownstreamMap(*op_downstream_map_);
 
+  build_cache.Put(build_signature,
+                  build_cache_dir,
+                  op_downstream_map_,
+                  op_happens_before_);
   is_build_ = true;
 
   return *op_downstream_map_;
@@ -773,6 +805,38 @@ void PirDependencyBuilder::ShareDependencyFrom(
   is_build_ = true;
 }
 
+std::vector<size_t> PirDependencyBuilder::SortDownstreamByLocality(
+    const std::vector<paddle::framework::InstructionBase*>& instructions,
+    size_t op_idx,
+    const std::set<size_t>& downstream_ops) {
+  std::set<int> written_vars;
+  for (auto& item : instructions.at(op_idx)->Outputs()) {
+    written_vars.insert(item.second.begin(), item.second.end());
+  }
+  std::vector<std::pair<size_t, size_t>> shared_num_and_op;
+  for (size_t next_op : downstream_ops) {
+    size_t shared_num = 0;
+    for (auto& item : instructions.at(next_op)->Inputs()) {
+      for (int var : item.second) {
+        shared_num += written_vars.count(var);
+      }
+    }
+    shared_num_and_op.emplace_back(shared_num, next_op);
+  }
+  std::stable_sort(shared_num_and_op.begin(),
+                   shared_num_and_op.end(),
+                   [](const std::pair<size_t, size_t>& lhs,
+                      const std::pair<size_t, size_t>& rhs) {
+                     return lhs.first > rhs.first;
+                   });
+  std::vector<size_t> sorted_ops;
+  sorted_ops.reserve(shared_num_and_op.size());
+  for (auto& item : shared_num_and_op) {
+    sorted_ops.push_back(item.second);
+  }
+  return sorted_ops;
+}
+
 void DependencyBuilderSimplify::GetAllbehind() {
   auto update_op_happen_before = [this](size_t prior_op_idx,
                                         size_t posterior_op_idx) {
@@ -15,6 +15,7 @@
 #pragma once
 
 #include <map>
+#include <string>
 #include <vector>
 
 #include "paddle/fluid/framework/new_executor/instruction/instruction_base.h"
@@ -124,6 +125,12 @@ class PirDependencyBuilder : public DependencyBuilder {
 
   void ShareDependencyFrom(const PirDependencyBuilder& src);
 
+  // The directory of the DependencyBuildCache, taken by Build,
+  // FLAGS_new_executor_build_cache_dir if empty.
+  void SetBuildCacheDir(const std::string& build_cache_dir) {
+    build_cache_dir_ = build_cache_dir;
+  }
+
   bool IsSameDeviceContext(size_t op1, size_t op2) const {
     return &((instructions_)[op1]->DeviceContext()) ==
            &((instructions_)[op2]->DeviceContext());
@@ -131,12 +138,22 @@ class PirDependencyBuilder : public DependencyBuilder {
 
   const std::string& GetInstructionName(size_t op_idx) const override;
 
+  // Orders the downstream ops of op[op_idx] by the number of variables they
+  // read from its outputs, most first, then by index. It is a locality hint:
+  // the first of them that gets ready reuses the most data if it runs on the
+  // thread that ran op[op_idx].
+  static std::vector<size_t> SortDownstreamByLocality(
+      const std::vector<paddle::framework::InstructionBase*>& instructions,
+      size_t op_idx,
+      const std::set<size_t>& downstream_ops);
+
  private:
   void AddDependencyForCommunicationOp() override;
 
   void AddDependencyForRandomOp() override;
 
   std::vector<paddle::framework::InstructionBase*> instructions_;  // not_owned
+  std::string build_cache_dir_;
 };
 
 class DependencyBuilderSimplify {
@@ -142,7 +142,13 @@ void ExecutionConfig::Log(int log_level) {
           << "used_for_jit = " << used_for_jit << "\n"
           << "used_for_sot = " << used_for_sot << "\n"
           << "device_num_threads = " << device_num_threads << "\n"
-          << "host_num_threads = " << host_num_threads << "\n";
+          << "host_num_threads = " << host_num_threads << "\n"
+          << "locality_aware_schedule = " << locality_aware_schedule << "\n"
+          << "static_memory_plan = " << static_memory_plan << "\n"
+          << "inline_trivial_instructions = " << inline_trivial_instructions
+          << "\n"
+          << "numa_node = " << numa_node << "\n"
+          << "build_cache_dir = " << build_cache_dir << "\n";
 
   log_str << "force_root_scope_vars = [";
   for (const std::string& var : force_root_scope_vars) {
@@ -35,6 +35,30 @@ struct ExecutionConfig {
   size_t device_num_threads{0};
   size_t host_num_threads{0};
 
+  // Places the host instructions when they get ready instead of at build
+  // time: the ready successor sharing the most data with an instruction runs
+  // next on the same thread, the others are queued on that thread for idle
+  // threads to steal.
+  bool locality_aware_schedule{false};
+
+  // Packs the host intermediates into one arena planned after the first run,
+  // when their sizes are known, and keeps them there instead of allocating
+  // and garbage collecting them in every run. Only for static shapes on CPU.
+  bool static_memory_plan{false};
+
+  // Runs the cheap host instructions, metadata ops and ops on small tensors,
+  // right after their only predecessor on the same thread, instead of
+  // scheduling them through the work queue.
+  bool inline_trivial_instructions{false};
+
+  // The NUMA node the host instructions run on, -1 to take the node the
+  // thread creating the interpreter is bound to, if any.
+  int numa_node{-1};
+
+  // The directory the instruction dependencies are saved to and loaded from,
+  // see DependencyBuildCache, FLAGS_new_executor_build_cache_dir if empty.
+  std::string build_cache_dir;
+
   std::set<std::pair<int, std::string>>
       force_sync_ops;  // set{pair<op_id, name>}, -1 matches any op_id, ""
                        // matches any name
@@ -0,0 +1,305 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/new_executor/interpreter/instruction_statistics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+
+#include "paddle/phi/common/thread_data_registry.h"
+#include "paddle/phi/core/memory/stats.h"
+
+namespace paddle {
+namespace framework {
+namespace interpreter {
+
+namespace {
+
+std::atomic<uint64_t> next_statistics_uid{1};
+
+// the counters of a buffer have a single writer
+template <typename T>
+void Accumulate(std::atomic<T>* counter, T value) {
+  counter->store(counter->load(std::memory_order_relaxed) + value,
+                 std::memory_order_relaxed);
+}
+
+template <typename StatType>
+int64_t CurrentThreadStat() {
+  return phi::ThreadDataRegistry<StatType>::GetInstance()
+      .GetCurrentThreadData()
+      .current;
+}
+
+#define DEVICE_ALLOCATED_STAT_CASE(id) \
+  case id:                             \
+    return CurrentThreadStat<memory::DeviceMemoryStatAllocated##id>()
+
+std::string JsonEscape(const std::string& str) {
+  std::string res;
+  res.reserve(str.size());
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      res.push_back('\\');
+    }
+    res.push_back(c);
+  }
+  return res;
+}
+
+}  // namespace
+
+struct InstructionStatistics::Counter {
+  std::atomic<uint64_t> run_count{0};
+  std::atomic<uint64_t> sampled_count{0};
+  std::atomic<uint64_t> wall_time_ns{0};
+  std::atomic<uint64_t> queue_wait_ns{0};
+  std::atomic<int64_t> allocated_bytes{0};
+};
+
+struct InstructionStatistics::ThreadBuffer {
+  explicit ThreadBuffer(size_t size) : counters(new Counter[size]) {}
+  std::unique_ptr<Counter[]> counters;
+};
+
+double InstructionStatistics::Stat::AvgWallTimeUs() const {
+  return sampled_count == 0 ? 0.0 : wall_time_ns / 1000.0 / sampled_count;
+}
+
+double InstructionStatistics::Stat::AvgQueueWaitUs() const {
+  return sampled_count == 0 ? 0.0 : queue_wait_ns / 1000.0 / sampled_count;
+}
+
+double InstructionStatistics::Stat::AvgAllocatedBytes() const {
+  return sampled_count == 0 ? 0.0
+                            : static_cast<double>(allocated_bytes) /
+                                  static_cast<double>(sampled_count);
+}
+
+double InstructionStatistics::Stat::EstimatedTotalTimeMs() const {
+  return AvgWallTimeUs() * run_count / 1000.0;
+}
+
+InstructionStatistics::InstructionStatistics(uint32_t sample_period)
+    : sample_period_(sample_period), uid_(next_statistics_uid++) {}
+
+InstructionStatistics::~InstructionStatistics() = default;
+
+void InstructionStatistics::Reset(const std::vector<std::string>& names) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  names_ = names;
+  buffers_.clear();
+  run_index_ = 0;
+  uid_ = next_statistics_uid++;
+}
+
+bool InstructionStatistics::BeginRun() {
+  uint64_t index = run_index_.fetch_add(1, std::memory_order_relaxed);
+  return sample_period_ != 0 && index % sample_period_ == 0;
+}
+
+InstructionStatistics::ThreadBuffer*
+InstructionStatistics::CurrentThreadBuffer() {
+  // the buffers of this thread by uid, a cache of buffers_ that any number of
+  // interpreters share. uids are never reused, so the entries of destroyed
+  // or reset statistics are never hit, and the cache is dropped when it
+  // grows past kMaxCached of them.
+  constexpr size_t kMaxCached = 256;
+  thread_local std::unordered_map<uint64_t, ThreadBuffer*> cache;
+  thread_local uint64_t last_uid = 0;
+  thread_local ThreadBuffer* last_buffer = nullptr;
+
+  uint64_t uid = uid_.load(std::memory_order_acquire);
+  if (uid == last_uid) {
+    return last_buffer;
+  }
+  auto iter = cache.find(uid);
+  if (iter == cache.end()) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto& buffer = buffers_[std::this_thread::get_id()];
+    if (buffer == nullptr) {
+      buffer = std::make_unique<ThreadBuffer>(names_.size());
+    }
+    if (cache.size() >= kMaxCached) {
+      cache.clear();
+    }
+    iter = cache.emplace(uid, buffer.get()).first;
+  }
+  last_uid = uid;
+  last_buffer = iter->second;
+  return last_buffer;
+}
+
+void InstructionStatistics::AddRun(size_t instr_id) {
+  Counter& counter = CurrentThreadBuffer()->counters[instr_id];
+  Accumulate<uint64_t>(&counter.run_count, 1);
+}
+
+void InstructionStatistics::AddSample(size_t instr_id,
+                                      uint64_t wall_time_ns,
+                                      uint64_t queue_wait_ns,
+                                      int64_t allocated_bytes) {
+  Counter& counter = CurrentThreadBuffer()->counters[instr_id];
+  Accumulate<uint64_t>(&counter.sampled_count, 1);
+  Accumulate(&counter.wall_time_ns, wall_time_ns);
+  Accumulate(&counter.queue_wait_ns, queue_wait_ns);
+  Accumulate(&counter.allocated_bytes, allocated_bytes);
+}
+
+std::vector<InstructionStatistics::Stat> InstructionStatistics::Collect()
+    const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  std::vector<Stat> stats(names_.size());
+  for (size_t i = 0; i < names_.size(); ++i) {
+    stats[i].id = i;
+    stats[i].name = names_[i];
+  }
+  for (auto& item : buffers_) {
+    const Counter* counters = item.second->counters.get();
+    for (size_t i = 0; i < stats.size(); ++i) {
+      auto relaxed = std::memory_order_relaxed;
+      stats[i].run_count += counters[i].run_count.load(relaxed);
+      stats[i].sampled_count += counters[i].sampled_count.load(relaxed);
+      stats[i].wall_time_ns += counters[i].wall_time_ns.load(relaxed);
+      stats[i].queue_wait_ns += counters[i].queue_wait_ns.load(relaxed);
+      stats[i].allocated_bytes += counters[i].allocated_bytes.load(relaxed);
+    }
+  }
+  std::stable_sort(
+      stats.begin(), stats.end(), [](const Stat& a, const Stat& b) {
+        return a.EstimatedTotalTimeMs() > b.EstimatedTotalTimeMs();
+      });
+  return stats;
+}
+
+std::string InstructionStatistics::ToTable() const {
+  std::vector<Stat> stats = Collect();
+  double total_ms = 0;
+  for (auto& stat : stats) {
+    total_ms += stat.EstimatedTotalTimeMs();
+  }
+
+  std::ostringstream os;
+  os << "Instruction statistics, 1 of " << sample_period_
+     << " runs sampled\n";
+  os << std::left << std::setw(6) << "id" << std::setw(40) << "name"
+     << std::right << std::setw(12) << "runs" << std::setw(10) << "sampled"
+     << std::setw(14) << "avg time(us)" << std::setw(14) << "avg wait(us)"
+     << std::setw(16) << "avg alloc(B)" << std::setw(14) << "total(ms)"
+     << std::setw(9) << "ratio" << "\n";
+  os << std::fixed << std::setprecision(3);
+  for (auto& stat : stats) {
+    os << std::left << std::setw(6) << stat.id << std::setw(40) << stat.name
+       << std::right << std::setw(12) << stat.run_count << std::setw(10)
+       << stat.sampled_count << std::setw(14) << stat.AvgWallTimeUs()
+       << std::setw(14) << stat.AvgQueueWaitUs() << std::setw(16)
+       << stat.AvgAllocatedBytes() << std::setw(14)
+       << stat.EstimatedTotalTimeMs() << std::setw(8)
+       << std::setprecision(2)
+       << (total_ms > 0 ? stat.EstimatedTotalTimeMs() / total_ms * 100 : 0.0)
+       << "%" << std::setprecision(3) << "\n";
+  }
+  return os.str();
+}
+
+std::string InstructionStatistics::ToJson() const {
+  std::vector<Stat> stats = Collect();
+  std::ostringstream os;
+  os << "{\"sample_period\":" << sample_period_ << ",\"instructions\":[";
+  for (size_t i = 0; i < stats.size(); ++i) {
+    auto& stat = stats[i];
+    os << (i == 0 ? "" : ",") << "{\"id\":" << stat.id << ",\"name\":\""
+       << JsonEscape(stat.name) << "\",\"run_count\":" << stat.run_count
+       << ",\"sampled_count\":" << stat.sampled_count
+       << ",\"wall_time_ns\":" << stat.wall_time_ns
+       << ",\"queue_wait_ns\":" << stat.queue_wait_ns
+       << ",\"allocated_bytes\":" << stat.allocated_bytes
+       << ",\"estimated_total_time_ms\":" << stat.EstimatedTotalTimeMs()
+       << "}";
+  }
+  os << "]}";
+  return os.str();
+}
+
+uint64_t InstructionStatistics::NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+int64_t InstructionStatistics::ThreadAllocatedBytes(const phi::Place& place) {
+  if (phi::is_cpu_place(place) || phi::is_cuda_pinned_place(place)) {
+    return CurrentThreadStat<memory::HostMemoryStatAllocated0>();
+  }
+  switch (place.GetDeviceId()) {
+    DEVICE_ALLOCATED_STAT_CASE(0);
+    DEVICE_ALLOCATED_STAT_CASE(1);
+    DEVICE_ALLOCATED_STAT_CASE(2);
+    DEVICE_ALLOCATED_STAT_CASE(3);
+    DEVICE_ALLOCATED_STAT_CASE(4);
+    DEVICE_ALLOCATED_STAT_CASE(5);
+    DEVICE_ALLOCATED_STAT_CASE(6);
+    DEVICE_ALLOCATED_STAT_CASE(7);
+    DEVICE_ALLOCATED_STAT_CASE(8);
+    DEVICE_ALLOCATED_STAT_CASE(9);
+    DEVICE_ALLOCATED_STAT_CASE(10);
+    DEVICE_ALLOCATED_STAT_CASE(11);
+    DEVICE_ALLOCATED_STAT_CASE(12);
+    DEVICE_ALLOCATED_STAT_CASE(13);
+    DEVICE_ALLOCATED_STAT_CASE(14);
+    DEVICE_ALLOCATED_STAT_CASE(15);
+    default:
+      return 0;
+  }
+}
+
+#undef DEVICE_ALLOCATED_STAT_CASE
+
+InstructionStatisticsGuard::InstructionStatisticsGuard(
+    InstructionStatistics* statistics,
+    size_t instr_id,
+    bool sampled,
+    uint64_t ready_ns,
+    const phi::Place& place)
+    : statistics_(statistics),
+      instr_id_(instr_id),
+      sampled_(statistics != nullptr && sampled),
+      place_(place) {
+  if (sampled_) {
+    start_ns_ = InstructionStatistics::NowNs();
+    queue_wait_ns_ =
+        ready_ns != 0 && start_ns_ > ready_ns ? start_ns_ - ready_ns : 0;
+    start_bytes_ = InstructionStatistics::ThreadAllocatedBytes(place_);
+  }
+}
+
+InstructionStatisticsGuard::~InstructionStatisticsGuard() {
+  if (statistics_ == nullptr) {
+    return;
+  }
+  statistics_->AddRun(instr_id_);
+  if (sampled_) {
+    uint64_t wall_time_ns = InstructionStatistics::NowNs() - start_ns_;
+    int64_t allocated_bytes =
+        InstructionStatistics::ThreadAllocatedBytes(place_) - start_bytes_;
+    statistics_->AddSample(
+        instr_id_, wall_time_ns, queue_wait_ns_, allocated_bytes);
+  }
+}
+
+}  // namespace interpreter
+}  // namespace framework
+}  // namespace paddle
@@ -0,0 +1,125 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <unordered_map>
+#include <vector>
+
+#include "paddle/phi/common/place.h"
+
+namespace paddle {
+namespace framework {
+namespace interpreter {
+
+// Statistics of the instructions of an interpreter, cheap enough to stay on
+// without the profiler. Every run of an instruction is counted, and in one
+// run of the interpreter out of `sample_period` the instructions are also
+// measured: wall time, time waited in the work queue once ready, and bytes
+// allocated and kept by the running thread.
+//
+// The counters live in one buffer per thread, written by that thread alone
+// with relaxed loads and stores, and are only summed up by Collect.
+class InstructionStatistics {
+ public:
+  struct Stat {
+    size_t id{0};
+    std::string name;
+    uint64_t run_count{0};
+    uint64_t sampled_count{0};
+    // summed over the sampled runs
+    uint64_t wall_time_ns{0};
+    uint64_t queue_wait_ns{0};
+    int64_t allocated_bytes{0};
+
+    double AvgWallTimeUs() const;
+    double AvgQueueWaitUs() const;
+    double AvgAllocatedBytes() const;
+    // the wall time of all the runs, extrapolated from the sampled ones
+    double EstimatedTotalTimeMs() const;
+  };
+
+  explicit InstructionStatistics(uint32_t sample_period);
+  ~InstructionStatistics();
+
+  // Drops the counters and starts over with the instructions `names`.
+  void Reset(const std::vector<std::string>& names);
+  size_t Size() const { return names_.size(); }
+  uint32_t SamplePeriod() const { return sample_period_; }
+
+  // Called when the interpreter starts a run, returns whether the
+  // instructions of this run are measured.
+  bool BeginRun();
+
+  void AddRun(size_t instr_id);
+  void AddSample(size_t instr_id,
+                 uint64_t wall_time_ns,
+                 uint64_t queue_wait_ns,
+                 int64_t allocated_bytes);
+
+  // The counters of all the threads, by decreasing estimated total time.
+  std::vector<Stat> Collect() const;
+  std::string ToTable() const;
+  std::string ToJson() const;
+
+  static uint64_t NowNs();
+  // the bytes allocated and not yet freed by the current thread on `place`
+  static int64_t ThreadAllocatedBytes(const phi::Place& place);
+
+ private:
+  struct Counter;
+  struct ThreadBuffer;
+
+  ThreadBuffer* CurrentThreadBuffer();
+
+  const uint32_t sample_period_;
+  std::atomic<uint64_t> run_index_{0};
+  // changes on Reset, so that threads drop their cached buffers
+  std::atomic<uint64_t> uid_;
+  std::vector<std::string> names_;
+
+  mutable std::mutex mutex_;
+  std::unordered_map<std::thread::id, std::unique_ptr<ThreadBuffer>> buffers_;
+};
+
+// Counts a run of an instruction, and measures it in a sampled run.
+class InstructionStatisticsGuard {
+ public:
+  // `ready_ns` is when the instruction got ready, 0 when unknown.
+  InstructionStatisticsGuard(InstructionStatistics* statistics,
+                             size_t instr_id,
+                             bool sampled,
+                             uint64_t ready_ns,
+                             const phi::Place& place);
+  ~InstructionStatisticsGuard();
+
+ private:
+  InstructionStatistics* statistics_;
+  size_t instr_id_;
+  bool sampled_;
+  phi::Place place_;
+  uint64_t start_ns_{0};
+  uint64_t queue_wait_ns_{0};
+  int64_t start_bytes_{0};
+};
+
+}  // namespace interpreter
+}  // namespace framework
+}  // namespace paddle
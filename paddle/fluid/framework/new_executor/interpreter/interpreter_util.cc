@@ -15,6 +15,9 @@
 #include "paddle/fluid/framework/new_executor/interpreter/interpreter_util.h"
 
 #include <algorithm>
+#include <atomic>
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
 
 #include "paddle/common/flags.h"
 #include "paddle/fluid/distributed/auto_parallel/dist_attr.h"
@@ -30,6 +33,7 @@
 #include "paddle/fluid/operators/controlflow/pylayer_op_helper.h"
 #include "paddle/fluid/operators/controlflow/while_op_helper.h"
 #include "paddle/fluid/operators/ops_extra_info.h"
+#include "paddle/fluid/pir/dialect/kernel/ir/kernel_type.h"
 #include "paddle/fluid/pir/dialect/operator/interface/op_yaml_info.h"
 #include "paddle/fluid/pir/dialect/operator/ir/op_dialect.h"
 #include "paddle/fluid/pir/dialect/operator/ir/pd_op.h"
@@ -188,6 +192,50 @@ bool IsCpuOp(paddle::framework::InstructionBase* instr) {
   return phi::is_cpu_place(instr->DeviceContext().GetPlace());
 }
 
+bool IsTrivialInstruction(const paddle::framework::InstructionBase* instr,
+                          int64_t max_numel) {
+  if (instr->KernelType() != OpFuncType::kCpuSync) {
+    return false;
+  }
+  const ::pir::Operation* op = instr->Operation();
+  if (op == nullptr || op->num_regions() > 0 || IsCommunicationOp(op)) {
+    return false;
+  }
+  static const std::unordered_set<std::string> metadata_instr_names = {
+      "builtin_combine_instruction",
+      "pd_op.shape",
+      "pd_op.full_int_array",
+      "pd_op.reshape_",
+      "pd_op.squeeze_",
+      "pd_op.unsqueeze_",
+  };
+  if (metadata_instr_names.count(instr->Name())) {
+    return true;
+  }
+  if (op->num_results() == 0) {
+    return false;
+  }
+  for (size_t i = 0; i < op->num_results(); ++i) {
+    auto type = op->result(i).type();
+    if (!type || !type.isa<paddle::dialect::AllocatedDenseTensorType>()) {
+      return false;
+    }
+    const phi::DDim& dims =
+        type.dyn_cast<paddle::dialect::AllocatedDenseTensorType>().dims();
+    int64_t numel = 1;
+    for (int j = 0; j < dims.size(); ++j) {
+      if (dims[j] < 0 || dims[j] > max_numel) {
+        return false;
+      }
+      numel *= dims[j];
+      if (numel > max_numel) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
 bool IsGradOp(const std::string& op_name) {
   return paddle::string::ends_with(op_name, "_grad");
 }
@@ -197,6 +245,49 @@ bool IsSupportedHeterPlace(const phi::Place& place) {
          phi::is_ipu_place(place) || phi::is_custom_place(place);
 }
 
+void ParallelFor(size_t num_tasks,
+                 size_t num_threads,
+                 const std::function<void(size_t)>& task) {
+  num_threads = std::min(num_threads, num_tasks);
+  if (num_threads <= 1) {
+    for (size_t i = 0; i < num_tasks; ++i) {
+      task(i);
+    }
+    return;
+  }
+
+  std::atomic<size_t> next_task{0};
+  std::mutex exception_mutex;
+  std::exception_ptr exception;
+  auto worker = [&]() {
+    for (size_t i = next_task++; i < num_tasks; i = next_task++) {
+      try {
+        task(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> guard(exception_mutex);
+        if (exception == nullptr) {
+          exception = std::current_exception();
+        }
+        next_task = num_tasks;
+        return;
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads - 1);
+  for (size_t i = 1; i < num_threads; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (exception != nullptr) {
+    std::rethrow_exception(exception);
+  }
+}
+
 bool IsMemcpyD2H(const Instruction& instr) {
   return instr.OpBase()->Type() == kMemcpyD2H;
 }
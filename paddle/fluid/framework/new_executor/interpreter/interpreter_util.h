@@ -15,6 +15,7 @@
 #pragma once
 
 #include <chrono>
+#include <functional>
 #include <iostream>
 #include <map>
 #include <memory>
@@ -80,6 +81,13 @@ bool IsCpuOp(const paddle::framework::InstructionBase& instr);
 
 bool IsCpuOp(const paddle::framework::InstructionBase* instr);
 
+// Whether the instruction is cheap enough to run right after its
+// predecessor instead of being scheduled: a host instruction that only
+// touches metadata, or whose outputs are dense tensors of static shapes
+// with at most `max_numel` elements.
+bool IsTrivialInstruction(const paddle::framework::InstructionBase* instr,
+                          int64_t max_numel = 1024);
+
 bool IsGradOp(const std::string& op_name);
 
 bool IsMemcpyD2H(const Instruction& instr);
@@ -94,6 +102,12 @@ bool IsMemcpyOp(const Instruction& instr);
 
 bool IsSupportedHeterPlace(const phi::Place& place);
 
+// Runs task(i) for every i in [0, num_tasks) on up to `num_threads` threads,
+// the calling one included, and rethrows the first exception of the tasks.
+void ParallelFor(size_t num_tasks,
+                 size_t num_threads,
+                 const std::function<void(size_t)>& task);
+
 void AddFetch(const std::vector<std::string>& fetch_names,
               framework::BlockDesc* block);
 
@@ -0,0 +1,118 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/new_executor/interpreter/static_memory_plan.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#include "paddle/common/enforce.h"
+
+namespace paddle {
+namespace framework {
+namespace interpreter {
+
+StaticMemoryPlanner::StaticMemoryPlanner(
+    std::function<bool(size_t, size_t)> happens_before)
+    : happens_before_(std::move(happens_before)), arena_size_(0) {
+  PADDLE_ENFORCE_NOT_NULL(
+      happens_before_,
+      common::errors::InvalidArgument(
+          "The happens-before function of StaticMemoryPlanner is null."));
+}
+
+size_t StaticMemoryPlanner::AddBuffer(size_t bytes,
+                                      size_t def,
+                                      const std::vector<size_t>& users) {
+  Buffer buffer;
+  buffer.size = (bytes + kAlignment - 1) / kAlignment * kAlignment;
+  buffer.def = def;
+  buffer.users = users;
+  buffer.users.push_back(def);
+  buffer.offset = 0;
+  buffers_.push_back(std::move(buffer));
+  return buffers_.size() - 1;
+}
+
+bool StaticMemoryPlanner::DeadBefore(const Buffer& buffer,
+                                     size_t op_idx) const {
+  for (size_t user : buffer.users) {
+    if (!happens_before_(user, op_idx)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool StaticMemoryPlanner::Conflict(const Buffer& a, const Buffer& b) const {
+  return !DeadBefore(a, b.def) && !DeadBefore(b, a.def);
+}
+
+size_t StaticMemoryPlanner::Plan() {
+  std::vector<size_t> order(buffers_.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+    return buffers_[a].size > buffers_[b].size;
+  });
+
+  arena_size_ = 0;
+  std::vector<size_t> placed;
+  std::vector<std::pair<size_t, size_t>> busy;  // [begin, end)
+  for (size_t idx : order) {
+    Buffer& buffer = buffers_[idx];
+    busy.clear();
+    for (size_t other : placed) {
+      if (Conflict(buffer, buffers_[other])) {
+        busy.emplace_back(buffers_[other].offset,
+                          buffers_[other].offset + buffers_[other].size);
+      }
+    }
+    std::sort(busy.begin(), busy.end());
+
+    // best fit among the gaps, or after the last conflicting buffer
+    size_t best_offset = 0;
+    size_t best_gap = std::numeric_limits<size_t>::max();
+    size_t end = 0;
+    for (auto& range : busy) {
+      if (range.first > end) {
+        size_t gap = range.first - end;
+        if (gap >= buffer.size && gap < best_gap) {
+          best_gap = gap;
+          best_offset = end;
+        }
+      }
+      end = std::max(end, range.second);
+    }
+    buffer.offset =
+        best_gap == std::numeric_limits<size_t>::max() ? end : best_offset;
+    arena_size_ = std::max(arena_size_, buffer.offset + buffer.size);
+    placed.push_back(idx);
+  }
+  return arena_size_;
+}
+
+size_t StaticMemoryPlanner::TotalSize() const {
+  size_t total = 0;
+  for (auto& buffer : buffers_) {
+    total += buffer.size;
+  }
+  return total;
+}
+
+}  // namespace interpreter
+}  // namespace framework
+}  // namespace paddle
@@ -0,0 +1,74 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <functional>
+#include <vector>
+
+namespace paddle {
+namespace framework {
+namespace interpreter {
+
+// StaticMemoryPlanner assigns the buffers of a program offsets in one arena,
+// so that two buffers share bytes only when one of them is dead before the
+// other is written. A buffer is written by one instruction and read by some
+// others; it is dead for a buffer written by `def` when all of its users
+// happen before `def`. Using the happens-before relation of the dependency
+// builder instead of a linear order keeps the plan valid for any schedule of
+// the multi-thread executor.
+class StaticMemoryPlanner {
+ public:
+  static constexpr size_t kAlignment = 64;
+
+  // happens_before(i, j) tells whether instruction i always finishes before
+  // instruction j starts.
+  explicit StaticMemoryPlanner(
+      std::function<bool(size_t, size_t)> happens_before);
+
+  // Adds a buffer of `bytes` written by the instruction `def` and used by
+  // `users`, and returns its index.
+  size_t AddBuffer(size_t bytes, size_t def, const std::vector<size_t>& users);
+
+  // Places the buffers, largest first, into the smallest gap left between
+  // the buffers they conflict with. Returns the size of the arena.
+  size_t Plan();
+
+  size_t BufferNum() const { return buffers_.size(); }
+  size_t Offset(size_t buffer) const { return buffers_.at(buffer).offset; }
+  // the aligned size of the buffer
+  size_t Size(size_t buffer) const { return buffers_.at(buffer).size; }
+  size_t ArenaSize() const { return arena_size_; }
+  // the arena size needed without reuse
+  size_t TotalSize() const;
+
+ private:
+  struct Buffer {
+    size_t size;
+    size_t def;
+    std::vector<size_t> users;
+    size_t offset;
+  };
+
+  bool DeadBefore(const Buffer& buffer, size_t op_idx) const;
+  bool Conflict(const Buffer& a, const Buffer& b) const;
+
+  std::function<bool(size_t, size_t)> happens_before_;
+  std::vector<Buffer> buffers_;
+  size_t arena_size_;
+};
+
+}  // namespace interpreter
+}  // namespace framework
+}  // namespace paddle
@@ -26,6 +26,7 @@
 #include "paddle/fluid/framework/new_executor/garbage_collector/garbage_collector.h"
 #include "paddle/fluid/framework/new_executor/interpreter/dependency_builder.h"
 #include "paddle/fluid/framework/new_executor/interpreter/execution_config.h"
+#include "paddle/fluid/framework/new_executor/interpreter/instruction_statistics.h"
 #include "paddle/fluid/framework/new_executor/interpreter/interpreter_util.h"
 #include "paddle/fluid/framework/new_executor/interpreter/stream_analyzer.h"
 #include "paddle/fluid/framework/new_executor/new_executor_defs.h"
@@ -41,6 +42,8 @@ COMMON_DECLARE_bool(new_executor_serial_run);
 PD_DECLARE_bool(new_executor_static_build);
 PD_DECLARE_bool(new_executor_use_inplace);
 PD_DECLARE_bool(new_executor_use_local_scope);
+PD_DECLARE_int32(new_executor_instruction_stats_sample_period);
+PD_DECLARE_int32(new_executor_build_num_threads);
 
 COMMON_DECLARE_bool(check_nan_inf);
 COMMON_DECLARE_bool(benchmark);
@@ -119,6 +122,11 @@ class InterpreterBaseImpl {
 
   virtual std::tuple<double, double> InterpreterRunTime() = 0;
 
+  // The run counts and sampled costs of the instructions, as a table or as
+  // JSON, see FLAGS_new_executor_instruction_stats_sample_period. Empty when
+  // the statistics are disabled.
+  virtual std::string DumpInstructionStatistics(bool as_json) const = 0;
+
   // Only for debug
   virtual Variable* DebugVar(const std::string& name) const = 0;
 };
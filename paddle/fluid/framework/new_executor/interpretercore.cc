@@ -34,6 +34,22 @@ PHI_DEFINE_EXPORTED_bool(new_executor_use_local_scope,
                          true,
                          "Use local_scope in new executor(especially used "
                          "in UT), can turn off for better performance");
+PHI_DEFINE_EXPORTED_int32(
+    new_executor_instruction_stats_sample_period,
+    64,
+    "Count the runs of every instruction of the new executor, and measure "
+    "them in one run out of this period, 0 to disable.");
+PHI_DEFINE_EXPORTED_int32(
+    new_executor_build_num_threads,
+    0,
+    "The number of threads to create the kernel instructions and analyse "
+    "the dependencies of the new executor with, 0 or 1 to build serially.");
+PHI_DEFINE_EXPORTED_string(
+    new_executor_build_cache_dir,
+    "",
+    "The directory to save the dependencies of the new executor programs in, "
+    "keyed by the hash of their instructions, and to load them from in later "
+    "builds. Empty to only share them inside the process.");
 
 namespace paddle::framework {
 
@@ -165,6 +181,10 @@ std::shared_ptr<ProgramDesc> InterpreterCore::GetMutableCopyProgram() {
   return impl_->GetMutableCopyProgram();
 }
 
+std::string InterpreterCore::DumpInstructionStatistics(bool as_json) const {
+  return impl_->DumpInstructionStatistics(as_json);
+}
+
 Variable* InterpreterCore::DebugVar(const std::string& name) const {
   return impl_->DebugVar(name);
 }
@@ -100,6 +100,9 @@ class InterpreterCore {
 
   std::tuple<double, double> InterpreterRunTime();
 
+  // see InterpreterBaseImpl::DumpInstructionStatistics
+  std::string DumpInstructionStatistics(bool as_json = false) const;
+
   // Only for debug
   TEST_API Variable* DebugVar(const std::string& name) const;
 
@@ -22,10 +22,12 @@
 #include "paddle/fluid/framework/details/nan_inf_utils.h"
 #include "paddle/fluid/framework/new_executor/interpreter/interpreter_util.h"
 #include "paddle/fluid/framework/new_executor/interpreter/static_build.h"
+#include "paddle/fluid/framework/new_executor/interpreter/static_memory_plan.h"
 #include "paddle/fluid/framework/operator.h"
 #include "paddle/fluid/platform/profiler/supplement_tracing.h"
 #include "paddle/phi/common/place.h"
 #include "paddle/phi/core/kernel_context.h"
+#include "paddle/phi/core/memory/allocation/numa_cpu_allocator.h"
 #include "paddle/phi/core/os_info.h"
 #include "paddle/phi/core/platform/device/gpu/gpu_info.h"
 #include "paddle/phi/core/platform/profiler/event_tracing.h"
@@ -186,6 +188,11 @@ PirInterpreter::PirInterpreter(const phi::Place& place,
   // TODO(zhangbo): delete var_scope
   var_scope_.SetLocalScope(local_scope_);
 
+  if (execution_config_.numa_node < 0) {
+    // follow the NUMA node of the thread creating the interpreter
+    execution_config_.numa_node =
+        memory::allocation::CurrentThreadBoundNumaNode();
+  }
   execution_config_.AnalyzeThreadPoolConfig(place, 1);
   execution_config_.Log(/*log_level=*/8);
 
@@ -277,6 +284,11 @@ PirInterpreter::PirInterpreter(
   // TODO(zhangbo): delete var_scope
   var_scope_.SetLocalScope(local_scope_);
 
+  if (execution_config_.numa_node < 0) {
+    // follow the NUMA node of the thread creating the interpreter
+    execution_config_.numa_node =
+        memory::allocation::CurrentThreadBoundNumaNode();
+  }
   execution_config_.AnalyzeThreadPoolConfig(place, 1);
   execution_config_.Log(/*log_level=*/8);
 
@@ -303,6 +315,9 @@ PirInterpreter::~PirInterpreter() {
   // cancel gc's thread
   gc_.reset(nullptr);
   async_work_queue_.reset();
+  // the scope may be gone already, so the tensors in it are not touched: the
+  // slices of the static memory plan own the arena, and it is freed with the
+  // last tensor that still holds one of them
   VLOG(4) << "~PirInterpreter(): " << this << " on " << place_;
 
 #ifdef PADDLE_WITH_DNNL
@@ -399,6 +414,14 @@ std::tuple<double, double> PirInterpreter::InterpreterRunTime() {
   return std::make_tuple(start_time, end_time);
 }
 
+std::string PirInterpreter::DumpInstructionStatistics(bool as_json) const {
+  if (instruction_statistics_ == nullptr) {
+    return "";
+  }
+  return as_json ? instruction_statistics_->ToJson()
+                 : instruction_statistics_->ToTable();
+}
+
 const interpreter::PirDependencyBuilder&
 PirInterpreter::GetPirDependencyBuilder() const {
   return ir_dependency_builder_;
@@ -805,6 +828,11 @@ void PirInterpreter::BuildInstruction() {
   VLOG(6) << "Build Instructions for pir ... ";
   vec_instruction_base_.clear();
   size_t op_idx = 0;
+  // The kernel instructions only read the program and the variables, and
+  // are created in parallel after the others. Communication ops set up the
+  // communication context of their device context and stay serial.
+  bool parallel_build = FLAGS_new_executor_build_num_threads > 1;
+  std::vector<std::pair<size_t, ::pir::Operation*>> parallel_build_ops;
   for (auto& op : *ir_block_) {
     VLOG(6) << "Build Instruction for op: " << op_idx;
     if (op.dialect()->name() == "builtin") {
@@ -927,6 +955,9 @@ void PirInterpreter::BuildInstruction() {
       if (op_name == "pd_op.share_var") continue;
       if (op.isa<paddle::dialect::LegacyKernelOp>()) {  // NOLINT
         CREATE_INSTR(LegacyKernelInstruction);
+      } else if (parallel_build && !interpreter::IsCommunicationOp(&op)) {
+        parallel_build_ops.emplace_back(op_idx++, &op);
+        vec_instruction_base_.emplace_back(nullptr);
       } else {
         CREATE_INSTR(PhiKernelInstruction);
       }
@@ -960,6 +991,20 @@ void PirInterpreter::BuildInstruction() {
           "and cinn dialect."));
     }
   }
+
+  interpreter::ParallelFor(
+      parallel_build_ops.size(),
+      FLAGS_new_executor_build_num_threads,
+      [this, &parallel_build_ops](size_t i) {
+        size_t instr_id = parallel_build_ops[i].first;
+        vec_instruction_base_[instr_id] =
+            std::make_unique<PhiKernelInstruction>(instr_id,
+                                                   place_,
+                                                   parallel_build_ops[i].second,
+                                                   value_exe_info_.get());
+      });
+  VLOG(6) << "Built " << parallel_build_ops.size()
+          << " kernel instructions in parallel";
 }
 
 std::string PirInterpreter::DebugInstructions() {
@@ -1086,16 +1131,58 @@ void PirInterpreter::BuildInstructionDependences() {
   for (auto& instr : vec_instruction_base_) {
     instructions_ptr.push_back(instr.get());
   }
+  ir_dependency_builder_.SetBuildCacheDir(execution_config_.build_cache_dir);
   auto downstream_map = ir_dependency_builder_.Build(instructions_ptr);
 
+  // A trivial instruction with a single predecessor runs right after it, on
+  // the same thread, see RunInstructionBaseAsync. Chains of them make
+  // segments that run back-to-back without touching the work queue.
+  std::vector<bool> inline_instrs;
+  if (execution_config_.inline_trivial_instructions &&
+      !FLAGS_new_executor_serial_run) {
+    std::vector<size_t> in_degree(instr_num, 0);
+    for (auto& item : downstream_map) {
+      for (size_t next_instr_id : item.second) {
+        ++in_degree[next_instr_id];
+      }
+    }
+    inline_instrs.assign(instr_num, false);
+    for (size_t instr_id = 0; instr_id < instr_num; ++instr_id) {
+      inline_instrs[instr_id] =
+          in_degree[instr_id] == 1 &&
+          interpreter::IsTrivialInstruction(instructions_ptr[instr_id]);
+    }
+  }
+
   for (size_t instr_id = 0; instr_id < instr_num; ++instr_id) {
     InstructionBase* cur_instr = vec_instruction_base_[instr_id].get();
-    const std::set<size_t>& next_instr_ids = downstream_map[instr_id];
+    std::set<size_t> scheduled_instr_ids;
+    const std::set<size_t>* next_instr_ids_ptr = &downstream_map[instr_id];
+    if (!inline_instrs.empty() &&
+        cur_instr->KernelType() != OpFuncType::kGpuAsync) {
+      for (size_t next_instr_id : *next_instr_ids_ptr) {
+        if (inline_instrs[next_instr_id]) {
+          cur_instr->AddNextInstrInline(next_instr_id);
+        } else {
+          scheduled_instr_ids.insert(next_instr_id);
+        }
+      }
+      next_instr_ids_ptr = &scheduled_instr_ids;
+    }
+    const std::set<size_t>& next_instr_ids = *next_instr_ids_ptr;
 
     if (FLAGS_new_executor_serial_run) {
       for (size_t next_instr_id : next_instr_ids) {
         cur_instr->AddNextInstrInSameThread(next_instr_id);
       }
+    } else if (execution_config_.locality_aware_schedule &&
+               cur_instr->KernelType() != OpFuncType::kGpuAsync) {
+      // placed when they get ready, see RunNextInstructions
+      for (size_t next_instr_id :
+           interpreter::PirDependencyBuilder::SortDownstreamByLocality(
+               instructions_ptr, instr_id, next_instr_ids)) {
+        cur_instr->AddNextInstrInDifferentThread(next_instr_id);
+      }
     } else {
       if (cur_instr->KernelType() == OpFuncType::kGpuAsync) {
         for (size_t next_instr_id : next_instr_ids) {
@@ -1122,7 +1209,7 @@ void PirInterpreter::BuildInstructionDependences() {
     }
 
     if (!is_shared_results_build_) {
-      for (size_t next_instr_id : next_instr_ids) {
+      for (size_t next_instr_id : downstream_map[instr_id]) {
         ++(*dependency_count_)[next_instr_id];
       }
     }
@@ -1301,6 +1388,12 @@ void PirInterpreter::CheckGC(InstructionBase* instr) {
       continue;
     }
 
+    if (!static_memory_planned_.empty() && static_memory_planned_[var_id]) {
+      VLOG(4) << value_exe_info_->GetNameById(static_cast<int>(var_id))
+              << " lives in the static memory plan, skip gc";
+      continue;
+    }
+
     if (is_ready) {
       VLOG(6) << "Async delete variable with name : "
               << value_exe_info_->GetNameById(static_cast<int>(var_id));
@@ -1314,6 +1407,161 @@ void PirInterpreter::CheckGC(InstructionBase* instr) {
   instr->ClearEagerGCVars();
 }
 
+bool PirInterpreter::UseStaticMemoryPlan() const {
+  if (!execution_config_.static_memory_plan || !phi::is_cpu_place(place_) ||
+      execution_config_.used_for_control_flow_op) {
+    return false;
+  }
+  // the sub blocks of control flow ops run on the variables of this block
+  for (auto& instr : vec_instruction_base_) {
+    if (instr->Operation() != nullptr &&
+        instr->Operation()->num_regions() > 0) {
+      VLOG(4) << "Disable the static memory plan because of "
+              << instr->Name();
+      return false;
+    }
+  }
+  return true;
+}
+
+void PirInterpreter::RecordStaticMemoryPlanVars(InstructionBase* instr) {
+  std::lock_guard<std::mutex> guard(static_memory_plan_mutex_);
+  const auto& var_list = value_exe_info_->GetVarList();
+  for (auto& item : instr->Outputs()) {
+    for (auto var_id : item.second) {
+      auto& record = static_memory_plan_records_[var_id];
+      record = StaticMemoryPlanRecord();
+      Variable* var = var_list[var_id];
+      if (var == nullptr || !var->IsType<phi::DenseTensor>()) {
+        continue;
+      }
+      const auto& tensor = var->Get<phi::DenseTensor>();
+      if (!tensor.IsInitialized() || !phi::is_cpu_place(tensor.place()) ||
+          !tensor.meta().is_contiguous() || tensor.meta().offset != 0) {
+        continue;
+      }
+      record.holder = tensor.Holder().get();
+      record.bytes = tensor.numel() * phi::SizeOf(tensor.dtype());
+    }
+  }
+}
+
+void PirInterpreter::BuildStaticMemoryPlan() {
+  const auto& var_list = value_exe_info_->GetVarList();
+  std::vector<std::vector<size_t>> writers(var_list.size());
+  std::vector<std::vector<size_t>> users(var_list.size());
+  for (size_t op_idx = 0; op_idx < vec_instruction_base_.size(); ++op_idx) {
+    InstructionBase* instr = vec_instruction_base_[op_idx].get();
+    for (auto& item : instr->Outputs()) {
+      for (auto var_id : item.second) {
+        writers[var_id].push_back(op_idx);
+      }
+    }
+    for (auto& item : instr->Inputs()) {
+      for (auto var_id : item.second) {
+        users[var_id].push_back(op_idx);
+      }
+    }
+  }
+
+  std::unordered_set<std::string> skip_vars(
+      execution_config_.skip_gc_vars.begin(),
+      execution_config_.skip_gc_vars.end());
+  skip_vars.insert(execution_config_.jit_input_vars.begin(),
+                   execution_config_.jit_input_vars.end());
+  skip_vars.insert(execution_config_.force_root_scope_vars.begin(),
+                   execution_config_.force_root_scope_vars.end());
+  skip_vars.insert(fetch_var_names_.begin(), fetch_var_names_.end());
+
+  // a holder seen in several outputs belongs to a view or an inplace result,
+  // whose memory can not be moved alone
+  std::unordered_map<const phi::Allocation*, size_t> holder_count;
+  for (auto& record : static_memory_plan_records_) {
+    if (record.holder != nullptr) {
+      ++holder_count[record.holder];
+    }
+  }
+
+  interpreter::StaticMemoryPlanner planner([this](size_t prior,
+                                                  size_t posterior) {
+    return ir_dependency_builder_.OpHappensBefore(prior, posterior);
+  });
+  std::vector<size_t> planned_vars;
+  for (size_t var_id = 0; var_id < static_memory_plan_records_.size();
+       ++var_id) {
+    const auto& record = static_memory_plan_records_[var_id];
+    if (record.holder == nullptr || record.bytes == 0 ||
+        writers[var_id].size() != 1 || holder_count[record.holder] != 1) {
+      continue;
+    }
+    std::string var_name =
+        value_exe_info_->GetNameById(static_cast<int>(var_id));
+    if (parameter_var_names_.count(var_name) || skip_vars.count(var_name)) {
+      continue;
+    }
+    planner.AddBuffer(record.bytes, writers[var_id][0], users[var_id]);
+    planned_vars.push_back(var_id);
+  }
+  std::vector<StaticMemoryPlanRecord>().swap(static_memory_plan_records_);
+  if (planned_vars.empty()) {
+    return;
+  }
+
+  size_t arena_size = planner.Plan();
+  static_memory_plan_arena_ = memory::AllocShared(place_, arena_size);
+  auto arena = static_memory_plan_arena_;
+  auto* base = static_cast<uint8_t*>(arena->ptr());
+  static_memory_planned_.assign(var_list.size(), false);
+  for (size_t i = 0; i < planned_vars.size(); ++i) {
+    static_memory_plan_holders_.emplace_back(
+        planned_vars[i],
+        std::shared_ptr<phi::Allocation>(
+            new phi::Allocation(
+                base + planner.Offset(i), planner.Size(i), place_),
+            [arena](phi::Allocation* slice) { delete slice; }));
+    static_memory_planned_[planned_vars[i]] = true;
+  }
+  VLOG(1) << "Static memory plan of PirInterpreter(" << this << "): "
+          << planned_vars.size() << " vars in " << arena_size
+          << " bytes instead of " << planner.TotalSize() << " bytes";
+}
+
+void PirInterpreter::ApplyStaticMemoryPlan() {
+  const auto& var_list = value_exe_info_->GetVarList();
+  for (auto& item : static_memory_plan_holders_) {
+    auto* tensor = var_list[item.first]->GetMutable<phi::DenseTensor>();
+    if (tensor->Holder() == item.second) {
+      continue;
+    }
+    // a tensor that outgrew its slice keeps the holder allocated by its op
+    size_t bytes = tensor->numel() * phi::SizeOf(tensor->dtype());
+    if (!tensor->meta().is_contiguous() || tensor->meta().offset != 0 ||
+        bytes > item.second->size()) {
+      VLOG(4) << value_exe_info_->GetNameById(static_cast<int>(item.first))
+              << " does not fit in the static memory plan";
+      continue;
+    }
+    tensor->ResetHolder(item.second);
+  }
+}
+
+void PirInterpreter::ClearStaticMemoryPlan() {
+  if (static_memory_plan_holders_.empty()) {
+    return;
+  }
+  // the tensors must not keep pointers into the arena
+  const auto& var_list = value_exe_info_->GetVarList();
+  for (auto& item : static_memory_plan_holders_) {
+    auto* tensor = var_list[item.first]->GetMutable<phi::DenseTensor>();
+    if (tensor->Holder() == item.second) {
+      tensor->clear();
+    }
+  }
+  static_memory_plan_holders_.clear();
+  static_memory_planned_.clear();
+  static_memory_plan_arena_.reset();
+}
+
 void PirInterpreter::CalculateLastLiveOps() {
   VLOG(4) << "PirInterpreter(): " << this << " start CalculateLastLiveOps";
   // calculate last_live_ops_
@@ -1504,10 +1752,18 @@ paddle::framework::FetchList PirInterpreter::Run(
 
     BuildInstruction();
     VLOG(4) << "Done BuildInstruction";
+    ResetInstructionStatistics();
 
     PreAnalysis();
     VLOG(4) << "Done PreAnalysis";
 
+    ClearStaticMemoryPlan();
+    if (UseStaticMemoryPlan()) {
+      static_memory_plan_records_.assign(value_exe_info_->GetVarList().size(),
+                                         StaticMemoryPlanRecord());
+      static_memory_plan_recording_ = true;
+    }
+
     if (UseTraceRun(execution_config_, onednn_op_num_, sync_op_num_)) {
       LOG_FIRST_N(INFO, 1) << "pir interpreter is running by trace mode ...";
       TraceRunImpl();
@@ -1517,9 +1773,15 @@ paddle::framework::FetchList PirInterpreter::Run(
       MultiThreadRunImpl();
     }
 
+    if (static_memory_plan_recording_) {
+      static_memory_plan_recording_ = false;
+      BuildStaticMemoryPlan();
+    }
+
     is_build_ = true;
     is_shared_results_build_ = true;
   } else {
+    ApplyStaticMemoryPlan();
     if (UseTraceRun(execution_config_, onednn_op_num_, sync_op_num_)) {
       TraceRunImpl();
     } else {
@@ -1582,10 +1844,18 @@ FetchList PirInterpreter::Run(const std::vector<std::string>& feed_names,
 
     BuildInstruction();
     VLOG(4) << "Done BuildInstruction";
+    ResetInstructionStatistics();
 
     PreAnalysis();
     VLOG(4) << "Done PreAnalysis";
 
+    ClearStaticMemoryPlan();
+    if (UseStaticMemoryPlan()) {
+      static_memory_plan_records_.assign(value_exe_info_->GetVarList().size(),
+                                         StaticMemoryPlanRecord());
+      static_memory_plan_recording_ = true;
+    }
+
     // Run
     if (UseTraceRun(execution_config_, onednn_op_num_, sync_op_num_)) {
       LOG_FIRST_N(INFO, 1) << "pir interpreter is running by trace mode ...";
@@ -1596,9 +1866,15 @@ FetchList PirInterpreter::Run(const std::vector<std::string>& feed_names,
       MultiThreadRunImpl();
     }
 
+    if (static_memory_plan_recording_) {
+      static_memory_plan_recording_ = false;
+      BuildStaticMemoryPlan();
+    }
+
     is_build_ = true;
     is_shared_results_build_ = true;
   } else {
+    ApplyStaticMemoryPlan();
     if (UseTraceRun(execution_config_, onednn_op_num_, sync_op_num_)) {
       TraceRunImpl();
     } else {
@@ -1633,6 +1909,8 @@ void PirInterpreter::TraceRunImpl() {
   }
 
   interpreter::ResetAtomicGuard guard(&deps_, &refs_);
+  instruction_statistics_sampled_ = instruction_statistics_ != nullptr &&
+                                    instruction_statistics_->BeginRun();
   VLOG(4) << "Tracing Instruction List";
 
   TraceRunInstructionList(vec_instruction_base_);
@@ -1651,6 +1929,8 @@ void PirInterpreter::MultiThreadRunImpl() {
   }
 
   interpreter::ResetAtomicGuard guard(&deps_, &refs_);
+  instruction_statistics_sampled_ = instruction_statistics_ != nullptr &&
+                                    instruction_statistics_->BeginRun();
   VLOG(4) << "Multi Thread Run Instruction List";
 
   async_work_queue_ = GetWorkQueue();
@@ -1748,6 +2028,7 @@ void PirInterpreter::MultiThreadRunInstructionList(
     if ((*dependency_count_)[i] == 0) {
       // NOTE(zhiqiu): hot fix for jit input var
       RecordMemcpyD2H(vec_instr.at(i).get());
+      MarkInstructionReady(i);
       if (FLAGS_new_executor_serial_run) {
         RunInstructionBaseAsync(i);
       } else {
@@ -1820,11 +2101,23 @@ void PirInterpreter::RunInstructionBaseAsync(size_t instr_id) {
   // scheduling, the priority order involved cross-thread scheduling is not
   // guaranteed. Only Ops scheduled by the same AddTask call have the guarantee
   // of priority order.
+  if (execution_config_.numa_node >= 0) {
+    memory::allocation::BindCurrentThreadToNumaNode(
+        execution_config_.numa_node);
+  }
   SchedulingQueue ready_ops(ir_instruction_scheduling_priority_less);
+  // inline successors, they only depend on the instruction before them and
+  // run first
+  std::vector<size_t> inline_ops;
   ready_ops.push(instr_id);
-  while (!ready_ops.empty()) {
-    instr_id = ready_ops.top();
-    ready_ops.pop();
+  while (!inline_ops.empty() || !ready_ops.empty()) {
+    if (!inline_ops.empty()) {
+      instr_id = inline_ops.back();
+      inline_ops.pop_back();
+    } else {
+      instr_id = ready_ops.top();
+      ready_ops.pop();
+    }
     auto* instr_node = vec_instruction_base_.at(instr_id).get();
 
     RunInstructionBase(instr_node);
@@ -1846,6 +2139,12 @@ void PirInterpreter::RunInstructionBaseAsync(size_t instr_id) {
     }
 
     RunNextInstructions(instr_node, &ready_ops);
+
+    const std::vector<size_t>& next_inline = instr_node->NextInstrsInline();
+    for (auto it = next_inline.rbegin(); it != next_inline.rend(); ++it) {
+      MarkInstructionReady(*it);
+      inline_ops.push_back(*it);
+    }
   }
 }
 
@@ -1857,14 +2156,30 @@ void PirInterpreter::RunNextInstructions(InstructionBase* instr,
   auto IsReady = [this](size_t next_id) {
     VLOG(4) << "op_id: " << next_id
             << ", remain deps: " << deps_[next_id]->DynamicDep();
-    return deps_[next_id]->CheckAndDecrease();
+    bool is_ready = deps_[next_id]->CheckAndDecrease();
+    if (is_ready) {
+      MarkInstructionReady(next_id);
+    }
+    return is_ready;
   };
 
+  // In locality aware schedule, the successors of a host instruction are in
+  // locality order. The first ready host one continues on this thread, the
+  // rest go to the queue of this thread, from which idle threads steal.
+  bool keep_one = execution_config_.locality_aware_schedule &&
+                  instr->KernelType() != OpFuncType::kGpuAsync &&
+                  reserved_next_ops->empty();
   for (size_t next_instr_id : instr->NextInstrsInDifferenceThread()) {
     if (IsReady(next_instr_id)) {
-      async_work_queue_->AddTask(
-          vec_instruction_base_[next_instr_id]->KernelType(),
-          [this, next_instr_id]() { RunInstructionBaseAsync(next_instr_id); });
+      OpFuncType next_type = vec_instruction_base_[next_instr_id]->KernelType();
+      if (keep_one && next_type != OpFuncType::kGpuAsync) {
+        reserved_next_ops->push(next_instr_id);
+        keep_one = false;
+        continue;
+      }
+      async_work_queue_->AddTask(next_type, [this, next_instr_id]() {
+        RunInstructionBaseAsync(next_instr_id);
+      });
     }
   }
 
@@ -1875,6 +2190,32 @@ void PirInterpreter::RunNextInstructions(InstructionBase* instr,
   }
 }
 
+void PirInterpreter::ResetInstructionStatistics() {
+  if (FLAGS_new_executor_instruction_stats_sample_period <= 0) {
+    instruction_statistics_.reset();
+    return;
+  }
+  if (instruction_statistics_ == nullptr) {
+    instruction_statistics_ =
+        std::make_unique<interpreter::InstructionStatistics>(
+            FLAGS_new_executor_instruction_stats_sample_period);
+  }
+  std::vector<std::string> names;
+  names.reserve(vec_instruction_base_.size());
+  for (auto& instr : vec_instruction_base_) {
+    names.push_back(instr->Name());
+  }
+  instruction_statistics_->Reset(names);
+  instruction_ready_ns_.assign(vec_instruction_base_.size(), 0);
+}
+
+void PirInterpreter::MarkInstructionReady(size_t instr_id) {
+  if (instruction_statistics_sampled_) {
+    instruction_ready_ns_[instr_id] =
+        interpreter::InstructionStatistics::NowNs();
+  }
+}
+
 void PirInterpreter::RunInstructionBase(InstructionBase* instr_node) {
   phi::RecordEvent instruction_event(
       instr_node->Name(), phi::TracerEventType::Operator, 1);
@@ -1924,6 +2265,14 @@ void PirInterpreter::RunInstructionBase(InstructionBase* instr_node) {
       {
         phi::RecordEvent record(
             "InstrRun", phi::TracerEventType::UserDefined, 10);
+        interpreter::InstructionStatisticsGuard statistics_guard(
+            instruction_statistics_.get(),
+            instr_node->Id(),
+            instruction_statistics_sampled_,
+            instruction_statistics_sampled_
+                ? instruction_ready_ns_[instr_node->Id()]
+                : 0,
+            cur_place);
         instr_node->Run();
       }
 
@@ -1948,6 +2297,9 @@ void PirInterpreter::RunInstructionBase(InstructionBase* instr_node) {
               << " runs on " << phi::GetCurrentThreadName() << "\n"
               << "After: " << cur_place << " "
               << instr_node->DebugStringEx(scope_, value_exe_info_.get());
+      if (UNLIKELY(static_memory_plan_recording_)) {
+        RecordStaticMemoryPlanVars(instr_node);
+      }
       CheckGC(instr_node);
       VLOG(4) << "done CheckGC";
       memory::LogDeviceMemoryStats(cur_place, instr_node->Name());
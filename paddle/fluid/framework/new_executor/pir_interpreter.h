@@ -14,8 +14,10 @@
 
 #pragma once
 #include <memory>
+#include <mutex>
 #include "paddle/fluid/framework/new_executor/instruction/instruction_base.h"
 #include "paddle/fluid/framework/new_executor/interpreter_base_impl.h"
+#include "paddle/phi/core/memory/malloc.h"
 #include "paddle/pir/include/core/value.h"
 
 #if defined(PADDLE_WITH_CUDA) || defined(PADDLE_WITH_HIP)
@@ -72,6 +74,8 @@ class PirInterpreter : public InterpreterBaseImpl {
 
   std::tuple<double, double> InterpreterRunTime() override;
 
+  std::string DumpInstructionStatistics(bool as_json) const override;
+
   std::shared_ptr<std::vector<size_t>> GetDependencyCount() const override;
 
   bool IsSharedResultsBuild() const override;
@@ -110,6 +114,12 @@ class PirInterpreter : public InterpreterBaseImpl {
 
   std::string GetNameByValue(::pir::Value value) const;
 
+  // The bytes of the arena of ExecutionConfig::static_memory_plan, 0 before
+  // the plan is built.
+  size_t StaticMemoryPlanArenaSize() const {
+    return static_memory_plan_arena_ ? static_memory_plan_arena_->size() : 0;
+  }
+
   // Only for debug
   Variable* DebugVar(const std::string& name) const override;
 
@@ -243,6 +253,10 @@ class PirInterpreter : public InterpreterBaseImpl {
 
   void RunInstructionBase(InstructionBase* instr_node);
 
+  void ResetInstructionStatistics();
+
+  void MarkInstructionReady(size_t instr_id);
+
   void RecordMemcpyD2H(InstructionBase* instr_node);
 
   ::pir::Value GetValueByName(const std::string& var_name);
@@ -253,6 +267,13 @@ class PirInterpreter : public InterpreterBaseImpl {
 
   void SolvePersistableVarNames();
 
+  // static memory plan
+  bool UseStaticMemoryPlan() const;
+  void RecordStaticMemoryPlanVars(InstructionBase* instr);
+  void BuildStaticMemoryPlan();
+  void ApplyStaticMemoryPlan();
+  void ClearStaticMemoryPlan();
+
   const interpreter::PirDependencyBuilder& GetPirDependencyBuilder() const;
 
   const interpreter::PirStreamAnalyzer& GetPirStreamAnalyzer() const;
@@ -285,6 +306,30 @@ class PirInterpreter : public InterpreterBaseImpl {
 #endif
   size_t last_calculate_instr_id_;
   bool enable_job_schedule_profiler_;
+
+  // The output tensors seen in the first run, by var id, to plan the memory
+  // of the later runs.
+  struct StaticMemoryPlanRecord {
+    const phi::Allocation* holder{nullptr};
+    size_t bytes{0};
+  };
+  bool static_memory_plan_recording_{false};
+  std::mutex static_memory_plan_mutex_;
+  std::vector<StaticMemoryPlanRecord> static_memory_plan_records_;
+  std::shared_ptr<phi::Allocation> static_memory_plan_arena_;
+  // var id -> the slice of the arena it lives in, which keeps the arena alive
+  // but does not free the memory itself
+  std::vector<std::pair<size_t, std::shared_ptr<phi::Allocation>>>
+      static_memory_plan_holders_;
+  std::vector<bool> static_memory_planned_;
+
+  // always-on statistics of the instructions, null when
+  // FLAGS_new_executor_instruction_stats_sample_period is 0
+  std::unique_ptr<interpreter::InstructionStatistics> instruction_statistics_;
+  // whether the instructions of the current run are measured
+  bool instruction_statistics_sampled_{false};
+  // when each instruction got ready in the current sampled run
+  std::vector<uint64_t> instruction_ready_ns_;
 };
 
 }  // namespace framework
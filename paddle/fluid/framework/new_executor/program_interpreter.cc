@@ -145,6 +145,8 @@ void ProgramInterpreter::RunImpl() {
   }
 
   interpreter::ResetAtomicGuard guard(&deps_, &refs_);
+  instruction_statistics_sampled_ = instruction_statistics_ != nullptr &&
+                                    instruction_statistics_->BeginRun();
 
   if (is_in_op_profiling_mode_ || execution_config_.used_for_inference ||
       ((execution_config_.used_for_jit || execution_config_.used_for_cinn) &&
@@ -687,6 +689,14 @@ std::tuple<double, double> ProgramInterpreter::InterpreterRunTime() {
   return std::make_tuple(start_time, end_time);
 }
 
+std::string ProgramInterpreter::DumpInstructionStatistics(bool as_json) const {
+  if (instruction_statistics_ == nullptr) {
+    return "";
+  }
+  return as_json ? instruction_statistics_->ToJson()
+                 : instruction_statistics_->ToTable();
+}
+
 void ProgramInterpreter::Convert(
     std::vector<paddle::framework::OpFuncNode>* op_func_nodes) {
   auto& vec_meta_info = var_scope_.MutableVecMetaInfo();
@@ -896,6 +906,33 @@ void ProgramInterpreter::Convert(
   }
 
   AnalyseExecuteOrderForTrace();
+  ResetInstructionStatistics();
+}
+
+void ProgramInterpreter::ResetInstructionStatistics() {
+  if (FLAGS_new_executor_instruction_stats_sample_period <= 0) {
+    instruction_statistics_.reset();
+    return;
+  }
+  if (instruction_statistics_ == nullptr) {
+    instruction_statistics_ =
+        std::make_unique<interpreter::InstructionStatistics>(
+            FLAGS_new_executor_instruction_stats_sample_period);
+  }
+  std::vector<std::string> names;
+  names.reserve(vec_instruction_.size());
+  for (auto& instr : vec_instruction_) {
+    names.push_back(instr.OpBase()->Type());
+  }
+  instruction_statistics_->Reset(names);
+  instruction_ready_ns_.assign(vec_instruction_.size(), 0);
+}
+
+void ProgramInterpreter::MarkInstructionReady(size_t instr_id) {
+  if (instruction_statistics_sampled_) {
+    instruction_ready_ns_[instr_id] =
+        interpreter::InstructionStatistics::NowNs();
+  }
 }
 
 void ProgramInterpreter::BuildSkipShareLoDInfo() {
@@ -1176,7 +1213,17 @@ void ProgramInterpreter::RunInstruction(const Instruction& instr_node) {
 #endif
 
     if (!instr_node.IsArtificial()) {
-      RunOperator(instr_node);
+      {
+        interpreter::InstructionStatisticsGuard statistics_guard(
+            instruction_statistics_.get(),
+            instr_node.Id(),
+            instruction_statistics_sampled_,
+            instruction_statistics_sampled_
+                ? instruction_ready_ns_[instr_node.Id()]
+                : 0,
+            instr_node.DeviceContext().GetPlace());
+        RunOperator(instr_node);
+      }
       CheckGC(instr_node);
       if (FLAGS_log_memory_stats) {
         memory::LogDeviceMemoryStats(place_, instr_node.OpBase()->Type());
@@ -1252,6 +1299,7 @@ void ProgramInterpreter::ExecuteInstructionList(
     if ((*dependency_count_)[i] == 0) {
       // NOTE(zhiqiu): hot fix for jit input var
       RecordMemcpyD2H(vec_instr.at(i));
+      MarkInstructionReady(i);
       if (FLAGS_new_executor_serial_run) {
         RunInstructionAsync(i);
       } else {
@@ -1327,7 +1375,11 @@ void ProgramInterpreter::RunNextInstructions(
   auto IsReady = [this](size_t next_id) {
     VLOG(4) << "op_id: " << next_id
             << ", remain deps: " << deps_[next_id]->DynamicDep();
-    return deps_[next_id]->CheckAndDecrease();
+    bool is_ready = deps_[next_id]->CheckAndDecrease();
+    if (is_ready) {
+      MarkInstructionReady(next_id);
+    }
+    return is_ready;
   };
 
   for (size_t next_instr_id : instr.NextInstrsInDifferenceThread()) {
@@ -120,6 +120,8 @@ class ProgramInterpreter : public InterpreterBaseImpl {
 
   std::tuple<double, double> InterpreterRunTime() override;
 
+  std::string DumpInstructionStatistics(bool as_json) const override;
+
   // Only for debug
   Variable* DebugVar(const std::string& name) const override;
 
@@ -150,6 +152,8 @@ class ProgramInterpreter : public InterpreterBaseImpl {
   void RunNextInstructions(const Instruction& instr_id,
                            SchedulingQueue* reserved_next_ops);
   void RunOperator(const Instruction& instr_node);
+  void ResetInstructionStatistics();
+  void MarkInstructionReady(size_t instr_id);
   // Trace
   void TraceInstructionList(const std::vector<Instruction>& vec_instr);
 
@@ -246,6 +250,14 @@ class ProgramInterpreter : public InterpreterBaseImpl {
 #endif
   size_t last_calculate_instr_id_;
   bool enable_job_schedule_profiler_;
+
+  // always-on statistics of the instructions, null when
+  // FLAGS_new_executor_instruction_stats_sample_period is 0
+  std::unique_ptr<interpreter::InstructionStatistics> instruction_statistics_;
+  // whether the instructions of the current run are measured
+  bool instruction_statistics_sampled_{false};
+  // when each instruction got ready in the current sampled run
+  std::vector<uint64_t> instruction_ready_ns_;
 };
 
 static inline const phi::DenseTensor& GetTensorFromVar(const Variable* var) {
@@ -0,0 +1,250 @@
+/* Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/framework/work_stealing_pool.h"
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <sstream>
+
+#include "paddle/common/enforce.h"
+
+namespace paddle {
+namespace framework {
+
+namespace {
+
+thread_local WorkStealingPool* tls_pool = nullptr;
+thread_local size_t tls_worker_id = 0;
+
+double Now() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace
+
+std::string WorkStealingPool::Stats::ToString() const {
+  std::ostringstream os;
+  double capacity = seconds * thread_num;
+  auto percent = [capacity](double busy) {
+    return capacity > 0 ? busy * 100 / capacity : 0;
+  };
+  os << "threads:" << thread_num << " cost:" << seconds
+     << "s idle:" << percent(idle_seconds) << "%";
+  for (auto& stage : stages) {
+    os << " " << stage.name << "[tasks:" << stage.tasks
+       << " stolen:" << stage.stolen << " busy:" << stage.busy_seconds
+       << "s util:" << percent(stage.busy_seconds) << "%]";
+  }
+  return os.str();
+}
+
+WorkStealingPool::WorkStealingPool(int thread_num) : start_(Now()) {
+  PADDLE_ENFORCE_GT(thread_num,
+                    0,
+                    common::errors::InvalidArgument(
+                        "The thread num of WorkStealingPool should be "
+                        "positive, but received %d.",
+                        thread_num));
+  workers_.resize(thread_num);
+  for (auto& worker : workers_) {
+    worker.reset(new Worker());
+  }
+  for (int i = 0; i < thread_num; ++i) {
+    workers_[i]->thread = std::thread(&WorkStealingPool::Loop, this, i);
+  }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  task_cond_.notify_all();
+  for (auto& worker : workers_) {
+    worker->thread.join();
+  }
+}
+
+int WorkStealingPool::AddStage(const std::string& name) {
+  stage_names_.push_back(name);
+  return static_cast<int>(stage_names_.size()) - 1;
+}
+
+void WorkStealingPool::Run(int stage, std::function<void()> task) {
+  PADDLE_ENFORCE_LT(stage,
+                    static_cast<int>(stage_names_.size()),
+                    common::errors::InvalidArgument(
+                        "Unknown stage %d of WorkStealingPool.", stage));
+  size_t worker_id = tls_pool == this ? tls_worker_id
+                                      : next_worker_++ % workers_.size();
+  {
+    // pending_ is raised before the task can be seen, so that Wait never
+    // returns while it is on its way to a deque
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++pending_;
+    {
+      auto& worker = *workers_[worker_id];
+      std::lock_guard<std::mutex> worker_lock(worker.mutex);
+      worker.tasks.push_back(Task{stage, worker_id, std::move(task)});
+    }
+    ++queued_;
+  }
+  task_cond_.notify_one();
+}
+
+bool WorkStealingPool::PopLocal(size_t worker_id, Task* task) {
+  auto& worker = *workers_[worker_id];
+  std::lock_guard<std::mutex> lock(worker.mutex);
+  if (worker.tasks.empty()) {
+    return false;
+  }
+  *task = std::move(worker.tasks.back());
+  worker.tasks.pop_back();
+  --queued_;
+  return true;
+}
+
+bool WorkStealingPool::Steal(size_t worker_id, Task* task) {
+  for (size_t i = 1; i < workers_.size(); ++i) {
+    auto& victim = *workers_[(worker_id + i) % workers_.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (victim.tasks.empty()) {
+      continue;
+    }
+    // the oldest task, which usually spawns the most work
+    *task = std::move(victim.tasks.front());
+    victim.tasks.pop_front();
+    --queued_;
+    return true;
+  }
+  return false;
+}
+
+void WorkStealingPool::Execute(size_t worker_id, Task* task) {
+  auto& worker = *workers_[worker_id];
+  if (worker.stages.size() <= static_cast<size_t>(task->stage)) {
+    worker.stages.resize(task->stage + 1);
+  }
+  // the time of the tasks run by RunPendingTasks inside this one is
+  // accounted to their own stage
+  double outer_nested = worker.nested_seconds;
+  worker.nested_seconds = 0;
+  double start = Now();
+  try {
+    task->func();
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!exception_) {
+      exception_ = std::current_exception();
+    }
+  }
+  // release the captures before the task is seen as done
+  task->func = nullptr;
+  double elapsed = Now() - start;
+  auto& stage = worker.stages[task->stage];
+  stage.busy_seconds += elapsed - worker.nested_seconds;
+  ++stage.tasks;
+  if (task->owner != worker_id) {
+    ++stage.stolen;
+  }
+  worker.nested_seconds = outer_nested + elapsed;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (--pending_ == 0) {
+    done_cond_.notify_all();
+  }
+}
+
+void WorkStealingPool::RunPendingTasks(size_t limit) {
+  if (tls_pool != this) {
+    return;
+  }
+  auto& worker = *workers_[tls_worker_id];
+  while (true) {
+    Task task;
+    {
+      std::lock_guard<std::mutex> lock(worker.mutex);
+      if (worker.tasks.size() <= limit) {
+        return;
+      }
+      task = std::move(worker.tasks.back());
+      worker.tasks.pop_back();
+      --queued_;
+    }
+    Execute(tls_worker_id, &task);
+  }
+}
+
+void WorkStealingPool::Loop(size_t worker_id) {
+  tls_pool = this;
+  tls_worker_id = worker_id;
+  while (true) {
+    Task task;
+    if (PopLocal(worker_id, &task) || Steal(worker_id, &task)) {
+      Execute(worker_id, &task);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (stop_ && queued_ <= 0) {
+      break;
+    }
+    task_cond_.wait(lock, [this]() { return stop_ || queued_ > 0; });
+  }
+  tls_pool = nullptr;
+}
+
+void WorkStealingPool::Wait() {
+  PADDLE_ENFORCE_NE(tls_pool,
+                    this,
+                    common::errors::PreconditionNotMet(
+                        "WorkStealingPool::Wait can not be called from a "
+                        "task of the same pool."));
+  std::exception_ptr exception;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cond_.wait(lock, [this]() { return pending_ == 0; });
+    std::swap(exception, exception_);
+  }
+  if (exception) {
+    std::rethrow_exception(exception);
+  }
+}
+
+WorkStealingPool::Stats WorkStealingPool::GetStats() const {
+  Stats stats;
+  stats.thread_num = ThreadNum();
+  stats.seconds = Now() - start_;
+  stats.stages.resize(stage_names_.size());
+  double busy = 0;
+  for (size_t i = 0; i < stage_names_.size(); ++i) {
+    auto& stage = stats.stages[i];
+    stage.name = stage_names_[i];
+    for (auto& worker : workers_) {
+      if (i < worker->stages.size()) {
+        stage.tasks += worker->stages[i].tasks;
+        stage.stolen += worker->stages[i].stolen;
+        stage.busy_seconds += worker->stages[i].busy_seconds;
+      }
+    }
+    busy += stage.busy_seconds;
+  }
+  stats.idle_seconds = std::max(0.0, stats.seconds * stats.thread_num - busy);
+  return stats;
+}
+
+}  // namespace framework
+}  // namespace paddle
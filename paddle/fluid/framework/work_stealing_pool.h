@@ -0,0 +1,127 @@
+/* Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>  // NOLINT
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+namespace paddle {
+namespace framework {
+
+// A fixed set of threads, each owning a deque of tasks. A thread pushes and
+// pops its own tasks at the back and, once it runs dry, steals from the front
+// of the others. Tasks spawned by a running task stay on its thread unless
+// another thread is idle, so a long task (e.g. reading a large file) only
+// delays the part of its work it has not handed out yet.
+//
+// Every task belongs to a stage registered by AddStage, the time spent in
+// each stage is accounted separately, which tells how many threads a stage
+// really keeps busy.
+class WorkStealingPool {
+ public:
+  struct StageStats {
+    std::string name;
+    uint64_t tasks = 0;
+    // tasks run by another thread than the one they were queued on
+    uint64_t stolen = 0;
+    // summed over the threads, excluding the tasks nested in RunPendingTasks
+    double busy_seconds = 0;
+  };
+
+  struct Stats {
+    int thread_num = 0;
+    double seconds = 0;
+    // thread time not spent in any task
+    double idle_seconds = 0;
+    std::vector<StageStats> stages;
+    std::string ToString() const;
+  };
+
+  explicit WorkStealingPool(int thread_num);
+  // Runs the remaining tasks and joins the threads.
+  ~WorkStealingPool();
+
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+  // Not thread safe, stages are added before the first Run.
+  int AddStage(const std::string& name);
+
+  // Queues `task` on the calling thread if it belongs to the pool, otherwise
+  // on the threads in turn.
+  void Run(int stage, std::function<void()> task);
+
+  // Called from a task: runs the tasks queued on this thread while there
+  // are more than `limit` of them. A task producing work faster than the
+  // pool consumes it calls this to bound the memory held by the queue.
+  void RunPendingTasks(size_t limit);
+
+  // Waits for all the queued tasks, and rethrows the first exception thrown
+  // by one of them. Must not be called from a task.
+  void Wait();
+
+  // Only consistent after Wait.
+  Stats GetStats() const;
+
+  int ThreadNum() const { return static_cast<int>(workers_.size()); }
+
+ private:
+  struct Task {
+    int stage = 0;
+    size_t owner = 0;
+    std::function<void()> func;
+  };
+
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+    std::thread thread;
+    // only touched by the thread of the worker
+    std::vector<StageStats> stages;
+    double nested_seconds = 0;
+  };
+
+  bool PopLocal(size_t worker_id, Task* task);
+  bool Steal(size_t worker_id, Task* task);
+  void Execute(size_t worker_id, Task* task);
+  void Loop(size_t worker_id);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::vector<std::string> stage_names_;
+  std::atomic<size_t> next_worker_{0};
+  // tasks waiting in the deques, may be transiently negative
+  std::atomic<int64_t> queued_{0};
+
+  std::mutex mutex_;
+  std::condition_variable task_cond_;
+  std::condition_variable done_cond_;
+  // queued and running tasks
+  int64_t pending_ = 0;
+  bool stop_ = false;
+  std::exception_ptr exception_;
+  double start_;
+};
+
+}  // namespace framework
+}  // namespace paddle
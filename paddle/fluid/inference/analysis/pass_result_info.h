@@ -55,6 +55,11 @@ class PassResultInfoForRuntime {
     return PADDLE_GET_CONST(T, map[predictor_id][pass_name]);
   }
 
+  bool Has(int predictor_id, const std::string& pass_name) const {
+    auto iter = map.find(predictor_id);
+    return iter != map.end() && iter->second.count(pass_name);
+  }
+
  private:
   using PassResultInfoMap =
       std::unordered_map<int, std::unordered_map<std::string, PassInfo>>;
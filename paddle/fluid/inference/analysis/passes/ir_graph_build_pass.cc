@@ -56,7 +56,8 @@ void IrGraphBuildPass::RunImpl(Argument *argument) {
         argument->scope_ptr(),
         place,
         argument->model_from_memory_valid() && argument->model_from_memory(),
-        argument->skip_load_params());
+        argument->skip_load_params(),
+        argument->model_params_mmap_valid() && argument->model_params_mmap());
     argument->SetMainProgram(program.release());
   } else {
     PADDLE_THROW(common::errors::PreconditionNotMet(
@@ -117,10 +118,16 @@ std::unique_ptr<framework::ProgramDesc> IrGraphBuildPass::LoadModel(
     framework::Scope *scope,
     const phi::Place &place,
     bool model_from_memory,
-    bool skip_load_params) {
+    bool skip_load_params,
+    bool mmap_params) {
   framework::Executor exe(place);
   if (!model_from_memory) {  // NOLINT
-    return Load(&exe, scope, program_path, params_path, !skip_load_params);
+    return Load(&exe,
+                scope,
+                program_path,
+                params_path,
+                !skip_load_params,
+                mmap_params && phi::is_cpu_place(place));
   } else {
     return LoadFromMemory(&exe, scope, program_path, params_path);
   }
@@ -564,6 +564,8 @@ AnalysisConfig::AnalysisConfig(const AnalysisConfig &other) {
   CP_MEMBER(specify_input_name_);
 
   CP_MEMBER(use_optimized_model_);
+  CP_MEMBER(mmap_params_);
+  CP_MEMBER(compiled_predictor_cache_dir_);
 
   CP_MEMBER(cpu_math_library_num_threads_);
 
@@ -1127,6 +1129,8 @@ std::string AnalysisConfig::SerializeInfoCache() {
   ss << ir_debug_;
 
   ss << use_optimized_model_;
+  ss << mmap_params_;
+  ss << compiled_predictor_cache_dir_;
 
   ss << specify_input_name_;
   ss << cpu_math_library_num_threads_;
@@ -1218,6 +1222,24 @@ bool AnalysisConfig::trt_engine_memory_sharing() const {
   return trt_engine_memory_sharing_;
 }
 
+void AnalysisConfig::EnableMmapParams(bool x) {
+#ifdef _WIN32
+  if (x) {
+    LOG(WARNING) << "Mapping the params file into memory is not supported on "
+                    "Windows, the params will be read instead.";
+    x = false;
+  }
+#endif
+  mmap_params_ = x;
+  Update();
+}
+
+void AnalysisConfig::EnableCompiledPredictorCache(
+    const std::string &cache_dir) {
+  compiled_predictor_cache_dir_ = cache_dir;
+  Update();
+}
+
 void AnalysisConfig::SetModelBuffer(const char *prog_buffer,
                                     size_t prog_buffer_size,
                                     const char *param_buffer,
@@ -1423,6 +1445,11 @@ std::string AnalysisConfig::Summary() {
   os.InsertRow({"ir_debug", ir_debug_ ? "true" : "false"});
   os.InsertRow(
       {"use_optimized_model", use_optimized_model_ ? "true" : "false"});
+  os.InsertRow({"mmap_params", mmap_params_ ? "true" : "false"});
+  if (!compiled_predictor_cache_dir_.empty()) {
+    os.InsertRow(
+        {"compiled_predictor_cache_dir", compiled_predictor_cache_dir_});
+  }
   os.InsertRow({"memory_optim", enable_memory_optim_ ? "true" : "false"});
   os.InsertRow({"enable_profile", with_profile_ ? "true" : "false"});
   os.InsertRow({"enable_log", with_glog_info_ ? "true" : "false"});
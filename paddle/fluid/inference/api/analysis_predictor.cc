@@ -21,6 +21,7 @@
 #include <fstream>
 #include <memory>
 #include <set>
+#include <sstream>
 #include <string>
 #include <utility>
 #include <vector>
@@ -49,6 +50,7 @@
 #include "paddle/fluid/inference/api/paddle_inference_api.h"
 #include "paddle/fluid/inference/api/paddle_inference_pass.h"
 #include "paddle/fluid/inference/api/resource_manager.h"
+#include "paddle/fluid/inference/io.h"
 #include "paddle/fluid/inference/utils/io_utils.h"
 #include "paddle/fluid/inference/utils/model_utils.h"
 #include "paddle/fluid/inference/utils/singleton.h"
@@ -66,6 +68,7 @@
 #include "paddle/phi/core/platform/device/gpu/gpu_types.h"
 #include "paddle/phi/core/platform/device_context.h"
 #include "paddle/phi/core/platform/profiler.h"
+#include "paddle/phi/core/scope_guard.h"
 
 #include "paddle/phi/core/generator.h"
 #include "paddle/phi/kernels/funcs/data_type_transform.h"
@@ -447,6 +450,8 @@ bool AnalysisPredictor::Init(
     config_.use_new_executor_ = true;
   }
 
+  InitCompiledPredictorCache();
+
   // Use Optimized model to inference
   if (config_.use_optimized_model_) {
     std::string optimized_model_path = GetOptimizedModelPath();
@@ -501,8 +506,13 @@ bool AnalysisPredictor::Init(
 
   // Prepare executor, create local variables.
   if (!PrepareExecutor()) {
+    if (compiled_cache_) {
+      // lets the other processes fill the entry
+      compiled_cache_->Unlock();
+    }
     return true;
   }
+  CommitCompiledPredictorCache();
 
 #if defined(PADDLE_WITH_CUDA) || defined(PADDLE_WITH_HIP)
   // TODO(inference): Now only gpu with external stream support private
@@ -592,6 +602,103 @@ void AnalysisPredictor::InitPlace() {
   }
 }
 
+void AnalysisPredictor::InitCompiledPredictorCache() {
+  if (config_.compiled_predictor_cache_dir_.empty() || status_is_cloned_) {
+    return;
+  }
+  if (config_.model_from_memory()) {
+    LOG(WARNING) << "The compiled predictor cache does not apply to the "
+                    "models loaded from memory.";
+    return;
+  }
+
+  // key on what changes the optimized program, not where it is saved
+  AnalysisConfig config(config_);
+  config.save_optimized_model_ = false;
+  config.use_optimized_model_ = false;
+  config.opt_cache_dir_.clear();
+  config.exec_stream_ = nullptr;
+  config.compiled_predictor_cache_dir_.clear();
+  std::stringstream config_info;
+  config_info << config.SerializeInfoCache() << config.new_ir_enabled()
+              << config.new_executor_enabled() << ";";
+  for (auto &pass : config.pass_builder()->AllPasses()) {
+    config_info << pass << ";";
+  }
+
+  compiled_cache_ = std::make_shared<inference::CompiledPredictorCache>(
+      config_.compiled_predictor_cache_dir_,
+      inference::CompiledPredictorCache::Key(config_.prog_file(),
+                                             config_.params_file(),
+                                             config_.model_dir(),
+                                             config_info.str()));
+  config_.SetOptimCacheDir(compiled_cache_->EntryDir());
+  if (!compiled_cache_->IsComplete()) {
+    // held until the entry is committed, so that the processes starting
+    // together fill it one at a time, and the next ones load it
+    if (!compiled_cache_->Lock()) {
+      LOG(WARNING) << "Can not lock the compiled predictor cache entry "
+                   << compiled_cache_->EntryDir()
+                   << ", other processes may fill it concurrently.";
+    }
+  }
+  if (!compiled_cache_->IsComplete()) {
+    VLOG(3) << "Fill the compiled predictor cache entry "
+            << compiled_cache_->EntryDir();
+    config_.EnableSaveOptimModel(true);
+    config_.UseOptimizedModel(false);
+    return;
+  }
+
+  compiled_cache_->Unlock();
+  VLOG(3) << "Load the compiled predictor cache entry "
+          << compiled_cache_->EntryDir();
+  config_.EnableSaveOptimModel(false);
+  config_.UseOptimizedModel(true);
+  inference::CompiledPredictorCache::ReusePlan reuse_plan;
+  if (config_.enable_memory_optim_ &&
+      compiled_cache_->LoadReusePlan(&reuse_plan)) {
+    // taken by PrepareExecutor of the predictor and its clones
+    inference::analysis::PassResultInfoForRuntime::Instance()->Set(
+        root_predictor_id_, "memory_optimize_pass", reuse_plan);
+  }
+}
+
+void AnalysisPredictor::CommitCompiledPredictorCache() {
+  if (!compiled_cache_ || status_is_cloned_ || config_.use_optimized_model_) {
+    return;
+  }
+  DEFINE_PADDLE_SCOPE_GUARD([this] { compiled_cache_->Unlock(); });
+  // nothing is saved with ir_optim off
+  std::string entry_dir = compiled_cache_->EntryDir();
+  std::string optimized_model =
+      entry_dir + (config_.new_ir_enabled() ? "/_optimized.json"
+                                            : "/_optimized.pdmodel");
+  if (!FileExists(optimized_model) ||
+      !FileExists(entry_dir + "/_optimized.pdiparams")) {
+    VLOG(3) << "No optimized model saved to " << entry_dir
+            << ", the compiled predictor cache entry is left incomplete.";
+    return;
+  }
+
+  auto *pass_res_info =
+      inference::analysis::PassResultInfoForRuntime::Instance();
+  if (config_.enable_memory_optim_ &&
+      pass_res_info->Has(root_predictor_id_, "memory_optimize_pass") &&
+      !compiled_cache_->SaveReusePlan(
+          pass_res_info->Get<std::unordered_map<std::string, std::string>>(
+              root_predictor_id_, "memory_optimize_pass"))) {
+    LOG(WARNING) << "Failed to save the memory reuse plan to " << entry_dir;
+    return;
+  }
+  if (!compiled_cache_->Commit()) {
+    LOG(WARNING) << "Failed to commit the compiled predictor cache entry "
+                 << entry_dir;
+    return;
+  }
+  LOG(INFO) << "Compiled predictor cache entry saved to " << entry_dir;
+}
+
 std::string AnalysisPredictor::GetOptimizedModelPath() {
   std::string model_opt_cache_dir = config_.opt_cache_dir_;
   if (!model_opt_cache_dir.empty()) {
@@ -1189,6 +1296,9 @@ bool AnalysisPredictor::SaveOrLoadPirParameters(bool for_save) {
     pir::SaveCombineFunction(
         const_tensor_out, param_names, optimized_params, true, false, true);
     LOG(INFO) << "Optimized params saved to " << optimized_params;
+  } else if (config_.mmap_params_ && phi::is_cpu_place(place_)) {
+    inference::LoadCombineParamsFromMappedFile(config_.params_file(),
+                                               tensor_out);
   } else {
     pir::LoadCombineFunction(
         config_.params_file(), filter_param_names, &tensor_out, false, place_);
@@ -1355,6 +1465,9 @@ bool AnalysisPredictor::PrepareExecutor() {
 
     execution_config.skip_gc_vars.insert(output_names.begin(),
                                          output_names.end());
+    if (compiled_cache_) {
+      execution_config.build_cache_dir = compiled_cache_->EntryDir();
+    }
 
     if (config_.new_ir_enabled()) {
       executor_->PrepareInterpreterCore(
@@ -1365,9 +1478,13 @@ bool AnalysisPredictor::PrepareExecutor() {
     }
   }
 
-  if (config_.enable_memory_optim_ && !config_.use_optimized_model_) {
-    auto *pass_res_info =
-        inference::analysis::PassResultInfoForRuntime::Instance();
+  auto *pass_res_info =
+      inference::analysis::PassResultInfoForRuntime::Instance();
+  // an optimized model has no reuse plan, unless loaded from the compiled
+  // predictor cache
+  if (config_.enable_memory_optim_ &&
+      (!config_.use_optimized_model_ ||
+       pass_res_info->Has(root_predictor_id_, "memory_optimize_pass"))) {
     auto reuse_table =
         pass_res_info->Get<std::unordered_map<std::string, std::string>>(
             root_predictor_id_, "memory_optimize_pass");
@@ -2136,6 +2253,8 @@ void AnalysisPredictor::PrepareArgument() {
   argument_->SetOptimizedModelSavePath(GetOptimizedModelPath());
   // For JITLayer
   argument_->SetSkipLoadParams(config_.skip_load_params_);
+  argument_->SetModelParamsMmap(config_.mmap_params_ &&
+                                !config_.model_from_memory());
 
   argument_->SetTensorRtPrecisionMode(static_cast<int>(
       paddle::ConvertPrecision(config_.tensorrt_precision_mode_)));
@@ -3165,6 +3284,14 @@ bool AnalysisPredictor::LoadParameters() {
                           common::errors::PreconditionNotMet(
                               "The inference program should be loaded first."));
 
+  if (config_.mmap_params_ && !config_.params_file().empty() &&
+      phi::is_cpu_place(place_) &&
+      inference::LoadMappedCombinePersistables(
+          scope_.get(), *inference_program_, config_.params_file())) {
+    VLOG(3) << "get " << scope_->LocalVarNames().size() << " vars after load";
+    return true;
+  }
+
   const auto &global_block = inference_program_->MutableBlock(0);
 
   // create a temporary program to load parameters.
@@ -3356,6 +3483,7 @@ std::unique_ptr<PaddlePredictor> AnalysisPredictor::Clone(void *stream) {
   auto *x = new AnalysisPredictor(config_);
   x->status_is_cloned_ = true;
   x->root_predictor_id_ = this->root_predictor_id_;
+  x->compiled_cache_ = compiled_cache_;
   x->config_.apply_optim_ = false;
   if (config_.use_external_stream_ && stream == nullptr) {
     PADDLE_THROW(common::errors::InvalidArgument(
@@ -3841,6 +3969,11 @@ void ConvertToMixedPrecision(const std::string &model_file,
                                                        white_list);
 }
 
+void ConvertToAlignedParams(const std::string &params_file,
+                            const std::string &aligned_params_file) {
+  paddle::inference::ConvertToAlignedParams(params_file, aligned_params_file);
+}
+
 }  // namespace paddle_infer
 
 namespace paddle_infer {
@@ -24,6 +24,7 @@
 #include "paddle/fluid/framework/op_compatible_info.h"
 #include "paddle/fluid/inference/analysis/analyzer.h"
 #include "paddle/fluid/inference/api/api_impl.h"
+#include "paddle/fluid/inference/api/compiled_predictor_cache.h"
 #include "paddle/fluid/inference/api/details/reset_tensor_array.h"
 #include "paddle/fluid/inference/api/helper.h"
 #include "paddle/fluid/inference/api/paddle_inference_api.h"
@@ -512,6 +513,10 @@ class AnalysisPredictor : public PaddlePredictor {
   void InitResourceManager(void *stream);
   std::string GetOptimizedModelPath();
   void ClearExtraParams();
+  // Points the optimized model options to the entry of the compiled
+  // predictor cache, to load it if complete and to fill it otherwise.
+  void InitCompiledPredictorCache();
+  void CommitCompiledPredictorCache();
 
 #if defined(PADDLE_WITH_DISTRIBUTE) && defined(PADDLE_WITH_PSCORE)
   // fleet exe related
@@ -596,6 +601,8 @@ class AnalysisPredictor : public PaddlePredictor {
 
   int predictor_id_;
   int root_predictor_id_{-1};
+  // shared with the clones
+  std::shared_ptr<inference::CompiledPredictorCache> compiled_cache_;
 
  private:
   std::once_flag register_input_hook_flag_;
@@ -0,0 +1,332 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/inference/api/compiled_predictor_cache.h"
+
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include "paddle/fluid/inference/analysis/helper.h"
+#include "paddle/fluid/inference/api/paddle_api.h"
+#include "paddle/phi/backends/cpu/cpu_info.h"
+
+namespace paddle {
+namespace inference {
+
+namespace {
+
+// bump it when the layout of an entry changes
+constexpr uint64_t kCompiledCacheVersion = 1;
+constexpr char kManifestMagic[8] = {'P', 'D', 'C', 'P', 'C', '0', '0', '1'};
+constexpr char kReusePlanMagic[8] = {'P', 'D', 'R', 'U', 'P', '0', '0', '1'};
+constexpr char kManifestFile[] = "manifest.bin";
+constexpr char kReusePlanFile[] = "reuse_plan.bin";
+constexpr char kLockFile[] = "fill.lock";
+
+// FNV-1a, stable across processes unlike std::hash
+class Hasher {
+ public:
+  void Add(const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+      hash_ = (hash_ ^ bytes[i]) * 1099511628211ULL;
+    }
+  }
+  void Add(uint64_t value) { Add(&value, sizeof(value)); }
+  void Add(const std::string& str) {
+    Add(str.size());
+    Add(str.data(), str.size());
+  }
+  uint64_t Value() const { return hash_; }
+
+ private:
+  uint64_t hash_{14695981039346656037ULL};
+};
+
+void AddFileContent(const std::string& path, Hasher* hasher) {
+  std::ifstream is(path, std::ios::binary);
+  std::string content((std::istreambuf_iterator<char>(is)),
+                      std::istreambuf_iterator<char>());
+  hasher->Add(content);
+}
+
+void AddFileStat(const std::string& path, Hasher* hasher) {
+  struct stat statbuf;
+  if (stat(path.c_str(), &statbuf) != 0) {
+    hasher->Add(static_cast<uint64_t>(-1));
+    return;
+  }
+  // a file replaced by a rename has a new inode, one rewritten in place a
+  // new mtime and ctime, to the nanosecond where the file system keeps it
+  hasher->Add(static_cast<uint64_t>(statbuf.st_dev));
+  hasher->Add(static_cast<uint64_t>(statbuf.st_ino));
+  hasher->Add(static_cast<uint64_t>(statbuf.st_size));
+  hasher->Add(static_cast<uint64_t>(statbuf.st_mtime));
+  hasher->Add(static_cast<uint64_t>(statbuf.st_ctime));
+#if defined(__APPLE__)
+  hasher->Add(static_cast<uint64_t>(statbuf.st_mtimespec.tv_nsec));
+  hasher->Add(static_cast<uint64_t>(statbuf.st_ctimespec.tv_nsec));
+#elif !defined(_WIN32)
+  hasher->Add(static_cast<uint64_t>(statbuf.st_mtim.tv_nsec));
+  hasher->Add(static_cast<uint64_t>(statbuf.st_ctim.tv_nsec));
+#endif
+}
+
+// Adds the name and stat of every file in `dir` but `skip_file`. An
+// overwritten param file changes its own stat, not the one of `dir`.
+void AddDirFileStats(const std::string& dir,
+                     const std::string& skip_file,
+                     Hasher* hasher) {
+  std::vector<std::string> names;
+  std::error_code ec;
+  for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+    std::string name = entry.path().filename().string();
+    if (entry.is_regular_file(ec) && name != skip_file) {
+      names.push_back(name);
+    }
+  }
+  // the order of a directory listing is unspecified
+  std::sort(names.begin(), names.end());
+  hasher->Add(names.size());
+  for (auto& name : names) {
+    hasher->Add(name);
+    AddFileStat(dir + "/" + name, hasher);
+  }
+}
+
+std::string CpuIsa() {
+  namespace cpu = phi::backends::cpu;
+  const std::pair<cpu::cpu_isa_t, const char*> isas[] = {
+      {cpu::sse42, "sse42"},
+      {cpu::avx, "avx"},
+      {cpu::avx2, "avx2"},
+      {cpu::avx512f, "avx512f"},
+      {cpu::avx512_core, "avx512_core"},
+      {cpu::avx512_core_vnni, "avx512_core_vnni"},
+      {cpu::avx512_bf16, "avx512_bf16"}};
+  std::string isa;
+  for (auto& item : isas) {
+    if (cpu::MayIUse(item.first)) {
+      isa += std::string(item.second) + ";";
+    }
+  }
+  return isa;
+}
+
+void MakeDir(const std::string& path) {
+  // another process may create it meanwhile
+  if (!analysis::PathExists(path) && MKDIR(path.c_str()) == -1) {
+    PADDLE_ENFORCE_EQ(
+        analysis::PathExists(path),
+        true,
+        common::errors::PreconditionNotMet(
+            "Can not create compiled predictor cache directory: %s, Make "
+            "sure you have permission to write",
+            path));
+  }
+}
+
+template <typename T>
+void WritePod(std::ostream& os, const T& value) {
+  os.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+bool ReadPod(std::istream& is, T* value) {
+  is.read(reinterpret_cast<char*>(value), sizeof(*value));
+  return static_cast<bool>(is);
+}
+
+void WriteString(std::ostream& os, const std::string& str) {
+  WritePod<uint64_t>(os, str.size());
+  os.write(str.data(), static_cast<std::streamsize>(str.size()));
+}
+
+bool ReadString(std::istream& is, std::string* str) {
+  uint64_t size = 0;
+  // no string of the cache is that long, the file is corrupted
+  if (!ReadPod(is, &size) || size > (1UL << 20)) {
+    return false;
+  }
+  str->resize(size);
+  is.read(&(*str)[0], static_cast<std::streamsize>(size));
+  return static_cast<bool>(is);
+}
+
+// write aside and rename, so that readers never see a partial file
+bool WriteFile(const std::string& path, const std::string& content) {
+  std::ostringstream tmp_path;
+  tmp_path << path << ".tmp" << std::random_device()();
+  {
+    std::ofstream os(tmp_path.str(), std::ios::binary | std::ios::trunc);
+    if (!os) {
+      return false;
+    }
+    os.write(content.data(), static_cast<std::streamsize>(content.size()));
+    if (!os) {
+      std::remove(tmp_path.str().c_str());
+      return false;
+    }
+  }
+  if (std::rename(tmp_path.str().c_str(), path.c_str()) != 0) {
+    std::remove(tmp_path.str().c_str());
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+CompiledPredictorCache::CompiledPredictorCache(const std::string& cache_dir,
+                                               const std::string& key)
+    : key_(key), entry_dir_(cache_dir + "/" + key) {
+  MakeDir(cache_dir);
+  MakeDir(entry_dir_);
+}
+
+CompiledPredictorCache::~CompiledPredictorCache() { Unlock(); }
+
+bool CompiledPredictorCache::Lock() {
+#ifndef _WIN32
+  if (lock_fd_ >= 0) {
+    return true;
+  }
+  std::string path = entry_dir_ + "/" + kLockFile;
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  // the lock goes with the process if it dies while filling the entry
+  int ret = 0;
+  do {
+    ret = flock(fd, LOCK_EX);
+  } while (ret != 0 && errno == EINTR);
+  if (ret != 0) {
+    close(fd);
+    return false;
+  }
+  lock_fd_ = fd;
+  return true;
+#else
+  return false;
+#endif
+}
+
+void CompiledPredictorCache::Unlock() {
+#ifndef _WIN32
+  if (lock_fd_ >= 0) {
+    // closing the file releases its lock
+    close(lock_fd_);
+    lock_fd_ = -1;
+  }
+#endif
+}
+
+std::string CompiledPredictorCache::Key(const std::string& prog_file,
+                                        const std::string& params_file,
+                                        const std::string& model_dir,
+                                        const std::string& config_info) {
+  Hasher hasher;
+  hasher.Add(kCompiledCacheVersion);
+  hasher.Add(paddle::get_version());
+  hasher.Add(CpuIsa());
+  if (!model_dir.empty()) {
+    AddFileContent(model_dir + "/__model__", &hasher);
+    // the params are separate files next to the model
+    AddDirFileStats(model_dir, "__model__", &hasher);
+  } else {
+    AddFileContent(prog_file, &hasher);
+    AddFileStat(params_file, &hasher);
+  }
+  hasher.Add(config_info);
+
+  std::ostringstream os;
+  os << std::hex << std::setw(16) << std::setfill('0') << hasher.Value();
+  return os.str();
+}
+
+bool CompiledPredictorCache::IsComplete() const {
+  std::ifstream is(entry_dir_ + "/" + kManifestFile, std::ios::binary);
+  if (!is) {
+    return false;
+  }
+  char magic[sizeof(kManifestMagic)];
+  std::string key;
+  return is.read(magic, sizeof(magic)) &&
+         std::memcmp(magic, kManifestMagic, sizeof(magic)) == 0 &&
+         ReadString(is, &key) && key == key_;
+}
+
+bool CompiledPredictorCache::Commit() const {
+  std::ostringstream os;
+  os.write(kManifestMagic, sizeof(kManifestMagic));
+  WriteString(os, key_);
+  return WriteFile(entry_dir_ + "/" + kManifestFile, os.str());
+}
+
+bool CompiledPredictorCache::SaveReusePlan(const ReusePlan& reuse_plan) const {
+  std::ostringstream os;
+  os.write(kReusePlanMagic, sizeof(kReusePlanMagic));
+  WritePod<uint64_t>(os, reuse_plan.size());
+  for (auto& item : reuse_plan) {
+    WriteString(os, item.first);
+    WriteString(os, item.second);
+  }
+  return WriteFile(entry_dir_ + "/" + kReusePlanFile, os.str());
+}
+
+bool CompiledPredictorCache::LoadReusePlan(ReusePlan* reuse_plan) const {
+  std::ifstream is(entry_dir_ + "/" + kReusePlanFile, std::ios::binary);
+  if (!is) {
+    return false;
+  }
+  char magic[sizeof(kReusePlanMagic)];
+  uint64_t entry_num = 0;
+  if (!is.read(magic, sizeof(magic)) ||
+      std::memcmp(magic, kReusePlanMagic, sizeof(magic)) != 0 ||
+      !ReadPod(is, &entry_num)) {
+    return false;
+  }
+  ReusePlan loaded;
+  for (uint64_t i = 0; i < entry_num; ++i) {
+    std::string var, reused_var;
+    if (!ReadString(is, &var) || !ReadString(is, &reused_var)) {
+      return false;
+    }
+    loaded.emplace(std::move(var), std::move(reused_var));
+  }
+  *reuse_plan = std::move(loaded);
+  return true;
+}
+
+}  // namespace inference
+}  // namespace paddle
@@ -0,0 +1,82 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+
+namespace paddle {
+namespace inference {
+
+// CompiledPredictorCache is an entry of a compiled predictor cache directory,
+// the state an AnalysisPredictor builds at its creation that the next
+// processes creating the same predictor can load instead of building it
+// again:
+//  - the optimized program and params, as saved by EnableSaveOptimModel,
+//  - the memory reuse plan of memory_optimize_pass,
+//  - the instruction dependencies of the new executor, see
+//    DependencyBuildCache.
+// The entries are keyed by the model files, the config, the instruction sets
+// of the CPU and the version of Paddle, so that an entry is never loaded by a
+// predictor it was not built for. An entry is complete once its manifest is
+// committed, after everything else is written. The processes filling the
+// same entry are serialized by a lock file in it, the ones waiting for it
+// find the entry complete once they take it.
+class CompiledPredictorCache {
+ public:
+  using ReusePlan = std::unordered_map<std::string, std::string>;
+
+  // Creates the directory of the entry of `key` in `cache_dir`.
+  CompiledPredictorCache(const std::string& cache_dir, const std::string& key);
+  ~CompiledPredictorCache();
+
+  CompiledPredictorCache(const CompiledPredictorCache&) = delete;
+  CompiledPredictorCache& operator=(const CompiledPredictorCache&) = delete;
+
+  // `config_info` serializes everything of the config that changes the
+  // optimized program. The model files are keyed by the content of the
+  // program, while the params are too large to be read for it and are keyed
+  // by the device, inode, size, mtime and ctime of their files. A param file
+  // rewritten in place with the same size within the timestamp resolution of
+  // the file system keeps its key, so clear the cache directory after such
+  // an update.
+  static std::string Key(const std::string& prog_file,
+                         const std::string& params_file,
+                         const std::string& model_dir,
+                         const std::string& config_info);
+
+  const std::string& key() const { return key_; }
+  const std::string& EntryDir() const { return entry_dir_; }
+
+  bool IsComplete() const;
+  // Blocks while another process fills the entry, then holds it until
+  // Unlock. Check IsComplete again once it returns. Returns false when the
+  // lock file can not be taken, or on Windows.
+  bool Lock();
+  void Unlock();
+  // Returns false when the manifest can not be written.
+  bool Commit() const;
+
+  bool SaveReusePlan(const ReusePlan& reuse_plan) const;
+  bool LoadReusePlan(ReusePlan* reuse_plan) const;
+
+ private:
+  std::string key_;
+  std::string entry_dir_;
+  int lock_fd_{-1};
+};
+
+}  // namespace inference
+}  // namespace paddle
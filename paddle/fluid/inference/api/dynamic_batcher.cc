@@ -0,0 +1,422 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>  // NOLINT
+#include <cstring>
+#include <deque>
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
+
+#include "paddle/common/enforce.h"
+#include "paddle/fluid/inference/api/paddle_inference_api.h"
+#include "paddle/phi/common/bfloat16.h"
+#include "paddle/phi/common/float16.h"
+
+namespace paddle_infer {
+namespace services {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+int64_t Numel(const std::vector<int>& shape) {
+  int64_t numel = 1;
+  for (int dim : shape) {
+    numel *= dim;
+  }
+  return numel;
+}
+
+// calls `visitor` with a value of the C++ type of `dtype`
+template <typename Visitor>
+void VisitDataType(DataType dtype, Visitor&& visitor) {
+  switch (dtype) {
+    case DataType::FLOAT32:
+      visitor(float{});
+      break;
+    case DataType::INT64:
+      visitor(int64_t{});
+      break;
+    case DataType::INT32:
+      visitor(int32_t{});
+      break;
+    case DataType::UINT8:
+      visitor(uint8_t{});
+      break;
+    case DataType::INT8:
+      visitor(int8_t{});
+      break;
+    case DataType::FLOAT16:
+      visitor(phi::dtype::float16{});
+      break;
+    case DataType::BOOL:
+      visitor(bool{});
+      break;
+    case DataType::FLOAT64:
+      visitor(double{});
+      break;
+    case DataType::BFLOAT16:
+      visitor(phi::dtype::bfloat16{});
+      break;
+    default:
+      PADDLE_THROW(common::errors::Unimplemented(
+          "Unsupported data type %d in DynamicBatcher.",
+          static_cast<int>(dtype)));
+  }
+}
+
+size_t SizeOfDataType(DataType dtype) {
+  size_t size = 0;
+  VisitDataType(dtype, [&](auto type) { size = sizeof(type); });
+  return size;
+}
+
+const DynamicBatcher::Options& CheckOptions(
+    const DynamicBatcher::Options& options) {
+  PADDLE_ENFORCE_GT(options.num_predictors,
+                    0,
+                    common::errors::InvalidArgument(
+                        "The num_predictors of DynamicBatcher should be "
+                        "greater than 0, but got %d.",
+                        options.num_predictors));
+  PADDLE_ENFORCE_GT(options.max_batch_size,
+                    0,
+                    common::errors::InvalidArgument(
+                        "The max_batch_size of DynamicBatcher should be "
+                        "greater than 0, but got %d.",
+                        options.max_batch_size));
+  PADDLE_ENFORCE_GT(options.max_queue_delay_us,
+                    0,
+                    common::errors::InvalidArgument(
+                        "The max_queue_delay_us of DynamicBatcher should be "
+                        "greater than 0, but got %d.",
+                        options.max_queue_delay_us));
+  return options;
+}
+
+}  // namespace
+
+struct DynamicBatcherRequest {
+  // ordered like the inputs of the predictors
+  std::vector<paddle::PaddleTensor> inputs;
+  int batch_size{0};
+  Clock::time_point arrival;
+  std::promise<std::vector<paddle::PaddleTensor>> promise;
+};
+
+struct DynamicBatcher::Impl {
+  using RequestPtr = std::unique_ptr<DynamicBatcherRequest>;
+
+  Impl(const Config& config, const Options& options);
+  ~Impl();
+
+  // Blocks until a batch is ready, returns an empty batch once stopped and
+  // drained.
+  std::vector<RequestPtr> NextBatch();
+  void RunBatch(Predictor* predictor, std::vector<RequestPtr>* batch);
+  bool CanBatch(const DynamicBatcherRequest& lhs,
+                const DynamicBatcherRequest& rhs) const;
+  // the batch size of the requests queued that can run with the first one
+  int QueuedBatchSize() const;
+
+  Options options;
+  PredictorPool pool;
+  std::vector<std::string> input_names;
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<RequestPtr> queue;
+  bool stop{false};
+  std::vector<std::thread> workers;
+
+  std::atomic<uint64_t> request_num{0};
+  std::atomic<uint64_t> batch_num{0};
+};
+
+DynamicBatcher::Impl::Impl(const Config& config, const Options& options)
+    : options(CheckOptions(options)), pool(config, options.num_predictors) {
+  input_names = pool.Retrieve(0)->GetInputNames();
+  for (size_t i = 0; i < options.num_predictors; ++i) {
+    Predictor* predictor = pool.Retrieve(i);
+    workers.emplace_back([this, predictor] {
+      for (;;) {
+        std::vector<RequestPtr> batch = NextBatch();
+        if (batch.empty()) {
+          return;
+        }
+        RunBatch(predictor, &batch);
+      }
+    });
+  }
+}
+
+DynamicBatcher::Impl::~Impl() {
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    stop = true;
+  }
+  cv.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+bool DynamicBatcher::Impl::CanBatch(const DynamicBatcherRequest& lhs,
+                                    const DynamicBatcherRequest& rhs) const {
+  for (size_t i = 0; i < lhs.inputs.size(); ++i) {
+    const paddle::PaddleTensor& l = lhs.inputs[i];
+    const paddle::PaddleTensor& r = rhs.inputs[i];
+    if (l.dtype != r.dtype ||
+        !std::equal(l.shape.begin() + 1,
+                    l.shape.end(),
+                    r.shape.begin() + 1,
+                    r.shape.end())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int DynamicBatcher::Impl::QueuedBatchSize() const {
+  int batch_size = 0;
+  for (auto& request : queue) {
+    if (CanBatch(*queue.front(), *request)) {
+      batch_size += request->batch_size;
+      if (batch_size >= options.max_batch_size) {
+        break;
+      }
+    }
+  }
+  return batch_size;
+}
+
+std::vector<DynamicBatcher::Impl::RequestPtr>
+DynamicBatcher::Impl::NextBatch() {
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;) {
+    cv.wait(lock, [this] { return stop || !queue.empty(); });
+    if (queue.empty()) {
+      return {};
+    }
+    // the front may have been taken by another worker while waiting
+    auto deadline = queue.front()->arrival +
+                    std::chrono::microseconds(options.max_queue_delay_us);
+    if (stop || Clock::now() >= deadline ||
+        QueuedBatchSize() >= options.max_batch_size) {
+      break;
+    }
+    cv.wait_until(lock, deadline);
+  }
+
+  std::vector<RequestPtr> batch;
+  batch.emplace_back(std::move(queue.front()));
+  queue.pop_front();
+  int batch_size = batch.front()->batch_size;
+  for (auto it = queue.begin();
+       it != queue.end() && batch_size < options.max_batch_size;) {
+    if (CanBatch(*batch.front(), **it) &&
+        batch_size + (*it)->batch_size <= options.max_batch_size) {
+      batch_size += (*it)->batch_size;
+      batch.emplace_back(std::move(*it));
+      it = queue.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  return batch;
+}
+
+void DynamicBatcher::Impl::RunBatch(Predictor* predictor,
+                                    std::vector<RequestPtr>* batch) {
+  try {
+    int batch_size = 0;
+    for (auto& request : *batch) {
+      batch_size += request->batch_size;
+    }
+
+    std::vector<char> buffer;
+    for (size_t i = 0; i < input_names.size(); ++i) {
+      const paddle::PaddleTensor& first = batch->front()->inputs[i];
+      std::vector<int> shape = first.shape;
+      shape[0] = batch_size;
+      const char* data = static_cast<const char*>(first.data.data());
+      if (batch->size() > 1) {
+        // concat along dim 0
+        buffer.clear();
+        for (auto& request : *batch) {
+          const paddle::PaddleBuf& buf = request->inputs[i].data;
+          const char* begin = static_cast<const char*>(buf.data());
+          buffer.insert(buffer.end(), begin, begin + buf.length());
+        }
+        data = buffer.data();
+      }
+      auto input = predictor->GetInputHandle(input_names[i]);
+      input->Reshape(shape);
+      VisitDataType(first.dtype, [&](auto type) {
+        using T = decltype(type);
+        input->CopyFromCpu(reinterpret_cast<const T*>(data));
+      });
+    }
+
+    PADDLE_ENFORCE_EQ(predictor->Run(),
+                      true,
+                      common::errors::Fatal(
+                          "The predictor of DynamicBatcher failed to run."));
+
+    std::vector<std::vector<paddle::PaddleTensor>> outputs(batch->size());
+    for (const std::string& name : predictor->GetOutputNames()) {
+      auto output = predictor->GetOutputHandle(name);
+      std::vector<int> shape = output->shape();
+      DataType dtype = output->type();
+      size_t bytes = Numel(shape) * SizeOfDataType(dtype);
+      PADDLE_ENFORCE_EQ(
+          batch->size() == 1 || output->lod().empty(),
+          true,
+          common::errors::Unimplemented(
+              "DynamicBatcher can not split the LoD output %s.", name));
+
+      buffer.resize(bytes);
+      VisitDataType(dtype, [&](auto type) {
+        using T = decltype(type);
+        output->CopyToCpu(reinterpret_cast<T*>(buffer.data()));
+      });
+
+      // an output is taken as batched when its dim 0 is the batch size,
+      // unless it is listed as unbatched
+      bool split = !shape.empty() && shape[0] == batch_size &&
+                   std::find(options.unbatched_output_names.begin(),
+                             options.unbatched_output_names.end(),
+                             name) == options.unbatched_output_names.end();
+      size_t offset = 0;
+      for (size_t r = 0; r < batch->size(); ++r) {
+        paddle::PaddleTensor tensor;
+        tensor.name = name;
+        tensor.dtype = dtype;
+        tensor.shape = shape;
+        size_t request_bytes = bytes;
+        if (split) {
+          tensor.shape[0] = (*batch)[r]->batch_size;
+          request_bytes = bytes / batch_size * (*batch)[r]->batch_size;
+        }
+        if (batch->size() == 1) {
+          tensor.lod = output->lod();
+        }
+        tensor.data.Resize(request_bytes);
+        std::memcpy(tensor.data.data(), buffer.data() + offset, request_bytes);
+        if (split) {
+          offset += request_bytes;
+        }
+        outputs[r].emplace_back(std::move(tensor));
+      }
+    }
+
+    batch_num.fetch_add(1, std::memory_order_relaxed);
+    for (size_t r = 0; r < batch->size(); ++r) {
+      (*batch)[r]->promise.set_value(std::move(outputs[r]));
+    }
+  } catch (...) {
+    for (auto& request : *batch) {
+      request->promise.set_exception(std::current_exception());
+    }
+  }
+}
+
+DynamicBatcher::DynamicBatcher(const Config& config, const Options& options)
+    : impl_(new Impl(config, options)) {}
+
+DynamicBatcher::~DynamicBatcher() = default;
+
+std::future<std::vector<paddle::PaddleTensor>> DynamicBatcher::Submit(
+    std::vector<paddle::PaddleTensor> inputs) {
+  const std::vector<std::string>& input_names = impl_->input_names;
+  PADDLE_ENFORCE_EQ(inputs.size(),
+                    input_names.size(),
+                    common::errors::InvalidArgument(
+                        "The model has %d inputs, but the request has %d.",
+                        input_names.size(),
+                        inputs.size()));
+
+  auto request = std::make_unique<DynamicBatcherRequest>();
+  request->inputs.resize(input_names.size());
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    size_t idx = i;
+    if (!inputs[i].name.empty()) {
+      auto it =
+          std::find(input_names.begin(), input_names.end(), inputs[i].name);
+      PADDLE_ENFORCE_NE(it,
+                        input_names.end(),
+                        common::errors::NotFound(
+                            "The model has no input %s.", inputs[i].name));
+      idx = it - input_names.begin();
+    }
+    PADDLE_ENFORCE_EQ(request->inputs[idx].shape.empty(),
+                      true,
+                      common::errors::InvalidArgument(
+                          "The input %s is given twice.", input_names[idx]));
+    paddle::PaddleTensor& input = inputs[i];
+    PADDLE_ENFORCE_EQ(
+        !input.shape.empty() && input.shape[0] > 0 && input.lod.empty(),
+        true,
+        common::errors::InvalidArgument(
+            "The input %s of DynamicBatcher should have a batch dimension "
+            "and no LoD.",
+            input_names[idx]));
+    PADDLE_ENFORCE_EQ(
+        input.data.length(),
+        Numel(input.shape) * SizeOfDataType(input.dtype),
+        common::errors::InvalidArgument(
+            "The data of the input %s does not match its shape.",
+            input_names[idx]));
+    if (request->batch_size == 0) {
+      request->batch_size = input.shape[0];
+    }
+    PADDLE_ENFORCE_EQ(input.shape[0],
+                      request->batch_size,
+                      common::errors::InvalidArgument(
+                          "The inputs of a request should have the same "
+                          "batch size, but the input %s has %d instead of %d.",
+                          input_names[idx],
+                          input.shape[0],
+                          request->batch_size));
+    request->inputs[idx] = std::move(input);
+  }
+
+  auto future = request->promise.get_future();
+  request->arrival = Clock::now();
+  {
+    std::lock_guard<std::mutex> guard(impl_->mutex);
+    PADDLE_ENFORCE_EQ(
+        impl_->stop,
+        false,
+        common::errors::Unavailable("The DynamicBatcher is stopped."));
+    impl_->queue.emplace_back(std::move(request));
+  }
+  impl_->request_num.fetch_add(1, std::memory_order_relaxed);
+  // wakes the workers waiting for the batch to fill up as well
+  impl_->cv.notify_all();
+  return future;
+}
+
+DynamicBatcher::Statistics DynamicBatcher::GetStatistics() const {
+  Statistics statistics;
+  statistics.request_num = impl_->request_num.load(std::memory_order_relaxed);
+  statistics.batch_num = impl_->batch_num.load(std::memory_order_relaxed);
+  return statistics;
+}
+
+}  // namespace services
+}  // namespace paddle_infer
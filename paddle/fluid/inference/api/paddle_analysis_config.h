@@ -889,6 +889,48 @@ struct PD_INFER_DECL AnalysisConfig {
   ///
   void UseOptimizedModel(bool x = true) { use_optimized_model_ = x; }
 
+  ///
+  /// \brief Control whether to load the combined params file by mapping it
+  /// into memory instead of reading it. The pages of the file are then shared
+  /// by the predictors in all the processes mapping it, until written. Only
+  /// the params aligned in the file, see ConvertToAlignedParams, are used in
+  /// place, the others are copied as before. It applies to the params
+  /// loaded on CPU, and is not supported on Windows.
+  ///
+  /// \param x whether to map the params file into memory.
+  ///
+  void EnableMmapParams(bool x = true);
+  ///
+  /// \brief A boolean state telling whether to map the params file into
+  /// memory.
+  ///
+  /// \return bool whether to map the params file into memory.
+  ///
+  bool mmap_params_enabled() const { return mmap_params_; }
+
+  ///
+  /// \brief Turn on the compiled predictor cache in `cache_dir`. The first
+  /// predictor created for a model and config saves what the analysis
+  /// builds there: the optimized program and params, the memory reuse plan
+  /// and the instruction dependencies of the new executor. The predictors
+  /// created with the same model, config, CPU and Paddle version later, in
+  /// any process, load them instead of running the analysis again, which
+  /// cuts the time to the first inference. It takes over the
+  /// optimized model options, see UseOptimizedModel and SetOptimCacheDir,
+  /// and does not apply to models loaded from memory.
+  ///
+  /// \param cache_dir the directory of the cache, shared by all the models.
+  ///
+  void EnableCompiledPredictorCache(const std::string& cache_dir);
+  ///
+  /// \brief Get the directory of the compiled predictor cache.
+  ///
+  /// \return const std::string& The directory, empty if the cache is off.
+  ///
+  const std::string& compiled_predictor_cache_dir() const {
+    return compiled_predictor_cache_dir_;
+  }
+
   ///
   /// \brief Control whether to debug IR graph analysis phase.
   /// This will generate DOT files for visualizing the computation graph after
@@ -1292,6 +1334,8 @@ struct PD_INFER_DECL AnalysisConfig {
   bool ir_debug_{false};
 
   bool use_optimized_model_{false};
+  bool mmap_params_{false};
+  std::string compiled_predictor_cache_dir_;
 
   bool use_new_executor_{false};
 
@@ -22,6 +22,8 @@ limitations under the License. */
 #pragma once
 
 #include <cassert>
+#include <cstdint>
+#include <future>  // NOLINT
 #include <map>
 #include <memory>
 #include <string>
@@ -248,6 +250,15 @@ PD_INFER_DECL void ConvertToMixedPrecision(
     std::unordered_set<std::string> black_list = {},
     std::unordered_set<std::string> white_list = {});
 
+///
+/// \brief Rewrite the combined params file `params_file` to
+/// `aligned_params_file`, with the data of every param aligned, so that the
+/// predictors mapping it into memory by Config::EnableMmapParams use it in
+/// place. The file can still be loaded as any params file.
+///
+PD_INFER_DECL void ConvertToAlignedParams(
+    const std::string& params_file, const std::string& aligned_params_file);
+
 namespace services {
 ///
 /// \class PredictorPool
@@ -273,6 +284,63 @@ class PD_INFER_DECL PredictorPool {
   std::shared_ptr<Predictor> main_pred_;
   std::vector<std::unique_ptr<Predictor>> preds_;
 };
+
+///
+/// \class DynamicBatcher
+///
+/// \brief DynamicBatcher serves single requests with a PredictorPool,
+/// coalescing the requests waiting for a predictor along the batch dimension
+/// into one run. A request is the host tensors of all the inputs, with the
+/// same batch size in dim 0. A run takes the requests queued with the same
+/// dtypes and dims after dim 0, up to max_batch_size in total, once the
+/// first of them has waited max_queue_delay_us or the batch is full.
+///
+/// The outputs are told apart by their shape only: those whose dim 0 equals
+/// the batch size of the run are split back to the requests along dim 0,
+/// the others are given whole to every request. An output that is not
+/// batched but whose dim 0 may happen to equal the batch size, like a
+/// [num_classes] table, has to be listed in unbatched_output_names. LoD
+/// tensors are not supported.
+///
+class PD_INFER_DECL DynamicBatcher {
+ public:
+  struct Options {
+    /// The predictors running batches concurrently, greater than 0.
+    size_t num_predictors{1};
+    /// The largest batch of a run, summed over its requests, greater than 0.
+    int max_batch_size{8};
+    /// How long the first request of a run waits for more requests, greater
+    /// than 0.
+    int max_queue_delay_us{1000};
+    /// The outputs given whole to every request whatever their dim 0.
+    std::vector<std::string> unbatched_output_names;
+  };
+
+  struct Statistics {
+    uint64_t request_num{0};
+    uint64_t batch_num{0};
+  };
+
+  DynamicBatcher() = delete;
+  DynamicBatcher(const DynamicBatcher&) = delete;
+  DynamicBatcher& operator=(const DynamicBatcher&) = delete;
+
+  DynamicBatcher(const Config& config, const Options& options);
+  /// \brief Runs the requests queued, then stops the predictors.
+  ~DynamicBatcher();
+
+  /// \brief Queues a request and returns its outputs, ordered like
+  /// GetOutputNames of the predictors. The inputs are matched to the
+  /// inputs of the predictors by name, or by position when unnamed.
+  std::future<std::vector<paddle::PaddleTensor>> Submit(
+      std::vector<paddle::PaddleTensor> inputs);
+
+  Statistics GetStatistics() const;
+
+ private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
 }  // namespace services
 
 }  // namespace paddle_infer
@@ -24,6 +24,8 @@ limitations under the License. */
 #include "paddle/fluid/framework/version.h"
 #include "paddle/fluid/platform/enforce.h"
 #include "paddle/fluid/pybind/pybind.h"
+#include "paddle/phi/core/framework/dense_tensor_serialize.h"
+#include "paddle/phi/core/memory/allocation/mmap_allocator.h"
 #include "paddle/phi/core/platform/cpu_helper.h"
 
 // phi
@@ -226,13 +228,18 @@ std::unique_ptr<framework::ProgramDesc> Load(framework::Executor* executor,
                                              framework::Scope* scope,
                                              const std::string& prog_filename,
                                              const std::string& param_filename,
-                                             bool load_params) {
+                                             bool load_params,
+                                             bool mmap_params) {
   std::string program_desc_str;
   ReadBinaryFile(prog_filename, &program_desc_str);
 
   std::unique_ptr<framework::ProgramDesc> main_program(
       new framework::ProgramDesc(program_desc_str));
 
+  if (load_params && mmap_params &&
+      LoadMappedCombinePersistables(scope, *main_program, param_filename)) {
+    return main_program;
+  }
   if (load_params) {
     LoadCombinePersistables(executor,
                             scope,
@@ -261,6 +268,100 @@ std::unique_ptr<framework::ProgramDesc> LoadFromMemory(
   return main_program;
 }
 
+void LoadCombineParamsFromMappedFile(
+    const std::string& param_filename,
+    const std::vector<phi::DenseTensor*>& tensors) {
+#ifdef _WIN32
+  PADDLE_THROW(common::errors::Unimplemented(
+      "Loading params from a memory mapped file is not supported on "
+      "Windows."));
+#else
+  std::shared_ptr<phi::Allocation> mapping =
+      memory::allocation::AllocateMemoryMapFileAllocation(param_filename);
+  size_t offset = 0;
+  size_t shared_num = 0;
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    PADDLE_ENFORCE_NOT_NULL(
+        tensors[i],
+        common::errors::InvalidArgument(
+            "The variable index %d to be loaded cannot be found.", i));
+    if (phi::DeserializeFromBuffer(mapping, &offset, tensors[i])) {
+      ++shared_num;
+    }
+  }
+  PADDLE_ENFORCE_EQ(offset,
+                    mapping->size(),
+                    common::errors::Unavailable(
+                        "Not allowed to load partial data via "
+                        "load_combine_op, please use load_op instead."));
+  if (shared_num < tensors.size()) {
+    LOG(INFO) << tensors.size() - shared_num << " of " << tensors.size()
+              << " params are copied out of " << param_filename
+              << " as they are not aligned in it, convert it by "
+                 "ConvertToAlignedParams to share them as well.";
+  }
+  VLOG(3) << "Load " << tensors.size() << " params from the mapped "
+          << param_filename << ", " << shared_num << " of them in place";
+#endif
+}
+
+bool LoadMappedCombinePersistables(framework::Scope* scope,
+                                   const framework::ProgramDesc& main_program,
+                                   const std::string& param_filename) {
+  const framework::BlockDesc& global_block = main_program.Block(0);
+  std::vector<std::string> param_list;
+  for (auto* var : global_block.AllVars()) {
+    if (!IsPersistable(var)) {
+      continue;
+    }
+    if (var->GetType() != framework::proto::VarType::DENSE_TENSOR) {
+      VLOG(3) << "Cannot map the params into memory, as " << var->Name()
+              << " is not a DenseTensor.";
+      return false;
+    }
+    param_list.push_back(var->Name());
+  }
+  // in the order of load_combine
+  std::sort(param_list.begin(), param_list.end());
+
+  std::vector<phi::DenseTensor*> tensors;
+  tensors.reserve(param_list.size());
+  for (auto& name : param_list) {
+    tensors.push_back(scope->Var(name)->GetMutable<phi::DenseTensor>());
+  }
+  LoadCombineParamsFromMappedFile(param_filename, tensors);
+  return true;
+}
+
+void ConvertToAlignedParams(const std::string& params_file,
+                            const std::string& aligned_params_file) {
+  std::ifstream fin(params_file, std::ios::binary);
+  PADDLE_ENFORCE_EQ(
+      static_cast<bool>(fin),
+      true,
+      common::errors::Unavailable("Failed to open file %s.", params_file));
+  std::ofstream fout(aligned_params_file, std::ios::binary);
+  PADDLE_ENFORCE_EQ(static_cast<bool>(fout),
+                    true,
+                    common::errors::Unavailable("Failed to open file %s.",
+                                                aligned_params_file));
+
+  auto* dev_ctx = phi::DeviceContextPool::Instance().Get(phi::CPUPlace());
+  size_t num = 0;
+  while (fin.peek() != EOF) {
+    phi::DenseTensor tensor;
+    phi::DeserializeFromStream(fin, &tensor, *dev_ctx);
+    phi::SerializeToStream(fout, tensor, *dev_ctx, true /* align_data */);
+    ++num;
+  }
+  PADDLE_ENFORCE_EQ(static_cast<bool>(fout),
+                    true,
+                    common::errors::Unavailable("Failed to write file %s.",
+                                                aligned_params_file));
+  VLOG(3) << "Convert " << num << " params of " << params_file << " to "
+          << aligned_params_file;
+}
+
 void SaveVars(const framework::Scope& scope,
               const std::vector<std::string>& vars,
               const std::string& dirname,
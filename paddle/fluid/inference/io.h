@@ -39,11 +39,14 @@ std::unique_ptr<framework::ProgramDesc> Load(framework::Executor* executor,
                                              framework::Scope* scope,
                                              const std::string& dirname);
 
+// With `mmap_params`, the params are loaded by LoadMappedCombinePersistables
+// when possible.
 std::unique_ptr<framework::ProgramDesc> Load(framework::Executor* executor,
                                              framework::Scope* scope,
                                              const std::string& prog_filename,
                                              const std::string& param_filename,
-                                             bool load_params = true);
+                                             bool load_params = true,
+                                             bool mmap_params = false);
 
 std::unique_ptr<framework::ProgramDesc> LoadFromMemory(
     framework::Executor* executor,
@@ -51,6 +54,26 @@ std::unique_ptr<framework::ProgramDesc> LoadFromMemory(
     const std::string& prog_buffer,
     const std::string& param_buffer);
 
+// Load `tensors` in order from the combined params file `param_filename`
+// mapped into memory. The pages of the file are shared by all the processes
+// mapping it until written, and the tensors aligned in the file, like the ones
+// written by ConvertToAlignedParams, use them in place instead of a copy.
+void LoadCombineParamsFromMappedFile(
+    const std::string& param_filename,
+    const std::vector<phi::DenseTensor*>& tensors);
+
+// Load the persistable variables of `main_program` into `scope` like the
+// load_combine op, but by LoadCombineParamsFromMappedFile. Returns false
+// without loading anything if some of them are not DenseTensors.
+bool LoadMappedCombinePersistables(framework::Scope* scope,
+                                   const framework::ProgramDesc& main_program,
+                                   const std::string& param_filename);
+
+// Rewrite the combined params file `params_file` to `aligned_params_file`,
+// with the data of every tensor aligned, still readable by load_combine.
+void ConvertToAlignedParams(const std::string& params_file,
+                            const std::string& aligned_params_file);
+
 // Save the variables from a scope to disk.
 void SaveVars(const framework::Scope& scope,
               const std::vector<std::string>& vars,
@@ -293,6 +293,9 @@ void BindDataset(py::module *m) {
       .def("get_shuffle_data_size",
            &framework::Dataset::GetShuffleDataSize,
            py::call_guard<py::gil_scoped_release>())
+      .def("get_pipeline_stats",
+           &framework::Dataset::GetPipelineStats,
+           py::call_guard<py::gil_scoped_release>())
       .def("set_queue_num",
            &framework::Dataset::SetChannelNum,
            py::call_guard<py::gil_scoped_release>())
@@ -557,6 +557,10 @@ void BindInferenceApi(py::module *m) {
          py::arg("keep_io_types") = true,
          py::arg("black_list") = std::unordered_set<std::string>(),
          py::arg("white_list") = std::unordered_set<std::string>());
+  m->def("convert_to_aligned_params",
+         &paddle_infer::ConvertToAlignedParams,
+         py::arg("params_file"),
+         py::arg("aligned_params_file"));
 }
 
 namespace {
@@ -865,6 +869,14 @@ void BindAnalysisConfig(py::module *m) {
       .def("use_optimized_model",
            &AnalysisConfig::UseOptimizedModel,
            py::arg("x") = true)
+      .def("enable_mmap_params",
+           &AnalysisConfig::EnableMmapParams,
+           py::arg("x") = true)
+      .def("mmap_params_enabled", &AnalysisConfig::mmap_params_enabled)
+      .def("enable_compiled_predictor_cache",
+           &AnalysisConfig::EnableCompiledPredictorCache)
+      .def("compiled_predictor_cache_dir",
+           &AnalysisConfig::compiled_predictor_cache_dir)
       .def("enable_memory_optim",
            &AnalysisConfig::EnableMemoryOptim,
            py::arg("x") = true)
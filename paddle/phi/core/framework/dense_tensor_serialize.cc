@@ -13,14 +13,61 @@
 // limitations under the License.
 
 #include "paddle/phi/core/framework/dense_tensor_serialize.h"
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
+#include "paddle/phi/backends/context_pool.h"
 #include "paddle/phi/core/framework/convert_utils.h"
 
 namespace phi {
 
+namespace {
+
+// A part of a buffer, kept alive as long as the part is.
+class BufferSliceAllocation : public phi::Allocation {
+ public:
+  BufferSliceAllocation(std::shared_ptr<phi::Allocation> buffer,
+                        size_t offset,
+                        size_t size)
+      : phi::Allocation(static_cast<uint8_t *>(buffer->ptr()) + offset,
+                        size,
+                        buffer->place()),
+        buffer_(std::move(buffer)) {}
+
+ private:
+  std::shared_ptr<phi::Allocation> buffer_;
+};
+
+const uint8_t *ReadFromBuffer(const phi::Allocation &buffer,
+                              size_t *offset,
+                              size_t size) {
+  PADDLE_ENFORCE_LE(
+      size,
+      buffer.size() - std::min(*offset, buffer.size()),
+      common::errors::InvalidArgument(
+          "Deserialize to tensor failed, the buffer of %d bytes ends before "
+          "the %d bytes at offset %d, maybe the loaded file is damaged.",
+          buffer.size(),
+          size,
+          *offset));
+  const uint8_t *data = static_cast<const uint8_t *>(buffer.ptr()) + *offset;
+  *offset += size;
+  return data;
+}
+
+template <typename T>
+T ReadFromBuffer(const phi::Allocation &buffer, size_t *offset) {
+  T value;
+  std::memcpy(&value, ReadFromBuffer(buffer, offset, sizeof(T)), sizeof(T));
+  return value;
+}
+
+}  // namespace
+
 void SerializeToStream(std::ostream &os,
                        const phi::DenseTensor &tensor,
-                       const phi::DeviceContext &dev_ctx) {
+                       const phi::DeviceContext &dev_ctx,
+                       bool align_data) {
   constexpr uint32_t kCurTensorVersion = 0;
   {  // the 1st field, uint32_t version for DenseTensor
     os.write(reinterpret_cast<const char *>(&kCurTensorVersion),
@@ -44,7 +91,8 @@ void SerializeToStream(std::ostream &os,
     }
   }
   // the 3st field, Tensor
-  TensorToStream(os, static_cast<phi::DenseTensor>(tensor), dev_ctx);
+  TensorToStream(
+      os, static_cast<phi::DenseTensor>(tensor), dev_ctx, align_data);
 }
 
 void SerializeToStream(std::ostream &os, const phi::DenseTensor &tensor) {
@@ -127,4 +175,81 @@ void DeserializeFromStream(std::istream &is,
   TensorFromStream(is, static_cast<phi::DenseTensor *>(tensor), dev_ctx);
 }
 
+bool DeserializeFromBuffer(const std::shared_ptr<phi::Allocation> &buffer,
+                           size_t *offset,
+                           phi::DenseTensor *tensor) {
+  PADDLE_ENFORCE_EQ(
+      phi::is_cpu_place(buffer->place()),
+      true,
+      common::errors::InvalidArgument(
+          "Only a CPU buffer can be deserialized to tensor, but got %s.",
+          buffer->place()));
+  {
+    // the 1st field, unit32_t version for DenseTensor
+    uint32_t version = ReadFromBuffer<uint32_t>(*buffer, offset);
+    PADDLE_ENFORCE_EQ(
+        version,
+        0U,
+        common::errors::InvalidArgument(
+            "Deserialize to tensor failed, maybe the loaded file is "
+            "not a paddle model(expected file format: 0, but %u found).",
+            version));
+  }
+  phi::LoD lod;
+  {
+    // the 2st field, LoD information
+    uint64_t lod_level = ReadFromBuffer<uint64_t>(*buffer, offset);
+    for (uint64_t i = 0; i < lod_level; ++i) {
+      uint64_t size = ReadFromBuffer<uint64_t>(*buffer, offset);
+      std::vector<size_t> level(size / sizeof(size_t));
+      std::memcpy(level.data(), ReadFromBuffer(*buffer, offset, size), size);
+      lod.emplace_back(std::move(level));
+    }
+  }
+  // the 3st filed, Tensor
+  {
+    uint32_t version = ReadFromBuffer<uint32_t>(*buffer, offset);
+    PADDLE_ENFORCE_EQ(
+        version,
+        0U,
+        common::errors::InvalidArgument(
+            "tensor version %u is not supported, Only version 0 is supported",
+            version));
+  }
+  proto::VarType::TensorDesc desc;
+  {
+    int32_t size = ReadFromBuffer<int32_t>(*buffer, offset);
+    PADDLE_ENFORCE_GE(size,
+                      0,
+                      common::errors::InvalidArgument(
+                          "phi::DenseTensor desc size should >= 0"));
+    PADDLE_ENFORCE_EQ(
+        desc.ParseFromArray(ReadFromBuffer(*buffer, offset, size), size),
+        true,
+        common::errors::InvalidArgument("Cannot parse tensor desc"));
+  }
+  std::vector<int64_t> dims(desc.dims().begin(), desc.dims().end());
+  phi::DenseTensorMeta meta(TransToPhiDataType(desc.data_type()),
+                            common::make_ddim(dims));
+  meta.lod = lod;
+  size_t size = meta.dims.numel() * SizeOfType(desc.data_type());
+  size_t data_offset = *offset;
+  const uint8_t *data = ReadFromBuffer(*buffer, offset, size);
+
+  bool shared = reinterpret_cast<uintptr_t>(data) % kTensorDataAlignment == 0;
+  if (shared) {
+    *tensor = phi::DenseTensor(
+        std::make_shared<BufferSliceAllocation>(buffer, data_offset, size),
+        meta);
+  } else {
+    tensor->set_meta(meta);
+    auto *dev_ctx = phi::DeviceContextPool::Instance().Get(phi::CPUPlace());
+    void *dst = dev_ctx->Alloc(tensor, meta.dtype);
+    if (size > 0) {
+      std::memcpy(dst, data, size);
+    }
+  }
+  return shared;
+}
+
 }  // namespace phi
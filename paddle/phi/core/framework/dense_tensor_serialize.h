@@ -36,7 +36,8 @@ namespace phi {
  */
 void SerializeToStream(std::ostream& os,
                        const phi::DenseTensor& tensor,
-                       const phi::DeviceContext& dev_ctx);
+                       const phi::DeviceContext& dev_ctx,
+                       bool align_data = false);
 void DeserializeFromStream(std::istream& is,
                            phi::DenseTensor* tensor,
                            const phi::DeviceContext& dev_ctx);
@@ -50,4 +51,15 @@ void SerializeToStream(std::ostream& os, const phi::DenseTensor& tensor);
 
 void DeserializeFromStream(std::istream& os, phi::DenseTensor* tensor);
 
+/*
+ * Deserialize phi::DenseTensor from the CPU `buffer` holding what
+ * SerializeToStream wrote, at `*offset`, which is moved past the tensor.
+ * The tensor shares the memory of `buffer` when its data is aligned to
+ * kTensorDataAlignment bytes, as written with `align_data`, and copies it
+ * otherwise. Returns whether the memory is shared.
+ */
+bool DeserializeFromBuffer(const std::shared_ptr<phi::Allocation>& buffer,
+                           size_t* offset,
+                           phi::DenseTensor* tensor);
+
 }  // namespace phi
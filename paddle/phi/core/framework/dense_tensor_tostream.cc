@@ -94,9 +94,32 @@ phi::DenseTensor InnerTensorContiguous(const phi::DenseTensor& tensor) {
   return tensor;
 }
 
+namespace {
+
+// Not a field of TensorDesc, so skipped when parsing it. The tag of a length
+// delimited field with this number takes two bytes.
+constexpr uint32_t kTensorDescPaddingField = 1000;
+constexpr size_t kTensorDescPaddingMinSize = 3;
+
+// Appends an unknown field of `size` bytes, at least
+// kTensorDescPaddingMinSize, to the serialized TensorDesc `desc`.
+void PadTensorDesc(size_t size, std::string* desc) {
+  uint32_t tag = (kTensorDescPaddingField << 3) | 2;
+  desc->push_back(static_cast<char>((tag & 0x7f) | 0x80));
+  desc->push_back(static_cast<char>(tag >> 7));
+  // the length fits in a single byte varint
+  desc->push_back(static_cast<char>(size - kTensorDescPaddingMinSize));
+  desc->append(size - kTensorDescPaddingMinSize, '\0');
+}
+
+}  // namespace
+
 void TensorToStream(std::ostream& os,
                     const phi::DenseTensor& tensor,
-                    const phi::DeviceContext& dev_ctx) {
+                    const phi::DeviceContext& dev_ctx,
+                    bool align_data) {
+  static_assert(kTensorDataAlignment + kTensorDescPaddingMinSize < 128,
+                "The padding of TensorDesc should fit in a varint byte.");
   const auto ensure_contiguous = [](const phi::DenseTensor& tensor) {
     if (tensor.meta().is_contiguous()) {
       return tensor;
@@ -118,9 +141,26 @@ void TensorToStream(std::ostream& os,
     auto* pb_dims = desc.mutable_dims();
     pb_dims->Resize(static_cast<int>(dims.size()), 0);
     std::copy(dims.begin(), dims.end(), pb_dims->begin());
-    int32_t size = desc.ByteSize();
-    os.write(reinterpret_cast<const char*>(&size), sizeof(size));
     auto out = desc.SerializeAsString();
+    if (align_data) {
+      std::streamoff pos = os.tellp();
+      PADDLE_ENFORCE_GE(pos,
+                        0,
+                        common::errors::InvalidArgument(
+                            "Cannot align the tensor data in a stream "
+                            "without position."));
+      size_t data_pos = static_cast<size_t>(pos) + sizeof(int32_t) + out.size();
+      size_t padding = kTensorDataAlignment - data_pos % kTensorDataAlignment;
+      padding %= kTensorDataAlignment;
+      if (padding > 0 && padding < kTensorDescPaddingMinSize) {
+        padding += kTensorDataAlignment;
+      }
+      if (padding > 0) {
+        PadTensorDesc(padding, &out);
+      }
+    }
+    int32_t size = static_cast<int32_t>(out.size());
+    os.write(reinterpret_cast<const char*>(&size), sizeof(size));
     os.write(out.data(), size);
   }
   {  // the 3rd field, tensor data
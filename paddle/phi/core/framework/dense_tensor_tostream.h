@@ -27,9 +27,18 @@
 
 namespace phi {
 
+// The alignment of the tensor data written by TensorToStream with
+// `align_data`, relative to the beginning of the stream.
+constexpr size_t kTensorDataAlignment = 64;
+
+// With `align_data`, the tensor description is padded with a field unknown to
+// the readers, so that the data is aligned to kTensorDataAlignment bytes and
+// may be used in place from a memory mapped file, while the stream can still
+// be read by TensorFromStream.
 TEST_API void TensorToStream(std::ostream& os,
                              const phi::DenseTensor& tensor,
-                             const phi::DeviceContext& dev_ctx);
+                             const phi::DeviceContext& dev_ctx,
+                             bool align_data = false);
 TEST_API void TensorFromStream(std::istream& is,
                                phi::DenseTensor* tensor,
                                const phi::DeviceContext& dev_ctx);
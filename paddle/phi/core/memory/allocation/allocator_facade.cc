@@ -25,8 +25,10 @@
 #include "paddle/phi/core/memory/allocation/auto_growth_best_fit_allocator_v2.h"
 #include "paddle/phi/core/memory/allocation/cpu_allocator.h"
 #include "paddle/phi/core/memory/allocation/naive_best_fit_allocator.h"
+#include "paddle/phi/core/memory/allocation/numa_cpu_allocator.h"
 #include "paddle/phi/core/memory/allocation/retry_allocator.h"
 #include "paddle/phi/core/memory/allocation/stat_allocator.h"
+#include "paddle/phi/core/memory/allocation/thread_caching_cpu_allocator.h"
 #include "paddle/phi/core/platform/device_context.h"
 
 #if defined(PADDLE_WITH_CUDA) || defined(PADDLE_WITH_HIP)
@@ -113,6 +115,11 @@ PHI_DEFINE_EXPORTED_bool(
 
 COMMON_DECLARE_string(allocator_strategy);
 COMMON_DECLARE_uint64(auto_growth_chunk_size_in_mb);
+COMMON_DECLARE_bool(use_numa_cpu_allocator);
+COMMON_DECLARE_uint64(numa_cpu_allocator_chunk_size_in_mb);
+COMMON_DECLARE_bool(use_thread_caching_cpu_allocator);
+COMMON_DECLARE_uint64(thread_caching_cpu_allocator_max_size_in_kb);
+COMMON_DECLARE_uint64(thread_caching_cpu_allocator_central_max_size_in_mb);
 COMMON_DECLARE_bool(use_auto_growth_pinned_allocator);
 COMMON_DECLARE_bool(use_cuda_malloc_async_allocator);
 COMMON_DECLARE_bool(auto_free_cudagraph_allocations_on_launch);
@@ -347,6 +354,10 @@ class AllocatorFacadePrivate {
     InitZeroSizeAllocators();
     InitSystemAllocators();
 
+    if (FLAGS_use_thread_caching_cpu_allocator) {
+      WrapThreadCachingCPUAllocator();
+    }
+
     if (FLAGS_gpu_allocator_retry_time > 0) {
       WrapCUDARetryAllocator(FLAGS_gpu_allocator_retry_time);
     }
@@ -820,6 +831,11 @@ class AllocatorFacadePrivate {
   const AllocatorMap& GetAllocatorMap() { return allocators_; }
 
   void InitNaiveBestFitCPUAllocator() {
+    if (FLAGS_use_numa_cpu_allocator) {
+      allocators_[phi::CPUPlace()] = std::make_shared<NumaCPUAllocator>(
+          FLAGS_numa_cpu_allocator_chunk_size_in_mb << 20);
+      return;
+    }
 #if defined(__APPLE__) && defined(__arm64__)
     // NOTE(wuweilong): It is more efficient to use CPUAllocator directly,
     // but it wll cause some problem in Mac OS m1 chip, so we use
@@ -1557,6 +1573,22 @@ class AllocatorFacadePrivate {
     }
   }
 
+  void WrapThreadCachingCPUAllocator() {
+    // the central pool of the thread caches would mix the blocks of all the
+    // NUMA nodes
+    PADDLE_ENFORCE_EQ(
+        FLAGS_use_numa_cpu_allocator,
+        false,
+        common::errors::InvalidArgument(
+            "FLAGS_use_thread_caching_cpu_allocator can not be used together "
+            "with FLAGS_use_numa_cpu_allocator."));
+    auto& allocator = allocators_[phi::CPUPlace()];
+    allocator = std::make_shared<ThreadCachingCPUAllocator>(
+        allocator,
+        FLAGS_thread_caching_cpu_allocator_max_size_in_kb << 10,
+        FLAGS_thread_caching_cpu_allocator_central_max_size_in_mb << 20);
+  }
+
   void WrapStatAllocator() {
     for (auto& pair : allocators_) {
       // Now memory stats is only supported for CPU, GPU, XPU and CustomDevice
@@ -18,6 +18,7 @@
 
 #include <fcntl.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <cstdlib>
 
 #include <atomic>
@@ -158,6 +159,58 @@ RefcountedMemoryMapAllocation::RefcountedMemoryMapAllocation(
   initializeRefercount();
 }
 
+void MemoryMapFileAllocation::close() {
+  if (closed_) {
+    return;
+  }
+  closed_ = true;
+  if (map_size_ == 0) {
+    return;
+  }
+  PADDLE_ENFORCE_NE(munmap(map_ptr_, map_size_),
+                    -1,
+                    common::errors::Unavailable(
+                        "could not unmap the file %s: %s (%d)",
+                        ipc_name_,
+                        strerror(errno),
+                        errno));
+}
+
+std::shared_ptr<MemoryMapFileAllocation> AllocateMemoryMapFileAllocation(
+    const std::string &file_name) {
+  int fd = open(file_name.c_str(), O_RDONLY);
+  PADDLE_ENFORCE_NE(
+      fd,
+      -1,
+      common::errors::Unavailable("Failed to open file %s: %s (%d)",
+                                  file_name,
+                                  strerror(errno),
+                                  errno));
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) == -1) {
+    ::close(fd);
+    PADDLE_THROW(common::errors::Unavailable(
+        "Failed to get the size of file %s: %s", file_name, strerror(errno)));
+  }
+  size_t size = static_cast<size_t>(file_stat.st_size);
+  void *ptr = nullptr;
+  if (size > 0) {
+    // Writable, so that the pages written get copied instead of faulting,
+    // but private, so that the file is never written back.
+    ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  }
+  ::close(fd);
+  PADDLE_ENFORCE_NE(ptr,
+                    MAP_FAILED,
+                    common::errors::Unavailable(
+                        "Memory map failed for file %s: %s (%d)",
+                        file_name,
+                        strerror(errno),
+                        errno));
+  VLOG(4) << "Map file " << file_name << " of " << size << " bytes";
+  return std::make_shared<MemoryMapFileAllocation>(ptr, size, file_name);
+}
+
 void MemoryMapAllocation::close() {
   if (!closed_fd_) {
     closed_fd_ = true;
@@ -99,6 +99,22 @@ class RefcountedMemoryMapAllocation : public MemoryMapAllocation {
   void resetBaseptr();
 };
 
+// MemoryMapFileAllocation maps a whole regular file privately, with its
+// pages shared with the page cache, and so with the other processes mapping
+// the same file, until they are written, when the writing process gets a
+// copy of its own. The file itself is never modified.
+class MemoryMapFileAllocation : public MemoryMapAllocation {
+ public:
+  MemoryMapFileAllocation(void *ptr, size_t size, std::string file_name)
+      : MemoryMapAllocation(ptr, size, std::move(file_name), -1) {}
+
+  void close() override;
+  ~MemoryMapFileAllocation() override { close(); }
+};
+
+std::shared_ptr<MemoryMapFileAllocation> AllocateMemoryMapFileAllocation(
+    const std::string &file_name);
+
 void AllocateMemoryMap(std::string filename,
                        int *shared_fd,
                        int flags,
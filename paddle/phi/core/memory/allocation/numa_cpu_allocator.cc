@@ -0,0 +1,291 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/phi/core/memory/allocation/numa_cpu_allocator.h"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <utility>
+
+#include "paddle/phi/core/enforce.h"
+#include "paddle/phi/core/memory/allocation/auto_growth_best_fit_allocator.h"
+#include "paddle/phi/core/memory/allocation/cpu_allocator.h"
+#include "paddle/phi/core/memory/stats.h"
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace paddle::memory::allocation {
+
+namespace {
+
+// the CPUs of every node, read from sysfs
+struct NumaTopology {
+  std::vector<std::vector<int>> node_cpus;
+  std::vector<int> cpu_nodes;
+};
+
+// parses a sysfs cpu list like "0-3,8,10-11"
+std::vector<int> ParseCpuList(const std::string& list) {
+  std::vector<int> cpus;
+  size_t pos = 0;
+  while (pos < list.size()) {
+    size_t end = list.find(',', pos);
+    if (end == std::string::npos) {
+      end = list.size();
+    }
+    std::string range = list.substr(pos, end - pos);
+    size_t dash = range.find('-');
+    try {
+      if (dash == std::string::npos) {
+        cpus.push_back(std::stoi(range));
+      } else {
+        int first = std::stoi(range.substr(0, dash));
+        int last = std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; ++cpu) {
+          cpus.push_back(cpu);
+        }
+      }
+    } catch (const std::exception&) {
+      return {};
+    }
+    pos = end + 1;
+  }
+  return cpus;
+}
+
+NumaTopology ReadNumaTopology() {
+  NumaTopology topology;
+#ifdef __linux__
+  std::ifstream online("/sys/devices/system/node/online");
+  std::string online_list;
+  if (online && std::getline(online, online_list)) {
+    std::vector<int> nodes = ParseCpuList(online_list);
+    int node_num = nodes.empty() ? 0 : nodes.back() + 1;
+    topology.node_cpus.resize(node_num);
+    for (int node : nodes) {
+      std::ifstream cpulist("/sys/devices/system/node/node" +
+                            std::to_string(node) + "/cpulist");
+      std::string cpus;
+      if (cpulist && std::getline(cpulist, cpus)) {
+        topology.node_cpus[node] = ParseCpuList(cpus);
+      }
+    }
+  }
+#endif
+  if (topology.node_cpus.empty()) {
+    topology.node_cpus.resize(1);
+  }
+  for (size_t node = 0; node < topology.node_cpus.size(); ++node) {
+    for (int cpu : topology.node_cpus[node]) {
+      if (cpu >= static_cast<int>(topology.cpu_nodes.size())) {
+        topology.cpu_nodes.resize(cpu + 1, 0);
+      }
+      topology.cpu_nodes[cpu] = static_cast<int>(node);
+    }
+  }
+  VLOG(3) << "Found " << topology.node_cpus.size() << " NUMA nodes";
+  return topology;
+}
+
+const NumaTopology& GetNumaTopology() {
+  static NumaTopology topology = ReadNumaTopology();
+  return topology;
+}
+
+thread_local int bound_numa_node = -1;
+
+#ifdef __linux__
+constexpr int kMpolPreferred = 1;
+
+// the affinity of the thread before it was bound, restored when unbound
+thread_local bool unbound_affinity_saved = false;
+thread_local cpu_set_t unbound_affinity;
+
+void SetThreadAffinity(const cpu_set_t& cpu_set) {
+  if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {
+    LOG(WARNING) << "Failed to set the CPU affinity of the thread, errno "
+                 << errno;
+  }
+}
+
+void SetThreadAffinity(const std::vector<int>& cpus) {
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (int cpu : cpus) {
+    if (cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &cpu_set);
+    }
+  }
+  SetThreadAffinity(cpu_set);
+}
+#endif
+
+}  // namespace
+
+int NumaNodeCount() {
+  return static_cast<int>(GetNumaTopology().node_cpus.size());
+}
+
+int CurrentThreadBoundNumaNode() { return bound_numa_node; }
+
+int CurrentThreadNumaNode() {
+  if (bound_numa_node >= 0) {
+    return bound_numa_node;
+  }
+#ifdef __linux__
+  const NumaTopology& topology = GetNumaTopology();
+  int cpu = sched_getcpu();
+  if (cpu >= 0 && cpu < static_cast<int>(topology.cpu_nodes.size())) {
+    return topology.cpu_nodes[cpu];
+  }
+#endif
+  return 0;
+}
+
+void BindCurrentThreadToNumaNode(int node) {
+  if (node == bound_numa_node || (node < 0 && bound_numa_node < 0)) {
+    return;
+  }
+  const NumaTopology& topology = GetNumaTopology();
+  PADDLE_ENFORCE_LT(
+      node,
+      NumaNodeCount(),
+      common::errors::InvalidArgument(
+          "The NUMA node should be less than %d, but got %d.",
+          NumaNodeCount(),
+          node));
+#ifdef __linux__
+  if (node >= 0) {
+    if (bound_numa_node < 0) {
+      unbound_affinity_saved =
+          sched_getaffinity(0, sizeof(unbound_affinity), &unbound_affinity) ==
+          0;
+    }
+    SetThreadAffinity(topology.node_cpus[node]);
+  } else if (unbound_affinity_saved) {
+    SetThreadAffinity(unbound_affinity);
+    unbound_affinity_saved = false;
+  }
+#endif
+  bound_numa_node = node < 0 ? -1 : node;
+}
+
+phi::Allocation* NumaNodeChunkAllocator::AllocateImpl(size_t size) {
+#ifdef __linux__
+  void* p = mmap(nullptr,
+                 size,
+                 PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS,
+                 -1,
+                 0);
+  PADDLE_ENFORCE_NE(p,
+                    MAP_FAILED,
+                    common::errors::ResourceExhausted(
+                        "Fail to alloc memory of %ld size on NUMA node %d, "
+                        "error code is %d.",
+                        size,
+                        node_,
+                        errno));
+  if (NumaNodeCount() > 1) {
+    // the pages are placed on the node when first touched
+    constexpr size_t kBitsPerWord = sizeof(unsigned long) * 8;  // NOLINT
+    std::vector<unsigned long> node_mask(                       // NOLINT
+        node_ / kBitsPerWord + 1,
+        0);
+    node_mask[node_ / kBitsPerWord] = 1UL << (node_ % kBitsPerWord);
+    if (syscall(SYS_mbind,
+                p,
+                size,
+                kMpolPreferred,
+                node_mask.data(),
+                node_mask.size() * kBitsPerWord + 1,
+                0) != 0) {
+      VLOG(4) << "Failed to bind memory to NUMA node " << node_ << ", errno "
+              << errno;
+    }
+  }
+  HOST_MEMORY_STAT_UPDATE(Reserved, 0, size);
+  return new Allocation(p, size, phi::CPUPlace());
+#else
+  void* p = nullptr;
+#ifdef _WIN32
+  p = _aligned_malloc(size, CPUAllocator::kAlignment);
+#else
+  int error = posix_memalign(&p, CPUAllocator::kAlignment, size);
+  PADDLE_ENFORCE_EQ(
+      error,
+      0,
+      common::errors::ResourceExhausted(
+          "Fail to alloc memory of %ld size, error code is %d.", size, error));
+#endif
+  HOST_MEMORY_STAT_UPDATE(Reserved, 0, size);
+  return new Allocation(p, size, phi::CPUPlace());
+#endif
+}
+
+void NumaNodeChunkAllocator::FreeImpl(phi::Allocation* allocation) {
+  auto size = allocation->size();
+  void* p = allocation->ptr();
+#ifdef __linux__
+  munmap(p, size);
+#elif defined(_WIN32)
+  _aligned_free(p);
+#else
+  free(p);  // NOLINT
+#endif
+  HOST_MEMORY_STAT_UPDATE(Reserved, 0, -size);
+  delete allocation;
+}
+
+NumaCPUAllocator::NumaCPUAllocator(size_t chunk_size) {
+  int node_num = NumaNodeCount();
+  for (int node = 0; node < node_num; ++node) {
+    node_allocators_.emplace_back(std::make_shared<AutoGrowthBestFitAllocator>(
+        std::make_shared<NumaNodeChunkAllocator>(node),
+        kAlignment,
+        chunk_size,
+        /*allow_free_idle_chunk=*/true));
+  }
+  VLOG(2) << "NumaCPUAllocator with " << node_num << " arenas, chunk size "
+          << chunk_size;
+}
+
+phi::Allocation* NumaCPUAllocator::AllocateImpl(size_t size) {
+  int node = std::min(CurrentThreadNumaNode(),
+                      static_cast<int>(node_allocators_.size()) - 1);
+  auto underlying_allocation = node_allocators_[node]->Allocate(size);
+  return new NumaAllocation(
+      static_unique_ptr_cast<Allocation>(std::move(underlying_allocation)),
+      node);
+}
+
+void NumaCPUAllocator::FreeImpl(phi::Allocation* allocation) {
+  delete allocation;
+}
+
+uint64_t NumaCPUAllocator::ReleaseImpl(const phi::Place& place) {
+  uint64_t released = 0;
+  for (auto& allocator : node_allocators_) {
+    released += allocator->Release(place);
+  }
+  return released;
+}
+
+}  // namespace paddle::memory::allocation
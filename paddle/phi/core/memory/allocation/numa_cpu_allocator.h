@@ -0,0 +1,99 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "paddle/phi/core/memory/allocation/allocator.h"
+
+namespace paddle {
+namespace memory {
+namespace allocation {
+
+// The NUMA nodes of the host, 1 when it is not a NUMA host or the topology
+// is unknown.
+int NumaNodeCount();
+
+// The node the calling thread is bound to, -1 when it is not bound.
+int CurrentThreadBoundNumaNode();
+
+// The node the calling thread is bound to, or else the node of the CPU it
+// runs on.
+int CurrentThreadNumaNode();
+
+// Binds the calling thread to the CPUs of `node`, so that it runs there and
+// the NUMA CPU allocator serves it from the arena of `node`. A negative
+// node unbinds the thread and restores the CPU affinity it had before it was
+// bound. Binding again to the same node does nothing.
+void BindCurrentThreadToNumaNode(int node);
+
+// Takes the memory of a NUMA node from the system, in chunks placed on that
+// node. Out of Linux, it is the aligned memory of CPUAllocator.
+class NumaNodeChunkAllocator : public Allocator {
+ public:
+  explicit NumaNodeChunkAllocator(int node) : node_(node) {}
+
+  bool IsAllocThreadSafe() const override { return true; }
+
+ protected:
+  phi::Allocation* AllocateImpl(size_t size) override;
+  void FreeImpl(phi::Allocation* allocation) override;
+
+ private:
+  int node_;
+};
+
+class NumaAllocation : public Allocation {
+ public:
+  NumaAllocation(DecoratedAllocationPtr underlying_allocation, int node)
+      : Allocation(underlying_allocation->ptr(),
+                   underlying_allocation->base_ptr(),
+                   underlying_allocation->size(),
+                   underlying_allocation->place()),
+        underlying_allocation_(std::move(underlying_allocation)),
+        node_(node) {}
+
+  int node() const { return node_; }
+
+ private:
+  DecoratedAllocationPtr underlying_allocation_;
+  int node_;
+};
+
+// NumaCPUAllocator keeps an auto growth arena per NUMA node, and serves a
+// thread from the arena of its node, so that the tensors a thread writes
+// are local to it. A tensor is freed to the arena it came from, whatever
+// the thread freeing it.
+class NumaCPUAllocator : public Allocator {
+ public:
+  static constexpr size_t kAlignment = 64;
+
+  explicit NumaCPUAllocator(size_t chunk_size);
+
+  bool IsAllocThreadSafe() const override { return true; }
+
+ protected:
+  phi::Allocation* AllocateImpl(size_t size) override;
+  void FreeImpl(phi::Allocation* allocation) override;
+  uint64_t ReleaseImpl(const phi::Place& place) override;
+
+ private:
+  std::vector<std::shared_ptr<Allocator>> node_allocators_;
+};
+
+}  // namespace allocation
+}  // namespace memory
+}  // namespace paddle
@@ -0,0 +1,358 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/phi/core/memory/allocation/thread_caching_cpu_allocator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <mutex>  // NOLINT
+#include <unordered_map>
+#include <vector>
+
+#include "paddle/phi/core/memory/allocation/spin_lock.h"
+#include "paddle/phi/core/memory/stats.h"
+
+namespace paddle::memory::allocation {
+
+namespace {
+
+constexpr size_t kMinClassSize = 64;
+constexpr size_t kMinClassSizeLog2 = 6;
+constexpr size_t kClassesPerDoubling = 4;
+// the bytes moved at once between a thread and the central pool
+constexpr size_t kBatchBytes = 64 << 10;
+constexpr size_t kMaxBatchNum = 32;
+
+size_t Log2Floor(size_t value) {
+  size_t log2 = 0;
+  while (value >>= 1) {
+    ++log2;
+  }
+  return log2;
+}
+
+size_t BatchNum(size_t size_class) {
+  size_t num = kBatchBytes / ThreadCachingCPUAllocator::ClassSize(size_class);
+  return std::min(std::max<size_t>(num, 1), kMaxBatchNum);
+}
+
+uint64_t NextCentralPoolId() {
+  static std::atomic<uint64_t> id{0};
+  return ++id;
+}
+
+// The HostThreadCached stat of an exiting thread is added to another thread
+// holding one, or lost when there is none, while the blocks it counts are
+// still cached in the central pools. Exiting threads park it here instead,
+// and the next thread updating the stat takes it over.
+std::atomic<int64_t> exited_thread_cached_bytes{0};
+
+void UpdateThreadCachedStat(int64_t bytes) {
+  if (UNLIKELY(exited_thread_cached_bytes.load(std::memory_order_relaxed) !=
+               0)) {
+    bytes += exited_thread_cached_bytes.exchange(0, std::memory_order_relaxed);
+  }
+  if (bytes != 0) {
+    HOST_MEMORY_STAT_UPDATE(ThreadCached, 0, bytes);
+  }
+}
+
+using FreeBlocks = std::vector<DecoratedAllocationPtr>;
+
+}  // namespace
+
+struct ThreadCachingCPUAllocator::CentralPool {
+  struct FreeList {
+    SpinLock lock;
+    FreeBlocks blocks;
+  };
+
+  CentralPool(std::shared_ptr<Allocator> underlying,
+              size_t class_num,
+              size_t max_bytes)
+      : underlying(std::move(underlying)),
+        lists(class_num),
+        max_bytes(max_bytes),
+        id(NextCentralPoolId()) {}
+
+  // Moves up to `num` blocks from the front of `blocks` to the central
+  // freelist of `size_class`, as many as fit under `max_bytes`, and returns
+  // how many.
+  size_t Push(size_t size_class, FreeBlocks* blocks, size_t num) {
+    size_t class_size = ClassSize(size_class);
+    size_t used = bytes.load(std::memory_order_relaxed);
+    size_t room = used < max_bytes ? (max_bytes - used) / class_size : 0;
+    num = std::min(num, room);
+    if (num > 0) {
+      auto& central_list = lists[size_class];
+      std::lock_guard<SpinLock> guard(central_list.lock);
+      std::move(blocks->begin(),
+                blocks->begin() + num,
+                std::back_inserter(central_list.blocks));
+      bytes.fetch_add(num * class_size, std::memory_order_relaxed);
+    }
+    blocks->erase(blocks->begin(), blocks->begin() + num);
+    return num;
+  }
+
+  // Moves up to `num` blocks of `size_class` to the back of `blocks`, or all
+  // of them when `num` is 0.
+  void Pop(size_t size_class, FreeBlocks* blocks, size_t num) {
+    auto& central_list = lists[size_class];
+    std::lock_guard<SpinLock> guard(central_list.lock);
+    size_t size = central_list.blocks.size();
+    num = num == 0 ? size : std::min(num, size);
+    std::move(central_list.blocks.end() - num,
+              central_list.blocks.end(),
+              std::back_inserter(*blocks));
+    central_list.blocks.resize(size - num);
+    bytes.fetch_sub(num * ClassSize(size_class), std::memory_order_relaxed);
+  }
+
+  // declared first, so that the blocks are freed before it goes
+  std::shared_ptr<Allocator> underlying;
+  std::vector<FreeList> lists;
+  // a soft limit of the bytes in all the freelists, the blocks given back
+  // above it are freed
+  const size_t max_bytes;
+  std::atomic<size_t> bytes{0};
+  const uint64_t id;
+  // set when the allocator is destroyed
+  std::atomic<bool> closed{false};
+};
+
+struct ThreadCachingCPUAllocator::ThreadCache {
+  ThreadCache(std::shared_ptr<CentralPool> central, size_t class_num)
+      : central(std::move(central)), lists(class_num) {}
+
+  // Hands the blocks to the central pool, or frees them when the allocator
+  // is destroyed or the central pool is full. The stat of the thread is
+  // still alive, even at thread exit, see ThreadCacheRegistry.
+  ~ThreadCache() {
+    bool closed = central->closed.load(std::memory_order_acquire);
+    int64_t freed_bytes = 0;
+    for (size_t size_class = 0; size_class < lists.size(); ++size_class) {
+      FreeBlocks& blocks = lists[size_class];
+      if (blocks.empty()) {
+        continue;
+      }
+      if (!closed) {
+        central->Push(size_class, &blocks, blocks.size());
+      }
+      freed_bytes += blocks.size() * ClassSize(size_class);
+      blocks.clear();
+    }
+    UpdateThreadCachedStat(-freed_bytes);
+  }
+
+  std::shared_ptr<CentralPool> central;
+  std::vector<FreeBlocks> lists;
+};
+
+namespace {
+
+// trivially destructible, so it is still readable from the thread_local
+// destructors running after the one of the registry
+thread_local bool thread_cache_registry_alive = false;
+
+struct ThreadCacheRegistry {
+  ThreadCacheRegistry() {
+    // creates the stat of the thread first, so that it is destroyed after
+    // the registry and the thread caches can still update it
+    HOST_MEMORY_STAT_UPDATE(ThreadCached, 0, 0);
+    thread_cache_registry_alive = true;
+  }
+  ~ThreadCacheRegistry() {
+    thread_cache_registry_alive = false;
+    last = nullptr;
+    caches.clear();
+    int64_t cached =
+        ThreadDataRegistry<HostMemoryStatThreadCached0>::GetInstance()
+            .GetCurrentThreadData()
+            .current;
+    if (cached != 0) {
+      HOST_MEMORY_STAT_UPDATE(ThreadCached, 0, -cached);
+      exited_thread_cached_bytes.fetch_add(cached, std::memory_order_relaxed);
+    }
+  }
+
+  static ThreadCacheRegistry* Get() {
+    static thread_local ThreadCacheRegistry registry;
+    return thread_cache_registry_alive ? &registry : nullptr;
+  }
+
+  // by the id of the central pool, type erased as ThreadCache is private
+  std::unordered_map<uint64_t, std::shared_ptr<void>> caches;
+  uint64_t last_id{0};
+  void* last{nullptr};
+};
+
+}  // namespace
+
+ThreadCachingCPUAllocator::ThreadCachingCPUAllocator(
+    std::shared_ptr<Allocator> underlying,
+    size_t max_cached_size,
+    size_t max_central_bytes)
+    : underlying_(std::move(underlying)),
+      max_cached_size_(std::max(max_cached_size, kMinClassSize)),
+      class_num_(SizeClassOf(max_cached_size_) + 1),
+      central_(std::make_shared<CentralPool>(
+          underlying_, class_num_, max_central_bytes)) {
+  // the blocks of the last class may be larger than max_cached_size
+  max_cached_size_ = ClassSize(class_num_ - 1);
+  VLOG(2) << "ThreadCachingCPUAllocator with " << class_num_
+          << " size classes up to " << max_cached_size_ << " bytes";
+}
+
+ThreadCachingCPUAllocator::~ThreadCachingCPUAllocator() {
+  central_->closed.store(true, std::memory_order_release);
+  Release(phi::CPUPlace());
+  // the caches of the other threads are dropped on their next allocation
+  auto* registry = ThreadCacheRegistry::Get();
+  if (registry != nullptr) {
+    registry->caches.erase(central_->id);
+    if (registry->last_id == central_->id) {
+      registry->last_id = 0;
+      registry->last = nullptr;
+    }
+  }
+}
+
+size_t ThreadCachingCPUAllocator::SizeClassOf(size_t size) {
+  if (size <= kMinClassSize) {
+    return 0;
+  }
+  // 2^log2 < size <= 2^(log2 + 1)
+  size_t log2 = Log2Floor(size - 1);
+  size_t base = size_t{1} << log2;
+  size_t step = base / kClassesPerDoubling;
+  size_t index = (size - base + step - 1) / step;
+  return (log2 - kMinClassSizeLog2) * kClassesPerDoubling + index;
+}
+
+size_t ThreadCachingCPUAllocator::ClassSize(size_t size_class) {
+  if (size_class == 0) {
+    return kMinClassSize;
+  }
+  size_t log2 = (size_class - 1) / kClassesPerDoubling + kMinClassSizeLog2;
+  size_t index = (size_class - 1) % kClassesPerDoubling + 1;
+  size_t base = size_t{1} << log2;
+  return base + index * (base / kClassesPerDoubling);
+}
+
+ThreadCachingCPUAllocator::ThreadCache*
+ThreadCachingCPUAllocator::CurrentThreadCache() {
+  auto* registry = ThreadCacheRegistry::Get();
+  if (UNLIKELY(registry == nullptr)) {
+    return nullptr;
+  }
+  if (LIKELY(registry->last_id == central_->id)) {
+    return static_cast<ThreadCache*>(registry->last);
+  }
+  auto iter = registry->caches.find(central_->id);
+  if (iter == registry->caches.end()) {
+    // drop the caches of the allocators destroyed since
+    for (auto it = registry->caches.begin(); it != registry->caches.end();) {
+      if (static_cast<ThreadCache*>(it->second.get())
+              ->central->closed.load(std::memory_order_acquire)) {
+        it = registry->caches.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    iter = registry->caches
+               .emplace(central_->id,
+                        std::make_shared<ThreadCache>(central_, class_num_))
+               .first;
+  }
+  registry->last_id = central_->id;
+  registry->last = iter->second.get();
+  return static_cast<ThreadCache*>(registry->last);
+}
+
+phi::Allocation* ThreadCachingCPUAllocator::AllocateImpl(size_t size) {
+  if (size > max_cached_size_) {
+    return new ThreadCachedAllocation(
+        static_unique_ptr_cast<Allocation>(underlying_->Allocate(size)),
+        ThreadCachedAllocation::kNotCached);
+  }
+
+  size_t size_class = SizeClassOf(size);
+  size_t class_size = ClassSize(size_class);
+  ThreadCache* cache = CurrentThreadCache();
+  if (LIKELY(cache != nullptr)) {
+    FreeBlocks& blocks = cache->lists[size_class];
+    if (blocks.empty()) {
+      // take a batch from the central pool
+      central_->Pop(size_class, &blocks, BatchNum(size_class));
+    }
+    if (!blocks.empty()) {
+      DecoratedAllocationPtr block = std::move(blocks.back());
+      blocks.pop_back();
+      UpdateThreadCachedStat(-static_cast<int64_t>(class_size));
+      return new ThreadCachedAllocation(std::move(block), size_class);
+    }
+  }
+  return new ThreadCachedAllocation(
+      static_unique_ptr_cast<Allocation>(underlying_->Allocate(class_size)),
+      size_class);
+}
+
+void ThreadCachingCPUAllocator::FreeImpl(phi::Allocation* allocation) {
+  auto* cached_allocation = static_cast<ThreadCachedAllocation*>(allocation);
+  size_t size_class = cached_allocation->size_class();
+  ThreadCache* cache = size_class == ThreadCachedAllocation::kNotCached
+                           ? nullptr
+                           : CurrentThreadCache();
+  if (LIKELY(cache != nullptr)) {
+    FreeBlocks& blocks = cache->lists[size_class];
+    blocks.emplace_back(cached_allocation->TakeUnderlyingAllocation());
+    int64_t cached_bytes = ClassSize(size_class);
+
+    size_t batch_num = BatchNum(size_class);
+    if (blocks.size() >= 2 * batch_num) {
+      // give the coldest batch back to the central pool, and free what it
+      // has no room for
+      size_t trim_num =
+          batch_num - central_->Push(size_class, &blocks, batch_num);
+      blocks.erase(blocks.begin(), blocks.begin() + trim_num);
+      cached_bytes -= static_cast<int64_t>(trim_num * ClassSize(size_class));
+    }
+    UpdateThreadCachedStat(cached_bytes);
+  }
+  // frees the underlying allocation if not cached
+  delete allocation;
+}
+
+uint64_t ThreadCachingCPUAllocator::ReleaseImpl(const phi::Place& place) {
+  std::vector<FreeBlocks> released(class_num_);
+  ThreadCache* cache = CurrentThreadCache();
+  for (size_t size_class = 0; size_class < class_num_; ++size_class) {
+    if (cache != nullptr) {
+      released[size_class].swap(cache->lists[size_class]);
+    }
+    central_->Pop(size_class, &released[size_class], 0);
+  }
+
+  uint64_t released_bytes = 0;
+  for (size_t size_class = 0; size_class < class_num_; ++size_class) {
+    released_bytes += released[size_class].size() * ClassSize(size_class);
+  }
+  UpdateThreadCachedStat(-static_cast<int64_t>(released_bytes));
+  released.clear();
+  return released_bytes + underlying_->Release(place);
+}
+
+}  // namespace paddle::memory::allocation
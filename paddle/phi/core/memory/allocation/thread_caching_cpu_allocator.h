@@ -0,0 +1,100 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memory>
+#include <utility>
+
+#include "paddle/phi/core/memory/allocation/allocator.h"
+
+namespace paddle {
+namespace memory {
+namespace allocation {
+
+class ThreadCachedAllocation : public Allocation {
+ public:
+  static constexpr size_t kNotCached = static_cast<size_t>(-1);
+
+  ThreadCachedAllocation(DecoratedAllocationPtr underlying_allocation,
+                         size_t size_class)
+      : Allocation(underlying_allocation->ptr(),
+                   underlying_allocation->base_ptr(),
+                   underlying_allocation->size(),
+                   underlying_allocation->place()),
+        underlying_allocation_(std::move(underlying_allocation)),
+        size_class_(size_class) {}
+
+  size_t size_class() const { return size_class_; }
+
+  DecoratedAllocationPtr TakeUnderlyingAllocation() {
+    return std::move(underlying_allocation_);
+  }
+
+ private:
+  DecoratedAllocationPtr underlying_allocation_;
+  size_t size_class_;
+};
+
+// ThreadCachingCPUAllocator keeps the freed CPU blocks of up to
+// `max_cached_size` bytes in freelists by size class in front of
+// `underlying`, like the thread caches of tcmalloc. Every thread has its own
+// freelists, used without any lock. When a freelist of a thread grows too
+// long, a batch of its blocks goes back to the central freelist of the size
+// class, where the other threads take them a batch at a time, so that the
+// lock of a central freelist is taken once per batch and not per block.
+// Larger blocks are served by `underlying` directly. The central freelists
+// keep up to `max_central_bytes` in all, the blocks given back beyond that
+// are freed to `underlying`.
+//
+// The central pool is shared by all the threads, so it is not combined with
+// the NUMA CPU allocator, whose arenas are per node.
+//
+// The bytes cached are reported as the HostThreadCached memory stat.
+class ThreadCachingCPUAllocator : public Allocator {
+ public:
+  ThreadCachingCPUAllocator(std::shared_ptr<Allocator> underlying,
+                            size_t max_cached_size,
+                            size_t max_central_bytes);
+  ~ThreadCachingCPUAllocator() override;
+
+  bool IsAllocThreadSafe() const override { return true; }
+
+  // Four size classes per power of two, the smallest being 64 bytes.
+  static size_t SizeClassOf(size_t size);
+  static size_t ClassSize(size_t size_class);
+
+ protected:
+  phi::Allocation* AllocateImpl(size_t size) override;
+  void FreeImpl(phi::Allocation* allocation) override;
+  // Frees the blocks cached by the calling thread and the central ones.
+  uint64_t ReleaseImpl(const phi::Place& place) override;
+
+ private:
+  struct CentralPool;
+  struct ThreadCache;
+
+  // nullptr once the thread caches of the calling thread are destroyed
+  ThreadCache* CurrentThreadCache();
+
+  std::shared_ptr<Allocator> underlying_;
+  size_t max_cached_size_;
+  size_t class_num_;
+  // shared with the thread caches, which may outlive the allocator
+  std::shared_ptr<CentralPool> central_;
+};
+
+}  // namespace allocation
+}  // namespace memory
+}  // namespace paddle
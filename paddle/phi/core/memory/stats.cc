@@ -166,6 +166,7 @@ int RegisterAllStats() {
 
   HOST_MEMORY_STAT_REGISTER(Allocated);
   HOST_MEMORY_STAT_REGISTER(Reserved);
+  HOST_MEMORY_STAT_REGISTER(ThreadCached);
   return 0;
 }
 
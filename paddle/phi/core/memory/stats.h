@@ -231,6 +231,7 @@ DEVICE_MEMORY_STAT_DECLARE(Reserved);
 
 HOST_MEMORY_STAT_DECLARE(Allocated);
 HOST_MEMORY_STAT_DECLARE(Reserved);
+HOST_MEMORY_STAT_DECLARE(ThreadCached);
 
 }  // namespace memory
 }  // namespace paddle
@@ -0,0 +1,555 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/phi/kernels/weight_only_linear_kernel.h"
+
+#ifdef PADDLE_WITH_AVX
+#include <immintrin.h>
+#endif
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "paddle/phi/backends/cpu/cpu_context.h"
+#include "paddle/phi/backends/cpu/cpu_info.h"
+#include "paddle/phi/core/kernel_registry.h"
+#include "paddle/phi/kernels/funcs/blas/blas.h"
+
+namespace phi {
+
+namespace {
+
+// The build only enables AVX, so the AVX2 and AVX-512 code is compiled for its
+// own target and picked at runtime. The tile kernels are flattened, so that
+// the generic tile loops are inlined into them and built for their target.
+#if defined(__GNUC__)
+#define WEIGHT_ONLY_TARGET(isa) __attribute__((target(isa)))
+#define WEIGHT_ONLY_KERNEL(isa) __attribute__((target(isa), flatten))
+#else
+#define WEIGHT_ONLY_TARGET(isa)
+#define WEIGHT_ONLY_KERNEL(isa)
+#endif
+
+// For arch 70 weight_quantize keeps the quantized weight row major as [k, n],
+// biased to unsigned. Each 4 int8 columns are stored in the order
+// (0, 2, 1, 3) and each 8 int4 columns in the order (0, 2, 4, 6, 1, 3, 5, 7).
+constexpr int kInt8Order[4] = {0, 2, 1, 3};
+constexpr int kInt4Order[8] = {0, 2, 4, 6, 1, 3, 5, 7};
+
+// the columns computed together, a multiple of the interleaved columns
+constexpr int kTileCols = 32;
+// the rows of x computed together, so that a weight is decoded once for them
+constexpr int kTileRows = 4;
+// From this many rows the kernel is compute bound, it dequantizes panels of
+// the weight and hands them to blas.
+constexpr int kGemmMinRows = 32;
+constexpr int kPanelCols = 256;
+
+// the column of each stored weight of a row
+std::vector<int> StoredColumns(int n, int bits) {
+  std::vector<int> cols(n);
+  const int group = bits == 8 ? 4 : 8;
+  for (int j = 0; j < n; ++j) {
+    const int pos = j % group;
+    cols[j] = j - pos + (bits == 8 ? kInt8Order[pos] : kInt4Order[pos]);
+  }
+  return cols;
+}
+
+template <int bits>
+inline int LoadWeight(const uint8_t* row, int j) {
+  if (bits == 8) {
+    return static_cast<int>(row[j]) - 128;
+  }
+  return static_cast<int>((row[j / 2] >> (4 * (j % 2))) & 0xF) - 8;
+}
+
+struct VecRef {
+  using Reg = float;
+  static constexpr int kLanes = 1;
+  static Reg Zero() { return 0.f; }
+  static Reg Set1(float value) { return value; }
+  static Reg Load(const float* ptr) { return *ptr; }
+  static void Store(float* ptr, Reg value) { *ptr = value; }
+  static Reg Mul(Reg a, Reg b) { return a * b; }
+  static Reg FMAdd(Reg a, Reg b, Reg c) { return a * b + c; }
+  template <int bits>
+  static Reg Decode(const uint8_t* row, int j) {
+    return static_cast<float>(LoadWeight<bits>(row, j));
+  }
+};
+
+// The AVX-512 registers are passed around in the generic tile loops, which
+// are only inlined into the AVX-512 kernel, so the ABI of such calls is moot.
+// gcc also flags the undefined lanes inside some AVX-512 intrinsics.
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#if !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#endif
+
+#ifdef PADDLE_WITH_AVX
+struct VecAVX2 {
+  using Reg = __m256;
+  static constexpr int kLanes = 8;
+  WEIGHT_ONLY_TARGET("avx2,fma") static Reg Zero() {
+    return _mm256_setzero_ps();
+  }
+  WEIGHT_ONLY_TARGET("avx2,fma") static Reg Set1(float value) {
+    return _mm256_set1_ps(value);
+  }
+  WEIGHT_ONLY_TARGET("avx2,fma") static Reg Load(const float* ptr) {
+    return _mm256_loadu_ps(ptr);
+  }
+  WEIGHT_ONLY_TARGET("avx2,fma") static void Store(float* ptr, Reg value) {
+    _mm256_storeu_ps(ptr, value);
+  }
+  WEIGHT_ONLY_TARGET("avx2,fma") static Reg Mul(Reg a, Reg b) {
+    return _mm256_mul_ps(a, b);
+  }
+  WEIGHT_ONLY_TARGET("avx2,fma") static Reg FMAdd(Reg a, Reg b, Reg c) {
+    return _mm256_fmadd_ps(a, b, c);
+  }
+  template <int bits>
+  WEIGHT_ONLY_TARGET("avx2,fma") static Reg Decode(const uint8_t* row, int j) {
+    if (bits == 8) {
+      // flipping the sign bit removes the bias of 128
+      __m128i packed = _mm_xor_si128(
+          _mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + j)),
+          _mm_set1_epi8(static_cast<char>(0x80)));
+      return _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(packed));
+    }
+    int packed;
+    std::memcpy(&packed, row + j / 2, sizeof(packed));
+    const __m256i shifts = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+    __m256i value = _mm256_and_si256(
+        _mm256_srlv_epi32(_mm256_set1_epi32(packed), shifts),
+        _mm256_set1_epi32(0xF));
+    return _mm256_cvtepi32_ps(_mm256_sub_epi32(value, _mm256_set1_epi32(8)));
+  }
+};
+#endif
+
+#ifdef PADDLE_WITH_AVX512F
+struct VecAVX512 {
+  using Reg = __m512;
+  static constexpr int kLanes = 16;
+  WEIGHT_ONLY_TARGET("avx512f") static Reg Zero() {
+    return _mm512_setzero_ps();
+  }
+  WEIGHT_ONLY_TARGET("avx512f") static Reg Set1(float value) {
+    return _mm512_set1_ps(value);
+  }
+  WEIGHT_ONLY_TARGET("avx512f") static Reg Load(const float* ptr) {
+    return _mm512_loadu_ps(ptr);
+  }
+  WEIGHT_ONLY_TARGET("avx512f") static void Store(float* ptr, Reg value) {
+    _mm512_storeu_ps(ptr, value);
+  }
+  WEIGHT_ONLY_TARGET("avx512f") static Reg Mul(Reg a, Reg b) {
+    return _mm512_mul_ps(a, b);
+  }
+  WEIGHT_ONLY_TARGET("avx512f") static Reg FMAdd(Reg a, Reg b, Reg c) {
+    return _mm512_fmadd_ps(a, b, c);
+  }
+  template <int bits>
+  WEIGHT_ONLY_TARGET("avx512f") static Reg Decode(const uint8_t* row, int j) {
+    if (bits == 8) {
+      // flipping the sign bit removes the bias of 128
+      __m128i packed = _mm_xor_si128(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + j)),
+          _mm_set1_epi8(static_cast<char>(0x80)));
+      return _mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(packed));
+    }
+    int low, high;
+    std::memcpy(&low, row + j / 2, sizeof(low));
+    std::memcpy(&high, row + j / 2 + sizeof(low), sizeof(high));
+    const __m512i shifts = _mm512_setr_epi32(
+        0, 4, 8, 12, 16, 20, 24, 28, 0, 4, 8, 12, 16, 20, 24, 28);
+    __m512i packed = _mm512_inserti64x4(
+        _mm512_castsi256_si512(_mm256_set1_epi32(low)),
+        _mm256_set1_epi32(high),
+        1);
+    __m512i value = _mm512_and_si512(_mm512_srlv_epi32(packed, shifts),
+                                     _mm512_set1_epi32(0xF));
+    return _mm512_cvtepi32_ps(_mm512_sub_epi32(value, _mm512_set1_epi32(8)));
+  }
+};
+#endif
+
+// Computes the rows [0, rows) of x against the stored columns [j0, j0 +
+// kTileCols). The weights are dequantized in registers and shared by the
+// rows, so the weight traffic is the quantized one.
+template <typename Vec, int bits, int rows>
+void ComputeTile(const float* x,
+                 int k,
+                 const uint8_t* weight,
+                 int64_t row_bytes,
+                 const float* scales,
+                 int n,
+                 int group_size,
+                 int j0,
+                 float* tile) {
+  using Reg = typename Vec::Reg;
+  constexpr int lanes = Vec::kLanes;
+  constexpr int vecs = kTileCols / lanes;
+  Reg acc[rows][vecs];
+  for (int r = 0; r < rows; ++r) {
+    for (int v = 0; v < vecs; ++v) {
+      acc[r][v] = Vec::Zero();
+    }
+  }
+  for (int start = 0; start < k; start += group_size) {
+    const float* scale = scales + static_cast<int64_t>(start / group_size) * n;
+    const int end = std::min(k, start + group_size);
+    for (int kk = start; kk < end; ++kk) {
+      const uint8_t* row = weight + kk * row_bytes;
+      Reg xs[rows];
+      for (int r = 0; r < rows; ++r) {
+        xs[r] = Vec::Set1(x[static_cast<int64_t>(r) * k + kk]);
+      }
+      for (int v = 0; v < vecs; ++v) {
+        const int j = j0 + v * lanes;
+        Reg w = Vec::Mul(Vec::template Decode<bits>(row, j),
+                         Vec::Load(scale + j));
+        for (int r = 0; r < rows; ++r) {
+          acc[r][v] = Vec::FMAdd(xs[r], w, acc[r][v]);
+        }
+      }
+    }
+  }
+  for (int r = 0; r < rows; ++r) {
+    for (int v = 0; v < vecs; ++v) {
+      Vec::Store(tile + r * kTileCols + v * lanes, acc[r][v]);
+    }
+  }
+}
+
+// Computes the tile of the rows [0, rows) of x, rows <= kTileRows.
+template <typename Vec, int bits>
+void ComputeRowTile(const float* x,
+                    int rows,
+                    int k,
+                    const uint8_t* weight,
+                    int64_t row_bytes,
+                    const float* scales,
+                    int n,
+                    int group_size,
+                    int j0,
+                    float* tile) {
+  switch (rows) {
+    case 1:
+      ComputeTile<Vec, bits, 1>(
+          x, k, weight, row_bytes, scales, n, group_size, j0, tile);
+      break;
+    case 2:
+      ComputeTile<Vec, bits, 2>(
+          x, k, weight, row_bytes, scales, n, group_size, j0, tile);
+      break;
+    case 3:
+      ComputeTile<Vec, bits, 3>(
+          x, k, weight, row_bytes, scales, n, group_size, j0, tile);
+      break;
+    default:
+      ComputeTile<Vec, bits, kTileRows>(
+          x, k, weight, row_bytes, scales, n, group_size, j0, tile);
+      break;
+  }
+}
+
+using RowTileFunc = void (*)(const float* x,
+                             int rows,
+                             int k,
+                             const uint8_t* weight,
+                             int64_t row_bytes,
+                             const float* scales,
+                             int n,
+                             int group_size,
+                             int j0,
+                             float* tile);
+
+#ifdef PADDLE_WITH_AVX
+template <int bits>
+WEIGHT_ONLY_KERNEL("avx2,fma")
+void ComputeRowTileAVX2(const float* x,
+                        int rows,
+                        int k,
+                        const uint8_t* weight,
+                        int64_t row_bytes,
+                        const float* scales,
+                        int n,
+                        int group_size,
+                        int j0,
+                        float* tile) {
+  ComputeRowTile<VecAVX2, bits>(
+      x, rows, k, weight, row_bytes, scales, n, group_size, j0, tile);
+}
+#endif
+
+#ifdef PADDLE_WITH_AVX512F
+template <int bits>
+WEIGHT_ONLY_KERNEL("avx512f")
+void ComputeRowTileAVX512(const float* x,
+                          int rows,
+                          int k,
+                          const uint8_t* weight,
+                          int64_t row_bytes,
+                          const float* scales,
+                          int n,
+                          int group_size,
+                          int j0,
+                          float* tile) {
+  ComputeRowTile<VecAVX512, bits>(
+      x, rows, k, weight, row_bytes, scales, n, group_size, j0, tile);
+}
+#endif
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+template <int bits>
+void WeightOnlyGemv(const float* x,
+                    int m,
+                    int k,
+                    int n,
+                    const uint8_t* weight,
+                    const float* scales,
+                    int group_size,
+                    const std::vector<int>& cols,
+                    float* out) {
+  RowTileFunc compute_tile = ComputeRowTile<VecRef, bits>;
+#ifdef PADDLE_WITH_AVX
+  if (phi::backends::cpu::MayIUse(phi::backends::cpu::avx2)) {
+    compute_tile = ComputeRowTileAVX2<bits>;
+  }
+#endif
+#ifdef PADDLE_WITH_AVX512F
+  if (phi::backends::cpu::MayIUse(phi::backends::cpu::avx512f)) {
+    compute_tile = ComputeRowTileAVX512<bits>;
+  }
+#endif
+
+  const int64_t row_bytes = static_cast<int64_t>(n) * bits / 8;
+  const int row_blocks = (m + kTileRows - 1) / kTileRows;
+  const int col_tiles = n / kTileCols;
+#ifdef PADDLE_WITH_MKLML
+#pragma omp parallel for collapse(2)
+#endif
+  for (int rb = 0; rb < row_blocks; ++rb) {
+    for (int ct = 0; ct < col_tiles; ++ct) {
+      const int r0 = rb * kTileRows;
+      const int rows = std::min(kTileRows, m - r0);
+      const int j0 = ct * kTileCols;
+      float tile[kTileRows * kTileCols];
+      compute_tile(x + static_cast<int64_t>(r0) * k,
+                   rows,
+                   k,
+                   weight,
+                   row_bytes,
+                   scales,
+                   n,
+                   group_size,
+                   j0,
+                   tile);
+      for (int r = 0; r < rows; ++r) {
+        float* out_row = out + static_cast<int64_t>(r0 + r) * n;
+        for (int c = 0; c < kTileCols; ++c) {
+          out_row[cols[j0 + c]] = tile[r * kTileCols + c];
+        }
+      }
+    }
+  }
+}
+
+// Dequantizes the weight by panels of columns and multiplies them with blas,
+// a panel is small enough to stay in cache while blas reads it.
+template <int bits>
+void WeightOnlyGemm(const phi::CPUContext& dev_ctx,
+                    const float* x,
+                    int m,
+                    int k,
+                    int n,
+                    const uint8_t* weight,
+                    const float* scales,
+                    int group_size,
+                    const std::vector<int>& cols,
+                    float* out) {
+  const int64_t row_bytes = static_cast<int64_t>(n) * bits / 8;
+  auto blas = phi::funcs::GetBlas<phi::CPUContext, float>(dev_ctx);
+  std::vector<float> panel(static_cast<int64_t>(k) * kPanelCols);
+  for (int c0 = 0; c0 < n; c0 += kPanelCols) {
+    const int panel_cols = std::min(kPanelCols, n - c0);
+#ifdef PADDLE_WITH_MKLML
+#pragma omp parallel for
+#endif
+    for (int kk = 0; kk < k; ++kk) {
+      const uint8_t* row = weight + kk * row_bytes;
+      const float* scale =
+          scales + static_cast<int64_t>(kk / group_size) * n;
+      float* panel_row = panel.data() + static_cast<int64_t>(kk) * panel_cols;
+      for (int j = c0; j < c0 + panel_cols; ++j) {
+        panel_row[cols[j] - c0] =
+            static_cast<float>(LoadWeight<bits>(row, j)) * scale[j];
+      }
+    }
+    blas.GEMM(false,
+              false,
+              m,
+              panel_cols,
+              k,
+              1.f,
+              x,
+              k,
+              panel.data(),
+              panel_cols,
+              0.f,
+              out + c0,
+              n);
+  }
+}
+
+}  // namespace
+
+template <typename T, typename Context>
+void WeightOnlyLinearKernel(const Context& dev_ctx,
+                            const DenseTensor& x,
+                            const DenseTensor& weight,
+                            const paddle::optional<DenseTensor>& bias,
+                            const DenseTensor& weight_scale,
+                            const std::string& weight_dtype,
+                            const int32_t arch,
+                            const int32_t group_size,
+                            DenseTensor* out) {
+  PADDLE_ENFORCE_EQ(
+      arch,
+      70,
+      common::errors::Unimplemented(
+          "The CPU weight_only_linear reads the row major weight that "
+          "weight_quantize produces for arch 70, but got arch %d.",
+          arch));
+  PADDLE_ENFORCE_EQ(weight_dtype == "int8" || weight_dtype == "int4",
+                    true,
+                    common::errors::InvalidArgument(
+                        "weight_dtype must be 'int8' or 'int4', but got %s.",
+                        weight_dtype));
+  const int bits = weight_dtype == "int8" ? 8 : 4;
+  const auto w_dims = weight.dims();
+  const int n =
+      group_size > 0 ? weight_scale.dims()[1] : weight_scale.dims()[0];
+  const int k = w_dims[1];
+  const int m = x.numel() / k;
+  PADDLE_ENFORCE_EQ(w_dims[0] * 8 / bits,
+                    n,
+                    common::errors::InvalidArgument(
+                        "The weight holds %d columns, but weight_scale has "
+                        "%d.",
+                        w_dims[0] * 8 / bits,
+                        n));
+  PADDLE_ENFORCE_EQ(n % kTileCols,
+                    0,
+                    common::errors::InvalidArgument(
+                        "The output features of weight_only_linear on CPU "
+                        "must be divisible by %d, but got %d.",
+                        kTileCols,
+                        n));
+
+  T* out_data = dev_ctx.template Alloc<T>(out);
+  if (m == 0) {
+    return;
+  }
+
+  const std::vector<int> cols = StoredColumns(n, bits);
+  // the scales in the order of the stored columns
+  const T* weight_scale_data = weight_scale.data<T>();
+  const int scale_rows = group_size > 0 ? weight_scale.dims()[0] : 1;
+  std::vector<float> scales(static_cast<int64_t>(scale_rows) * n);
+  for (int g = 0; g < scale_rows; ++g) {
+    for (int j = 0; j < n; ++j) {
+      scales[g * n + j] =
+          static_cast<float>(weight_scale_data[g * n + cols[j]]);
+    }
+  }
+  const int rows_per_scale = group_size > 0 ? group_size : k;
+
+  std::vector<float> x_float, out_float;
+  const float* x_ptr = nullptr;
+  float* out_ptr = nullptr;
+  if (std::is_same<T, float>::value) {
+    x_ptr = reinterpret_cast<const float*>(x.data<T>());
+    out_ptr = reinterpret_cast<float*>(out_data);
+  } else {
+    const T* x_data = x.data<T>();
+    x_float.resize(x.numel());
+    for (int64_t i = 0; i < x.numel(); ++i) {
+      x_float[i] = static_cast<float>(x_data[i]);
+    }
+    out_float.resize(static_cast<int64_t>(m) * n);
+    x_ptr = x_float.data();
+    out_ptr = out_float.data();
+  }
+
+  const uint8_t* weight_data =
+      reinterpret_cast<const uint8_t*>(weight.data<int8_t>());
+  const float* scales_data = scales.data();
+  if (m >= kGemmMinRows) {
+    auto gemm = bits == 8 ? WeightOnlyGemm<8> : WeightOnlyGemm<4>;
+    gemm(dev_ctx,
+         x_ptr,
+         m,
+         k,
+         n,
+         weight_data,
+         scales_data,
+         rows_per_scale,
+         cols,
+         out_ptr);
+  } else {
+    auto gemv = bits == 8 ? WeightOnlyGemv<8> : WeightOnlyGemv<4>;
+    gemv(x_ptr,
+         m,
+         k,
+         n,
+         weight_data,
+         scales_data,
+         rows_per_scale,
+         cols,
+         out_ptr);
+  }
+
+  const T* bias_data = bias ? bias.get().data<T>() : nullptr;
+  if (bias_data || !std::is_same<T, float>::value) {
+    for (int64_t i = 0; i < static_cast<int64_t>(m) * n; ++i) {
+      float value = out_ptr[i];
+      if (bias_data) {
+        value += static_cast<float>(bias_data[i % n]);
+      }
+      out_data[i] = static_cast<T>(value);
+    }
+  }
+}
+
+}  // namespace phi
+
+PD_REGISTER_KERNEL(weight_only_linear,
+                   CPU,
+                   ALL_LAYOUT,
+                   phi::WeightOnlyLinearKernel,
+                   float,
+                   phi::dtype::float16,
+                   phi::dtype::bfloat16) {}
@@ -0,0 +1,500 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifdef PADDLE_WITH_AVX
+#include <immintrin.h>
+#endif
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "paddle/phi/backends/cpu/cpu_info.h"
+#include "paddle/phi/core/kernel_registry.h"
+#include "paddle/phi/core/tensor_utils.h"
+
+namespace phi {
+namespace fusion {
+
+namespace {
+
+// The dot products of q with the keys and the axpys of the values are the
+// inner loops of the attention. Their AVX2 and AVX-512 versions carry a
+// target attribute, since the kernel is built with -mavx only, and one of
+// them is chosen by MayIUse once per call.
+#if defined(__GNUC__)
+#define BMHA_TARGET(isa) __attribute__((target(isa)))
+#else
+#define BMHA_TARGET(isa)
+#endif
+
+using DotFunc = float (*)(const float*, const float*, int);
+using AxpyFunc = void (*)(float, const float*, float*, int);
+
+float DotRef(const float* x, const float* y, int n) {
+  float sum = 0.f;
+  for (int i = 0; i < n; ++i) {
+    sum += x[i] * y[i];
+  }
+  return sum;
+}
+
+// y += a * x
+void AxpyRef(float a, const float* x, float* y, int n) {
+  for (int i = 0; i < n; ++i) {
+    y[i] += a * x[i];
+  }
+}
+
+#ifdef PADDLE_WITH_AVX
+BMHA_TARGET("avx2,fma")
+float DotAVX2(const float* x, const float* y, int n) {
+  constexpr int block = 8;
+  __m256 sum = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + block <= n; i += block) {
+    sum = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), sum);
+  }
+  __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum),
+                           _mm256_extractf128_ps(sum, 1));
+  half = _mm_hadd_ps(half, half);
+  half = _mm_hadd_ps(half, half);
+  float res = _mm_cvtss_f32(half);
+  for (; i < n; ++i) {
+    res += x[i] * y[i];
+  }
+  return res;
+}
+
+BMHA_TARGET("avx2,fma")
+void AxpyAVX2(float a, const float* x, float* y, int n) {
+  constexpr int block = 8;
+  __m256 alpha = _mm256_set1_ps(a);
+  int i = 0;
+  for (; i + block <= n; i += block) {
+    _mm256_storeu_ps(
+        y + i,
+        _mm256_fmadd_ps(alpha, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+  }
+  for (; i < n; ++i) {
+    y[i] += a * x[i];
+  }
+}
+#endif
+
+#ifdef PADDLE_WITH_AVX512F
+BMHA_TARGET("avx512f")
+float DotAVX512(const float* x, const float* y, int n) {
+  constexpr int block = 16;
+  __m512 sum = _mm512_setzero_ps();
+  int i = 0;
+  for (; i + block <= n; i += block) {
+    sum = _mm512_fmadd_ps(_mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i), sum);
+  }
+  // _mm512_reduce_add_ps trips -Wuninitialized on some gcc versions
+  alignas(64) float lanes[block];
+  _mm512_store_ps(lanes, sum);
+  float res = 0.f;
+  for (float lane : lanes) {
+    res += lane;
+  }
+  for (; i < n; ++i) {
+    res += x[i] * y[i];
+  }
+  return res;
+}
+
+BMHA_TARGET("avx512f")
+void AxpyAVX512(float a, const float* x, float* y, int n) {
+  constexpr int block = 16;
+  __m512 alpha = _mm512_set1_ps(a);
+  int i = 0;
+  for (; i + block <= n; i += block) {
+    _mm512_storeu_ps(
+        y + i,
+        _mm512_fmadd_ps(alpha, _mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));
+  }
+  for (; i < n; ++i) {
+    y[i] += a * x[i];
+  }
+}
+#endif
+
+// Rotates the pairs (2i, 2i + 1) of x, cos and sin hold a value per pair.
+void RotaryInterleaved(const float* cos, const float* sin, int dim, float* x) {
+  for (int i = 0; i < dim / 2; ++i) {
+    const float left = x[2 * i];
+    const float right = x[2 * i + 1];
+    x[2 * i] = left * cos[i] - right * sin[i];
+    x[2 * i + 1] = right * cos[i] + left * sin[i];
+  }
+}
+
+// Rotates the pairs (i, i + dim / 2) of x as the neox style does.
+void RotaryNeox(const float* cos, const float* sin, int dim, float* x) {
+  const int half = dim / 2;
+  for (int i = 0; i < half; ++i) {
+    const float left = x[i];
+    const float right = x[i + half];
+    x[i] = left * cos[i] - right * sin[i];
+    x[i + half] = right * cos[i] + left * sin[i];
+  }
+}
+
+}  // namespace
+
+// The tokens of all the sequences are packed in qkv, a sequence either feeds
+// its prompt (seq_lens_encoder > 0) or decodes one token (seq_lens_decoder >
+// 0). K and V live in paged caches of [max_block_num, kv_num_head,
+// block_size, dim_head], block_tables maps the logical blocks of a sequence to
+// the physical ones, so the caches never move when a sequence grows.
+template <typename T, typename Context>
+void BlockMultiheadAttentionKernel(
+    const Context& dev_ctx,
+    const DenseTensor& qkv,
+    const DenseTensor& key_cache,
+    const DenseTensor& value_cache,
+    const DenseTensor& seq_lens_encoder,
+    const DenseTensor& seq_lens_decoder,
+    const DenseTensor& seq_lens_this_time,
+    const DenseTensor& padding_offsets,
+    const DenseTensor& cum_offsets,
+    const DenseTensor& cu_seqlens_q,
+    const DenseTensor& cu_seqlens_k,
+    const DenseTensor& block_tables,
+    const paddle::optional<DenseTensor>& pre_key_cache,
+    const paddle::optional<DenseTensor>& pre_value_cache,
+    const paddle::optional<DenseTensor>& rope_emb,
+    const paddle::optional<DenseTensor>& mask,
+    const paddle::optional<DenseTensor>& tgt_mask,
+    const paddle::optional<DenseTensor>& cache_k_quant_scales,
+    const paddle::optional<DenseTensor>& cache_v_quant_scales,
+    const paddle::optional<DenseTensor>& cache_k_dequant_scales,
+    const paddle::optional<DenseTensor>& cache_v_dequant_scales,
+    const paddle::optional<DenseTensor>& qkv_out_scale,
+    const paddle::optional<DenseTensor>& qkv_bias,
+    const paddle::optional<DenseTensor>& out_shift,
+    const paddle::optional<DenseTensor>& out_smooth,
+    const paddle::optional<DenseTensor>& max_enc_len_this_time,
+    const paddle::optional<DenseTensor>& max_dec_len_this_time,
+    int max_seq_len,
+    int block_size,
+    bool use_neox_style,
+    const bool dynamic_cachekv_quant,
+    const int quant_round_type,
+    const float quant_max_bound,
+    const float quant_min_bound,
+    const float out_scale,
+    const std::string& compute_dtype,
+    const float rope_theta,
+    DenseTensor* fmha_out,
+    DenseTensor* qkv_out,
+    DenseTensor* key_cache_out,
+    DenseTensor* value_cache_out) {
+  PADDLE_ENFORCE_EQ(
+      pre_key_cache || pre_value_cache,
+      false,
+      common::errors::Unimplemented(
+          "block_multihead_attention on CPU does not support pre_cache."));
+  PADDLE_ENFORCE_EQ(
+      cache_k_quant_scales || cache_v_quant_scales || cache_k_dequant_scales ||
+          cache_v_dequant_scales || dynamic_cachekv_quant,
+      false,
+      common::errors::Unimplemented("block_multihead_attention on CPU does "
+                                    "not support cache kv quant."));
+  PADDLE_ENFORCE_EQ(
+      qkv_out_scale.get_ptr(),
+      nullptr,
+      common::errors::Unimplemented("block_multihead_attention on CPU does "
+                                    "not support qkv_out_scale."));
+  PADDLE_ENFORCE_EQ(
+      out_scale > 0 || out_shift || out_smooth,
+      false,
+      common::errors::Unimplemented("block_multihead_attention on CPU does "
+                                    "not support out quant."));
+  PADDLE_ENFORCE_EQ(key_cache.dims()[2],
+                    block_size,
+                    common::errors::InvalidArgument(
+                        "The third dim of key_cache must be block_size %d, "
+                        "but got %d.",
+                        block_size,
+                        key_cache.dims()[2]));
+
+  const int token_num = qkv.dims()[0];
+  const int kv_num_head = key_cache.dims()[1];
+  const int dim_head = key_cache.dims()[3];
+  const int total_num_head = qkv.dims()[qkv.dims().size() - 1] / dim_head;
+  const int q_num_head = total_num_head - 2 * kv_num_head;
+  const int gqa_group_size = q_num_head / kv_num_head;
+  const int bsz = cum_offsets.dims()[0];
+  const int max_block_per_seq = block_tables.dims()[1];
+  const int64_t qkv_stride = total_num_head * dim_head;
+  const int64_t block_stride = kv_num_head * block_size * dim_head;
+  const float scale = 1.0f / std::sqrt(static_cast<float>(dim_head));
+  VLOG(3) << "bsz: " << bsz << " token_num: " << token_num
+          << " q_num_head: " << q_num_head << " kv_num_head: " << kv_num_head
+          << " dim_head: " << dim_head
+          << " max_block_per_seq: " << max_block_per_seq;
+
+  // q, k and v are updated in place like the other devices do
+  if (!qkv_out->IsSharedBufferWith(qkv)) {
+    phi::Copy(dev_ctx, qkv, dev_ctx.GetPlace(), false, qkv_out);
+  }
+  if (!key_cache_out->IsSharedBufferWith(key_cache)) {
+    phi::Copy(dev_ctx, key_cache, dev_ctx.GetPlace(), false, key_cache_out);
+  }
+  if (!value_cache_out->IsSharedBufferWith(value_cache)) {
+    phi::Copy(
+        dev_ctx, value_cache, dev_ctx.GetPlace(), false, value_cache_out);
+  }
+  T* qkv_data = qkv_out->data<T>();
+  T* key_cache_data = key_cache_out->data<T>();
+  T* value_cache_data = value_cache_out->data<T>();
+  T* out_data = dev_ctx.template Alloc<T>(fmha_out);
+
+  const int* seq_lens_encoder_data = seq_lens_encoder.data<int>();
+  const int* seq_lens_decoder_data = seq_lens_decoder.data<int>();
+  const int* seq_lens_this_time_data = seq_lens_this_time.data<int>();
+  const int* padding_offsets_data = padding_offsets.data<int>();
+  const int* block_tables_data = block_tables.data<int>();
+  const T* qkv_bias_data = qkv_bias ? qkv_bias->data<T>() : nullptr;
+
+  const float* rope_data = rope_emb ? rope_emb->data<float>() : nullptr;
+  // cos is followed by sin, [2, 1, rope_len, 1, dim_head or dim_head / 2]
+  const int64_t rope_stride =
+      rope_emb ? rope_emb->dims()[2] * rope_emb->dims()[4] : 0;
+  const int rope_dim = use_neox_style ? dim_head : dim_head / 2;
+
+  const T* mask_data = mask ? mask->data<T>() : nullptr;
+  const int mask_num_head = mask ? mask->dims()[1] : 0;
+  const int64_t mask_rows = mask ? mask->dims()[2] : 0;
+  const int64_t mask_cols = mask ? mask->dims()[3] : 0;
+  const T* tgt_mask_data = tgt_mask ? tgt_mask->data<T>() : nullptr;
+  const int tgt_mask_num_head = tgt_mask ? tgt_mask->dims()[1] : 0;
+  const int64_t tgt_mask_len =
+      tgt_mask ? tgt_mask->dims()[tgt_mask->dims().size() - 1] : 0;
+
+  // The position of the query of each token, -1 for the padding tokens of
+  // the stopped sequences. The decoding tokens rotate a copy of q and k, so
+  // qkv_out keeps them as the other devices do.
+  std::vector<int> query_pos(token_num, -1);
+  std::vector<float> decoder_q(static_cast<int64_t>(bsz) * q_num_head *
+                               dim_head);
+
+  DotFunc dot = DotRef;
+  AxpyFunc axpy = AxpyRef;
+#ifdef PADDLE_WITH_AVX
+  if (phi::backends::cpu::MayIUse(phi::backends::cpu::avx2)) {
+    dot = DotAVX2;
+    axpy = AxpyAVX2;
+  }
+#endif
+#ifdef PADDLE_WITH_AVX512F
+  if (phi::backends::cpu::MayIUse(phi::backends::cpu::avx512f)) {
+    dot = DotAVX512;
+    axpy = AxpyAVX512;
+  }
+#endif
+
+  // add the bias, apply the rotary embedding and write k and v to the caches
+#ifdef PADDLE_WITH_MKLML
+#pragma omp parallel
+#endif
+  {
+    // the scratch of the thread, shared by its tokens
+    std::vector<float> decoder_k(kv_num_head * dim_head);
+    std::vector<float> cos(rope_dim), sin(rope_dim);
+#ifdef PADDLE_WITH_MKLML
+#pragma omp for
+#endif
+    for (int ti = 0; ti < token_num; ++ti) {
+      const int ori_token_idx = ti + padding_offsets_data[ti];
+      const int bi = ori_token_idx / max_seq_len;
+      const bool is_encoder = seq_lens_encoder_data[bi] > 0;
+      if (!is_encoder && (seq_lens_decoder_data[bi] == 0 ||
+                          seq_lens_this_time_data[bi] == 0)) {
+        continue;
+      }
+      const int pos =
+          is_encoder ? ori_token_idx % max_seq_len : seq_lens_decoder_data[bi];
+      query_pos[ti] = pos;
+
+      T* token_qkv = qkv_data + ti * qkv_stride;
+      if (qkv_bias_data) {
+        for (int64_t i = 0; i < qkv_stride; ++i) {
+          token_qkv[i] += qkv_bias_data[i];
+        }
+      }
+
+      T* q = token_qkv;
+      T* k = token_qkv + q_num_head * dim_head;
+      const T* v = k + kv_num_head * dim_head;
+      if (!is_encoder) {
+        q = decoder_q.data() + bi * q_num_head * dim_head;
+        std::memcpy(q, token_qkv, q_num_head * dim_head * sizeof(T));
+        std::memcpy(decoder_k.data(), k, kv_num_head * dim_head * sizeof(T));
+        k = decoder_k.data();
+      }
+
+      if (rope_data) {
+        if (use_neox_style) {
+          std::memcpy(cos.data(),
+                      rope_data + pos * dim_head,
+                      rope_dim * sizeof(float));
+          std::memcpy(sin.data(),
+                      rope_data + rope_stride + pos * dim_head,
+                      rope_dim * sizeof(float));
+        } else if (is_encoder) {
+          std::memcpy(cos.data(),
+                      rope_data + pos * rope_dim,
+                      rope_dim * sizeof(float));
+          std::memcpy(sin.data(),
+                      rope_data + rope_stride + pos * rope_dim,
+                      rope_dim * sizeof(float));
+        } else {
+          // the decoding step computes the angles from rope_theta
+          for (int i = 0; i < rope_dim; ++i) {
+            const float angle =
+                pos / std::pow(rope_theta,
+                               static_cast<float>(2 * i) / dim_head);
+            cos[i] = std::cos(angle);
+            sin[i] = std::sin(angle);
+          }
+        }
+        auto rotary = use_neox_style ? RotaryNeox : RotaryInterleaved;
+        for (int hi = 0; hi < q_num_head; ++hi) {
+          rotary(cos.data(), sin.data(), dim_head, q + hi * dim_head);
+        }
+        for (int hi = 0; hi < kv_num_head; ++hi) {
+          rotary(cos.data(), sin.data(), dim_head, k + hi * dim_head);
+        }
+      }
+
+      const int block_id =
+          block_tables_data[bi * max_block_per_seq + pos / block_size];
+      const int block_offset = pos % block_size;
+      for (int hi = 0; hi < kv_num_head; ++hi) {
+        const int64_t cache_offset =
+            block_id * block_stride +
+            (hi * block_size + block_offset) * dim_head;
+        std::memcpy(key_cache_data + cache_offset,
+                    k + hi * dim_head,
+                    dim_head * sizeof(T));
+        std::memcpy(value_cache_data + cache_offset,
+                    v + hi * dim_head,
+                    dim_head * sizeof(T));
+      }
+    }
+  }
+
+  // Every query walks the blocks of its sequence and keeps a running max and
+  // sum of the softmax, so no score matrix of the whole sequence is needed.
+#ifdef PADDLE_WITH_MKLML
+#pragma omp parallel
+#endif
+  {
+    // the scratch of the thread, shared by its queries
+    std::vector<float> scores(block_size);
+    std::vector<float> acc(dim_head);
+#ifdef PADDLE_WITH_MKLML
+#pragma omp for collapse(2) schedule(dynamic)
+#endif
+    for (int ti = 0; ti < token_num; ++ti) {
+      for (int hi = 0; hi < q_num_head; ++hi) {
+        const int pos = query_pos[ti];
+        if (pos < 0) {
+          continue;
+        }
+        const int bi = (ti + padding_offsets_data[ti]) / max_seq_len;
+        const bool is_encoder = seq_lens_encoder_data[bi] > 0;
+        const int kv_hi = hi / gqa_group_size;
+        const float* q = is_encoder
+                             ? qkv_data + ti * qkv_stride + hi * dim_head
+                             : decoder_q.data() +
+                                   (bi * q_num_head + hi) * dim_head;
+
+        // the prompt sees itself under a mask, otherwise the keys up to pos
+        const T* row_mask = nullptr;
+        int kv_len = pos + 1;
+        if (is_encoder && mask_data) {
+          kv_len = seq_lens_encoder_data[bi];
+          const int mask_hi = mask_num_head == 1 ? 0 : hi;
+          row_mask = mask_data +
+                     ((bi * mask_num_head + mask_hi) * mask_rows + pos) *
+                         mask_cols;
+        } else if (!is_encoder && tgt_mask_data) {
+          const int mask_hi = tgt_mask_num_head == 1 ? 0 : hi;
+          row_mask = tgt_mask_data +
+                     (bi * tgt_mask_num_head + mask_hi) * tgt_mask_len;
+        }
+
+        std::fill(acc.begin(), acc.end(), 0.f);
+        float max_score = -std::numeric_limits<float>::infinity();
+        float sum = 0.f;
+        const int* block_table = block_tables_data + bi * max_block_per_seq;
+        for (int start = 0; start < kv_len; start += block_size) {
+          const int len = std::min(block_size, kv_len - start);
+          const int64_t cache_offset =
+              block_table[start / block_size] * block_stride +
+              kv_hi * block_size * dim_head;
+          const T* k = key_cache_data + cache_offset;
+          const T* v = value_cache_data + cache_offset;
+
+          float block_max = -std::numeric_limits<float>::infinity();
+          for (int j = 0; j < len; ++j) {
+            scores[j] = dot(q, k + j * dim_head, dim_head) * scale;
+            if (row_mask) {
+              scores[j] += row_mask[start + j];
+            }
+            block_max = std::max(block_max, scores[j]);
+          }
+          if (block_max == -std::numeric_limits<float>::infinity()) {
+            continue;
+          }
+          if (block_max > max_score) {
+            const float correction = std::exp(max_score - block_max);
+            for (int d = 0; d < dim_head; ++d) {
+              acc[d] *= correction;
+            }
+            sum *= correction;
+            max_score = block_max;
+          }
+          for (int j = 0; j < len; ++j) {
+            const float p = std::exp(scores[j] - max_score);
+            sum += p;
+            axpy(p, v + j * dim_head, acc.data(), dim_head);
+          }
+        }
+
+        T* out =
+            out_data + (static_cast<int64_t>(ti) * q_num_head + hi) * dim_head;
+        const float inv_sum = sum > 0.f ? 1.f / sum : 0.f;
+        for (int d = 0; d < dim_head; ++d) {
+          out[d] = acc[d] * inv_sum;
+        }
+      }
+    }
+  }
+}
+
+}  // namespace fusion
+}  // namespace phi
+
+PD_REGISTER_KERNEL(block_multihead_attention,
+                   CPU,
+                   ALL_LAYOUT,
+                   phi::fusion::BlockMultiheadAttentionKernel,
+                   float) {}
@@ -39,6 +39,9 @@ if TYPE_CHECKING:
 
 
 def _get_arch_info():
+    # The CPU kernels read the row major layout of SM70.
+    if paddle.get_device() == 'cpu':
+        return 70
     # Get SMVersion from device.
     cuda_version = paddle.version.cuda()
     if (
@@ -66,7 +69,7 @@ def weight_quantize(
         x (Tensor): The input Tensor to be quantized, the data type is float16 or bfloat16.
         algo (str): The algo that is x will be apply, must be one of 'weight_only_int8',
             'weight_only_int4' and 'llm.int8', default: 'weight_only_int8'.
-        arch (int): The compute arch for target device. For example, A100 is 80, v100 is 70, if you do not assign arch, we will get arch from your device, default: None.
+        arch (int): The compute arch for target device. For example, A100 is 80, v100 is 70, if you do not assign arch, we will get arch from your device, default: None. On CPU, it defaults to 70, whose row major layout the CPU kernel reads.
         group_size (int): The group size for weight quantization. -1 stands for default per-channel mode. Currently only support 64 or 128.
 
     Returns:
@@ -200,7 +203,7 @@ def weight_only_linear(
             be performed. Otherwise, The bias is added to the matrix multiplication result.
         weight_scale (Tensor|None): The input scale Tensor Provided to weight for dequantization. Its rank must be 1.
         weight_dtype(str): The dtype of  weight Tensor, must be one of 'int8', 'int4', Defaulted to 'int8'.
-        arch (int): The compute arch for target device. For example, A100 is 80, v100 is 70, if you do not assign arch, we will get arch from your device, default: None.
+        arch (int): The compute arch for target device. For example, A100 is 80, v100 is 70, if you do not assign arch, we will get arch from your device, default: None. On CPU, it defaults to 70, whose row major layout the CPU kernel reads.
         group_size (int): The group size for weight quantization. -1 stands for default per-channel mode. Currently only support 64 or 128.
     Returns:
         Tensor: the output Tensor, the data type is the same as that of x.
@@ -60,3 +60,61 @@ TEST(FS, mv) {
 
 #endif
 }
+
+TEST(FS, native_io) {
+#ifdef _LINUX
+  if (!paddle::framework::localfs_native_io()) {
+    return;
+  }
+  std::string content;
+  for (int i = 0; i < 100000; ++i) {
+    content += std::to_string(i) + " some feature values\n";
+  }
+  auto write_file = [&](const std::string& path, const std::string& data) {
+    int err_no = 0;
+    auto fp = paddle::framework::fs_open_write(path, &err_no, "");
+    ASSERT_EQ(fwrite(data.data(), 1, data.size(), fp.get()), data.size());
+  };
+  auto read_file = [](const std::string& path) {
+    int err_no = 0;
+    auto fp = paddle::framework::fs_open_read(path, &err_no, "");
+    std::string data;
+    char buf[4096];
+    size_t n = 0;
+    while ((n = fread(buf, 1, sizeof(buf), fp.get())) > 0) {
+      data.append(buf, n);
+    }
+    return data;
+  };
+
+  for (bool direct_io : {false, true}) {
+    paddle::framework::localfs_set_direct_io(direct_io);
+    // parent directories are created on write
+    write_file("native_io_test/a/part-000", content);
+    ASSERT_EQ(read_file("native_io_test/a/part-000"), content);
+    write_file("native_io_test/a/part-000.gz", content);
+    ASSERT_EQ(read_file("native_io_test/a/part-000.gz"), content);
+  }
+  paddle::framework::localfs_set_direct_io(false);
+  ASSERT_LT(
+      paddle::framework::localfs_file_size("native_io_test/a/part-000.gz"),
+      static_cast<int64_t>(content.size()));
+
+  int err_no = 0;
+  {
+    auto fp = paddle::framework::fs_open_append_write(
+        "native_io_test/a/part-000", &err_no, "");
+    ASSERT_EQ(fwrite("tail\n", 1, 5, fp.get()), 5u);
+  }
+  ASSERT_EQ(read_file("native_io_test/a/part-000"), content + "tail\n");
+
+  // files written by the gzip pipeline are read natively and vice versa
+  paddle::framework::localfs_set_native_io(false);
+  write_file("native_io_test/b.gz", content);
+  ASSERT_EQ(read_file("native_io_test/a/part-000.gz"), content);
+  paddle::framework::localfs_set_native_io(true);
+  ASSERT_EQ(read_file("native_io_test/b.gz"), content);
+
+  paddle::framework::localfs_remove("native_io_test");
+#endif
+}
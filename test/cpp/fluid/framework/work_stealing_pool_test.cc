@@ -0,0 +1,78 @@
+/* Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/framework/work_stealing_pool.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <stdexcept>
+
+namespace framework = paddle::framework;
+
+TEST(WorkStealingPool, SpawnedTasks) {
+  framework::WorkStealingPool pool(4);
+  int outer = pool.AddStage("outer");
+  int inner = pool.AddStage("inner");
+  const int chunk_lines = 16;
+  std::atomic<int> lines(0);
+  // the first task is slow and spawns most of the chunks, the others may
+  // steal them to finish early
+  for (int i = 0; i < 4; ++i) {
+    pool.Run(outer, [&, i]() {
+      int num = i == 0 ? 200 : 10;
+      for (int j = 0; j < num; ++j) {
+        pool.Run(inner, [&]() {
+          std::this_thread::sleep_for(std::chrono::microseconds(100));
+          lines.fetch_add(chunk_lines);
+        });
+        pool.RunPendingTasks(8);
+      }
+    });
+  }
+  pool.Wait();
+  // every line is consumed once, whichever thread ran its chunk
+  EXPECT_EQ(lines.load(), 230 * chunk_lines);
+
+  auto stats = pool.GetStats();
+  ASSERT_EQ(stats.thread_num, 4);
+  ASSERT_EQ(stats.stages.size(), 2UL);
+  EXPECT_EQ(stats.stages[0].name, "outer");
+  EXPECT_EQ(stats.stages[0].tasks, 4UL);
+  EXPECT_EQ(stats.stages[1].tasks, 230UL);
+  EXPECT_LE(stats.stages[1].stolen, stats.stages[1].tasks);
+  EXPECT_GT(stats.stages[1].busy_seconds, 0);
+  EXPECT_FALSE(stats.ToString().empty());
+}
+
+TEST(WorkStealingPool, Exception) {
+  framework::WorkStealingPool pool(2);
+  int stage = pool.AddStage("throw");
+  std::atomic<int> sum(0);
+  for (int i = 0; i < 10; ++i) {
+    pool.Run(stage, [&, i]() {
+      if (i == 5) {
+        throw std::runtime_error("task failed");
+      }
+      sum.fetch_add(1);
+    });
+  }
+  EXPECT_THROW(pool.Wait(), std::runtime_error);
+  EXPECT_EQ(sum.load(), 9);
+  // the pool is still usable
+  pool.Run(stage, [&]() { sum.fetch_add(1); });
+  pool.Wait();
+  EXPECT_EQ(sum.load(), 10);
+}
@@ -16,7 +16,14 @@
 
 #include "paddle/phi/core/memory/allocation/mmap_allocator.h"
 
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
 #include "gtest/gtest.h"
+#include "paddle/phi/backends/context_pool.h"
+#include "paddle/phi/core/framework/dense_tensor_serialize.h"
 
 namespace paddle {
 namespace memory {
@@ -46,6 +53,96 @@ TEST(MemoryMapAllocation, test_allocation_base) {
   }
 }
 
+void SaveTensors(const std::string& file_name, bool align_data) {
+  auto* dev_ctx = phi::DeviceContextPool::Instance().Get(phi::CPUPlace());
+  std::ofstream fout(file_name, std::ios::binary);
+  for (int i = 0; i < 3; ++i) {
+    phi::DenseTensor tensor;
+    tensor.Resize({i + 1, 7});
+    float* data = dev_ctx->Alloc<float>(&tensor);
+    for (int64_t j = 0; j < tensor.numel(); ++j) {
+      data[j] = static_cast<float>(i * 100 + j);
+    }
+    phi::SerializeToStream(fout, tensor, *dev_ctx, align_data);
+  }
+}
+
+void CheckTensor(const phi::DenseTensor& tensor, int i) {
+  ASSERT_EQ(tensor.dims(), common::make_ddim({i + 1, 7}));
+  for (int64_t j = 0; j < tensor.numel(); ++j) {
+    ASSERT_EQ(tensor.data<float>()[j], static_cast<float>(i * 100 + j));
+  }
+}
+
+TEST(MemoryMapFileAllocation, share_aligned_tensors) {
+  // by pid, as the child forked by test_allocation_base runs the tests too
+  const std::string file_name =
+      "mmap_file_allocation_test_aligned_" + std::to_string(getpid());
+  SaveTensors(file_name, true);
+
+  // still readable as before
+  {
+    std::ifstream fin(file_name, std::ios::binary);
+    for (int i = 0; i < 3; ++i) {
+      phi::DenseTensor tensor;
+      phi::DeserializeFromStream(fin, &tensor);
+      CheckTensor(tensor, i);
+    }
+  }
+
+  std::vector<phi::DenseTensor> tensors(3);
+  {
+    auto mapping = AllocateMemoryMapFileAllocation(file_name);
+    size_t offset = 0;
+    for (int i = 0; i < 3; ++i) {
+      EXPECT_TRUE(phi::DeserializeFromBuffer(mapping, &offset, &tensors[i]));
+      const char* data = static_cast<const char*>(tensors[i].data());
+      EXPECT_GE(data, static_cast<const char*>(mapping->ptr()));
+      EXPECT_LT(data, static_cast<const char*>(mapping->ptr()) + offset);
+    }
+    EXPECT_EQ(offset, mapping->size());
+  }
+  // the tensors keep the mapping alive
+  for (int i = 0; i < 3; ++i) {
+    CheckTensor(tensors[i], i);
+  }
+
+  // the pages written are private to the process
+  tensors[0].data<float>()[0] = -1.f;
+  {
+    auto mapping = AllocateMemoryMapFileAllocation(file_name);
+    size_t offset = 0;
+    phi::DenseTensor tensor;
+    phi::DeserializeFromBuffer(mapping, &offset, &tensor);
+    CheckTensor(tensor, 0);
+  }
+  std::remove(file_name.c_str());
+}
+
+TEST(MemoryMapFileAllocation, copy_unaligned_tensors) {
+  // by pid, as the child forked by test_allocation_base runs the tests too
+  const std::string file_name =
+      "mmap_file_allocation_test_unaligned_" + std::to_string(getpid());
+  SaveTensors(file_name, false);
+
+  auto mapping = AllocateMemoryMapFileAllocation(file_name);
+  size_t offset = 0;
+  size_t shared_num = 0;
+  for (int i = 0; i < 3; ++i) {
+    phi::DenseTensor tensor;
+    if (phi::DeserializeFromBuffer(mapping, &offset, &tensor)) {
+      ++shared_num;
+    }
+    CheckTensor(tensor, i);
+  }
+  EXPECT_LT(shared_num, 3UL);
+  EXPECT_EQ(offset, mapping->size());
+
+  phi::DenseTensor tensor;
+  EXPECT_ANY_THROW(phi::DeserializeFromBuffer(mapping, &offset, &tensor));
+  std::remove(file_name.c_str());
+}
+
 }  // namespace allocation
 }  // namespace memory
 }  // namespace paddle
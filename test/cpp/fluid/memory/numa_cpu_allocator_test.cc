@@ -0,0 +1,109 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/phi/core/memory/allocation/numa_cpu_allocator.h"
+
+#include <cstring>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+PD_DECLARE_bool(free_idle_chunk);
+
+namespace paddle {
+namespace memory {
+namespace allocation {
+
+TEST(NumaCPUAllocator, allocate_on_bound_node) {
+  ASSERT_GE(NumaNodeCount(), 1);
+  auto allocator = std::make_shared<NumaCPUAllocator>(1 << 20);
+
+  std::thread worker([&] {
+#ifdef __linux__
+    // a mask of its own, which unbinding gives back
+    cpu_set_t mask, restored;
+    CPU_ZERO(&mask);
+    CPU_SET(sched_getcpu(), &mask);
+    ASSERT_EQ(sched_setaffinity(0, sizeof(mask), &mask), 0);
+#endif
+    BindCurrentThreadToNumaNode(0);
+    EXPECT_EQ(CurrentThreadBoundNumaNode(), 0);
+    EXPECT_EQ(CurrentThreadNumaNode(), 0);
+
+    auto allocation = allocator->Allocate(1000);
+    ASSERT_NE(allocation->ptr(), nullptr);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(allocation->ptr()) %
+                  NumaCPUAllocator::kAlignment,
+              0UL);
+    EXPECT_GE(allocation->size(), 1000UL);
+    auto* numa_allocation = dynamic_cast<NumaAllocation*>(allocation.get());
+    ASSERT_NE(numa_allocation, nullptr);
+    EXPECT_EQ(numa_allocation->node(), 0);
+    std::memset(allocation->ptr(), 1, 1000);
+
+    BindCurrentThreadToNumaNode(-1);
+    EXPECT_EQ(CurrentThreadBoundNumaNode(), -1);
+#ifdef __linux__
+    ASSERT_EQ(sched_getaffinity(0, sizeof(restored), &restored), 0);
+    EXPECT_TRUE(CPU_EQUAL(&mask, &restored));
+#endif
+  });
+  worker.join();
+}
+
+TEST(NumaCPUAllocator, free_on_other_thread) {
+  bool free_idle_chunk = FLAGS_free_idle_chunk;
+  FLAGS_free_idle_chunk = false;
+  auto allocator = std::make_shared<NumaCPUAllocator>(1 << 20);
+  const int thread_num = 4;
+  const int alloc_num = 64;
+
+  std::vector<std::vector<AllocationPtr>> allocations(thread_num);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < thread_num; ++i) {
+    threads.emplace_back([&, i] {
+      for (int j = 0; j < alloc_num; ++j) {
+        size_t size = (i + 1) * (j + 1) * 128;
+        auto allocation = allocator->Allocate(size);
+        std::memset(allocation->ptr(), i, size);
+        allocations[i].emplace_back(std::move(allocation));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  threads.clear();
+
+  // free on a thread other than the allocating one
+  for (int i = 0; i < thread_num; ++i) {
+    threads.emplace_back(
+        [&, i] { allocations[(i + 1) % thread_num].clear(); });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_GT(allocator->Release(phi::CPUPlace()), 0UL);
+  FLAGS_free_idle_chunk = free_idle_chunk;
+}
+
+}  // namespace allocation
+}  // namespace memory
+}  // namespace paddle
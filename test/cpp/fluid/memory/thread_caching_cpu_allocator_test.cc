@@ -0,0 +1,191 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/phi/core/memory/allocation/thread_caching_cpu_allocator.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <future>  // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "paddle/phi/core/memory/stats.h"
+
+namespace paddle {
+namespace memory {
+namespace allocation {
+
+class CountedAllocator : public Allocator {
+ public:
+  bool IsAllocThreadSafe() const override { return true; }
+
+  int64_t AllocatedNum() const { return allocated_num_; }
+  int64_t LiveNum() const { return live_num_; }
+
+ protected:
+  phi::Allocation *AllocateImpl(size_t size) override {
+    ++allocated_num_;
+    ++live_num_;
+    return new Allocation(malloc(size), size, phi::CPUPlace());  // NOLINT
+  }
+
+  void FreeImpl(phi::Allocation *allocation) override {
+    --live_num_;
+    free(allocation->ptr());  // NOLINT
+    delete allocation;
+  }
+
+ private:
+  std::atomic<int64_t> allocated_num_{0};
+  std::atomic<int64_t> live_num_{0};
+};
+
+TEST(ThreadCachingCPUAllocator, size_class) {
+  EXPECT_EQ(ThreadCachingCPUAllocator::SizeClassOf(1), 0UL);
+  EXPECT_EQ(ThreadCachingCPUAllocator::ClassSize(0), 64UL);
+  EXPECT_EQ(ThreadCachingCPUAllocator::ClassSize(
+                ThreadCachingCPUAllocator::SizeClassOf(100)),
+            112UL);
+  EXPECT_EQ(ThreadCachingCPUAllocator::ClassSize(
+                ThreadCachingCPUAllocator::SizeClassOf(4096)),
+            4096UL);
+  for (size_t size = 1; size <= (1 << 20); size += 7) {
+    size_t size_class = ThreadCachingCPUAllocator::SizeClassOf(size);
+    EXPECT_GE(ThreadCachingCPUAllocator::ClassSize(size_class), size);
+    if (size_class > 0) {
+      EXPECT_LT(ThreadCachingCPUAllocator::ClassSize(size_class - 1), size);
+    }
+  }
+}
+
+TEST(ThreadCachingCPUAllocator, reuse_in_thread) {
+  auto underlying = std::make_shared<CountedAllocator>();
+  auto allocator = std::make_shared<ThreadCachingCPUAllocator>(
+      underlying, 256 << 10, 64 << 20);
+  int64_t cached_bytes = HOST_MEMORY_STAT_CURRENT_VALUE(ThreadCached, 0);
+
+  void *ptr = nullptr;
+  {
+    auto allocation = allocator->Allocate(100);
+    ptr = allocation->ptr();
+    EXPECT_EQ(allocation->size(), 112UL);
+  }
+  EXPECT_EQ(HOST_MEMORY_STAT_CURRENT_VALUE(ThreadCached, 0),
+            cached_bytes + 112);
+  {
+    auto allocation = allocator->Allocate(110);
+    EXPECT_EQ(allocation->ptr(), ptr);
+  }
+  EXPECT_EQ(underlying->AllocatedNum(), 1);
+
+  // larger than the cached size, not cached
+  {
+    auto allocation = allocator->Allocate(1 << 20);
+    EXPECT_EQ(underlying->LiveNum(), 2);
+  }
+  EXPECT_EQ(underlying->LiveNum(), 1);
+
+  EXPECT_EQ(allocator->Release(phi::CPUPlace()), 112UL);
+  EXPECT_EQ(underlying->LiveNum(), 0);
+  EXPECT_EQ(HOST_MEMORY_STAT_CURRENT_VALUE(ThreadCached, 0), cached_bytes);
+}
+
+TEST(ThreadCachingCPUAllocator, multi_thread) {
+  auto underlying = std::make_shared<CountedAllocator>();
+  auto allocator = std::make_shared<ThreadCachingCPUAllocator>(
+      underlying, 256 << 10, 64 << 20);
+  const int thread_num = 8;
+  const int round_num = 100;
+  const int alloc_num = 64;
+  int64_t cached_bytes = HOST_MEMORY_STAT_CURRENT_VALUE(ThreadCached, 0);
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < thread_num; ++i) {
+    threads.emplace_back([&, i] {
+      std::vector<AllocationPtr> allocations;
+      for (int round = 0; round < round_num; ++round) {
+        for (int j = 0; j < alloc_num; ++j) {
+          size_t size = ((i + j) % 16 + 1) * 512;
+          auto allocation = allocator->Allocate(size);
+          std::memset(allocation->ptr(), i, size);
+          allocations.emplace_back(std::move(allocation));
+        }
+        allocations.clear();
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  // the caches of the exited threads went to the central pool
+  EXPECT_LT(underlying->AllocatedNum(), thread_num * round_num * alloc_num);
+  EXPECT_GT(underlying->LiveNum(), 0);
+  allocator->Release(phi::CPUPlace());
+  EXPECT_EQ(underlying->LiveNum(), 0);
+  // the stat of the exited threads is not lost
+  EXPECT_EQ(HOST_MEMORY_STAT_CURRENT_VALUE(ThreadCached, 0), cached_bytes);
+}
+
+TEST(ThreadCachingCPUAllocator, trim_central_pool) {
+  auto underlying = std::make_shared<CountedAllocator>();
+  // room for 128 blocks of 512 bytes
+  auto allocator = std::make_shared<ThreadCachingCPUAllocator>(
+      underlying, 256 << 10, 64 << 10);
+  int64_t cached_bytes = HOST_MEMORY_STAT_CURRENT_VALUE(ThreadCached, 0);
+
+  std::thread worker([&] {
+    std::vector<AllocationPtr> allocations;
+    for (int i = 0; i < 1024; ++i) {
+      allocations.emplace_back(allocator->Allocate(512));
+    }
+    allocations.clear();
+    // at most two batches of 32 blocks are left in the thread cache
+    EXPECT_LE(underlying->LiveNum(), 128 + 64);
+  });
+  worker.join();
+  EXPECT_LE(underlying->LiveNum(), 128);
+  EXPECT_GT(underlying->LiveNum(), 0);
+  allocator->Release(phi::CPUPlace());
+  EXPECT_EQ(underlying->LiveNum(), 0);
+  EXPECT_EQ(HOST_MEMORY_STAT_CURRENT_VALUE(ThreadCached, 0), cached_bytes);
+}
+
+TEST(ThreadCachingCPUAllocator, drop_cache_of_destroyed_allocator) {
+  auto underlying = std::make_shared<CountedAllocator>();
+  auto allocator = std::make_shared<ThreadCachingCPUAllocator>(
+      underlying, 256 << 10, 64 << 20);
+  std::promise<void> cached, destroyed;
+  std::thread worker([&] {
+    allocator->Allocate(1024);
+    cached.set_value();
+    destroyed.get_future().wait();
+
+    // the next allocator used by the thread drops the stale cache
+    auto other = std::make_shared<ThreadCachingCPUAllocator>(
+        std::make_shared<CountedAllocator>(), 256 << 10, 64 << 20);
+    other->Allocate(1024);
+    EXPECT_EQ(underlying->LiveNum(), 0);
+  });
+  cached.get_future().wait();
+  EXPECT_EQ(underlying->LiveNum(), 1);
+  allocator.reset();
+  destroyed.set_value();
+  worker.join();
+}
+
+}  // namespace allocation
+}  // namespace memory
+}  // namespace paddle
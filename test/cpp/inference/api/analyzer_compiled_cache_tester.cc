@@ -0,0 +1,219 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <dirent.h>
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <thread>  // NOLINT
+
+#include "paddle/fluid/inference/api/compiled_predictor_cache.h"
+#include "test/cpp/inference/api/tester_helper.h"
+
+namespace paddle_infer {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+Config GetConfig() {
+  Config config;
+  config.SetModel(FLAGS_infer_model + "/__model__",
+                  FLAGS_infer_model + "/__params__");
+  config.DisableGpu();
+  config.SetCpuMathLibraryNumThreads(FLAGS_cpu_num_threads);
+  config.EnableMemoryOptim();
+  return config;
+}
+
+std::string CacheDir(const std::string& name) {
+  return "compiled_cache_test_" + name + "_" + std::to_string(getpid());
+}
+
+// the complete entries of the cache
+std::vector<std::string> Entries(const std::string& cache_dir) {
+  std::vector<std::string> entries;
+  DIR* dir = opendir(cache_dir.c_str());
+  if (dir == nullptr) {
+    return entries;
+  }
+  while (struct dirent* entry = readdir(dir)) {
+    std::string name = entry->d_name;
+    if (name != "." && name != ".." &&
+        std::ifstream(cache_dir + "/" + name + "/manifest.bin").good()) {
+      entries.push_back(name);
+    }
+  }
+  closedir(dir);
+  return entries;
+}
+
+std::vector<float> RandomImage() {
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<float> dist(0.f, 1.f);
+  std::vector<float> image(3 * 224 * 224);
+  for (auto& value : image) {
+    value = dist(gen);
+  }
+  return image;
+}
+
+std::vector<float> Run(Predictor* predictor, const std::vector<float>& image) {
+  auto input = predictor->GetInputHandle(predictor->GetInputNames()[0]);
+  input->Reshape({1, 3, 224, 224});
+  input->CopyFromCpu(image.data());
+  predictor->Run();
+  auto output = predictor->GetOutputHandle(predictor->GetOutputNames()[0]);
+  std::vector<int> shape = output->shape();
+  std::vector<float> result(std::accumulate(
+      shape.begin(), shape.end(), 1, std::multiplies<int>()));
+  output->CopyToCpu(result.data());
+  return result;
+}
+
+void ExpectNear(const std::vector<float>& result,
+                const std::vector<float>& expected) {
+  ASSERT_EQ(result.size(), expected.size());
+  for (size_t i = 0; i < result.size(); ++i) {
+    EXPECT_NEAR(result[i], expected[i], FLAGS_accuracy);
+  }
+}
+
+// The time to the first inference: creating the predictor and running it.
+double FirstInferenceMs(const Config& config,
+                        const std::vector<float>& image) {
+  auto start = Clock::now();
+  auto predictor = CreatePredictor(config);
+  Run(predictor.get(), image);
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+}  // namespace
+
+TEST(CompiledPredictorCache, compare_with_predictor) {
+  std::vector<float> image = RandomImage();
+  auto predictor = CreatePredictor(GetConfig());
+  std::vector<float> expected = Run(predictor.get(), image);
+
+  const std::string cache_dir = CacheDir("compare");
+  Config config = GetConfig();
+  config.EnableCompiledPredictorCache(cache_dir);
+  ASSERT_EQ(config.compiled_predictor_cache_dir(), cache_dir);
+
+  // the first predictor fills the entry, the next one loads it
+  for (int i = 0; i < 2; ++i) {
+    auto cached_predictor = CreatePredictor(config);
+    ExpectNear(Run(cached_predictor.get(), image), expected);
+    auto clone = cached_predictor->Clone();
+    ExpectNear(Run(clone.get(), image), expected);
+    EXPECT_EQ(Entries(cache_dir).size(), 1UL);
+  }
+
+  // another config has its own entry
+  Config other_config = GetConfig();
+  other_config.EnableCompiledPredictorCache(cache_dir);
+  other_config.EnableMemoryOptim(false);
+  auto other_predictor = CreatePredictor(other_config);
+  ExpectNear(Run(other_predictor.get(), image), expected);
+  EXPECT_EQ(Entries(cache_dir).size(), 2UL);
+}
+
+TEST(CompiledPredictorCache, key_of_model_dir) {
+  const std::string model_dir = CacheDir("model_dir");
+  ASSERT_EQ(mkdir(model_dir.c_str(), 0755), 0);
+  auto write = [&](const std::string& name, const std::string& content) {
+    std::ofstream(model_dir + "/" + name) << content;
+  };
+  write("__model__", "program");
+  write("fc_0.w_0", "weight");
+  auto key = [&]() {
+    return paddle::inference::CompiledPredictorCache::Key(
+        "", "", model_dir, "config");
+  };
+  std::string old_key = key();
+  EXPECT_EQ(key(), old_key);
+
+  // a param overwritten in place, only its own mtime changes
+  write("fc_0.w_0", "WEIGHT");
+  struct utimbuf times = {1000, 1000};
+  ASSERT_EQ(utime((model_dir + "/fc_0.w_0").c_str(), &times), 0);
+  EXPECT_NE(key(), old_key);
+
+  // a param replaced by a file of the same size and mtime, only its inode
+  // changes
+  old_key = key();
+  write("fc_0.w_0.tmp", "weight");
+  ASSERT_EQ(utime((model_dir + "/fc_0.w_0.tmp").c_str(), &times), 0);
+  ASSERT_EQ(rename((model_dir + "/fc_0.w_0.tmp").c_str(),
+                   (model_dir + "/fc_0.w_0").c_str()),
+            0);
+  EXPECT_NE(key(), old_key);
+
+  remove((model_dir + "/__model__").c_str());
+  remove((model_dir + "/fc_0.w_0").c_str());
+  rmdir(model_dir.c_str());
+}
+
+TEST(CompiledPredictorCache, lock_entry) {
+  const std::string cache_dir = CacheDir("lock");
+  paddle::inference::CompiledPredictorCache filler(cache_dir, "entry");
+  paddle::inference::CompiledPredictorCache waiter(cache_dir, "entry");
+  ASSERT_TRUE(filler.Lock());
+
+  // the waiter takes the lock once the filler committed the entry
+  std::atomic<bool> locked{false};
+  std::thread thread([&] {
+    EXPECT_TRUE(waiter.Lock());
+    locked = true;
+    EXPECT_TRUE(waiter.IsComplete());
+    waiter.Unlock();
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_FALSE(locked);
+  ASSERT_TRUE(filler.Commit());
+  filler.Unlock();
+  thread.join();
+  EXPECT_TRUE(locked);
+}
+
+// The time to the first inference without the cache, with an empty cache and
+// with the entry of the predictor in the cache. Disabled in CI, run it with
+// --gtest_also_run_disabled_tests.
+TEST(BENCHMARK, DISABLED_compiled_predictor_cache) {
+  const int repeat = std::max(FLAGS_repeat, 1);
+  std::vector<float> image = RandomImage();
+  const std::string cache_dir = CacheDir("benchmark");
+  Config cached_config = GetConfig();
+  cached_config.EnableCompiledPredictorCache(cache_dir);
+
+  double cold_ms = FirstInferenceMs(cached_config, image);
+  double uncached_ms = 0, warm_ms = 0;
+  for (int i = 0; i < repeat; ++i) {
+    uncached_ms += FirstInferenceMs(GetConfig(), image);
+    warm_ms += FirstInferenceMs(cached_config, image);
+  }
+  LOG(INFO) << "time to the first inference: without the cache "
+            << uncached_ms / repeat << " ms, cold " << cold_ms
+            << " ms, warm " << warm_ms / repeat << " ms";
+}
+
+}  // namespace paddle_infer
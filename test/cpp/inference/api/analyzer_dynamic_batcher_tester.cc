@@ -0,0 +1,275 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <thread>  // NOLINT
+
+#include "test/cpp/inference/api/tester_helper.h"
+
+PD_DEFINE_int32(batcher_clients,
+                16,
+                "The client threads submitting to the DynamicBatcher.");
+PD_DEFINE_int32(batcher_max_batch_size, 8, "The max batch size of a run.");
+PD_DEFINE_int32(batcher_max_queue_delay_us,
+                2000,
+                "How long the first request of a run waits for others.");
+
+namespace paddle_infer {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+Config GetConfig() {
+  Config config;
+  config.SetModel(FLAGS_infer_model + "/__model__",
+                  FLAGS_infer_model + "/__params__");
+  config.DisableGpu();
+  config.SetCpuMathLibraryNumThreads(FLAGS_cpu_num_threads);
+  return config;
+}
+
+paddle::PaddleTensor RandomImage(std::mt19937* gen) {
+  std::uniform_real_distribution<float> dist(0.f, 1.f);
+  paddle::PaddleTensor tensor;
+  tensor.shape = {1, 3, 224, 224};
+  tensor.dtype = paddle::PaddleDType::FLOAT32;
+  size_t numel = 3 * 224 * 224;
+  tensor.data.Resize(numel * sizeof(float));
+  float* data = static_cast<float*>(tensor.data.data());
+  for (size_t i = 0; i < numel; ++i) {
+    data[i] = dist(*gen);
+  }
+  return tensor;
+}
+
+std::vector<float> RunDirectly(Predictor* predictor,
+                               const paddle::PaddleTensor& image) {
+  auto input = predictor->GetInputHandle(predictor->GetInputNames()[0]);
+  input->Reshape(image.shape);
+  input->CopyFromCpu(static_cast<const float*>(image.data.data()));
+  predictor->Run();
+  auto output = predictor->GetOutputHandle(predictor->GetOutputNames()[0]);
+  std::vector<int> shape = output->shape();
+  std::vector<float> result(std::accumulate(
+      shape.begin(), shape.end(), 1, std::multiplies<int>()));
+  output->CopyToCpu(result.data());
+  return result;
+}
+
+std::vector<float> ToVector(const paddle::PaddleTensor& tensor) {
+  const float* data = static_cast<const float*>(tensor.data.data());
+  return std::vector<float>(data, data + tensor.data.length() / sizeof(float));
+}
+
+void PrintLatency(const std::string& name,
+                  std::vector<double> latency_ms,
+                  double elapsed_ms) {
+  std::sort(latency_ms.begin(), latency_ms.end());
+  LOG(INFO) << name << ": " << latency_ms.size() << " requests in "
+            << elapsed_ms << " ms, "
+            << latency_ms.size() * 1000. / elapsed_ms << " requests/s, "
+            << "latency p50 " << latency_ms[latency_ms.size() / 2]
+            << " ms, p99 " << latency_ms[latency_ms.size() * 99 / 100]
+            << " ms";
+}
+
+}  // namespace
+
+TEST(DynamicBatcher, compare_with_predictor) {
+  const int request_num = 16;
+  std::mt19937 gen(0);
+  std::vector<paddle::PaddleTensor> images;
+  std::vector<std::vector<float>> expected;
+  auto predictor = CreatePredictor(GetConfig());
+  for (int i = 0; i < request_num; ++i) {
+    images.emplace_back(RandomImage(&gen));
+    expected.emplace_back(RunDirectly(predictor.get(), images.back()));
+  }
+
+  services::DynamicBatcher::Options options;
+  options.num_predictors = 2;
+  options.max_batch_size = 4;
+  options.max_queue_delay_us = 10000;
+  services::DynamicBatcher batcher(GetConfig(), options);
+
+  std::vector<std::future<std::vector<paddle::PaddleTensor>>> futures(
+      request_num);
+  std::vector<std::thread> clients;
+  for (int c = 0; c < 4; ++c) {
+    clients.emplace_back([&, c] {
+      for (int i = c; i < request_num; i += 4) {
+        futures[i] = batcher.Submit({images[i]});
+      }
+    });
+  }
+  for (auto& client : clients) {
+    client.join();
+  }
+
+  for (int i = 0; i < request_num; ++i) {
+    std::vector<paddle::PaddleTensor> outputs = futures[i].get();
+    ASSERT_EQ(outputs.size(), 1UL);
+    EXPECT_EQ(outputs[0].shape[0], 1);
+    std::vector<float> result = ToVector(outputs[0]);
+    ASSERT_EQ(result.size(), expected[i].size());
+    for (size_t j = 0; j < result.size(); ++j) {
+      EXPECT_NEAR(result[j], expected[i][j], FLAGS_accuracy);
+    }
+  }
+
+  auto statistics = batcher.GetStatistics();
+  EXPECT_EQ(statistics.request_num, static_cast<uint64_t>(request_num));
+  EXPECT_LE(statistics.batch_num, statistics.request_num);
+  EXPECT_GE(statistics.batch_num,
+            static_cast<uint64_t>(request_num / options.max_batch_size));
+}
+
+TEST(DynamicBatcher, wrong_input) {
+  services::DynamicBatcher::Options options;
+  services::DynamicBatcher batcher(GetConfig(), options);
+  std::mt19937 gen(0);
+  paddle::PaddleTensor image = RandomImage(&gen);
+  image.name = "not_an_input";
+  EXPECT_ANY_THROW(batcher.Submit({image}));
+  EXPECT_ANY_THROW(batcher.Submit({}));
+}
+
+TEST(DynamicBatcher, wrong_options) {
+  services::DynamicBatcher::Options options;
+  options.num_predictors = 0;
+  EXPECT_ANY_THROW(services::DynamicBatcher(GetConfig(), options));
+  options.num_predictors = 1;
+  options.max_batch_size = 0;
+  EXPECT_ANY_THROW(services::DynamicBatcher(GetConfig(), options));
+  options.max_batch_size = 8;
+  options.max_queue_delay_us = -1;
+  EXPECT_ANY_THROW(services::DynamicBatcher(GetConfig(), options));
+}
+
+TEST(DynamicBatcher, unbatched_output) {
+  std::mt19937 gen(0);
+  std::vector<paddle::PaddleTensor> images = {RandomImage(&gen),
+                                              RandomImage(&gen)};
+  auto predictor = CreatePredictor(GetConfig());
+  std::string output_name = predictor->GetOutputNames()[0];
+  size_t numel = RunDirectly(predictor.get(), images[0]).size();
+
+  // the two requests fill a batch, whose output is given whole to both
+  services::DynamicBatcher::Options options;
+  options.max_batch_size = 2;
+  options.max_queue_delay_us = 1000000;
+  options.unbatched_output_names = {output_name};
+  services::DynamicBatcher batcher(GetConfig(), options);
+  auto first = batcher.Submit({images[0]});
+  auto second = batcher.Submit({images[1]});
+  for (auto* future : {&first, &second}) {
+    std::vector<paddle::PaddleTensor> outputs = future->get();
+    ASSERT_EQ(outputs.size(), 1UL);
+    EXPECT_EQ(outputs[0].shape[0], 2);
+    EXPECT_EQ(ToVector(outputs[0]).size(), 2 * numel);
+  }
+  EXPECT_EQ(batcher.GetStatistics().batch_num, 1UL);
+}
+
+// Serves batch size 1 requests from closed-loop clients, with the
+// predictors of a PredictorPool used directly, one client per predictor,
+// then with a DynamicBatcher over the same number of predictors. Disabled
+// in CI, run it with --gtest_also_run_disabled_tests.
+TEST(BENCHMARK, DISABLED_dynamic_batcher) {
+  const int predictor_num = std::max(FLAGS_num_threads, 1);
+  const int requests_per_client = std::max(FLAGS_repeat, 1) * 16;
+  std::mt19937 gen(0);
+  paddle::PaddleTensor image = RandomImage(&gen);
+
+  {
+    services::PredictorPool pool(GetConfig(), predictor_num);
+    std::vector<std::vector<double>> latency_ms(predictor_num);
+    std::vector<std::thread> clients;
+    auto start = Clock::now();
+    for (int c = 0; c < predictor_num; ++c) {
+      clients.emplace_back([&, c] {
+        Predictor* predictor = pool.Retrieve(c);
+        for (int i = 0; i < requests_per_client; ++i) {
+          auto begin = Clock::now();
+          RunDirectly(predictor, image);
+          latency_ms[c].push_back(
+              std::chrono::duration<double, std::milli>(Clock::now() - begin)
+                  .count());
+        }
+      });
+    }
+    for (auto& client : clients) {
+      client.join();
+    }
+    double elapsed_ms =
+        std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count();
+    std::vector<double> all_latency_ms;
+    for (auto& client_latency_ms : latency_ms) {
+      all_latency_ms.insert(all_latency_ms.end(),
+                            client_latency_ms.begin(),
+                            client_latency_ms.end());
+    }
+    PrintLatency("PredictorPool", all_latency_ms, elapsed_ms);
+  }
+
+  {
+    services::DynamicBatcher::Options options;
+    options.num_predictors = predictor_num;
+    options.max_batch_size = FLAGS_batcher_max_batch_size;
+    options.max_queue_delay_us = FLAGS_batcher_max_queue_delay_us;
+    services::DynamicBatcher batcher(GetConfig(), options);
+
+    std::vector<std::vector<double>> latency_ms(FLAGS_batcher_clients);
+    std::vector<std::thread> clients;
+    auto start = Clock::now();
+    for (int c = 0; c < FLAGS_batcher_clients; ++c) {
+      clients.emplace_back([&, c] {
+        for (int i = 0; i < requests_per_client; ++i) {
+          auto begin = Clock::now();
+          batcher.Submit({image}).get();
+          latency_ms[c].push_back(
+              std::chrono::duration<double, std::milli>(Clock::now() - begin)
+                  .count());
+        }
+      });
+    }
+    for (auto& client : clients) {
+      client.join();
+    }
+    double elapsed_ms =
+        std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count();
+    std::vector<double> all_latency_ms;
+    for (auto& client_latency_ms : latency_ms) {
+      all_latency_ms.insert(all_latency_ms.end(),
+                            client_latency_ms.begin(),
+                            client_latency_ms.end());
+    }
+    PrintLatency("DynamicBatcher", all_latency_ms, elapsed_ms);
+    auto statistics = batcher.GetStatistics();
+    LOG(INFO) << "DynamicBatcher: " << statistics.batch_num
+              << " runs, average batch size "
+              << static_cast<double>(statistics.request_num) /
+                     statistics.batch_num;
+  }
+}
+
+}  // namespace paddle_infer
@@ -0,0 +1,93 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <random>
+
+#include "test/cpp/inference/api/tester_helper.h"
+
+namespace paddle_infer {
+
+namespace {
+
+Config GetConfig(const std::string& params_file) {
+  Config config;
+  config.SetModel(FLAGS_infer_model + "/__model__", params_file);
+  config.DisableGpu();
+  config.SetCpuMathLibraryNumThreads(FLAGS_cpu_num_threads);
+  return config;
+}
+
+std::vector<float> RandomImage() {
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<float> dist(0.f, 1.f);
+  std::vector<float> image(3 * 224 * 224);
+  for (auto& value : image) {
+    value = dist(gen);
+  }
+  return image;
+}
+
+std::vector<float> Run(Predictor* predictor, const std::vector<float>& image) {
+  auto input = predictor->GetInputHandle(predictor->GetInputNames()[0]);
+  input->Reshape({1, 3, 224, 224});
+  input->CopyFromCpu(image.data());
+  predictor->Run();
+  auto output = predictor->GetOutputHandle(predictor->GetOutputNames()[0]);
+  std::vector<int> shape = output->shape();
+  std::vector<float> result(std::accumulate(
+      shape.begin(), shape.end(), 1, std::multiplies<int>()));
+  output->CopyToCpu(result.data());
+  return result;
+}
+
+void ExpectNear(const std::vector<float>& result,
+                const std::vector<float>& expected) {
+  ASSERT_EQ(result.size(), expected.size());
+  for (size_t i = 0; i < result.size(); ++i) {
+    EXPECT_NEAR(result[i], expected[i], FLAGS_accuracy);
+  }
+}
+
+}  // namespace
+
+TEST(MmapParams, compare_with_read_params) {
+  const std::string params_file = FLAGS_infer_model + "/__params__";
+  const std::string aligned_params_file = "mmap_params_test_aligned_params";
+  ConvertToAlignedParams(params_file, aligned_params_file);
+
+  std::vector<float> image = RandomImage();
+  auto predictor = CreatePredictor(GetConfig(params_file));
+  std::vector<float> expected = Run(predictor.get(), image);
+
+  // unaligned params are copied out of the mapping
+  for (auto& file : {params_file, aligned_params_file}) {
+    Config config = GetConfig(file);
+    config.EnableMmapParams();
+    ASSERT_TRUE(config.mmap_params_enabled());
+    auto mmap_predictor = CreatePredictor(config);
+    ExpectNear(Run(mmap_predictor.get(), image), expected);
+    auto clone = mmap_predictor->Clone();
+    ExpectNear(Run(clone.get(), image), expected);
+  }
+
+  // the aligned params are still loaded as usual without the mapping
+  auto aligned_predictor = CreatePredictor(GetConfig(aligned_params_file));
+  ExpectNear(Run(aligned_predictor.get(), image), expected);
+  std::remove(aligned_params_file.c_str());
+}
+
+}  // namespace paddle_infer
@@ -18,10 +18,16 @@
 
 #include <chrono>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "paddle/phi/core/kernel_registry.h"
 
+#include "paddle/fluid/framework/new_executor/instruction/instruction_base.h"
+#include "paddle/fluid/framework/new_executor/interpreter/build_cache.h"
+#include "paddle/fluid/framework/new_executor/interpreter/instruction_statistics.h"
+#include "paddle/fluid/framework/new_executor/interpreter/static_memory_plan.h"
 #include "paddle/fluid/framework/new_executor/pir_interpreter.h"
 #include "paddle/fluid/pir/dialect/operator/ir/control_flow_op.h"
 #include "paddle/fluid/pir/dialect/operator/ir/op_dialect.h"
@@ -98,6 +104,418 @@ TEST(StandaloneExecutor, run) {
   EXPECT_EQ(res3, true);
 }
 
+TEST(StandaloneExecutor, run_locality_aware_schedule) {
+  pir::IrContext* ctx = pir::IrContext::Instance();
+  pir::Program program((ctx));
+
+  ctx->GetOrRegisterDialect<paddle::dialect::OperatorDialect>();
+
+  pir::Builder builder = pir::Builder(ctx, program.block());
+
+  // a diamond: c = a + b, d = a + c, e = b + c, f = d + e
+  paddle::dialect::FullOp a = builder.Build<paddle::dialect::FullOp>(
+      std::vector<int64_t>{2, 2}, 1.0, phi::DataType::FLOAT32, phi::CPUPlace());
+  paddle::dialect::FullOp b = builder.Build<paddle::dialect::FullOp>(
+      std::vector<int64_t>{2, 2}, 2.0, phi::DataType::FLOAT32, phi::CPUPlace());
+  auto c = builder.Build<paddle::dialect::AddOp>(a->result(0), b->result(0));
+  auto d = builder.Build<paddle::dialect::AddOp>(a->result(0), c->result(0));
+  auto e = builder.Build<paddle::dialect::AddOp>(b->result(0), c->result(0));
+  auto f = builder.Build<paddle::dialect::AddOp>(d->result(0), e->result(0));
+
+  std::string out_name = "add_out";
+  builder.Build<pir::ShadowOutputOp>(f->result(0), out_name);
+
+  auto kernel_program = paddle::dialect::PdOpLowerToKernelPass(&program);
+
+  auto place = phi::CPUPlace();
+  Scope scope;
+  interpreter::ExecutionConfig execution_config;
+  execution_config.locality_aware_schedule = true;
+  InterpreterCore test_core(
+      place, {}, kernel_program->block(), &scope, execution_config);
+
+  test_core.SetSkipGcVars({out_name});
+
+  for (int i = 0; i < 10; ++i) {
+    test_core.Run({});
+
+    auto out_tensor =
+        test_core.local_scope() == nullptr
+            ? scope.FindVar(out_name)->Get<phi::DenseTensor>()
+            : test_core.local_scope()
+                  ->FindVar(out_name)
+                  ->Get<phi::DenseTensor>();
+    for (int j = 0; j < 4; ++j) {
+      EXPECT_EQ(simple_cmp(out_tensor.data<float>()[j], 9.0), true);
+    }
+  }
+}
+
+TEST(StandaloneExecutor, run_inline_trivial_instructions) {
+  pir::IrContext* ctx = pir::IrContext::Instance();
+  pir::Program program((ctx));
+
+  ctx->GetOrRegisterDialect<paddle::dialect::OperatorDialect>();
+
+  pir::Builder builder = pir::Builder(ctx, program.block());
+
+  // a chain of small adds, c = a + b, d = c + c, e = d + a, next to a big
+  // one that is scheduled as usual
+  paddle::dialect::FullOp a = builder.Build<paddle::dialect::FullOp>(
+      std::vector<int64_t>{2, 2}, 1.0, phi::DataType::FLOAT32, phi::CPUPlace());
+  paddle::dialect::FullOp b = builder.Build<paddle::dialect::FullOp>(
+      std::vector<int64_t>{2, 2}, 2.0, phi::DataType::FLOAT32, phi::CPUPlace());
+  auto c = builder.Build<paddle::dialect::AddOp>(a->result(0), b->result(0));
+  auto d = builder.Build<paddle::dialect::AddOp>(c->result(0), c->result(0));
+  auto e = builder.Build<paddle::dialect::AddOp>(d->result(0), a->result(0));
+  paddle::dialect::FullOp big = builder.Build<paddle::dialect::FullOp>(
+      std::vector<int64_t>{64, 64},
+      1.0,
+      phi::DataType::FLOAT32,
+      phi::CPUPlace());
+  auto big_add =
+      builder.Build<paddle::dialect::AddOp>(big->result(0), big->result(0));
+
+  std::string out_name = "add_out";
+  std::string big_out_name = "big_add_out";
+  builder.Build<pir::ShadowOutputOp>(e->result(0), out_name);
+  builder.Build<pir::ShadowOutputOp>(big_add->result(0), big_out_name);
+
+  auto kernel_program = paddle::dialect::PdOpLowerToKernelPass(&program);
+
+  auto place = phi::CPUPlace();
+  Scope scope;
+  interpreter::ExecutionConfig execution_config;
+  execution_config.inline_trivial_instructions = true;
+  InterpreterCore test_core(
+      place, {}, kernel_program->block(), &scope, execution_config);
+
+  test_core.SetSkipGcVars({out_name, big_out_name});
+
+  for (int i = 0; i < 10; ++i) {
+    test_core.Run({});
+
+    const Scope* out_scope = test_core.local_scope() == nullptr
+                                 ? &scope
+                                 : test_core.local_scope();
+    auto& out_tensor = out_scope->FindVar(out_name)->Get<phi::DenseTensor>();
+    for (int j = 0; j < 4; ++j) {
+      EXPECT_EQ(simple_cmp(out_tensor.data<float>()[j], 7.0), true);
+    }
+    auto& big_out_tensor =
+        out_scope->FindVar(big_out_name)->Get<phi::DenseTensor>();
+    EXPECT_EQ(big_out_tensor.numel(), 64 * 64);
+    EXPECT_EQ(simple_cmp(big_out_tensor.data<float>()[64 * 64 - 1], 2.0),
+              true);
+  }
+}
+
+TEST(StaticMemoryPlanner, Plan) {
+  // a chain of instructions: 0 -> 1 -> 2 -> 3
+  interpreter::StaticMemoryPlanner chain(
+      [](size_t prior, size_t posterior) { return prior < posterior; });
+  size_t b0 = chain.AddBuffer(100, 0, {1});
+  size_t b1 = chain.AddBuffer(200, 1, {2});
+  size_t b2 = chain.AddBuffer(100, 2, {3});
+  EXPECT_EQ(chain.Plan(), 384UL);
+  EXPECT_EQ(chain.TotalSize(), 512UL);
+  EXPECT_EQ(chain.Offset(b1), 0UL);
+  // b0 is dead when b2 is written
+  EXPECT_EQ(chain.Offset(b0), chain.Offset(b2));
+  EXPECT_EQ(chain.Offset(b0), 256UL);
+
+  // nothing is ordered, so nothing is shared
+  interpreter::StaticMemoryPlanner parallel(
+      [](size_t prior, size_t posterior) { return false; });
+  parallel.AddBuffer(64, 0, {});
+  parallel.AddBuffer(64, 1, {});
+  parallel.AddBuffer(64, 2, {});
+  EXPECT_EQ(parallel.Plan(), parallel.TotalSize());
+}
+
+TEST(StandaloneExecutor, run_static_memory_plan) {
+  pir::IrContext* ctx = pir::IrContext::Instance();
+  pir::Program program((ctx));
+
+  ctx->GetOrRegisterDialect<paddle::dialect::OperatorDialect>();
+
+  pir::Builder builder = pir::Builder(ctx, program.block());
+
+  // a = 1, b = a + a, c = b + b, d = c + c, e = d + d
+  paddle::dialect::FullOp a = builder.Build<paddle::dialect::FullOp>(
+      std::vector<int64_t>{64, 64},
+      1.0,
+      phi::DataType::FLOAT32,
+      phi::CPUPlace());
+  auto b = builder.Build<paddle::dialect::AddOp>(a->result(0), a->result(0));
+  auto c = builder.Build<paddle::dialect::AddOp>(b->result(0), b->result(0));
+  auto d = builder.Build<paddle::dialect::AddOp>(c->result(0), c->result(0));
+  auto e = builder.Build<paddle::dialect::AddOp>(d->result(0), d->result(0));
+
+  std::string out_name = "add_out";
+  builder.Build<pir::ShadowOutputOp>(e->result(0), out_name);
+
+  auto kernel_program = paddle::dialect::PdOpLowerToKernelPass(&program);
+
+  auto place = phi::CPUPlace();
+  Scope scope;
+  interpreter::ExecutionConfig execution_config;
+  execution_config.static_memory_plan = true;
+  PirInterpreter test_core(
+      place, {}, kernel_program->block(), &scope, execution_config);
+
+  test_core.SetSkipGcVars({out_name});
+
+  for (int i = 0; i < 5; ++i) {
+    test_core.Run(std::vector<std::string>{});
+
+    // a and c, b and d share their bytes
+    EXPECT_EQ(test_core.StaticMemoryPlanArenaSize(), 2UL * 64 * 64 * 4);
+
+    auto out_tensor =
+        test_core.local_scope() == nullptr
+            ? scope.FindVar(out_name)->Get<phi::DenseTensor>()
+            : test_core.local_scope()
+                  ->FindVar(out_name)
+                  ->Get<phi::DenseTensor>();
+    for (int j = 0; j < 64 * 64; ++j) {
+      EXPECT_EQ(simple_cmp(out_tensor.data<float>()[j], 16.0), true);
+    }
+  }
+
+  // the scope may go first, the interpreter then only drops the arena
+  auto short_scope = std::make_unique<Scope>();
+  auto short_core =
+      std::make_unique<PirInterpreter>(place,
+                                       std::vector<std::string>{},
+                                       kernel_program->block(),
+                                       short_scope.get(),
+                                       execution_config);
+  short_core->SetSkipGcVars({out_name});
+  short_core->Run(std::vector<std::string>{});
+  short_core->Run(std::vector<std::string>{});
+  EXPECT_EQ(short_core->StaticMemoryPlanArenaSize(), 2UL * 64 * 64 * 4);
+  short_scope.reset();
+  short_core.reset();
+}
+
+TEST(InstructionStatistics, Collect) {
+  interpreter::InstructionStatistics statistics(2);
+  statistics.Reset({"pd_op.full", "pd_op.add"});
+  for (int i = 0; i < 4; ++i) {
+    bool sampled = statistics.BeginRun();
+    EXPECT_EQ(sampled, i % 2 == 0);
+    interpreter::InstructionStatisticsGuard guard(
+        &statistics, 1, sampled, 0, phi::CPUPlace());
+  }
+
+  auto stats = statistics.Collect();
+  ASSERT_EQ(stats.size(), 2UL);
+  // the instruction that ran comes first
+  EXPECT_EQ(stats[0].name, "pd_op.add");
+  EXPECT_EQ(stats[0].run_count, 4UL);
+  EXPECT_EQ(stats[0].sampled_count, 2UL);
+  EXPECT_EQ(stats[1].run_count, 0UL);
+
+  statistics.Reset({"pd_op.full"});
+  EXPECT_EQ(statistics.Collect()[0].run_count, 0UL);
+}
+
+TEST(InstructionStatistics, ManyInstances) {
+  // one thread serving more interpreters than it used to cache
+  std::vector<std::unique_ptr<interpreter::InstructionStatistics>> statistics;
+  for (int i = 0; i < 16; ++i) {
+    statistics.emplace_back(
+        std::make_unique<interpreter::InstructionStatistics>(1));
+    statistics.back()->Reset({"pd_op.full", "pd_op.add"});
+  }
+  for (int round = 0; round < 3; ++round) {
+    for (size_t i = 0; i < statistics.size(); ++i) {
+      statistics[i]->AddRun(i % 2);
+    }
+  }
+  statistics[0]->Reset({"pd_op.full"});
+  statistics[0]->AddRun(0);
+  EXPECT_EQ(statistics[0]->Collect()[0].run_count, 1UL);
+  for (size_t i = 1; i < statistics.size(); ++i) {
+    // nothing sampled, so the stats stay in the order of the ids
+    auto stats = statistics[i]->Collect();
+    EXPECT_EQ(stats[i % 2].run_count, 3UL);
+    EXPECT_EQ(stats[1 - i % 2].run_count, 0UL);
+  }
+}
+
+TEST(StandaloneExecutor, instruction_statistics) {
+  pir::IrContext* ctx = pir::IrContext::Instance();
+  pir::Program program((ctx));
+
+  ctx->GetOrRegisterDialect<paddle::dialect::OperatorDialect>();
+
+  pir::Builder builder = pir::Builder(ctx, program.block());
+
+  paddle::dialect::FullOp a = builder.Build<paddle::dialect::FullOp>(
+      std::vector<int64_t>{2, 2}, 1.0, phi::DataType::FLOAT32, phi::CPUPlace());
+  auto b = builder.Build<paddle::dialect::AddOp>(a->result(0), a->result(0));
+
+  std::string out_name = "add_out";
+  builder.Build<pir::ShadowOutputOp>(b->result(0), out_name);
+
+  auto kernel_program = paddle::dialect::PdOpLowerToKernelPass(&program);
+
+  int32_t sample_period = FLAGS_new_executor_instruction_stats_sample_period;
+  FLAGS_new_executor_instruction_stats_sample_period = 2;
+
+  auto place = phi::CPUPlace();
+  Scope scope;
+  InterpreterCore test_core(place, {}, kernel_program->block(), &scope);
+  test_core.SetSkipGcVars({out_name});
+  for (int i = 0; i < 4; ++i) {
+    test_core.Run({});
+  }
+  FLAGS_new_executor_instruction_stats_sample_period = sample_period;
+
+  std::string table = test_core.DumpInstructionStatistics();
+  EXPECT_NE(table.find("pd_op.add"), std::string::npos);
+  std::string json = test_core.DumpInstructionStatistics(true);
+  EXPECT_NE(
+      json.find("\"name\":\"pd_op.add\",\"run_count\":4,\"sampled_count\":2"),
+      std::string::npos);
+}
+
+TEST(DependencyBuildCache, SaveLoad) {
+  // 0 -> 1 -> 2, 0 -> 3
+  interpreter::DependencyBuildCache::DownstreamMap downstream_map = {
+      {0, {1, 3}}, {1, {2}}};
+  interpreter::DependencyBuildCache::HappensBefore happens_before(
+      4, std::vector<bool>(4, false));
+  happens_before[0][1] = happens_before[0][2] = happens_before[0][3] = true;
+  happens_before[1][2] = true;
+
+  std::string signature = "program";
+  std::string path = interpreter::DependencyBuildCache::FilePath(
+      ::testing::TempDir(), interpreter::DependencyBuildCache::Hash(signature));
+  EXPECT_TRUE(interpreter::DependencyBuildCache::Save(
+      path, signature, downstream_map, happens_before));
+
+  interpreter::DependencyBuildCache::DownstreamMap loaded_downstream_map;
+  interpreter::DependencyBuildCache::HappensBefore loaded_happens_before;
+  EXPECT_TRUE(interpreter::DependencyBuildCache::Load(
+      path, signature, 4, &loaded_downstream_map, &loaded_happens_before));
+  EXPECT_EQ(loaded_downstream_map, downstream_map);
+  EXPECT_EQ(loaded_happens_before, happens_before);
+
+  // other programs, as if their hashes collided with the one of the file
+  EXPECT_FALSE(interpreter::DependencyBuildCache::Load(
+      path, "programs", 4, &loaded_downstream_map, &loaded_happens_before));
+  EXPECT_FALSE(interpreter::DependencyBuildCache::Load(
+      path, "prograM", 4, &loaded_downstream_map, &loaded_happens_before));
+  EXPECT_FALSE(interpreter::DependencyBuildCache::Load(
+      path, signature, 5, &loaded_downstream_map, &loaded_happens_before));
+}
+
+class FakeInstruction : public InstructionBase {
+ public:
+  FakeInstruction(size_t id, const std::string& name)
+      : InstructionBase(id, phi::CPUPlace()), name_(name) {}
+  void Run() override {}
+  const std::string& Name() const override { return name_; }
+  ::pir::Operation* Operation() const override { return nullptr; }
+
+ private:
+  std::string name_;
+};
+
+TEST(DependencyBuildCache, SignatureKernelType) {
+  FakeInstruction full(0, "pd_op.full");
+  FakeInstruction add(1, "pd_op.add");
+  std::vector<InstructionBase*> instructions = {&full, &add};
+  std::string signature =
+      interpreter::DependencyBuildCache::Signature(instructions);
+  EXPECT_EQ(signature,
+            interpreter::DependencyBuildCache::Signature(instructions));
+
+  // the dependencies of asynchronous kernels differ
+  add.SetKernelType(OpFuncType::kGpuAsync);
+  EXPECT_NE(signature,
+            interpreter::DependencyBuildCache::Signature(instructions));
+}
+
+TEST(DependencyBuildCache, GetBySignature) {
+  auto& cache = interpreter::DependencyBuildCache::Instance();
+  auto downstream_map =
+      std::make_shared<interpreter::DependencyBuildCache::DownstreamMap>();
+  auto happens_before =
+      std::make_shared<interpreter::DependencyBuildCache::HappensBefore>(
+          2, std::vector<bool>(2, false));
+  cache.Put("collision test", "", downstream_map, happens_before);
+
+  std::shared_ptr<interpreter::DependencyBuildCache::DownstreamMap>
+      found_downstream_map;
+  std::shared_ptr<interpreter::DependencyBuildCache::HappensBefore>
+      found_happens_before;
+  EXPECT_TRUE(cache.Get("collision test",
+                        2,
+                        "",
+                        &found_downstream_map,
+                        &found_happens_before));
+  EXPECT_EQ(found_happens_before, happens_before);
+  // one different byte
+  EXPECT_FALSE(cache.Get("collision tesT",
+                         2,
+                         "",
+                         &found_downstream_map,
+                         &found_happens_before));
+}
+
+TEST(StandaloneExecutor, run_parallel_build) {
+  pir::IrContext* ctx = pir::IrContext::Instance();
+  pir::Program program((ctx));
+
+  ctx->GetOrRegisterDialect<paddle::dialect::OperatorDialect>();
+
+  pir::Builder builder = pir::Builder(ctx, program.block());
+
+  // a diamond: c = a + b, d = a + c, e = b + c, f = d + e
+  paddle::dialect::FullOp a = builder.Build<paddle::dialect::FullOp>(
+      std::vector<int64_t>{2, 2}, 1.0, phi::DataType::FLOAT32, phi::CPUPlace());
+  paddle::dialect::FullOp b = builder.Build<paddle::dialect::FullOp>(
+      std::vector<int64_t>{2, 2}, 2.0, phi::DataType::FLOAT32, phi::CPUPlace());
+  auto c = builder.Build<paddle::dialect::AddOp>(a->result(0), b->result(0));
+  auto d = builder.Build<paddle::dialect::AddOp>(a->result(0), c->result(0));
+  auto e = builder.Build<paddle::dialect::AddOp>(b->result(0), c->result(0));
+  auto f = builder.Build<paddle::dialect::AddOp>(d->result(0), e->result(0));
+
+  std::string out_name = "add_out";
+  builder.Build<pir::ShadowOutputOp>(f->result(0), out_name);
+
+  auto kernel_program = paddle::dialect::PdOpLowerToKernelPass(&program);
+
+  int32_t build_num_threads = FLAGS_new_executor_build_num_threads;
+  FLAGS_new_executor_build_num_threads = 4;
+
+  auto place = phi::CPUPlace();
+  auto check = [&](InterpreterCore* test_core, Scope* scope) {
+    test_core->SetSkipGcVars({out_name});
+    test_core->Run({});
+    const Scope* out_scope = test_core->local_scope() == nullptr
+                                 ? scope
+                                 : test_core->local_scope();
+    auto& out_tensor = out_scope->FindVar(out_name)->Get<phi::DenseTensor>();
+    for (int j = 0; j < 4; ++j) {
+      EXPECT_EQ(simple_cmp(out_tensor.data<float>()[j], 9.0), true);
+    }
+  };
+  Scope scope;
+  InterpreterCore test_core(place, {}, kernel_program->block(), &scope);
+  check(&test_core, &scope);
+  // takes the dependencies of test_core from the build cache
+  Scope another_scope;
+  InterpreterCore another_core(
+      place, {}, kernel_program->block(), &another_scope);
+  check(&another_core, &another_scope);
+  FLAGS_new_executor_build_num_threads = build_num_threads;
+}
+
 TEST(StandaloneExecutor, run_error) {
   pir::IrContext* ctx = pir::IrContext::Instance();
   pir::Program program((ctx));
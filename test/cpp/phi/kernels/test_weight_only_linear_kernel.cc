@@ -0,0 +1,202 @@
+// Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <sys/time.h>
+
+#include <random>
+#include <string>
+
+#include "glog/logging.h"
+#include "paddle/phi/backends/context_pool.h"
+#include "paddle/phi/backends/cpu/cpu_context.h"
+#include "paddle/phi/core/dense_tensor.h"
+#include "paddle/phi/core/meta_tensor.h"
+#include "paddle/phi/infermeta/binary.h"
+#include "paddle/phi/infermeta/multiary.h"
+#include "paddle/phi/infermeta/unary.h"
+#include "paddle/phi/kernels/matmul_kernel.h"
+#include "paddle/phi/kernels/weight_only_linear_kernel.h"
+#include "paddle/phi/kernels/weight_quantize_kernel.h"
+
+namespace phi {
+namespace tests {
+
+namespace {
+
+// weight_quantize lays the weight out row major for this arch, which is the
+// layout weight_only_linear reads on CPU
+constexpr int kArch = 70;
+
+inline double GetCurrentUS() {
+  struct timeval time = {};
+  gettimeofday(&time, nullptr);
+  return 1e+6 * time.tv_sec + time.tv_usec;  // NOLINT
+}
+
+const CPUContext& GetContext() {
+  auto& pool = phi::DeviceContextPool::Instance();
+  return *static_cast<const CPUContext*>(pool.GetByPlace(phi::CPUPlace()));
+}
+
+DenseTensor RandomTensor(const std::vector<int64_t>& dims, unsigned seed) {
+  DenseTensor tensor;
+  tensor.Resize(common::make_ddim(dims));
+  float* data = GetContext().Alloc<float>(&tensor);
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> dist(-1.f, 1.f);
+  for (int64_t i = 0; i < tensor.numel(); ++i) {
+    data[i] = dist(rng);
+  }
+  return tensor;
+}
+
+// A [k, n] weight that quantizes without error: every group of a column is
+// an integer multiple of the scale of the column and reaches the bound.
+DenseTensor QuantizableWeight(int k, int n, int bits, int group_size) {
+  const int bound = bits == 8 ? 127 : 7;
+  const int rows_per_scale = group_size > 0 ? group_size : k;
+  DenseTensor weight;
+  weight.Resize({k, n});
+  float* data = GetContext().Alloc<float>(&weight);
+  std::mt19937 rng(k + n + bits);
+  std::uniform_int_distribution<int> dist(-bound, bound);
+  for (int j = 0; j < n; ++j) {
+    const float scale = 0.25f * static_cast<float>(j % 7 + 1);
+    for (int i = 0; i < k; ++i) {
+      const int value = i % rows_per_scale == 0 ? bound : dist(rng);
+      data[i * n + j] = static_cast<float>(value) * scale;
+    }
+  }
+  return weight;
+}
+
+void Quantize(const DenseTensor& weight,
+              const std::string& weight_dtype,
+              int group_size,
+              DenseTensor* quant_weight,
+              DenseTensor* scale) {
+  const std::string algo = "weight_only_" + weight_dtype;
+  MetaTensor meta_out(quant_weight);
+  MetaTensor meta_scale(scale);
+  WeightQuantizeInferMeta(
+      weight, algo, kArch, group_size, &meta_out, &meta_scale);
+  WeightQuantizeKernel<float, CPUContext>(
+      GetContext(), weight, algo, kArch, group_size, quant_weight, scale);
+}
+
+DenseTensor WeightOnlyLinear(const DenseTensor& x,
+                             const DenseTensor& quant_weight,
+                             const DenseTensor& scale,
+                             const std::string& weight_dtype,
+                             int group_size) {
+  DenseTensor out;
+  MetaTensor meta_out(&out);
+  WeightOnlyLinearInferMeta(x,
+                            quant_weight,
+                            MetaTensor(),
+                            scale,
+                            weight_dtype,
+                            kArch,
+                            group_size,
+                            &meta_out);
+  WeightOnlyLinearKernel<float, CPUContext>(GetContext(),
+                                            x,
+                                            quant_weight,
+                                            paddle::none,
+                                            scale,
+                                            weight_dtype,
+                                            kArch,
+                                            group_size,
+                                            &out);
+  return out;
+}
+
+DenseTensor Matmul(const DenseTensor& x, const DenseTensor& weight) {
+  DenseTensor out;
+  MetaTensor meta_out(&out);
+  MatmulInferMeta(x, weight, false, false, &meta_out);
+  MatmulKernel<float, CPUContext>(GetContext(), x, weight, false, false, &out);
+  return out;
+}
+
+void CheckWeightOnlyLinear(int m,
+                           int k,
+                           int n,
+                           const std::string& weight_dtype,
+                           int group_size) {
+  const int bits = weight_dtype == "int8" ? 8 : 4;
+  DenseTensor weight = QuantizableWeight(k, n, bits, group_size);
+  DenseTensor quant_weight, scale;
+  Quantize(weight, weight_dtype, group_size, &quant_weight, &scale);
+
+  DenseTensor x = RandomTensor({m, k}, m);
+  DenseTensor out =
+      WeightOnlyLinear(x, quant_weight, scale, weight_dtype, group_size);
+  DenseTensor expected = Matmul(x, weight);
+  ASSERT_EQ(out.dims(), expected.dims());
+  const float* out_data = out.data<float>();
+  const float* expected_data = expected.data<float>();
+  for (int64_t i = 0; i < out.numel(); ++i) {
+    ASSERT_NEAR(out_data[i], expected_data[i], 1e-3 * k)
+        << "m " << m << " " << weight_dtype << " group_size " << group_size;
+  }
+}
+
+}  // namespace
+
+TEST(WeightOnlyLinear, compare_with_matmul) {
+  for (const std::string weight_dtype : {"int8", "int4"}) {
+    for (int group_size : {-1, 64, 128}) {
+      // the rows go through the register tiles, then through blas
+      for (int m : {1, 3, 4, 7, 40}) {
+        CheckWeightOnlyLinear(m, 256, 192, weight_dtype, group_size);
+      }
+    }
+  }
+}
+
+// GEMV and GEMM of weight_only_linear against matmul over the float weight.
+// Disabled in CI, run it with --gtest_also_run_disabled_tests.
+TEST(BENCHMARK, DISABLED_weight_only_linear) {
+  constexpr int repeat = 10;
+  constexpr int k = 4096;
+  constexpr int n = 4096;
+  DenseTensor weight = RandomTensor({k, n}, 0);
+  for (int m : {1, 64}) {
+    DenseTensor x = RandomTensor({m, k}, m);
+    Matmul(x, weight);
+    double start = GetCurrentUS();
+    for (int i = 0; i < repeat; ++i) {
+      Matmul(x, weight);
+    }
+    const double matmul_us = (GetCurrentUS() - start) / repeat;
+    for (const std::string weight_dtype : {"int8", "int4"}) {
+      DenseTensor quant_weight, scale;
+      Quantize(weight, weight_dtype, 128, &quant_weight, &scale);
+      WeightOnlyLinear(x, quant_weight, scale, weight_dtype, 128);
+      start = GetCurrentUS();
+      for (int i = 0; i < repeat; ++i) {
+        WeightOnlyLinear(x, quant_weight, scale, weight_dtype, 128);
+      }
+      const double weight_only_us = (GetCurrentUS() - start) / repeat;
+      LOG(INFO) << "m " << m << ", k " << k << ", n " << n
+                << ": matmul takes " << matmul_us << " us, weight_only_linear "
+                << weight_dtype << " takes " << weight_only_us << " us";
+    }
+  }
+}
+
+}  // namespace tests
+}  // namespace phi
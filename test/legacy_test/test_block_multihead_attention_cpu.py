@@ -0,0 +1,229 @@
+# Copyright (c) 2024 PaddlePaddle Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+import unittest
+
+import numpy as np
+from test_block_multihead_attention import (
+    block_cache_to_naive_cache,
+    create_attn_mask,
+    get_padding_offset,
+    naive_attention_impl,
+    remove_padding,
+)
+
+import paddle
+from paddle.incubate.nn.functional import block_multihead_attention
+
+paddle.seed(2024)
+np.random.seed(2024)
+
+
+class TestBlockMultiHeadAttnEncDecCPU(unittest.TestCase):
+    def setUp(self):
+        paddle.disable_static()
+        paddle.set_device("cpu")
+        self.name = "TestBlockMultiHeadAttnEncDecCPU"
+        self.place = paddle.CPUPlace()
+        self.batch_size = 2
+        self.num_head = 8
+        self.kv_num_head = 8
+        self.seq_len = 40
+        self.max_dec_len = 24
+        self.dim_head = 64
+        self.blocksize = 16
+        self.dtype = "float32"
+        self.init_config()
+        self.q_hid_dim = self.num_head * self.dim_head
+        self.kv_hid_dim = self.kv_num_head * self.dim_head
+        self.block_num_per_seq = (
+            self.seq_len + self.max_dec_len + self.blocksize - 1
+        ) // self.blocksize
+        self.max_block_num = self.block_num_per_seq * self.batch_size
+        # hand the blocks out of order, as a serving engine would
+        self.free_list = list(np.random.permutation(self.max_block_num))
+        self.seq_lens_encoder = paddle.to_tensor(
+            [self.seq_len] * self.batch_size, "int32"
+        )
+        self.seq_lens_decoder = paddle.to_tensor([0] * self.batch_size, "int32")
+        self.seq_lens_this_time = self.seq_lens_encoder.clone()
+        self.cache_shape = (
+            self.max_block_num,
+            self.kv_num_head,
+            self.blocksize,
+            self.dim_head,
+        )
+        self.attention_mask = create_attn_mask(
+            self.dtype, self.batch_size, [self.seq_len] * self.batch_size
+        )
+        self.tgt_mask = paddle.randn(
+            [self.batch_size, self.num_head, 1, self.seq_len + 1],
+            dtype=self.dtype,
+        )
+        self.scale = 1.0 / np.sqrt(self.dim_head)
+        self.cache_k = paddle.zeros(shape=self.cache_shape, dtype=self.dtype)
+        self.cache_v = paddle.zeros(shape=self.cache_shape, dtype=self.dtype)
+        self.block_tables = paddle.zeros(
+            shape=(self.batch_size, self.block_num_per_seq), dtype="int32"
+        )
+        for i in range(self.batch_size):
+            for j in range(self.block_num_per_seq):
+                self.block_tables[i, j] = int(self.free_list.pop())
+
+    def init_config(self):
+        pass
+
+    def get_qkv(self, seq_len):
+        q = paddle.to_tensor(
+            np.random.random(
+                (self.batch_size, self.num_head, seq_len, self.dim_head)
+            ),
+            place=self.place,
+            dtype=self.dtype,
+        )
+        k = paddle.to_tensor(
+            np.random.random(
+                (self.batch_size, self.kv_num_head, seq_len, self.dim_head)
+            ),
+            place=self.place,
+            dtype=self.dtype,
+        )
+        v = paddle.to_tensor(
+            np.random.random(
+                (self.batch_size, self.kv_num_head, seq_len, self.dim_head)
+            ),
+            place=self.place,
+            dtype=self.dtype,
+        )
+        token_num = self.batch_size * seq_len
+        qkv = paddle.concat(
+            [
+                q.transpose([0, 2, 1, 3]).reshape([token_num, self.q_hid_dim]),
+                k.transpose([0, 2, 1, 3]).reshape([token_num, self.kv_hid_dim]),
+                v.transpose([0, 2, 1, 3]).reshape([token_num, self.kv_hid_dim]),
+            ],
+            axis=1,
+        )
+        return q, k, v, qkv
+
+    def run_block_attention(self, qkv, max_seq_len, mask, tgt_mask):
+        padding_offset, cum_offset, cu_seqlens_q, cu_seqlens_k = (
+            get_padding_offset(
+                self.batch_size, max_seq_len, self.seq_lens_this_time
+            )
+        )
+        return block_multihead_attention(
+            qkv,
+            self.cache_k,
+            self.cache_v,
+            self.seq_lens_encoder,
+            self.seq_lens_decoder,
+            self.seq_lens_this_time,
+            padding_offset,
+            cum_offset,
+            cu_seqlens_q,
+            cu_seqlens_k,
+            self.block_tables,
+            None,  # pre_key_cache
+            None,  # pre_value_cache
+            None,  # cache_k_quant_scales
+            None,  # cache_v_quant_scales
+            None,  # cache_k_dequant_scales
+            None,  # cache_v_dequant_scales
+            None,  # qkv_out_scale
+            None,  # qkv_bias
+            None,  # out_shift
+            None,  # out_smooth
+            None,  # max_enc_len_this_time
+            None,  # max_dec_len_this_time
+            None,  # rotary_embs
+            mask,  # attn_mask
+            tgt_mask,  # tgt_mask
+            max_seq_len,
+            self.blocksize,
+            False,  # use_neox_rotary_style
+        )[0]
+
+    def test_all(self):
+        paddle.disable_static()
+        # encoder, causal
+        q, k, v, qkv = self.get_qkv(self.seq_len)
+        out_ = naive_attention_impl(
+            q, k, v, None, None, None, None, self.attention_mask, self.scale
+        )
+        _, _, cu_seqlens_q, _ = get_padding_offset(
+            self.batch_size, self.seq_len, self.seq_lens_this_time
+        )
+        token_num = self.batch_size * self.seq_len
+        out_ = remove_padding(
+            self.seq_lens_this_time, cu_seqlens_q, out_, token_num
+        )
+        out = self.run_block_attention(qkv, self.seq_len, None, None)
+        np.testing.assert_allclose(
+            out.numpy(), out_.numpy(), rtol=1e-05, atol=1e-05
+        )
+
+        # encoder with the mask gives the same result
+        out = self.run_block_attention(
+            qkv, self.seq_len, self.attention_mask, None
+        )
+        np.testing.assert_allclose(
+            out.numpy(), out_.numpy(), rtol=1e-05, atol=1e-05
+        )
+
+        # decoder
+        naive_cache_k, naive_cache_v = block_cache_to_naive_cache(
+            self.cache_k,
+            self.cache_v,
+            self.batch_size,
+            self.block_tables,
+            self.seq_len,
+        )
+        group = self.num_head // self.kv_num_head
+        naive_cache_k = paddle.repeat_interleave(naive_cache_k, group, axis=1)
+        naive_cache_v = paddle.repeat_interleave(naive_cache_v, group, axis=1)
+        self.seq_lens_decoder[:] = self.seq_lens_encoder
+        self.seq_lens_encoder[:] = 0
+        self.seq_lens_this_time[:] = 1
+        q, k, v, qkv = self.get_qkv(1)
+        out_ = (
+            naive_attention_impl(
+                q,
+                k,
+                v,
+                naive_cache_k,
+                naive_cache_v,
+                None,
+                None,
+                self.tgt_mask,
+                self.scale,
+            )
+            .transpose([0, 2, 1, 3])
+            .reshape([self.batch_size, -1])
+        )
+        out = self.run_block_attention(qkv, 1, None, self.tgt_mask)
+        np.testing.assert_allclose(
+            out.numpy(), out_.numpy(), rtol=1e-05, atol=1e-05
+        )
+
+
+class TestBlockMultiHeadAttnEncDecGQACPU(TestBlockMultiHeadAttnEncDecCPU):
+    def init_config(self):
+        self.name = "TestBlockMultiHeadAttnEncDecGQACPU"
+        self.kv_num_head = 2
+        self.dim_head = 36
+
+
+if __name__ == "__main__":
+    unittest.main()